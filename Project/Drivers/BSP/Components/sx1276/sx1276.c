@@ -1367,16 +1367,12 @@ uint8_t SX1276Read( uint8_t addr )
 
 void SX1276WriteBuffer( uint8_t addr, uint8_t *buffer, uint8_t size )
 {
-    uint8_t i;
-
     //NSS = 0;
     HW_GPIO_Write( RADIO_NSS_PORT, RADIO_NSS_PIN, 0 );
 
     HW_SPI_InOut( addr | 0x80 );
-    for( i = 0; i < size; i++ )
-    {
-        HW_SPI_InOut( buffer[i] );
-    }
+    // Single registers stay polled, FIFO loads go over DMA
+    HW_SPI_Burst( buffer, NULL, size );
 
     //NSS = 1;
     HW_GPIO_Write( RADIO_NSS_PORT, RADIO_NSS_PIN, 1 );
@@ -1384,17 +1380,11 @@ void SX1276WriteBuffer( uint8_t addr, uint8_t *buffer, uint8_t size )
 
 void SX1276ReadBuffer( uint8_t addr, uint8_t *buffer, uint8_t size )
 {
-    uint8_t i;
-
     //NSS = 0;
     HW_GPIO_Write( RADIO_NSS_PORT, RADIO_NSS_PIN, 0 );
 
     HW_SPI_InOut( addr & 0x7F );
-
-    for( i = 0; i < size; i++ )
-    {
-        buffer[i] = HW_SPI_InOut( 0 );
-    }
+    HW_SPI_Burst( NULL, buffer, size );
 
     //NSS = 1;
     HW_GPIO_Write( RADIO_NSS_PORT, RADIO_NSS_PIN, 1 );
@@ -33,12 +33,8 @@ Maintainer: Miguel Luis ( Semtech ), Gregory Cristian ( Semtech ) and Daniel Jae
 
 #include "debug_uart.h"
 #include "global.h"
-
-#ifndef DISABLE_SEND_DEBUG
-	#define dbg_send(...) Debug_printf(__VA_ARGS__)//; await_uart_tx()
-#else
-	#define dbg_send(...)
-#endif
+#include "mac_trace.h"
+#include "lora_class_b.h"
 
 #ifndef DISABLE_LORA_CLASS_DEBUG
 	#define LORA_CLASS_printf(...) Debug_printf(__VA_ARGS__)//; await_uart_tx()
@@ -422,6 +418,12 @@ static MlmeConfirm_t MlmeConfirm;
  */
 static uint8_t RxSlot = 0;
 
+/*!
+ * RxSlot values for the class B windows, after RX1 (0) and RX2 (1)
+ */
+#define RX_SLOT_BEACON 2
+#define RX_SLOT_PING   3
+
 /*!
  * LoRaMac tx/rx operation state
  */
@@ -688,6 +690,7 @@ static void OnRadioTxDone( void )
     RegionSetBandTxDone( LoRaMacRegion, &txDone );
     // Update Aggregated last tx done time
     AggregatedLastTxDoneTime = curTime;
+    MAC_TRACE( mac_trace_tx_done, Channel, 0 );
 
     if( NodeAckRequested == false )
     {
@@ -715,6 +718,8 @@ static void PrepareRxDoneAbort( void )
 
 static void OnRadioRxDone( uint8_t *payload, uint16_t size, int16_t rssi, int8_t snr )
 {
+    // Taken first, so the processing below does not skew the timing measurement
+    TimerTime_t rxElapsed = TimerGetElapsedTime( AggregatedLastTxDoneTime );
     LoRaMacHeader_t macHdr;
     LoRaMacFrameCtrl_t fCtrl;
     ApplyCFListParams_t applyCFList;
@@ -743,6 +748,14 @@ static void OnRadioRxDone( uint8_t *payload, uint16_t size, int16_t rssi, int8_t
 
     bool isMicOk = false;
 
+    if( RxSlot == RX_SLOT_BEACON )
+    {
+        // Beacons are not LoRaWAN frames, lora_class_b parses them and
+        // decides whether the radio keeps listening
+        lora_class_b_on_beacon( payload, size, TimerGetCurrentTime( ) );
+        return;
+    }
+
     McpsConfirm.AckReceived = false;
     McpsIndication.Rssi = rssi;
     McpsIndication.Snr = snr;
@@ -756,6 +769,18 @@ static void OnRadioRxDone( uint8_t *payload, uint16_t size, int16_t rssi, int8_t
     McpsIndication.AckReceived = false;
     McpsIndication.DownLinkCounter = 0;
     McpsIndication.McpsIndication = MCPS_UNCONFIRMED;
+    McpsIndication.RxTimingValid = false;
+    MAC_TRACE( mac_trace_rx_done, size, rssi );
+
+    if( ( LoRaMacDeviceClass != CLASS_C ) && ( RxSlot < RX_SLOT_BEACON ) && ( IsLoRaMacNetworkJoined == true ) )
+    {
+        // The network starts the downlink preamble exactly ReceiveDelay after
+        // the end of the uplink, so anything left after the time on air is
+        // timing error on our side
+        uint32_t rxDelay = ( RxSlot == 0 ) ? LoRaMacParams.ReceiveDelay1 : LoRaMacParams.ReceiveDelay2;
+        McpsIndication.RxTimingOffset = ( int32_t )( rxElapsed - rxDelay - Radio.TimeOnAir( MODEM_LORA, size ) );
+        McpsIndication.RxTimingValid = true;
+    }
 
     Radio.Sleep( );
     TimerStop( &RxWindowTimer2 );
@@ -1134,6 +1159,7 @@ static void OnRadioRxDone( uint8_t *payload, uint16_t size, int16_t rssi, int8_t
 
 static void OnRadioTxTimeout( void )
 {
+    MAC_TRACE( mac_trace_tx_timeout, 0, 0 );
     if( LoRaMacDeviceClass != CLASS_C )
     {
         Radio.Sleep( );
@@ -1150,6 +1176,12 @@ static void OnRadioTxTimeout( void )
 
 static void OnRadioRxError( void )
 {
+    MAC_TRACE( mac_trace_rx_error, RxSlot, 0 );
+    if( RxSlot >= RX_SLOT_BEACON )
+    {
+        lora_class_b_on_rx_timeout( RxSlot == RX_SLOT_BEACON );
+        return;
+    }
     if( LoRaMacDeviceClass != CLASS_C )
     {
         Radio.Sleep( );
@@ -1185,6 +1217,12 @@ static void OnRadioRxError( void )
 
 static void OnRadioRxTimeout( void )
 {
+    MAC_TRACE( mac_trace_rx_timeout, RxSlot, 0 );
+    if( RxSlot >= RX_SLOT_BEACON )
+    {
+        lora_class_b_on_rx_timeout( RxSlot == RX_SLOT_BEACON );
+        return;
+    }
     if( LoRaMacDeviceClass != CLASS_C )
     {
         Radio.Sleep( );
@@ -1242,16 +1280,16 @@ static void OnMacStateCheckTimerEvent( void )
 			}
 			#endif
 			
-					dbg_send("195487ABCDEF LoRaMac.c:OnMacStateCheckTimerEvent Abort\r\n");
+					MAC_TRACE( mac_trace_state_abort, 0, 0 );
         }
 
         if( ( LoRaMacFlags.Bits.MlmeReq == 1 ) || ( ( LoRaMacFlags.Bits.McpsReq == 1 ) ) )
         {
-					dbg_send("195487ABCDEF LoRaMac.c:OnMacStateCheckTimerEvent MLME|MCPS\r\n");
+					MAC_TRACE( mac_trace_state_mlme_mcps, 0, 0 );
             if( ( McpsConfirm.Status == LORAMAC_EVENT_INFO_STATUS_TX_TIMEOUT ) ||
                 ( MlmeConfirm.Status == LORAMAC_EVENT_INFO_STATUS_TX_TIMEOUT ) )
             {
-							dbg_send("195487ABCDEF LoRaMac.c:OnMacStateCheckTimerEvent TX Timeout\r\n");
+							MAC_TRACE( mac_trace_state_tx_timeout, 0, 0 );
                 // Stop transmit cycle due to tx timeout.
                 LoRaMacState &= ~LORAMAC_TX_RUNNING;
 				#ifdef ENABLE_DEBUG_PINS_TIMERS
@@ -1277,7 +1315,7 @@ static void OnMacStateCheckTimerEvent( void )
 
                     if( MlmeConfirm.Status == LORAMAC_EVENT_INFO_STATUS_OK )
                     {// Node joined successfully
-											dbg_send("195487ABCDEF LoRaMac.c:OnMacStateCheckTimerEvent Join Success\r\n");
+											MAC_TRACE( mac_trace_join_success, JoinRequestTrials, 0 );
                         UpLinkCounter = 0;
                         ChannelsNbRepCounter = 0;
                         LoRaMacState &= ~LORAMAC_TX_RUNNING;
@@ -1289,10 +1327,10 @@ static void OnMacStateCheckTimerEvent( void )
                     }
                     else
                     {
-											dbg_send("195487ABCDEF LoRaMac.c:OnMacStateCheckTimerEvent Join Fail\r\n");
+											MAC_TRACE( mac_trace_join_fail, JoinRequestTrials, MlmeConfirm.Status );
                         if( JoinRequestTrials >= MaxJoinRequestTrials )
                         {
-													dbg_send("195487ABCDEF LoRaMac.c:OnMacStateCheckTimerEvent Join Give Up\r\n");
+													MAC_TRACE( mac_trace_join_give_up, 0, 0 );
                             LoRaMacState &= ~LORAMAC_TX_RUNNING;
 							#ifdef ENABLE_DEBUG_PINS_TIMERS
 							{
@@ -1302,7 +1340,7 @@ static void OnMacStateCheckTimerEvent( void )
                         }
                         else
                         {
-													dbg_send("195487ABCDEF LoRaMac.c:OnMacStateCheckTimerEvent Join Retry\r\n");
+													MAC_TRACE( mac_trace_join_retry, 0, 0 );
                             LoRaMacFlags.Bits.MacDone = 0;
                             // Sends the same frame again
                             OnTxDelayedTimerEvent( );
@@ -1311,7 +1349,7 @@ static void OnMacStateCheckTimerEvent( void )
                 }
                 else
                 {// Procedure for all other frames
-									dbg_send("195487ABCDEF LoRaMac.c:OnMacStateCheckTimerEvent Non join frame\r\n");
+									MAC_TRACE( mac_trace_state_non_join_frame, 0, 0 );
                     if( ( ChannelsNbRepCounter >= LoRaMacParams.ChannelsNbRep ) || ( LoRaMacFlags.Bits.McpsInd == 1 ) )
                     {
                         if( LoRaMacFlags.Bits.McpsInd == 0 )
@@ -1347,7 +1385,7 @@ static void OnMacStateCheckTimerEvent( void )
 
         if( LoRaMacFlags.Bits.McpsInd == 1 )
         {// Procedure if we received a frame
-					dbg_send("195487ABCDEF LoRaMac.c:OnMacStateCheckTimerEvent Received Frame\r\n");
+					MAC_TRACE( mac_trace_state_rx_frame, 0, 0 );
             if( ( McpsConfirm.AckReceived == true ) || ( AckTimeoutRetriesCounter > AckTimeoutRetries ) )
             {
                 AckTimeoutRetry = false;
@@ -1369,7 +1407,7 @@ static void OnMacStateCheckTimerEvent( void )
 
         if( ( AckTimeoutRetry == true ) && ( ( LoRaMacState & LORAMAC_TX_DELAYED ) == 0 ) )
         {// Retransmissions procedure for confirmed uplinks
-					dbg_send("195487ABCDEF LoRaMac.c:OnMacStateCheckTimerEvent Confirmed up retry\r\n");
+					MAC_TRACE( mac_trace_confirmed_retry, AckTimeoutRetriesCounter, 0 );
             AckTimeoutRetry = false;
             if( ( AckTimeoutRetriesCounter < AckTimeoutRetries ) && ( AckTimeoutRetriesCounter <= MAX_ACK_RETRIES ) )
             {
@@ -1439,7 +1477,7 @@ static void OnMacStateCheckTimerEvent( void )
     }
     if( LoRaMacState == LORAMAC_IDLE )
     {
-			dbg_send("195487ABCDEF LoRaMac.c:OnMacStateCheckTimerEvent Idle\r\n");
+			MAC_TRACE( mac_trace_state_idle, 0, 0 );
         if( LoRaMacFlags.Bits.McpsReq == 1 )
         {
             LoRaMacPrimitives->MacMcpsConfirm( &McpsConfirm );
@@ -1527,6 +1565,7 @@ static void OnRxWindow1TimerEvent( void )
 
     RegionRxConfig( LoRaMacRegion, &RxWindow1Config, ( int8_t* )&McpsIndication.RxDatarate );
     RxWindowSetup( RxWindow1Config.RxContinuous, LoRaMacParams.MaxRxWindow );
+    MAC_TRACE( mac_trace_rx_window_1, McpsIndication.RxDatarate, RxWindow1Config.WindowTimeout );
 }
 
 static void OnRxWindow2TimerEvent( void )
@@ -1552,6 +1591,7 @@ static void OnRxWindow2TimerEvent( void )
     {
         RxWindowSetup( RxWindow2Config.RxContinuous, LoRaMacParams.MaxRxWindow );
         RxSlot = RxWindow2Config.Window;
+        MAC_TRACE( mac_trace_rx_window_2, McpsIndication.RxDatarate, RxWindow2Config.WindowTimeout );
     }
 }
 
@@ -1582,6 +1622,31 @@ static void RxWindowSetup( bool rxContinuous, uint32_t maxRxWindow )
     }
 }
 
+bool LoRaMacClassBBeaconRx( void )
+{
+    if( ( LoRaMacState != LORAMAC_IDLE ) || ( Radio.GetStatus( ) != RF_IDLE ) )
+    {
+        return false;
+    }
+    RxSlot = RX_SLOT_BEACON;
+    return true;
+}
+
+bool LoRaMacClassBPingSlotRx( RxConfigParams_t *rxConfig )
+{
+    if( ( LoRaMacState != LORAMAC_IDLE ) || ( Radio.GetStatus( ) != RF_IDLE ) )
+    {
+        return false;
+    }
+    if( RegionRxConfig( LoRaMacRegion, rxConfig, ( int8_t* )&McpsIndication.RxDatarate ) == false )
+    {
+        return false;
+    }
+    RxSlot = RX_SLOT_PING;
+    RxWindowSetup( false, LoRaMacParams.MaxRxWindow );
+    return true;
+}
+
 static bool ValidatePayloadLength( uint8_t lenN, int8_t datarate, uint8_t fOptsLen )
 {
     GetPhyParams_t getPhy;
@@ -1700,6 +1765,33 @@ static LoRaMacStatus_t AddMacCommand( uint8_t cmd, uint8_t p1, uint8_t p2 )
                 status = LORAMAC_STATUS_OK;
             }
             break;
+        case MOTE_MAC_DEVICE_TIME_REQ:
+            if( MacCommandsBufferIndex < bufLen )
+            {
+                MacCommandsBuffer[MacCommandsBufferIndex++] = cmd;
+                // No payload for this command
+                status = LORAMAC_STATUS_OK;
+            }
+            break;
+        case MOTE_MAC_PING_SLOT_INFO_REQ:
+            if( MacCommandsBufferIndex < ( bufLen - 1 ) )
+            {
+                MacCommandsBuffer[MacCommandsBufferIndex++] = cmd;
+                // Periodicity
+                MacCommandsBuffer[MacCommandsBufferIndex++] = p1 & 0x07;
+                status = LORAMAC_STATUS_OK;
+            }
+            break;
+        case MOTE_MAC_PING_SLOT_CHANNEL_ANS:
+        case MOTE_MAC_BEACON_FREQ_ANS:
+            if( MacCommandsBufferIndex < ( bufLen - 1 ) )
+            {
+                MacCommandsBuffer[MacCommandsBufferIndex++] = cmd;
+                // Status: Datarate OK (ping slot only), Channel frequency OK
+                MacCommandsBuffer[MacCommandsBufferIndex++] = p1;
+                status = LORAMAC_STATUS_OK;
+            }
+            break;
         default:
             return LORAMAC_STATUS_SERVICE_UNKNOWN;
     }
@@ -1727,6 +1819,8 @@ static uint8_t ParseMacCommandsToRepeat( uint8_t* cmdBufIn, uint8_t length, uint
             // STICKY
             case MOTE_MAC_DL_CHANNEL_ANS:
             case MOTE_MAC_RX_PARAM_SETUP_ANS:
+            case MOTE_MAC_PING_SLOT_CHANNEL_ANS:
+            case MOTE_MAC_BEACON_FREQ_ANS:
             { // 1 byte payload
                 cmdBufOut[cmdCount++] = cmdBufIn[i++];
                 cmdBufOut[cmdCount++] = cmdBufIn[i];
@@ -1745,6 +1839,7 @@ static uint8_t ParseMacCommandsToRepeat( uint8_t* cmdBufIn, uint8_t length, uint
             }
             case MOTE_MAC_LINK_ADR_ANS:
             case MOTE_MAC_NEW_CHANNEL_ANS:
+            case MOTE_MAC_PING_SLOT_INFO_REQ:
             { // 1 byte payload
                 i++;
                 break;
@@ -1752,6 +1847,7 @@ static uint8_t ParseMacCommandsToRepeat( uint8_t* cmdBufIn, uint8_t length, uint
             case MOTE_MAC_TX_PARAM_SETUP_ANS:
             case MOTE_MAC_DUTY_CYCLE_ANS:
             case MOTE_MAC_LINK_CHECK_REQ:
+            case MOTE_MAC_DEVICE_TIME_REQ:
             { // 0 byte payload
                 break;
             }
@@ -1935,6 +2031,52 @@ static void ProcessMacCommands( uint8_t *payload, uint8_t macIndex, uint8_t comm
                     AddMacCommand( MOTE_MAC_DL_CHANNEL_ANS, status, 0 );
                 }
                 break;
+            case SRV_MAC_DEVICE_TIME_ANS:
+                {
+                    // GPS time at the end of the uplink that carried the request
+                    uint32_t seconds;
+                    uint8_t fraction;
+
+                    seconds = ( uint32_t )payload[macIndex++];
+                    seconds |= ( uint32_t )payload[macIndex++] << 8;
+                    seconds |= ( uint32_t )payload[macIndex++] << 16;
+                    seconds |= ( uint32_t )payload[macIndex++] << 24;
+                    fraction = payload[macIndex++];
+
+                    lora_class_b_on_device_time( seconds, fraction, AggregatedLastTxDoneTime );
+                }
+                break;
+            case SRV_MAC_PING_SLOT_INFO_ANS:
+                lora_class_b_on_ping_slot_info_ans( );
+                break;
+            case SRV_MAC_PING_SLOT_CHANNEL_REQ:
+                {
+                    uint32_t frequency;
+                    int8_t datarate;
+
+                    frequency = ( uint32_t )payload[macIndex++];
+                    frequency |= ( uint32_t )payload[macIndex++] << 8;
+                    frequency |= ( uint32_t )payload[macIndex++] << 16;
+                    frequency *= 100;
+                    datarate = payload[macIndex++] & 0x0F;
+
+                    status = lora_class_b_ping_slot_channel_req( frequency, datarate );
+                    AddMacCommand( MOTE_MAC_PING_SLOT_CHANNEL_ANS, status, 0 );
+                }
+                break;
+            case SRV_MAC_BEACON_FREQ_REQ:
+                {
+                    uint32_t frequency;
+
+                    frequency = ( uint32_t )payload[macIndex++];
+                    frequency |= ( uint32_t )payload[macIndex++] << 8;
+                    frequency |= ( uint32_t )payload[macIndex++] << 16;
+                    frequency *= 100;
+
+                    status = lora_class_b_beacon_freq_req( frequency );
+                    AddMacCommand( MOTE_MAC_BEACON_FREQ_ANS, status, 0 );
+                }
+                break;
             default:
                 // Unknown command. ABORT MAC commands processing
                 return;
@@ -1954,13 +2096,19 @@ LoRaMacStatus_t Send( LoRaMacHeader_t *macHdr, uint8_t fPort, void *fBuffer, uin
     fCtrl.Bits.AdrAckReq     = false;
     fCtrl.Bits.Adr           = AdrCtrlOn;
 
+    // In uplinks the FPending bit is the ClassB bit
+    if( LoRaMacDeviceClass == CLASS_B )
+    {
+        fCtrl.Bits.FPending  = 1;
+    }
+
     // Prepare the frame
     status = PrepareFrame( macHdr, &fCtrl, fPort, fBuffer, fBufferSize );
 
     // Validate status
     if( status != LORAMAC_STATUS_OK )
     {
-			dbg_send("195487ABCDEF LoRaMac.c:Send PrepareFrame failed\r\n");
+			MAC_TRACE( mac_trace_prepare_frame_failed, status, 0 );
         return status;
     }
 
@@ -1982,7 +2130,7 @@ static LoRaMacStatus_t ScheduleTx( void )
     // Check if the device is off
     if( MaxDCycle == 255 )
     {
-			dbg_send("195487ABCDEF LoRaMac.c:ScheduleTx Device Off\r\n");
+			MAC_TRACE( mac_trace_schedule_device_off, 0, 0 );
         return LORAMAC_STATUS_DEVICE_OFF;
     }
     if( MaxDCycle == 0 )
@@ -2023,16 +2171,16 @@ static LoRaMacStatus_t ScheduleTx( void )
 
     if( IsLoRaMacNetworkJoined == false )
     {
-			dbg_send("195487ABCDEF LoRaMac.c:ScheduleTx Not Joined\r\n");
+			MAC_TRACE( mac_trace_schedule_not_joined, 0, 0 );
         RxWindow1Delay = LoRaMacParams.JoinAcceptDelay1 + RxWindow1Config.WindowOffset;
         RxWindow2Delay = LoRaMacParams.JoinAcceptDelay2 + RxWindow2Config.WindowOffset;
     }
     else
     {
-			dbg_send("195487ABCDEF LoRaMac.c:ScheduleTx Joined\r\n");
+			MAC_TRACE( mac_trace_schedule_joined, 0, 0 );
         if( ValidatePayloadLength( LoRaMacTxPayloadLen, LoRaMacParams.ChannelsDatarate, MacCommandsBufferIndex ) == false )
         {
-					dbg_send("195487ABCDEF LoRaMac.c:ScheduleTx Payload length error\r\n");
+					MAC_TRACE( mac_trace_schedule_length_error, 0, 0 );
             return LORAMAC_STATUS_LENGTH_ERROR;
         }
         RxWindow1Delay = LoRaMacParams.ReceiveDelay1 + RxWindow1Config.WindowOffset;
@@ -2047,7 +2195,7 @@ static LoRaMacStatus_t ScheduleTx( void )
 			LL_GPIO_SetOutputPin(DEBUG_1_PORT, DEBUG_1_PIN);
 		}
 		#endif
-			dbg_send("195487ABCDEF LoRaMac.c:ScheduleTx Sending Now\r\n");
+			MAC_TRACE( mac_trace_schedule_send_now, Channel, 0 );
         // Try to send now
         return SendFrameOnChannel( Channel );
     }
@@ -2058,7 +2206,7 @@ static LoRaMacStatus_t ScheduleTx( void )
 			LL_GPIO_ResetOutputPin(DEBUG_1_PORT, DEBUG_1_PIN);
 		}
 		#endif
-			dbg_send("195487ABCDEF LoRaMac.c:ScheduleTx Sending later, returning OK\r\n");
+			MAC_TRACE( mac_trace_schedule_send_later, Channel, MIN( dutyCycleTimeOff / 100, 0xFFFF ) );
         // Send later - prepare timer
         LoRaMacState |= LORAMAC_TX_DELAYED;
         TimerSetValue( &TxDelayedTimer, dutyCycleTimeOff );
@@ -2186,7 +2334,7 @@ LoRaMacStatus_t PrepareFrame( LoRaMacHeader_t *macHdr, LoRaMacFrameCtrl_t *fCtrl
         case FRAME_TYPE_DATA_UNCONFIRMED_UP:
             if( IsLoRaMacNetworkJoined == false )
             {
-							dbg_send("195487ABCDEF LoRaMac.c:PrepareFrame Not Joined\r\n");
+							MAC_TRACE( mac_trace_prepare_not_joined, 0, 0 );
                 return LORAMAC_STATUS_NO_NETWORK_JOINED; // No network has been joined yet
             }
 
@@ -2296,11 +2444,11 @@ LoRaMacStatus_t PrepareFrame( LoRaMacHeader_t *macHdr, LoRaMacFrameCtrl_t *fCtrl
             }
             break;
         default:
-					dbg_send("195487ABCDEF LoRaMac.c:PrepareFrame LORAMAC_STATUS_SERVICE_UNKNOWN\r\n");
+					MAC_TRACE( mac_trace_prepare_service_unknown, 0, 0 );
             return LORAMAC_STATUS_SERVICE_UNKNOWN;
     }
 
-		dbg_send("195487ABCDEF LoRaMac.c:PrepareFrame OK\r\n");
+		MAC_TRACE( mac_trace_prepare_ok, 0, 0 );
     return LORAMAC_STATUS_OK;
 }
 
@@ -2339,6 +2487,9 @@ LoRaMacStatus_t SendFrameOnChannel( uint8_t channel )
 		JoinAttempts++;
     }
 
+    // A class B window that is still open gives the radio back
+    lora_class_b_before_tx( );
+
     // Send now
     Radio.Send( LoRaMacBuffer, LoRaMacBufferPktLen );
 
@@ -2349,7 +2500,7 @@ LoRaMacStatus_t SendFrameOnChannel( uint8_t channel )
 	}
 	#endif
 		
-		dbg_send("195487ABCDEF LoRaMac.c:SendFrameOnChannel Returning OK\r\n");
+		MAC_TRACE( mac_trace_send_on_channel, LoRaMacParams.ChannelsDatarate, TxTimeOnAir );
 
     return LORAMAC_STATUS_OK;
 }
@@ -2558,7 +2709,7 @@ LoRaMacStatus_t LoRaMacQueryTxPossible( uint8_t size, LoRaMacTxInfo_t* txInfo )
 
     if( txInfo == NULL )
     {
-			dbg_send("195487ABCDEF lora.c:LoRaMacQueryTxPossible nul param\r\n");
+			MAC_TRACE( mac_trace_query_null_param, 0, 0 );
         return LORAMAC_STATUS_PARAMETER_INVALID;
     }
 
@@ -2605,11 +2756,11 @@ LoRaMacStatus_t LoRaMacQueryTxPossible( uint8_t size, LoRaMacTxInfo_t* txInfo )
     // Verify if the fOpts and the payload fit into the maximum payload
     if( ValidatePayloadLength( size, datarate, fOptLen ) == false )
     {
-			dbg_send("195487ABCDEF lora.c:LoRaMacQueryTxPossible length error\r\n");
+			MAC_TRACE( mac_trace_query_length_error, size, txInfo->MaxPossiblePayload );
         return LORAMAC_STATUS_LENGTH_ERROR;
     }
 		
-		dbg_send("195487ABCDEF lora.c:LoRaMacQueryTxPossible returning OK\r\n");
+		MAC_TRACE( mac_trace_query_ok, 0, 0 );
     return LORAMAC_STATUS_OK;
 }
 
@@ -3233,6 +3384,17 @@ LoRaMacStatus_t LoRaMacMlmeRequest( MlmeReq_t *mlmeRequest )
         return LORAMAC_STATUS_BUSY;
     }
 
+    // The class B requests ride on the next uplink and are answered through
+    // lora_class_b, so a link check confirm pending on the same uplink is kept
+    if( mlmeRequest->Type == MLME_DEVICE_TIME )
+    {
+        return AddMacCommand( MOTE_MAC_DEVICE_TIME_REQ, 0, 0 );
+    }
+    if( mlmeRequest->Type == MLME_PING_SLOT_INFO )
+    {
+        return AddMacCommand( MOTE_MAC_PING_SLOT_INFO_REQ, mlmeRequest->Req.PingSlotInfo.Periodicity, 0 );
+    }
+
     memset1( ( uint8_t* ) &MlmeConfirm, 0, sizeof( MlmeConfirm ) );
 
     MlmeConfirm.Status = LORAMAC_EVENT_INFO_STATUS_ERROR;
@@ -3340,13 +3502,13 @@ LoRaMacStatus_t LoRaMacMcpsRequest( McpsReq_t *mcpsRequest )
 
     if( mcpsRequest == NULL )
     {
-			dbg_send("195487ABCDEF LoRaMac.c:LoRaMacMcpsRequest null param\r\n");
+			MAC_TRACE( mac_trace_mcps_null_param, 0, 0 );
         return LORAMAC_STATUS_PARAMETER_INVALID;
     }
     if( ( ( LoRaMacState & LORAMAC_TX_RUNNING ) == LORAMAC_TX_RUNNING ) ||
         ( ( LoRaMacState & LORAMAC_TX_DELAYED ) == LORAMAC_TX_DELAYED ) )
     {
-			dbg_send("195487ABCDEF LoRaMac.c:LoRaMacMcpsRequest tx busy\r\n");
+			MAC_TRACE( mac_trace_mcps_busy, 0, LoRaMacState );
         return LORAMAC_STATUS_BUSY;
     }
 
@@ -3408,10 +3570,10 @@ LoRaMacStatus_t LoRaMacMcpsRequest( McpsReq_t *mcpsRequest )
 
     if( readyToSend == true )
     {
-			dbg_send("195487ABCDEF LoRaMac.c:LoRaMacMcpsRequest ready to send\r\n");
+			MAC_TRACE( mac_trace_mcps_ready, mcpsRequest->Type, 0 );
         if( AdrCtrlOn == false )
         {
-            dbg_send("195487ABCDEF LoRaMac.c:LoRaMacMcpsRequest AdrCtlOn == false\r\n");
+            MAC_TRACE( mac_trace_mcps_adr_off, datarate, 0 );
             verify.DatarateParams.Datarate = datarate;
             verify.DatarateParams.UplinkDwellTime = LoRaMacParams.UplinkDwellTime;
 
@@ -3421,7 +3583,7 @@ LoRaMacStatus_t LoRaMacMcpsRequest( McpsReq_t *mcpsRequest )
             }
             else
             {
-                dbg_send("195487ABCDEF LoRaMac.c:LoRaMacMcpsRequest Region Verify Failed\r\n");
+                MAC_TRACE( mac_trace_mcps_dr_invalid, datarate, 0 );
                 return LORAMAC_STATUS_PARAMETER_INVALID;
             }
         }
@@ -3434,13 +3596,13 @@ LoRaMacStatus_t LoRaMacMcpsRequest( McpsReq_t *mcpsRequest )
         status = Send( &macHdr, fPort, fBuffer, fBufferSize );
         if( status == LORAMAC_STATUS_OK )
         {
-					dbg_send("195487ABCDEF LoRaMac.c:LoRaMacMcpsRequest status OK\r\n");
+					MAC_TRACE( mac_trace_mcps_ok, 0, 0 );
             McpsConfirm.McpsRequest = mcpsRequest->Type;
             LoRaMacFlags.Bits.McpsReq = 1;
         }
         else
         {
-					dbg_send("195487ABCDEF LoRaMac.c:LoRaMacMcpsRequest status FAIL\r\n");
+					MAC_TRACE( mac_trace_mcps_fail, status, 0 );
             NodeAckRequested = false;
         }
     }
@@ -3459,6 +3621,48 @@ LoRaMacStatus_t isLoRaMacTxBusy( void )
 	return LORAMAC_STATUS_OK;
 }
 
+TimerTime_t LoRaMacQueryTxTimeOff( void )
+{
+    CalcBackOffParams_t calcBackOff;
+    NextChanParams_t nextChan;
+    TimerTime_t dutyCycleTimeOff = 0;
+    TimerTime_t aggregatedTimeOff = 0;
+    uint8_t channel = 0;
+
+    if( MaxDCycle == 255 )
+    {
+        return 0;
+    }
+
+    // Same back-off as ScheduleTx, without accumulating into AggregatedTimeOff
+    calcBackOff.Joined = IsLoRaMacNetworkJoined;
+    calcBackOff.DutyCycleEnabled = DutyCycleOn;
+    calcBackOff.Channel = LastTxChannel;
+    calcBackOff.ElapsedTime = TimerGetElapsedTime( LoRaMacInitializationTime );
+    calcBackOff.TxTimeOnAir = TxTimeOnAir;
+    calcBackOff.LastTxIsJoinRequest = LastTxIsJoinRequest;
+    RegionCalcBackOff( LoRaMacRegion, &calcBackOff );
+
+    if( MaxDCycle != 0 )
+    {
+        aggregatedTimeOff = AggregatedTimeOff + ( TxTimeOnAir * AggregatedDCycle - TxTimeOnAir );
+    }
+
+    nextChan.AggrTimeOff = aggregatedTimeOff;
+    nextChan.Datarate = LoRaMacParams.ChannelsDatarate;
+    nextChan.DutyCycleEnabled = DutyCycleOn;
+    nextChan.Joined = IsLoRaMacNetworkJoined;
+    nextChan.LastAggrTx = AggregatedLastTxDoneTime;
+
+    if( RegionNextChannel( LoRaMacRegion, &nextChan, &channel, &dutyCycleTimeOff, &aggregatedTimeOff ) == false )
+    {
+        // ScheduleTx falls back to the default datarate, which it can send on
+        return 0;
+    }
+
+    return dutyCycleTimeOff;
+}
+
 LoRaMacStatus_t isLoRaMacTxDelayed( void )
 {
 	if( LoRaMacState & LORAMAC_TX_DELAYED  == LORAMAC_TX_DELAYED  )
@@ -428,7 +428,27 @@ typedef enum eLoRaMacMoteCmd
     /*!
      * DlChannelAns
      */
-    MOTE_MAC_DL_CHANNEL_ANS          = 0x0A
+    MOTE_MAC_DL_CHANNEL_ANS          = 0x0A,
+    /*!
+     * DeviceTimeReq
+     *
+     * LoRaWAN Specification V1.0.3 chapter 5.9
+     */
+    MOTE_MAC_DEVICE_TIME_REQ         = 0x0D,
+    /*!
+     * PingSlotInfoReq
+     *
+     * LoRaWAN Specification V1.0.3 chapter 14.1
+     */
+    MOTE_MAC_PING_SLOT_INFO_REQ      = 0x10,
+    /*!
+     * PingSlotChannelAns
+     */
+    MOTE_MAC_PING_SLOT_CHANNEL_ANS   = 0x11,
+    /*!
+     * BeaconFreqAns
+     */
+    MOTE_MAC_BEACON_FREQ_ANS         = 0x13
 }LoRaMacMoteCmd_t;
 
 /*!
@@ -474,6 +494,22 @@ typedef enum eLoRaMacSrvCmd
      * DlChannelReq
      */
     SRV_MAC_DL_CHANNEL_REQ           = 0x0A,
+    /*!
+     * DeviceTimeAns
+     */
+    SRV_MAC_DEVICE_TIME_ANS          = 0x0D,
+    /*!
+     * PingSlotInfoAns
+     */
+    SRV_MAC_PING_SLOT_INFO_ANS       = 0x10,
+    /*!
+     * PingSlotChannelReq
+     */
+    SRV_MAC_PING_SLOT_CHANNEL_REQ    = 0x11,
+    /*!
+     * BeaconFreqReq
+     */
+    SRV_MAC_BEACON_FREQ_REQ          = 0x13,
 }LoRaMacSrvCmd_t;
 
 /*!
@@ -939,6 +975,15 @@ typedef struct sMcpsIndication
      * The downlink counter value for the received frame
      */
     uint32_t DownLinkCounter;
+    /*!
+     * Start of the received frame relative to the nominal start of the
+     * receive window [ms]. Positive when the frame arrived late.
+     */
+    int32_t RxTimingOffset;
+    /*!
+     * Set if RxTimingOffset was measured for this frame (class A, joined)
+     */
+    bool RxTimingValid;
 }McpsIndication_t;
 
 /*!
@@ -987,6 +1032,18 @@ typedef enum eMlme
      * LoRaWAN end-device certification
      */
     MLME_TXCW_1,
+    /*!
+     * DeviceTimeReq - GPS time for class B beacon acquisition
+     *
+     * LoRaWAN Specification V1.0.3, chapter 5.9
+     */
+    MLME_DEVICE_TIME,
+    /*!
+     * PingSlotInfoReq - Tells the network the class B ping slot periodicity
+     *
+     * LoRaWAN Specification V1.0.3, chapter 14.1
+     */
+    MLME_PING_SLOT_INFO,
 }Mlme_t;
 
 /*!
@@ -1037,6 +1094,17 @@ typedef struct sMlmeReqTxCw
     uint8_t Power;
 }MlmeReqTxCw_t;
 
+/*!
+ * LoRaMAC MLME-Request for the class B ping slot periodicity
+ */
+typedef struct sMlmeReqPingSlotInfo
+{
+    /*!
+     * Periodicity 0..7, 2^(7-Periodicity) ping slots per beacon period
+     */
+    uint8_t Periodicity;
+}MlmeReqPingSlotInfo_t;
+
 /*!
  * LoRaMAC MLME-Request structure
  */
@@ -1060,6 +1128,10 @@ typedef struct sMlmeReq
          * MLME-Request parameters for Tx continuous mode request
          */
         MlmeReqTxCw_t TxCw;
+        /*!
+         * MLME-Request parameters for a ping slot info request
+         */
+        MlmeReqPingSlotInfo_t PingSlotInfo;
     }Req;
 }MlmeReq_t;
 
@@ -1961,6 +2033,42 @@ LoRaMacStatus_t isLoRaMacTxBusy(void);
 
 LoRaMacStatus_t isLoRaMacTxDelayed( void );
 
+/*!
+ * \brief   Time until ScheduleTx would put the next frame on air
+ *
+ * \details Runs the same back-off and channel selection as ScheduleTx, but
+ *          leaves the MAC state untouched, so the application can sleep through
+ *          the duty cycle time-off instead of the MAC holding the frame.
+ *
+ * \retval  Time-off in ms, 0 when a frame can be sent now.
+ */
+TimerTime_t LoRaMacQueryTxTimeOff( void );
+
+/*!
+ * \brief   Hands the radio to a class B beacon window
+ *
+ * \details The caller configures the radio and starts the reception itself.
+ *          The RX done, timeout and error events for the window are passed
+ *          to lora_class_b instead of the class A processing.
+ *
+ * \retval  false if the MAC or the radio is busy, the window is skipped.
+ */
+bool LoRaMacClassBBeaconRx( void );
+
+/*!
+ * \brief   Opens a class B ping slot
+ *
+ * \details A frame received in the slot is processed like a class C
+ *          downlink, a timeout or error is passed to lora_class_b.
+ *
+ * \param   [IN] rxConfig Window computed by RegionComputeRxWindowParameters,
+ *                        with the ping slot frequency.
+ *
+ * \retval  false if the MAC or the radio is busy, the slot is skipped.
+ */
+struct sRxConfigParams;
+bool LoRaMacClassBPingSlotRx( struct sRxConfigParams *rxConfig );
+
 /*! \} defgroup LORAMAC */
 
 #endif // __LORAMAC_H__
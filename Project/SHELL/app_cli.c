@@ -53,6 +53,14 @@
 #include "adc.h"
 #include "radio_common.h"
 #include "lora_sensum.h"
+#include "rx_timing.h"
+#include "link_policy.h"
+#include "lora_class_b.h"
+#include "event_loop.h"
+#include "mac_trace.h"
+#include "clock_manager.h"
+#include "buffer_arena.h"
+#include "stack_monitor.h"
 
 #include "global.h"
 #include "Commissioning.h"
@@ -95,6 +103,11 @@ Cmd_registration a_cmd_registration[SHELL_NB_COMMANDS] = {
 	{(char *) "appkey"    , cli_appkey   , 0xFFFFFFFF},
 	{(char *) "channel"   , cli_channel  , 0xFFFFFFFF},
 	{(char *) "reboot"    , cli_reboot   , 0xFFFFFFFF},
+	{(char *) "trace"     , cli_trace    , 0xFFFFFFFF},
+	{(char *) "link"      , cli_link     , 0xFFFFFFFF},
+	{(char *) "clock"     , cli_clock    , 0xFFFFFFFF},
+	{(char *) "classb"    , cli_classb   , 0xFFFFFFFF},
+	{(char *) "stack"     , cli_stack    , 0xFFFFFFFF},
 	
 };
 
@@ -157,6 +170,13 @@ eExecStatus cli_help( int argc,   char *argv[],
 	await_uart_tx();
 	dbg_print("channel  : Configure Default channel list for AU915\r\n");
 	await_uart_tx();
+	dbg_print("trace    : Dump or clear the LoRaMac event trace\r\n");
+	dbg_print("link     : Link margin and TX power/datarate policy\r\n");
+	await_uart_tx();
+	dbg_print("clock    : Clock policy and energy per uplink\r\n");
+	await_uart_tx();
+	dbg_print("stack    : Stack high water mark and interrupt nesting\r\n");
+	await_uart_tx();
 	dbg_print("show     : Display all configuration information\r\n");
 	await_uart_tx();
 	dbg_print("help     : Display this message\r\n");
@@ -202,6 +222,15 @@ eExecStatus cli_show( int argc, char *argv[], char **ppcStringReply )
 			break;
 	}
 	
+	rx_timing_print();
+	uplink_queue_print();
+	link_policy_print();
+	lora_class_b_print();
+	event_loop_print();
+	delay_print();
+	clock_print();
+	arena_print();
+	stack_monitor_print();
 	
 	//prints out all configurations
 	cli_mode     (argc_internal, argv_internal, ppcStringReply);
@@ -981,6 +1010,36 @@ eExecStatus cli_reboot( int argc, char *argv[], char **ppcStringReply )
 	while(1);
 }
 
+eExecStatus cli_trace( int argc, char *argv[], char **ppcStringReply )
+{
+	cli_trace_implementation(argc, argv);
+	return SHELL_EXECSTATUS_OK_NO_FREE;
+}
+
+eExecStatus cli_link( int argc, char *argv[], char **ppcStringReply )
+{
+	cli_link_implementation(argc, argv);
+	return SHELL_EXECSTATUS_OK_NO_FREE;
+}
+
+eExecStatus cli_clock( int argc, char *argv[], char **ppcStringReply )
+{
+	cli_clock_implementation(argc, argv);
+	return SHELL_EXECSTATUS_OK_NO_FREE;
+}
+
+eExecStatus cli_classb( int argc, char *argv[], char **ppcStringReply )
+{
+	cli_classb_implementation(argc, argv);
+	return SHELL_EXECSTATUS_OK_NO_FREE;
+}
+
+eExecStatus cli_stack( int argc, char *argv[], char **ppcStringReply )
+{
+	cli_stack_implementation(argc, argv);
+	return SHELL_EXECSTATUS_OK_NO_FREE;
+}
+
 
 eExecStatus cli_appkey( int argc, char *argv[], char **ppcStringReply )
 {
@@ -77,6 +77,11 @@ eExecStatus cli_appkey   ( int argc, char *argv[], char **ppcStringReply );
 eExecStatus cli_appeui   ( int argc, char *argv[], char **ppcStringReply );
 eExecStatus cli_channel  ( int argc, char *argv[], char **ppcStringReply );
 eExecStatus cli_reboot   ( int argc, char *argv[], char **ppcStringReply );
+eExecStatus cli_trace    ( int argc, char *argv[], char **ppcStringReply );
+eExecStatus cli_link     ( int argc, char *argv[], char **ppcStringReply );
+eExecStatus cli_clock    ( int argc, char *argv[], char **ppcStringReply );
+eExecStatus cli_classb   ( int argc, char *argv[], char **ppcStringReply );
+eExecStatus cli_stack    ( int argc, char *argv[], char **ppcStringReply );
 
 
 #endif /* APP_CLI_H_ */
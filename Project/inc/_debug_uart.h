@@ -44,6 +44,8 @@
 #define RX_BUFFER_LENGTH 100
 #define TX_BUFFER_LENGTH 1024
 
+#define DEBUG_UART_BAUD 9600
+
 /********************************************************************
  *Register Bitfields                                                *
  ********************************************************************/
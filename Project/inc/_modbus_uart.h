@@ -30,11 +30,13 @@
 #define LPUART1_CLOCK_SELECTION_ADDR (LPUART_CLOCK_t*)0x4002104C
 #define LPUART1_CLKEN_ADDR	(RCC_APB1ENR_t*)0x40021038
 
+#define MODBUS_BAUD 9600
+
 //LPUART1
 #define LPUART1_BASE_ADDR	0x40004800
 #define LPUART1_CR1_ADDR (LPUART_CR1_t*)0x40004800
 #define LPUART1_CR2_ADDR (LPUART_CR1_t*)0x40004804
-#define LPUART1_CR3_ADDR (LPUART_CR1_t*)0x40004808
+#define LPUART1_CR3_ADDR (LPUART_CR3_t*)0x40004808
 #define LPUART1_BRR_ADDR (LPUART_BRR_t*)0x4000480C
 #define LPUART1_RQR_ADDR (LPUART_RQR_t*)0x40004818
 #define LPUART1_ISR_ADDR (LPUART_ISR_t*)0x4000481C
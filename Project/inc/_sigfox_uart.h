@@ -29,6 +29,8 @@
 //Clock Selection
 #define USART5_CLKEN_ADDR	(RCC_APB1ENR_t*)0x40021038
 
+#define SIGFOX_BAUD 9600
+
 //UART1
 #define USART5_BASE_ADDR	0x40005000
 #define USART5_CR1_ADDR (USART_CR1_t*)0x40005000
@@ -0,0 +1,72 @@
+/*
+   _____             _____                 
+  / ____|           / ____|                
+ | (___   ___ _ __ | (___  _   _ _ __ ___  
+  \___ \ / _ \ '_ \ \___ \| | | | '_ ` _ \ 
+  ____) |  __/ | | |____) | |_| | | | | | |
+ |_____/ \___|_| |_|_____/ \__,_|_| |_| |_|
+                                           
+                                           
+	Description: Sensor acquisition scheduler.
+	             Powers the sensors of a device mode, starts every conversion
+	             as soon as its sensor has warmed up, then sleeps until each
+	             result is ready, so the conversion times overlap instead of
+	             adding up.
+
+	Maintainer: Shea Gosnell
+
+*/
+
+#ifndef ACQUIRE_HEADER
+#define ACQUIRE_HEADER
+#include <stdint.h>
+#include <stdbool.h>
+#include "timeServer.h"
+#include "debug_uart.h"
+
+/********************************************************************
+ *Public Definitions                                                *
+ ********************************************************************/
+#ifdef DISABLE_ACQUIRE_DEBUG
+	#define dbg_acquire(...)
+#else
+	#define dbg_acquire(...) Debug_printf(__VA_ARGS__)
+#endif
+
+//Every callback is passed the result pointer of the job it belongs to.
+typedef struct
+{
+	const char* name;
+	uint16_t    warmup_ms    ; //from power_on() or supply on, until start() can be called
+	uint16_t    conversion_ms; //from start() until the result can be read
+	uint16_t    timeout_ms   ; //extra time allowed for ready() after conversion_ms
+	void (*power_on )(void* result);                 //optional
+	bool (*start    )(void* result);                 //false if the conversion could not be started
+	bool (*ready    )(void* result);                 //optional, polled once conversion_ms has passed
+	void (*collect  )(void* result, bool timed_out); //reads the result out of the sensor
+	void (*power_off)(void* result);                 //optional
+}acquire_driver_t;
+
+typedef enum
+{
+	acquire_state_warmup = 0,
+	acquire_state_converting,
+	acquire_state_done,
+}acquire_state_e;
+
+typedef struct
+{
+	const acquire_driver_t* driver;
+	void*                   result;
+	//owned by the scheduler
+	acquire_state_e         state;
+	uint16_t                warmup_ms;
+	TimerTime_t             started_at;
+}acquire_job_t;
+
+/********************************************************************
+ *Function Prototypes                                               *
+ ********************************************************************/
+void acquire_run(acquire_job_t* jobs, uint8_t count);
+
+#endif //ACQUIRE_HEADER
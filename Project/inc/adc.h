@@ -27,8 +27,11 @@
  *Function Prototypes                                               *
  ********************************************************************/
 uint16_t AdcReadCompensate(uint32_t Channel);
+uint16_t AdcReadCompensateChannels(const uint32_t* channels, uint16_t* results, uint8_t count);
 void init_three_adc( void );
 void three_adc_send( void );
+void three_adc_save_config( void );
+void three_adc_load_config( void );
 uint16_t read_adc( void );
 void init_adc( void );
 
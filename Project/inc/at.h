@@ -124,15 +124,6 @@ typedef enum eATEerror
 
 /* Exported functions ------------------------------------------------------- */
 
-/**
- * @brief  Store the received data
- * @param  Application port
- * @param  Buffer of the received data
- * @param  Size of the received data
- * @retval None
- */
-void set_at_receive(uint8_t AppPort, uint8_t* Buff, uint8_t BuffSize);
-
 /**
  * @brief  Return AT_OK in all cases
  * @param  Param string of the AT command - unused
@@ -484,20 +475,6 @@ ATEerror_t at_SendBinary(const char *param);
  */
 ATEerror_t at_Send(const char *param);
 
-/**
- * @brief  Print last received data in binary format with hexadecimal value
- * @param  String parameter
- * @retval AT_OK if OK, or an appropriate AT_xxx error code
- */
-ATEerror_t at_ReceiveBinary(const char *param);
-
-/**
- * @brief  Print last received data
- * @param  String parameter
- * @retval AT_OK if OK, or an appropriate AT_xxx error code
- */
-ATEerror_t at_Receive(const char *param);
-
 /**
  * @brief  Print the version of the AT_Slave FW
  * @param  String parameter
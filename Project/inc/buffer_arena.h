@@ -0,0 +1,68 @@
+/*
+   _____             _____                 
+  / ____|           / ____|                
+ | (___   ___ _ __ | (___  _   _ _ __ ___  
+  \___ \ / _ \ '_ \ \___ \| | | | '_ ` _ \ 
+  ____) |  __/ | | |____) | |_| | | | | | |
+ |_____/ \___|_| |_|_____/ \__,_|_| |_| |_|
+                                           
+                                           
+	Description: Lifetime-scoped scratch arena.
+								Frame buffers that only live for one call chain borrow from here
+								instead of each holding their own static or stack copy. Take a mark
+								before allocating and release it on the way out, scopes must nest.
+
+	Maintainer: Shea Gosnell
+
+*/
+
+#ifndef BUFFER_ARENA_HEADER
+#define BUFFER_ARENA_HEADER
+#include <stdint.h>
+#include <stdbool.h>
+
+/********************************************************************
+ *Public Definitions                                                *
+ ********************************************************************/
+#define ARENA_ALIGN(size)          (((size) + 3u) & ~3u)
+
+//largest uplink the AT layer will accept, and its hex encoding ("1:", two per byte, null)
+#define ARENA_UPLINK_PAYLOAD_MAX   64
+#define ARENA_UPLINK_ASCII_MAX     ((2 * ARENA_UPLINK_PAYLOAD_MAX) + 3)
+//a function 3/4 response for the most registers modbus allows in one read
+#define ARENA_MODBUS_REGISTERS_MAX 125
+#define ARENA_MODBUS_RX_MAX        ((2 * ARENA_MODBUS_REGISTERS_MAX) + 5)
+//one LSM6DSL FIFO batch, 128 samples of three axes
+#define ARENA_VIBRATION_BATCH_MAX  768
+//the whole LPS22HB FIFO, 32 slots of pressure and temperature
+#define ARENA_BARO_FIFO_MAX        160
+
+//the most each scope holds at once, the arena only has to fit the largest
+#define ARENA_UPLINK_SCOPE         (ARENA_ALIGN(ARENA_UPLINK_ASCII_MAX) + ARENA_ALIGN(ARENA_UPLINK_PAYLOAD_MAX))
+#define ARENA_MODBUS_SCOPE         ARENA_ALIGN(ARENA_MODBUS_RX_MAX)
+#define ARENA_VIBRATION_SCOPE      ARENA_ALIGN(ARENA_VIBRATION_BATCH_MAX)
+#define ARENA_BARO_SCOPE           ARENA_ALIGN(ARENA_BARO_FIFO_MAX)
+#define ARENA_MAX(a, b)            (((a) > (b)) ? (a) : (b))
+#define ARENA_SIZE                 ARENA_MAX(ARENA_MAX(ARENA_UPLINK_SCOPE, ARENA_MODBUS_SCOPE), ARENA_MAX(ARENA_VIBRATION_SCOPE, ARENA_BARO_SCOPE))
+
+typedef enum
+{
+	arena_owner_uplink_ascii = 0,
+	arena_owner_uplink_payload,
+	arena_owner_modbus_rx,
+	arena_owner_vibration_batch,
+	arena_owner_baro_fifo,
+	arena_owner_count,
+}arena_owner_e;
+
+typedef uint16_t arena_mark_t;
+
+/********************************************************************
+ *Function Prototypes                                               *
+ ********************************************************************/
+arena_mark_t arena_mark    (void);
+void*        arena_alloc   (arena_owner_e owner, uint16_t size);
+void         arena_release (arena_mark_t mark);
+void         arena_print   (void);
+
+#endif //BUFFER_ARENA_HEADER
@@ -0,0 +1,93 @@
+/*
+   _____             _____                 
+  / ____|           / ____|                
+ | (___   ___ _ __ | (___  _   _ _ __ ___  
+  \___ \ / _ \ '_ \ \___ \| | | | '_ ` _ \ 
+  ____) |  __/ | | |____) | |_| | | | | | |
+ |_____/ \___|_| |_|_____/ \__,_|_| |_| |_|
+                                           
+                                           
+	Description: System clock and core voltage manager.
+
+	Maintainer: Shea Gosnell
+
+*/
+
+#ifndef CLOCK_MANAGER_HEADER
+#define CLOCK_MANAGER_HEADER
+#include <stdint.h>
+#include <stdbool.h>
+#include "debug_uart.h"
+
+/********************************************************************
+ *Public Definitions                                                *
+ ********************************************************************/
+#ifdef DISABLE_CLOCK_DEBUG
+	#define dbg_clock(...)
+#else
+	#define dbg_clock(...) Debug_printf(__VA_ARGS__)
+#endif
+
+//slowest first, the highest profile asked for by any user is the one that runs
+typedef enum
+{
+	clock_profile_low = 0, //MSI 4.2MHz, range 3, for waiting, flash can't be written
+	clock_profile_mid,     //HSI16, range 2, for sensor work
+	clock_profile_high,    //PLL 32MHz, range 1, for the radio and crypto
+	clock_profiles,
+}clock_profile_e;
+
+typedef enum
+{
+	clock_policy_fixed = 0, //PLL 32MHz all the time, as before the manager
+	clock_policy_burst,     //profiles as asked for, the radio waits at 32MHz
+	clock_policy_lean,      //as burst, but the radio waits (and its SPI runs) on MSI
+	clock_policies,
+}clock_policy_e;
+
+typedef enum
+{
+	clock_user_main = 0, //event handlers and init
+	clock_user_radio,    //an uplink, from the request to the last receive window
+	clock_users,
+}clock_user_e;
+
+//Typical supply currents from the STM32L072 datasheet, running from flash.
+//They only scale the time spent in each profile, recalibrate against a bench
+//measurement if the absolute numbers matter.
+#define CLOCK_LOW_RUN_UA    620
+#define CLOCK_LOW_SLEEP_UA  190
+#define CLOCK_MID_RUN_UA    2700
+#define CLOCK_MID_SLEEP_UA  750
+#define CLOCK_HIGH_RUN_UA   6700
+#define CLOCK_HIGH_SLEEP_UA 1800
+#define CLOCK_STOP_UA       1
+
+/********************************************************************
+ *Function Prototypes                                               *
+ ********************************************************************/
+void            clock_manager_init  (void);
+void            clock_request       (clock_user_e user, clock_profile_e profile);
+void            clock_release       (clock_user_e user);
+clock_profile_e clock_current       (void);
+void            clock_set_policy    (clock_policy_e policy);
+clock_policy_e  clock_get_policy    (void);
+
+//kernel clock for USART1, LPUART1 and I2C1, as a CCIPR selection and in Hz
+uint8_t         clock_kernel_select (void);
+uint32_t        clock_kernel_hz     (void);
+
+//called from the low power manager
+void            clock_sleep_enter   (void);
+void            clock_sleep_exit    (void);
+void            clock_stop_enter    (void);
+void            clock_stop_exit     (void);
+void            clock_wait_enter    (void);
+void            clock_wait_exit     (void);
+
+void            clock_uplink_done   (void);
+void            clock_print         (void);
+void            clock_clear_stats   (void);
+void            cli_clock_implementation(int argc, char *argv[]);
+
+#endif //CLOCK_MANAGER_HEADER
@@ -0,0 +1,60 @@
+/*
+   _____             _____                 
+  / ____|           / ____|                
+ | (___   ___ _ __ | (___  _   _ _ __ ___  
+  \___ \ / _ \ '_ \ \___ \| | | | '_ ` _ \ 
+  ____) |  __/ | | |____) | |_| | | | | | |
+ |_____/ \___|_| |_|_____/ \__,_|_| |_| |_|
+                                           
+                                           
+	Description: Composite device mode, several sensor components in one
+								device. Each enabled component adds its part to one shared
+								uplink frame, and their conversions run together in one wake.
+
+	Maintainer: Shea Gosnell
+
+*/
+
+#ifndef COMPOSITE_HEADER
+#define COMPOSITE_HEADER
+#include <stdint.h>
+#include <stdbool.h>
+#include "global.h"
+#include "acquire.h"
+
+/********************************************************************
+ *Public Definitions                                                *
+ ********************************************************************/
+//A sensor component. Components are indexed by composite_part_e, which is
+//also their bit in the components mask and the order of their parts in the
+//frame. Every callback is optional.
+typedef struct
+{
+	const char             *name;
+	const acquire_driver_t *driver;  //joins the shared acquisition
+	void                   *result;  //passed to the driver
+	void (*init)(void);
+	void (*fill)(int32_t values[]);  //composite_value_e, after the acquisition
+	test_status_e (*test)(void);     //after the acquisition
+	void (*load_config)(void);
+	void (*save_config)(void);
+	void (*save_data)(void);
+	void (*load_data)(void);
+	void (*cli)(int argc, char *argv[]); //given the whole command, name first
+	uint64_t cli_commands;           //generic CLI commands it needs
+}composite_component_t;
+
+/********************************************************************
+ *Function Prototypes                                               *
+ ********************************************************************/
+void          composite_init        (void);
+test_status_e composite_test        (void);
+void          composite_on_wakeup   (void);
+void          composite_uplink      (void);
+void          composite_save_config (void);
+void          composite_load_config (void);
+void          composite_save_data   (void);
+void          composite_load_data   (void);
+void          composite_cli         (int argc, char *argv[]);
+
+#endif //COMPOSITE_HEADER
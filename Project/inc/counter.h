@@ -55,7 +55,7 @@ typedef struct
 /********************************************************************
  *Global Variables                                                  *
  ********************************************************************/
-extern volatile uint8_t  wake_via_counters;
+extern volatile uint32_t count1;
 extern uint32_t debounce_interval;
 extern uint32_t leak_interval;
 extern uint16_t maximum_hourly_flow;
@@ -68,6 +68,7 @@ extern uint16_t  consecutive_burst_hours;
  
  
 void init_single_counter(void);
+void init_count1_only(void);
 void init_two_counter_tamper(void);
 void init_three_counter(void);
 void init_three_edge_alarm(void);
@@ -33,6 +33,9 @@ void Debug_printf( const char *format, ... );
 void read_cli( void );
 void Debug_AddToWriteBuffer(char* message, int length);
 void await_uart_tx(void);
+void Debug_sleep(void);
+void Debug_flush(void);
+void Debug_clock_changed(void);
 int  isCharToSend(void);
 int  Debug_getRxDataLength( void );
 char Debug_getChar( void );
@@ -28,6 +28,8 @@
  *Function Prototypes                                               *
  ********************************************************************/
 void delay_timeout_ms(uint32_t delay_ms);
+void delay_stop_ms(uint32_t delay_ms);
+void delay_print(void);
 void delayWithFeedback(int numberOfPeriods, int feedbackPeriodMs);
 bool timer_expired(TimerEvent_t* timer);
 void start_timeout_timer(TimerEvent_t* timer, uint32_t timeout_ms);
@@ -20,10 +20,24 @@
 #define DS18B20HEADER
 #include <stdint.h>
 #include "lora_sensum.h"
+#include "acquire.h"
 
 /********************************************************************
  *Public Definitions                                                *
  ********************************************************************/
+typedef enum
+{
+	RESULT_OK           = 0,
+	RESULT_DATA_OPEN    = 1,
+	RESULT_DATA_SHORT   = 2,
+	RESULT_CRC_ERR      = 3,
+}result_status_e;
+
+typedef struct
+{
+	int16_t temperature;
+	result_status_e status;
+}ds18b20_result_t;
 
  /********************************************************************
  *Public Function Prototypes                                         *
@@ -45,6 +59,7 @@ void ds18b20_mulit_on_each_wakeup(void);
  /********************************************************************
  *Global Variables                                                  *
  ********************************************************************/
+extern const acquire_driver_t ds18b20_acquire_driver;
 
 
 
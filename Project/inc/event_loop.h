@@ -0,0 +1,52 @@
+/*
+   _____             _____                 
+  / ____|           / ____|                
+ | (___   ___ _ __ | (___  _   _ _ __ ___  
+  \___ \ / _ \ '_ \ \___ \| | | | '_ ` _ \ 
+  ____) |  __/ | | |____) | |_| | | | | | |
+ |_____/ \___|_| |_|_____/ \__,_|_| |_| |_|
+                                           
+                                           
+	Description: Events posted from interrupts and run from the sleep loop.
+
+	Maintainer: Shea Gosnell
+
+*/
+
+#ifndef EVENT_LOOP_HEADER
+#define EVENT_LOOP_HEADER
+#include <stdint.h>
+#include <stdbool.h>
+
+/********************************************************************
+ *Public Definitions                                                *
+ ********************************************************************/
+//in the order they are run when several are pending
+typedef enum
+{
+	event_downlink = 0,  //a LoRa downlink is waiting
+	event_uplink_queue,  //the duty cycle back-off has passed
+	event_count,         //a counter or sensor alert interrupt
+	event_hourly,        //RTC alarm B, on the hour
+	event_device,        //anything for device.on_each_wakeup
+	event_scheduled,     //the sleep timer, ends Sleep()
+	event_types,
+}event_type_e;
+
+typedef void (*event_handler_t)(void);
+
+/********************************************************************
+ *Function Prototypes                                               *
+ ********************************************************************/
+void event_post       (event_type_e event);
+void event_register   (event_type_e event, event_handler_t handler);
+bool event_take       (event_type_e event);
+void event_clear      (event_type_e event);
+bool event_pending    (event_type_e event);
+bool event_any_pending(void);
+bool event_dispatch   (void);
+void event_loop_sleep (void);
+void event_loop_print (void);
+void event_loop_clear_stats(void);
+
+#endif //EVENT_LOOP_HEADER
@@ -0,0 +1,98 @@
+/*
+   _____             _____                 
+  / ____|           / ____|                
+ | (___   ___ _ __ | (___  _   _ _ __ ___  
+  \___ \ / _ \ '_ \ \___ \| | | | '_ ` _ \ 
+  ____) |  __/ | | |____) | |_| | | | | | |
+ |_____/ \___|_| |_|_____/ \__,_|_| |_| |_|
+                                           
+                                           
+	Description: Report by exception.
+	             Decides when a threshold sensor has something worth an uplink,
+	             the same way in every mode: a limit crossed and held for the
+	             dwell, a return inside the limits past the hysteresis, a jump
+	             between two checks, a drift since the last uplink, or too long
+	             without any uplink at all.
+
+	Maintainer: Shea Gosnell
+
+*/
+
+#ifndef EXCEPTION_REPORT_HEADER
+#define EXCEPTION_REPORT_HEADER
+#include <stdint.h>
+#include <stdbool.h>
+#include "flash_map.h"
+
+/********************************************************************
+ *Public Definitions                                                *
+ ********************************************************************/
+typedef enum
+{
+	exception_band_normal = 0,
+	exception_band_upper,
+	exception_band_lower,
+}exception_band_e;
+
+typedef enum
+{
+	exception_none = 0,
+	exception_upper,    //went over the upper limit
+	exception_lower,    //went under the lower limit
+	exception_clear,    //back inside the limits
+	exception_rate,     //changed by the rate or more since the last check
+	exception_deadband, //changed by the deadband or more since the last uplink
+}exception_reason_e;
+
+//the limits a mode keeps in its own config page, with the triggers beside them
+typedef struct
+{
+	int32_t  upper;
+	int32_t  lower;
+	bool     upper_enabled;
+	bool     lower_enabled;
+	uint32_t hysteresis; //how far back inside a limit the value has to be to clear
+	uint16_t deadband;
+	uint16_t rate;
+	uint8_t  dwell;
+}exception_config_t;
+
+//one channel, all zero is a channel inside its limits that has not been checked
+typedef struct
+{
+	exception_band_e band;
+	exception_band_e pending;
+	uint8_t          dwell_count;
+	bool             has_previous;
+	bool             has_reported;
+	int32_t          previous;
+	int32_t          reported;
+}exception_channel_t;
+
+//max_silence 0 keeps the regular uplink every wakeups_per_uplink
+typedef struct
+{
+	uint16_t max_silence;
+	uint16_t silent_wakeups;
+}exception_schedule_t;
+
+/********************************************************************
+ *Function Prototypes                                               *
+ ********************************************************************/
+exception_config_t exception_config         (int32_t upper, bool upper_enabled, int32_t lower, bool lower_enabled, uint32_t hysteresis, const exception_tuning_t* tuning);
+bool               exception_config_active  (const exception_config_t* config);
+exception_reason_e exception_check          (exception_channel_t* channel, const exception_config_t* config, int32_t value);
+void               exception_reported       (exception_channel_t* channel, int32_t value);
+void               exception_reset          (exception_channel_t* channel);
+const char*        exception_reason_name    (exception_reason_e reason);
+
+bool               exception_heartbeat_due  (exception_schedule_t* schedule);
+void               exception_sent           (exception_schedule_t* schedule);
+
+void               exception_tuning_defaults(exception_tuning_t* tuning);
+void               exception_cli_help       (const char* channels);
+bool               exception_cli_tuning     (const char* setting, const char* value, exception_tuning_t* tuning, uint32_t scale);
+bool               exception_cli_silence    (const char* value, exception_schedule_t* schedule);
+void               exception_cli_show       (const char* name, const exception_tuning_t* tuning, uint32_t scale);
+
+#endif //EXCEPTION_REPORT_HEADER
@@ -0,0 +1,50 @@
+/*
+   _____             _____                 
+  / ____|           / ____|                
+ | (___   ___ _ __ | (___  _   _ _ __ ___  
+  \___ \ / _ \ '_ \ \___ \| | | | '_ ` _ \ 
+  ____) |  __/ | | |____) | |_| | | | | | |
+ |_____/ \___|_| |_|_____/ \__,_|_| |_| |_|
+                                           
+                                           
+	Description: Integer conversion kernels for the sensor drivers.
+	             The MCU has no FPU, every float operation is a call into the
+	             soft-float library, so all raw->engineering unit conversions
+	             are done here with exact integer arithmetic instead.
+	             Results are truncated toward zero, matching the (int) casts
+	             used by the float code these replace.
+
+	Maintainer: Shea Gosnell
+
+*/
+
+#ifndef FIXED_POINT_HEADER
+#define FIXED_POINT_HEADER
+#include <stdint.h>
+#include <stdbool.h>
+
+/********************************************************************
+ *Public Definitions                                                *
+ ********************************************************************/
+//"-2147483648" with a point, and the terminator
+#define FXP_FORMAT_SIZE      13
+
+/********************************************************************
+ *Function Prototypes                                               *
+ ********************************************************************/
+int32_t  fxp_scale(int32_t value, uint32_t numerator, uint32_t denominator);
+
+int16_t  fxp_sht3x_temperature_centi(uint16_t raw);
+uint16_t fxp_sht3x_humidity_centi(uint16_t raw);
+uint16_t fxp_sht3x_temperature_raw(int32_t centi);
+uint16_t fxp_sht3x_humidity_raw(int32_t centi);
+int16_t  fxp_sht2x_temperature_centi(uint16_t raw);
+int16_t  fxp_sht2x_humidity_deci(uint16_t raw);
+int32_t  fxp_ds18b20_millicelsius(int16_t raw);
+uint16_t fxp_vrefint_compensate(uint16_t adc, uint16_t vrefint, uint16_t vrefint_cal);
+uint16_t fxp_ext_voltage_centi(uint16_t adc);
+int32_t  fxp_float32_to_milli(uint32_t bits);
+bool     fxp_parse_scaled(const char* str, uint32_t scale, int32_t* result);
+char*    fxp_format_scaled(char* buffer, int32_t value, uint32_t scale);
+
+#endif //FIXED_POINT_HEADER
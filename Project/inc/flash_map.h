@@ -29,6 +29,11 @@
 #define DATA_SIZE   60 //Bytes
 #define PAGE_SIZE   64 //Bytes
 
+//Written with a mode's settings where 0 is itself a setting, so a page from
+//flash_erase_all() or from another mode loads the defaults instead
+#define CONFIG_MAGIC_BARO      0xB4
+#define CONFIG_MAGIC_COMPOSITE 0xC3
+
 /********************************************************************
  *Definitions                                                       *
  ********************************************************************/
@@ -64,6 +69,14 @@ typedef struct
 }PACKED threshold_data_t;
 
 #pragma pop
+
+//report by exception triggers kept beside a threshold pair, see exception_report.h
+typedef struct
+{
+	uint16_t deadband; //change since the last uplink, 0 for none
+	uint16_t rate;     //change between two checks, 0 for none
+	uint8_t  dwell;    //checks a new band must hold before it reports
+}PACKED exception_tuning_t;
  
 
 typedef union
@@ -88,7 +101,8 @@ typedef union
 	struct
 	{
 		uint16_t join_channel_list[6]; //12 Bytes  total 12
-		uint8_t  reserved[52];         //52 Bytes  total 64
+		uint8_t  link_policy_enabled;  //01 Byte   total 13
+		uint8_t  reserved[51];         //51 Bytes  total 64
 	}PACKED members;
 }radio_config_page_layout_t;
 STATIC_ASSERT((sizeof(MEMBER(radio_config_page_layout_t,members)) == PAGE_SIZE));
@@ -101,7 +115,10 @@ typedef union
 	{
 		threshold_data_t Temperature_threshold_upper;          //3 Bytes Total 3
 		threshold_data_t Temperature_threshold_lower;          //3 Bytes Total 6
-		uint8_t               reserved[PAGE_SIZE-6];
+		uint16_t              temperature_hysteresis;          //2 Bytes Total 8
+		exception_tuning_t    temperature_exception;           //5 Bytes Total 13
+		uint16_t              max_silence_wakeups;             //2 Bytes Total 15
+		uint8_t               reserved[PAGE_SIZE-15];
 	}PACKED members;
 }ds18b20_config_page_layout_t;
 STATIC_ASSERT((sizeof(MEMBER(ds18b20_config_page_layout_t,members)) == PAGE_SIZE));
@@ -120,9 +137,15 @@ typedef union
 			humidity_lower_enabled    :1,
 			temperature_upper_enabled :1,
 			temperature_lower_enabled :1,
-			reserved                  :4;
+			alert_mode_enabled        :1,
+			reserved                  :3;
 		uint8_t threshold_wakeups;
-		uint8_t reserved2[PAGE_SIZE-10];
+		uint16_t temperature_hysteresis;
+		uint16_t humidity_hysteresis;
+		exception_tuning_t temperature_exception;
+		exception_tuning_t humidity_exception;
+		uint16_t max_silence_wakeups;
+		uint8_t reserved2[PAGE_SIZE-26];
 	}PACKED members;
 	
 }sht30_config_page_layout_t;
@@ -175,7 +198,8 @@ typedef union
 		uint8_t               invert_dir :1,
 		                      pullup_enabled :1,
 		                      reserved1  :6;              //01 bytes  total 12
-		uint8_t               reserved[PAGE_SIZE-12];
+		uint8_t               interval_minutes;           //01 bytes  total 13
+		uint8_t               reserved[PAGE_SIZE-13];
 	}PACKED members;
 }count_config_page_layout_t;
 STATIC_ASSERT((sizeof(MEMBER(count_config_page_layout_t,members)) == PAGE_SIZE));
@@ -187,7 +211,8 @@ typedef union
 	{
 		uint16_t reads_per_uplink;
 		uint8_t  device_address;
-		uint8_t               reserved[PAGE_SIZE-3];
+		int32_t  flow_threshold; //thousandths of the meter unit, 0 for none
+		uint8_t               reserved[PAGE_SIZE-7];
 	}PACKED members;
 }scl61d5_config_page_layout_t;
 STATIC_ASSERT((sizeof(MEMBER(scl61d5_config_page_layout_t,members)) == PAGE_SIZE));
@@ -212,6 +237,73 @@ typedef union
 }co2_config_page_layout_t;
 STATIC_ASSERT((sizeof(MEMBER(co2_config_page_layout_t,members)) == PAGE_SIZE));
 
+typedef union
+{
+	uint8_t raw_bytes[PAGE_SIZE];
+	struct
+	{
+		uint16_t wake_threshold_mg;
+		uint8_t  capture_limit; //batches per uplink interval
+		uint8_t  reserved[PAGE_SIZE-3];
+	}PACKED members;
+}vibration_config_page_layout_t;
+STATIC_ASSERT((sizeof(MEMBER(vibration_config_page_layout_t,members)) == PAGE_SIZE));
+
+typedef union
+{
+	uint8_t raw_bytes[PAGE_SIZE];
+	struct
+	{
+		uint32_t upper_threshold_pa; //0 for none
+		uint32_t lower_threshold_pa; //0 for none
+		uint16_t rate_threshold;     //Pa/h, 0 for none
+		uint8_t  magic;              //CONFIG_MAGIC_BARO
+		uint8_t  reserved[PAGE_SIZE-11];
+	}PACKED members;
+}baro_config_page_layout_t;
+STATIC_ASSERT((sizeof(MEMBER(baro_config_page_layout_t,members)) == PAGE_SIZE));
+
+typedef union
+{
+	uint8_t raw_bytes[PAGE_SIZE];
+	struct
+	{
+		uint16_t orientation_threshold_mg;
+		uint16_t freefall_threshold_mg;
+		uint16_t freefall_duration_ms;
+		uint8_t  heartbeat_intervals; //uplink intervals
+		uint8_t  reserved[PAGE_SIZE-7];
+	}PACKED members;
+}tamper_config_page_layout_t;
+STATIC_ASSERT((sizeof(MEMBER(tamper_config_page_layout_t,members)) == PAGE_SIZE));
+
+//the composite mode's own page, a counter part keeps its settings on the
+//counter page as the counter modes do
+typedef union
+{
+	uint8_t raw_bytes[PAGE_SIZE];
+	struct
+	{
+		uint8_t  components; //a bit per composite_part_e
+		light_sensor_config_component_t light_config;
+		uint8_t  magic;      //CONFIG_MAGIC_COMPOSITE
+		uint8_t  reserved[PAGE_SIZE-3];
+	}PACKED members;
+}composite_config_page_layout_t;
+STATIC_ASSERT((sizeof(MEMBER(composite_config_page_layout_t,members)) == PAGE_SIZE));
+
+//the sampler's settings, on whichever page the sampling mode has free
+typedef union
+{
+	uint8_t raw_bytes[PAGE_SIZE];
+	struct
+	{
+		uint16_t sample_period_s; //0 for a single reading at each uplink
+		uint8_t  reserved[PAGE_SIZE-2];
+	}PACKED members;
+}sample_config_page_layout_t;
+STATIC_ASSERT((sizeof(MEMBER(sample_config_page_layout_t,members)) == PAGE_SIZE));
+
 typedef union
 {
 	uint8_t raw_bytes[PAGE_SIZE];
@@ -234,6 +326,26 @@ typedef union
 	}PACKED members;
 }count_data_page_layout_t;
 STATIC_ASSERT((sizeof(MEMBER(count_data_page_layout_t,members)) == DATA_SIZE));
+
+#define INTERVAL_FLASH_DELTAS 20
+
+//starts the same as count_data_page_layout_t, so the counts survive a mode change
+typedef union
+{
+	uint8_t raw_bytes[DATA_SIZE];
+	struct
+	{
+		uint32_t count1;                        //4 bytes
+		uint32_t count2;                        //8 bytes
+		uint32_t count3;                        //12 bytes
+		uint16_t head_sequence;                 //14 bytes
+		uint8_t  interval_minutes;              //15 bytes
+		uint8_t  unsent;                        //16 bytes
+		uint32_t base;                          //20 bytes
+		uint16_t deltas[INTERVAL_FLASH_DELTAS]; //60 bytes
+	}PACKED members;
+}interval_data_page_layout_t;
+STATIC_ASSERT((sizeof(MEMBER(interval_data_page_layout_t,members)) == DATA_SIZE));
  
  /********************************************************************
  *Function Prototypes                                               *
@@ -148,6 +148,19 @@
  #define DISABLE_SX1276_DEBUG
  #define DISABLE_BUFFER_TRACE
  #define DISABLE_OWP_DEBUG
+ #define DISABLE_ACQUIRE_DEBUG
+ #define DISABLE_RX_TIMING_DEBUG
+ #define DISABLE_UPLINK_QUEUE_DEBUG
+ #define DISABLE_LINK_POLICY_DEBUG
+ #define DISABLE_INTERVAL_METER_DEBUG
+ #define DISABLE_CLOCK_DEBUG
+ #define DISABLE_LORA_CLASS_B_DEBUG
+ #define DISABLE_VIBRATION_DEBUG
+ #define DISABLE_BARO_DEBUG
+ #define DISABLE_TAMPER_DEBUG
+ #define DISABLE_COMPOSITE_DEBUG
+ #define DISABLE_SAMPLER_DEBUG
+// #define DISABLE_MAC_TRACE
  #define DISABLE_SIGFOX_DEBUG
  #define DISABLE_LORA_CLASS_DEBUG
  #define DISABLE_LORA_CLASSC_DEBUG
@@ -200,6 +213,7 @@
 	 char           * mode_name;
 	 bool             legacy_counter;
 	 bool             lora_class_c;
+	 bool             lora_class_b;
 	 uint64_t         cli_commands; //If we end up with more than 64 command options, then consider using
  }sensum_device_callback_t;       //a packed bitfield struct here, to extend the range.
  
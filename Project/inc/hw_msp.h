@@ -124,6 +124,30 @@ typedef enum
  * @retval Value that was read
  */
 uint16_t HW_AdcReadChannel(uint32_t Channel);
+
+/**
+ * @brief  Largest channel list accepted by HW_AdcReadChannels
+ */
+#define HW_ADC_MAX_CHANNELS 8
+
+/**
+ * @brief  Reads a list of channels in a single scan sequence
+ * @note   The ADC is calibrated once per scan, VREFINT is always part of the
+ *         sequence and every conversion is 16x oversampled by the hardware.
+ *         A channel may appear in the list more than once.
+ * @param  Channels list of LL_ADC_CHANNEL_x to read
+ * @param  Results  one reading per entry in Channels
+ * @param  Count    number of entries, 0 just reads VREFINT
+ * @retval The VREFINT reading from the same scan
+ */
+uint16_t HW_AdcReadChannels(const uint32_t *Channels, uint16_t *Results, uint8_t Count);
+
+/**
+ * @brief  Converts a VREFINT reading to the supply voltage
+ * @param  vrefint reading of the VREFINT channel
+ * @retval supply in mV, 0 if vrefint is 0
+ */
+uint32_t HW_VrefintToBatteryLevel_mv(uint16_t vrefint);
 /*!
  * \brief Get the current temperature
  *
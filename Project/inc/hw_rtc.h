@@ -66,13 +66,13 @@ extern "C" {
 #endif
 
 /* Includes ------------------------------------------------------------------*/
+#include <stdbool.h>
 #include "utilities.h"
 
 /* Exported types ------------------------------------------------------------*/
 /* Exported constants --------------------------------------------------------*/
 /* External variables --------------------------------------------------------*/
 extern volatile int wake_via_rtc_a;
-extern volatile int wake_via_rtc_b;
 /* Exported macros -----------------------------------------------------------*/
 /* Exported functions ------------------------------------------------------- */
 
@@ -156,6 +156,16 @@ void HW_RTC_DelayMs(uint32_t delay);
  */
 void HW_RTC_StartHourlyAlarm(void);
 
+/**
+ * @brief  Set the Alarm B interval. The hourly work still only runs on the hour,
+ *         callback is run from the interrupt at every interval boundary.
+ * @param  minutes: a divisor of 60
+ * @param  callback: called at each boundary, NULL for none
+ * @retval false if the interval does not divide the hour
+ */
+bool HW_RTC_SetAlarmInterval(uint8_t minutes, void (*callback)(void));
+uint8_t HW_RTC_GetAlarmInterval(void);
+
 /**
  * @brief  Get the current hour (0-24)
  * @param  none
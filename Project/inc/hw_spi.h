@@ -81,6 +81,14 @@ extern "C" {
  */
 void HW_SPI_Init(void);
 
+/**
+ * @brief Recomputes the SPI divisor after a system clock change
+ *
+ * @param [IN] None
+ * @retval None
+ */
+void HW_SPI_ClockChanged(void);
+
 /**
  * @brief De-initializes the SPI object and MCU peripheral
  *
@@ -115,6 +123,20 @@ void HW_SPI_IoDeInit(void);
  */
 uint16_t HW_SPI_InOut(uint16_t outData);
 
+/* Bursts shorter than this are polled, as HW_SPI_InOut */
+#define HW_SPI_DMA_MIN_SIZE 8
+
+/**
+ * @brief Full duplex burst over SPI1, using DMA1 channels 2 and 3
+ *
+ * @param  [IN]  txData Bytes to send, or NULL to send zeros
+ * @param  [OUT] rxData Received bytes, or NULL to discard them
+ * @param  [IN]  size   Number of bytes
+ * @retval None
+ * @note NSS is left to the caller. Returns once the bus is idle.
+ */
+void HW_SPI_Burst(const uint8_t *txData, uint8_t *rxData, uint16_t size);
+
 
 
 #ifdef __cplusplus
@@ -30,6 +30,7 @@
  *Function Prototypes                                               *
  ********************************************************************/
 bool i2c1_init( void );
+void i2c1_clock_changed( void );
 void i2c1_send(uint8_t slave_address, uint8_t *data, int data_length, int send_stop);
 int i2c1_send_feedback(uint8_t slave_address, uint8_t *data, int data_length, int send_stop);
 void i2c1_receive(uint8_t slave_address, uint8_t *data, int data_length, int send_stop);
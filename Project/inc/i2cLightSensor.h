@@ -21,6 +21,7 @@
 #define I2C_LIGHTSENSOR_HEADER
 #include <stdint.h>
 #include "flash_map.h"
+#include "acquire.h"
 
 /********************************************************************
  *Definitions                                                       *
@@ -57,6 +58,7 @@ void set_light_sensor_config_values(light_sensor_config_component_t config);
  /********************************************************************
  *Global Variables                                                  *
  ********************************************************************/
+extern const acquire_driver_t si1133_acquire_driver;
 
 
 
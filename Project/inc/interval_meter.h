@@ -0,0 +1,53 @@
+/*
+   _____             _____                 
+  / ____|           / ____|                
+ | (___   ___ _ __ | (___  _   _ _ __ ___  
+  \___ \ / _ \ '_ \ \___ \| | | | '_ ` _ \ 
+  ____) |  __/ | | |____) | |_| | | | | | |
+ |_____/ \___|_| |_|_____/ \__,_|_| |_| |_|
+                                           
+                                           
+	Description: Interval metering for count1.
+								Records the count at every 5, 15, 30 or 60 minute boundary and
+								sends every interval not yet delivered as variable width deltas.
+
+	Maintainer: Shea Gosnell
+
+*/
+
+#ifndef INTERVAL_METER_HEADER
+#define INTERVAL_METER_HEADER
+#include <stdint.h>
+#include <stdbool.h>
+#include "debug_uart.h"
+
+/********************************************************************
+ *Public Definitions                                                *
+ ********************************************************************/
+#ifdef DISABLE_INTERVAL_METER_DEBUG
+	#define dbg_interval(...)
+#else
+	#define dbg_interval(...) Debug_printf(__VA_ARGS__)
+#endif
+
+#define INTERVAL_MINUTES_DEFAULT 15
+//a day at 15 minutes, 8 hours at 5 minutes
+#define INTERVAL_RING_ENTRIES    96
+
+/********************************************************************
+ *Global Variables                                                  *
+ ********************************************************************/
+extern uint8_t interval_minutes;
+
+/********************************************************************
+ *Function Prototypes                                               *
+ ********************************************************************/
+void init_interval_meter        (void);
+void interval_meter_on_wakeup   (void);
+void interval_meter_uplink      (void);
+void interval_meter_save_data   (void);
+void interval_meter_load_data   (void);
+void interval_meter_cli         (int argc, char *argv[]);
+bool interval_minutes_valid     (uint8_t minutes);
+
+#endif //INTERVAL_METER_HEADER
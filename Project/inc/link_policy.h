@@ -0,0 +1,46 @@
+/*
+   _____             _____                 
+  / ____|           / ____|                
+ | (___   ___ _ __ | (___  _   _ _ __ ___  
+  \___ \ / _ \ '_ \ \___ \| | | | '_ ` _ \ 
+  ____) |  __/ | | |____) | |_| | | | | | |
+ |_____/ \___|_| |_|_____/ \__,_|_| |_| |_|
+                                           
+                                           
+	Description: Link quality estimator and TX power / datarate policy.
+
+	Maintainer: Shea Gosnell
+
+*/
+
+#ifndef LINK_POLICY_HEADER
+#define LINK_POLICY_HEADER
+#include <stdint.h>
+#include <stdbool.h>
+#include "debug_uart.h"
+
+/********************************************************************
+ *Public Definitions                                                *
+ ********************************************************************/
+#ifdef DISABLE_LINK_POLICY_DEBUG
+	#define dbg_link_policy(...)
+#else
+	#define dbg_link_policy(...) Debug_printf(__VA_ARGS__)
+#endif
+
+//number of margin samples kept, the best of these is compared to the target
+#define LINK_POLICY_SAMPLES 8
+
+/********************************************************************
+ *Function Prototypes                                               *
+ ********************************************************************/
+void link_policy_on_downlink   (int8_t snr, int16_t rssi, uint8_t rx_datarate);
+void link_policy_on_link_check (bool answered, uint8_t demod_margin, uint8_t gateways);
+void link_policy_on_confirm    (bool confirmed, bool ack_received, uint8_t retries, uint32_t time_on_air_ms);
+void link_policy_before_uplink (uint8_t size);
+void link_policy_enable        (bool enable);
+bool link_policy_enabled       (void);
+void link_policy_print         (void);
+void cli_link_implementation   (int argc, char *argv[]);
+
+#endif //LINK_POLICY_HEADER
@@ -389,6 +389,14 @@ void lora_config_tx_datarate_set(int8_t TxDataRate);
  * @retval tx datarate
  */ 
 int8_t lora_config_tx_datarate_get(void );
+
+/**
+ * @brief  largest application payload the current datarate allows,
+ *         after any pending MAC commands
+ * @param  None
+ * @retval size in bytes
+ */ 
+uint8_t lora_max_payload(void);
   
 #ifdef __cplusplus
 }
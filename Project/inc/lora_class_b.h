@@ -0,0 +1,69 @@
+/*
+   _____             _____                 
+  / ____|           / ____|                
+ | (___   ___ _ __ | (___  _   _ _ __ ___  
+  \___ \ / _ \ '_ \ \___ \| | | | '_ ` _ \ 
+  ____) |  __/ | | |____) | |_| | | | | | |
+ |_____/ \___|_| |_|_____/ \__,_|_| |_| |_|
+                                           
+                                           
+	Description: Interface for LoRaWAN class B, beacon tracking and ping slots
+
+	Maintainer: Shea Gosnell
+
+*/
+
+#ifndef LORA_CLASS_B_HEADER
+#define LORA_CLASS_B_HEADER
+#include <stdint.h>
+#include <stdbool.h>
+#include "LoRaMac.h"
+#include "debug_uart.h"
+
+/********************************************************************
+ *Public Definitions                                                *
+ ********************************************************************/
+#ifdef DISABLE_LORA_CLASS_B_DEBUG
+	#define dbg_class_b(...)
+#else
+	#define dbg_class_b(...) Debug_printf(__VA_ARGS__)
+#endif
+
+//2^(7-periodicity) ping slots per 128s beacon period, spread over its 122.88s
+//beacon window, so 2 opens 32 of them, one every 3.84s
+#define CLASS_B_DEFAULT_PERIODICITY 2
+#define CLASS_B_MAX_PERIODICITY     7
+
+typedef enum
+{
+	class_b_off = 0,
+	class_b_wait_time,      //DeviceTimeReq goes out with the next uplink
+	class_b_searching,      //listening continuously for any beacon
+	class_b_acquiring,      //one window around the beacon DeviceTime predicts
+	class_b_wait_ping_info, //beacon locked, PingSlotInfoReq not answered yet
+	class_b_locked,         //answered, class B starts at the next beacon
+	class_b_active,
+}class_b_state_e;
+
+/********************************************************************
+ *Function Prototypes                                               *
+ ********************************************************************/
+void            lora_class_b_init                  (void (*on_class_change)(DeviceClass_t new_class));
+bool            lora_class_b_start                 (void);
+void            lora_class_b_stop                  (void);
+void            lora_class_b_before_uplink         (void);
+class_b_state_e lora_class_b_state                 (void);
+bool            lora_class_b_set_periodicity       (uint8_t periodicity);
+void            lora_class_b_print                 (void);
+void            cli_classb_implementation          (int argc, char *argv[]);
+
+//called from LoRaMac.c
+void            lora_class_b_on_beacon             (uint8_t *payload, uint16_t size, uint32_t rx_done_ms);
+void            lora_class_b_on_rx_timeout         (bool beacon);
+void            lora_class_b_before_tx             (void);
+void            lora_class_b_on_device_time        (uint32_t gps_s, uint8_t fraction, uint32_t tx_done_ms);
+void            lora_class_b_on_ping_slot_info_ans (void);
+uint8_t         lora_class_b_ping_slot_channel_req (uint32_t frequency, int8_t datarate);
+uint8_t         lora_class_b_beacon_freq_req       (uint32_t frequency);
+
+#endif //LORA_CLASS_B_HEADER
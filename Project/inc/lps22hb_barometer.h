@@ -0,0 +1,75 @@
+/*
+   _____             _____                 
+  / ____|           / ____|                
+ | (___   ___ _ __ | (___  _   _ _ __ ___  
+  \___ \ / _ \ '_ \ \___ \| | | | '_ ` _ \ 
+  ____) |  __/ | | |____) | |_| | | | | | |
+ |_____/ \___|_| |_|_____/ \__,_|_| |_| |_|
+                                           
+                                           
+	Description: Barometer mode on an LPS22HB pressure sensor.
+								The sensor fills its FIFO at 1Hz on its own and the watermark
+								wakes the MCU for one I2C burst. The batches feed a pressure
+								trend, and only a threshold or trend change uplinks early.
+
+	Maintainer: Shea Gosnell
+
+*/
+
+#ifndef LPS22HB_BAROMETER_HEADER
+#define LPS22HB_BAROMETER_HEADER
+#include <stdint.h>
+#include <stdbool.h>
+#include "global.h"
+
+/********************************************************************
+ *Public Definitions                                                *
+ ********************************************************************/
+#define BARO_ODR_HZ          1
+//samples per batch, the FIFO watermark (at most 31)
+#define BARO_WATERMARK       30
+//bytes per FIFO slot, 24 bit pressure then 16 bit temperature
+#define BARO_SLOT_BYTES      5
+#define BARO_FIFO_SLOTS      32
+//batch means the trend is fitted over, 8 minutes at the watermark
+#define BARO_TREND_POINTS    16
+#define BARO_TREND_MIN_POINTS 4
+
+#define BARO_HYSTERESIS_PA   50
+#define BARO_DEFAULT_RATE    100 //Pa/h
+
+typedef enum
+{
+	baro_band_normal = 0,
+	baro_band_high,
+	baro_band_low,
+}baro_band_e;
+
+typedef enum
+{
+	baro_trend_steady = 0,
+	baro_trend_rising,
+	baro_trend_falling,
+}baro_trend_e;
+
+//why the summary was sent
+typedef enum
+{
+	baro_reason_scheduled = 0,
+	baro_reason_threshold,
+	baro_reason_trend,
+}baro_reason_e;
+
+/********************************************************************
+ *Function Prototypes                                               *
+ ********************************************************************/
+void          baro_init        (void);
+test_status_e baro_test        (void);
+void          baro_on_event    (void);
+void          baro_on_wakeup   (void);
+void          baro_uplink      (void);
+void          baro_save_config (void);
+void          baro_load_config (void);
+void          baro_cli         (int argc, char *argv[]);
+
+#endif //LPS22HB_BAROMETER_HEADER
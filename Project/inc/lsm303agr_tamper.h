@@ -0,0 +1,70 @@
+/*
+   _____             _____                 
+  / ____|           / ____|                
+ | (___   ___ _ __ | (___  _   _ _ __ ___  
+  \___ \ / _ \ '_ \ \___ \| | | | '_ ` _ \ 
+  ____) |  __/ | | |____) | |_| | | | | | |
+ |_____/ \___|_| |_|_____/ \__,_|_| |_| |_|
+                                           
+                                           
+	Description: Tamper mode on an LSM303AGR accelerometer.
+								The sensor watches its own orientation and free-fall in low power
+								mode and only interrupts the MCU when one of them happens, so the
+								sensor is never polled. Each event sends an alarm straight away.
+
+	Maintainer: Shea Gosnell
+
+*/
+
+#ifndef LSM303AGR_TAMPER_HEADER
+#define LSM303AGR_TAMPER_HEADER
+#include <stdint.h>
+#include <stdbool.h>
+#include "global.h"
+
+/********************************************************************
+ *Public Definitions                                                *
+ ********************************************************************/
+#define TAMPER_ODR_HZ                 25
+//threshold register step at 2g full scale
+#define TAMPER_THS_STEP_MG            16
+//about 45 degrees of tilt before the orientation is known again
+#define TAMPER_DEFAULT_ORIENTATION_MG 704
+#define TAMPER_DEFAULT_FREEFALL_MG    352
+#define TAMPER_DEFAULT_FREEFALL_MS    120
+//uplink intervals between heartbeats
+#define TAMPER_DEFAULT_HEARTBEAT      24
+
+//the face pointing up, from the axis over the 6D threshold
+typedef enum
+{
+	tamper_orientation_unknown = 0,
+	tamper_orientation_x_up,
+	tamper_orientation_x_down,
+	tamper_orientation_y_up,
+	tamper_orientation_y_down,
+	tamper_orientation_z_up,
+	tamper_orientation_z_down,
+}tamper_orientation_e;
+
+//why the report was sent
+typedef enum
+{
+	tamper_reason_heartbeat = 0,
+	tamper_reason_orientation,
+	tamper_reason_freefall,
+}tamper_reason_e;
+
+/********************************************************************
+ *Function Prototypes                                               *
+ ********************************************************************/
+void          accel_tamper_init        (void);
+test_status_e accel_tamper_test        (void);
+void          accel_tamper_on_event    (void);
+void          accel_tamper_on_wakeup   (void);
+void          accel_tamper_uplink      (void);
+void          accel_tamper_save_config (void);
+void          accel_tamper_load_config (void);
+void          accel_tamper_cli         (int argc, char *argv[]);
+
+#endif //LSM303AGR_TAMPER_HEADER
@@ -0,0 +1,59 @@
+/*
+   _____             _____                 
+  / ____|           / ____|                
+ | (___   ___ _ __ | (___  _   _ _ __ ___  
+  \___ \ / _ \ '_ \ \___ \| | | | '_ ` _ \ 
+  ____) |  __/ | | |____) | |_| | | | | | |
+ |_____/ \___|_| |_|_____/ \__,_|_| |_| |_|
+                                           
+                                           
+	Description: Vibration mode on an LSM6DSL accelerometer.
+								Wake-on-motion on INT1, a FIFO batch on INT2, and an RMS, peak
+								and dominant frequency summary per axis at each uplink.
+
+	Maintainer: Shea Gosnell
+
+*/
+
+#ifndef LSM6DSL_VIBRATION_HEADER
+#define LSM6DSL_VIBRATION_HEADER
+#include <stdint.h>
+#include <stdbool.h>
+#include "global.h"
+
+/********************************************************************
+ *Public Definitions                                                *
+ ********************************************************************/
+#define VIBRATION_AXES           3
+//one batch, a power of two for the DFT
+#define VIBRATION_SAMPLES        128
+#define VIBRATION_BATCH_BYTES    (VIBRATION_SAMPLES * VIBRATION_AXES * 2)
+//the batch is read in I2C bursts of whole samples under the 255 byte limit
+#define VIBRATION_BURST_SAMPLES  32
+//accelerometer and FIFO rate while capturing
+#define VIBRATION_ODR_HZ         416
+
+#define VIBRATION_DEFAULT_WAKE_MG 250
+#define VIBRATION_DEFAULT_LIMIT   4
+
+typedef struct
+{
+	uint16_t rms_mg;    //with the mean (gravity) removed
+	uint16_t peak_mg;   //largest distance from the mean
+	uint16_t freq_hz;   //centre of the strongest DFT bin, 0 if there was no signal
+	bool     clipped;   //a sample hit full scale
+}vibration_axis_t;
+
+/********************************************************************
+ *Function Prototypes                                               *
+ ********************************************************************/
+void          vibration_init        (void);
+test_status_e vibration_test        (void);
+void          vibration_on_event    (void);
+void          vibration_on_wakeup   (void);
+void          vibration_uplink      (void);
+void          vibration_save_config (void);
+void          vibration_load_config (void);
+void          vibration_cli         (int argc, char *argv[]);
+
+#endif //LSM6DSL_VIBRATION_HEADER
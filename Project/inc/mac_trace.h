@@ -0,0 +1,104 @@
+/*
+   _____             _____                 
+  / ____|           / ____|                
+ | (___   ___ _ __ | (___  _   _ _ __ ___  
+  \___ \ / _ \ '_ \ \___ \| | | | '_ ` _ \ 
+  ____) |  __/ | | |____) | |_| | | | | | |
+ |_____/ \___|_| |_|_____/ \__,_|_| |_| |_|
+                                           
+                                           
+	Description: Interface for the binary LoRaMac event trace.
+								metaScripts/mac_trace_decode.sh reads the event numbers below,
+								so existing values must not be changed, only added to.
+
+	Maintainer: Shea Gosnell
+
+*/
+
+#ifndef MAC_TRACE_HEADER
+#define MAC_TRACE_HEADER
+#include <stdint.h>
+
+/********************************************************************
+ *Public Definitions                                                *
+ ********************************************************************/
+//must be a power of 2
+#define MAC_TRACE_ENTRIES 64
+
+typedef enum
+{
+	mac_trace_none                   = 0 ,
+	
+	//OnMacStateCheckTimerEvent
+	mac_trace_state_abort            = 1 ,
+	mac_trace_state_mlme_mcps        = 2 ,
+	mac_trace_state_tx_timeout       = 3 ,
+	mac_trace_join_success           = 4 , //arg8: join trials
+	mac_trace_join_fail              = 5 , //arg8: join trials, arg16: confirm status
+	mac_trace_join_give_up           = 6 ,
+	mac_trace_join_retry             = 7 ,
+	mac_trace_state_non_join_frame   = 8 ,
+	mac_trace_state_rx_frame         = 9 ,
+	mac_trace_confirmed_retry        = 10, //arg8: retries so far
+	mac_trace_state_idle             = 11,
+	
+	//Send, ScheduleTx, PrepareFrame, SendFrameOnChannel
+	mac_trace_prepare_frame_failed   = 12, //arg8: status
+	mac_trace_schedule_device_off    = 13,
+	mac_trace_schedule_not_joined    = 14,
+	mac_trace_schedule_joined        = 15,
+	mac_trace_schedule_length_error  = 16,
+	mac_trace_schedule_send_now      = 17, //arg8: channel
+	mac_trace_schedule_send_later    = 18, //arg8: channel, arg16: duty cycle wait in 100ms units
+	mac_trace_prepare_not_joined     = 19,
+	mac_trace_prepare_service_unknown= 20,
+	mac_trace_prepare_ok             = 21,
+	mac_trace_send_on_channel        = 22, //arg8: datarate, arg16: time on air ms
+	
+	//LoRaMacQueryTxPossible
+	mac_trace_query_null_param       = 23,
+	mac_trace_query_length_error     = 24, //arg8: requested length, arg16: max payload at the datarate, less pending MAC commands
+	mac_trace_query_ok               = 25,
+	
+	//LoRaMacMcpsRequest
+	mac_trace_mcps_null_param        = 26,
+	mac_trace_mcps_busy              = 27, //arg16: MAC state
+	mac_trace_mcps_ready             = 28, //arg8: request type
+	mac_trace_mcps_adr_off           = 29, //arg8: requested datarate
+	mac_trace_mcps_dr_invalid        = 30, //arg8: requested datarate
+	mac_trace_mcps_ok                = 31,
+	mac_trace_mcps_fail              = 32, //arg8: status
+	
+	//radio and window events
+	mac_trace_tx_done                = 33, //arg8: channel
+	mac_trace_tx_timeout             = 34,
+	mac_trace_rx_window_1            = 35, //arg8: datarate, arg16: window timeout symbols
+	mac_trace_rx_window_2            = 36, //arg8: datarate, arg16: window timeout symbols
+	mac_trace_rx_done                = 37, //arg8: size, arg16: rssi
+	mac_trace_rx_timeout             = 38, //arg8: slot
+	mac_trace_rx_error               = 39, //arg8: slot
+}mac_trace_event_e;
+
+typedef struct
+{
+	uint32_t timestamp; //ms, from TimerGetCurrentTime
+	uint8_t  event    ;
+	uint8_t  arg8     ;
+	uint16_t arg16    ;
+}mac_trace_entry_t;
+
+#ifdef DISABLE_MAC_TRACE
+	#define MAC_TRACE(event, arg8, arg16)
+#else
+	#define MAC_TRACE(event, arg8, arg16) mac_trace((event), (arg8), (arg16))
+#endif
+
+/********************************************************************
+ *Function Prototypes                                               *
+ ********************************************************************/
+void mac_trace(mac_trace_event_e event, uint8_t arg8, uint16_t arg16);
+void mac_trace_dump( void );
+void mac_trace_clear( void );
+void cli_trace_implementation(int argc, char *argv[]);
+
+#endif //MAC_TRACE_HEADER
@@ -7,7 +7,7 @@
  |_____/ \___|_| |_|_____/ \__,_|_| |_| |_|
                                            
                                            
-	Description: Device driver for the UMG604 Power meter.
+	Description: Device driver for the SCL-61D5 water meter.
 
 	Maintainer: Shea Gosnell
 
@@ -20,11 +20,19 @@
 #include "modbus_uart.h"
 #include "lora_sensum.h"
 
+/********************************************************************
+ *Public Definitions                                                *
+ ********************************************************************/
+#define SCL61D5_THRESHOLD_OFF INT32_MAX
+
 /********************************************************************
  *Function Prototypes                                               *
  ********************************************************************/
+void scl61d5_init(void);
 void scl61d5_wakeup(void);
+void scl61d5_on_each_wakeup(void);
 void scl61d5_uplink(void);
+void scl61d5_cli(int argc, char *argv[]);
 
 void scl61d5_save_config(void);
 void scl61d5_load_config(void);
@@ -34,6 +42,7 @@ void scl61d5Downlink(uint8_t *buffer, uint8_t size);
 /********************************************************************
  *Global Variables                                                  *
  ********************************************************************/
+extern int32_t flow_threshold;
 
 
 #endif //SCL61D5_HEADER
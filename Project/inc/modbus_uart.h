@@ -29,6 +29,7 @@ typedef enum
 	modbus_error_no_support = -1,
 	modbus_error_crc        = -2,
 	modbus_error_count      = -3,
+	modbus_error_no_memory  = -4,
 }modbus_error_e;
 
 typedef struct
@@ -55,6 +56,7 @@ typedef struct
  *Function Prototypes                                               *
  ********************************************************************/
 void     modbus_init( void );
+void     modbus_clock_changed( void );
 void     modbus_tamper_init(void);
 int      modbus_writeRegisters(uint8_t dev_addr, uint16_t memory_address, uint16_t register_count, uint8_t *transmit_buffer, uint8_t data_bytes_count);
 int      modbus_readRegisters(uint8_t dev_addr, uint16_t memory_address, uint16_t count, uint16_t *receive_buffer);
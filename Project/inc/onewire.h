@@ -19,6 +19,7 @@
 #ifndef ONEWIRE_HEADER
 #define ONEWIRE_HEADER
 #include <stdint.h>
+#include <stdbool.h>
 #include "lora_sensum.h"
 #include "debug_uart.h"
 
@@ -34,7 +35,7 @@
  *Public Function Prototypes                                         *
  ********************************************************************/
 void OWP_init(GPIO_TypeDef* port, uint16_t pin);
-void OWP_reset_bus(void);
+bool OWP_reset_bus(void);
 void OWP_write_byte(uint8_t byte);
 uint8_t OWP_read_byte(void);
 uint64_t OWP_getSingleID(void);
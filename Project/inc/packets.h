@@ -37,6 +37,7 @@ typedef enum//max is 16
 	packet_type_alarm,     //4
 	packet_type_error,     //5
 	packet_type_data2,     //6
+	packet_type_interval,  //7
 	packet_type_downlink_response = 15,
 }packet_type_e;
 
@@ -52,6 +53,7 @@ typedef enum
 	transmit_status_no_join,
 	transmit_status_no_send,
 	transmit_status_received_downlink,
+	transmit_status_queued,
 }transmit_status_e;
  
 typedef enum //max is 16
@@ -128,7 +130,8 @@ typedef  union
 			second        :6, //14
 			minute        :6, //18
 			hour          :5, //12
-			reserved      :7; //7 //was packet type and voltage
+			stack_free    :4, //4  min free stack, 64 byte units, of the run before this reset
+			isr_depth     :3; //3  deepest interrupt nesting, of the run before this reset
 		uint8_t
 		    sys_voltage	:4,
 			pkt_type	:4;
@@ -327,22 +330,7 @@ STATIC_ASSERT((sizeof(MEMBER(LIGHT_payload_t,members)) == LIGHT_SIZE));
 
 /****************************************************************************/
 
-#define SCL61D5_SIZE 12
-typedef union
-{
-	uint8_t payload[SCL61D5_SIZE];
-	struct
-	{
-		float watermark_high;
-		float watermark_low;
-		uint32_t 
-			high_tod    :12,
-			low_tod     :12,
-		    sys_voltage	:4,
-			pkt_type	:4;
-	}PACKED members;
-}scl61d5_payload_t;
-STATIC_ASSERT((sizeof(MEMBER(scl61d5_payload_t,members)) == SCL61D5_SIZE));
+//the SCL61D5 daily summary is packed by flow_summary_schema in payload_schemas.c
 
 /****************************************************************************/
 
@@ -0,0 +1,78 @@
+/*
+   _____             _____                 
+  / ____|           / ____|                
+ | (___   ___ _ __ | (___  _   _ _ __ ___  
+  \___ \ / _ \ '_ \ \___ \| | | | '_ ` _ \ 
+  ____) |  __/ | | |____) | |_| | | | | | |
+ |_____/ \___|_| |_|_____/ \__,_|_| |_| |_|
+                                           
+                                           
+	Description: Schema driven bit packing for uplink payloads.
+								Fields are packed LSB first from payload[0], the same order the
+								PACKED bitfield unions in packets.h use, so a schema can stand in
+								for one of those layouts byte for byte.
+
+	Maintainer: Shea Gosnell
+
+*/
+
+#ifndef PAYLOAD_CODEC_HEADER
+#define PAYLOAD_CODEC_HEADER
+#include <stdint.h>
+#include <stdbool.h>
+
+/********************************************************************
+ *Public Definitions                                                *
+ ********************************************************************/
+//no source value (the field is packed as 0), or no delta reference
+#define CODEC_NONE   0xFF
+
+//field flags
+#define CODEC_SIGNED 0x01 //two's complement, or zigzag for a varint
+#define CODEC_VARINT 0x02 //width is the group size, the top bit of each group marks another group
+#define CODEC_ALIGN  0x04 //start the field on a byte boundary
+#define CODEC_WRAP   0x08 //keep the low bits instead of saturating, as a bitfield assignment does
+
+typedef struct
+{
+	uint8_t  source; //index into the value array
+	uint8_t  delta;  //the value at this index is subtracted first, CODEC_NONE for none
+	uint8_t  width;  //bits, or the group size of a varint
+	uint8_t  flags;
+	uint16_t scale;  //divisor applied before packing, 0 and 1 both leave the value alone
+}codec_field_t;
+
+typedef struct
+{
+	const codec_field_t *fields;
+	uint8_t              count;
+}codec_schema_t;
+
+//for frames a fixed schema can't describe, such as a run of deltas
+typedef struct
+{
+	uint8_t *buffer; //NULL when only counting bits
+	uint16_t size_bits;
+	uint16_t bit;
+	bool     overflow;
+}codec_writer_t;
+
+//The name is only read by metaScripts/payload_decoder_gen.sh, keep one field per line.
+#define CODEC_FIELD(name, source, delta, width, flags, scale) { (source), (delta), (width), (flags), (scale) }
+#define CODEC_SCHEMA(name, fields) const codec_schema_t name = { (fields), sizeof(fields)/sizeof((fields)[0]) }
+
+/********************************************************************
+ *Function Prototypes                                               *
+ ********************************************************************/
+uint8_t  codec_encode       (const codec_schema_t *schema, const int32_t values[], uint8_t buffer[], uint8_t size);
+uint16_t codec_encoded_bits (const codec_schema_t *schema, const int32_t values[]);
+uint32_t codec_zigzag       (int32_t value);
+
+void     codec_writer_init  (codec_writer_t *writer, uint8_t buffer[], uint8_t size);
+void     codec_put_bits     (codec_writer_t *writer, uint32_t value, uint8_t width);
+void     codec_put_varint   (codec_writer_t *writer, uint32_t value, uint8_t width);
+void     codec_align        (codec_writer_t *writer);
+void     codec_write        (codec_writer_t *writer, const codec_schema_t *schema, const int32_t values[]);
+uint8_t  codec_writer_bytes (const codec_writer_t *writer);
+
+#endif //PAYLOAD_CODEC_HEADER
@@ -0,0 +1,197 @@
+/*
+   _____             _____                 
+  / ____|           / ____|                
+ | (___   ___ _ __ | (___  _   _ _ __ ___  
+  \___ \ / _ \ '_ \ \___ \| | | | '_ ` _ \ 
+  ____) |  __/ | | |____) | |_| | | | | | |
+ |_____/ \___|_| |_|_____/ \__,_|_| |_| |_|
+                                           
+                                           
+	Description: Payload codec schemas, and the value arrays they read from.
+
+	Maintainer: Shea Gosnell
+
+*/
+
+#ifndef PAYLOAD_SCHEMAS_HEADER
+#define PAYLOAD_SCHEMAS_HEADER
+#include "payload_codec.h"
+
+/********************************************************************
+ *Public Definitions                                                *
+ ********************************************************************/
+typedef enum
+{
+	single_count_value_count1 = 0,
+	single_count_value_leak,
+	single_count_value_tod,
+	single_count_value_voltage,
+	single_count_value_type,
+	//cumulative count at the end of each hour of the period
+	single_count_value_hour1,
+	single_count_value_hour2,
+	single_count_value_hour3,
+	single_count_value_hour4,
+	single_count_value_hour5,
+	single_count_value_hour6,
+	single_count_values,
+}single_count_value_e;
+
+typedef enum
+{
+	flow_summary_value_layout = 0,
+	flow_summary_value_samples,
+	flow_summary_value_failures,
+	flow_summary_value_mean,
+	flow_summary_value_min,
+	flow_summary_value_max,
+	flow_summary_value_min_tod,
+	flow_summary_value_max_tod,
+	flow_summary_value_volume,
+	flow_summary_value_stddev,
+	flow_summary_value_p10,
+	flow_summary_value_p50,
+	flow_summary_value_p90,
+	flow_summary_value_crossings,
+	flow_summary_value_first_up,
+	flow_summary_value_last_down,
+	flow_summary_value_above,
+	flow_summary_value_voltage,
+	flow_summary_value_type,
+	flow_summary_values,
+}flow_summary_value_e;
+
+//flow_summary_value_layout
+typedef enum
+{
+	flow_summary_layout_full = 0,
+	flow_summary_layout_core,
+	flow_summary_layout_detail,
+}flow_summary_layout_e;
+
+//the per axis values are in the same order for each axis
+#define VIBRATION_SUMMARY_AXIS_VALUES 3
+typedef enum
+{
+	vibration_summary_value_motions = 0,
+	vibration_summary_value_captures,
+	vibration_summary_value_rms_x,
+	vibration_summary_value_peak_x,
+	vibration_summary_value_freq_x,
+	vibration_summary_value_rms_y,
+	vibration_summary_value_peak_y,
+	vibration_summary_value_freq_y,
+	vibration_summary_value_rms_z,
+	vibration_summary_value_peak_z,
+	vibration_summary_value_freq_z,
+	vibration_summary_value_clipped,
+	vibration_summary_value_fault,
+	vibration_summary_value_voltage,
+	vibration_summary_value_type,
+	vibration_summary_values,
+}vibration_summary_value_e;
+
+typedef enum
+{
+	baro_summary_value_reason = 0,
+	baro_summary_value_band,
+	baro_summary_value_trend,
+	baro_summary_value_fault,
+	baro_summary_value_overrun,
+	baro_summary_value_pressure,
+	baro_summary_value_rate,
+	baro_summary_value_min,
+	baro_summary_value_max,
+	baro_summary_value_temperature,
+	baro_summary_value_batches,
+	baro_summary_value_voltage,
+	baro_summary_value_type,
+	baro_summary_values,
+}baro_summary_value_e;
+
+typedef enum
+{
+	tamper_report_value_reason = 0,
+	tamper_report_value_orientation,
+	tamper_report_value_previous,
+	tamper_report_value_fault,
+	tamper_report_value_changes,
+	tamper_report_value_freefalls,
+	tamper_report_value_voltage,
+	tamper_report_value_type,
+	tamper_report_values,
+}tamper_report_value_e;
+
+//bit n of the composite header's components field is part n
+typedef enum
+{
+	composite_part_counter = 0,
+	composite_part_sht30,
+	composite_part_ds18b20,
+	composite_part_light,
+	composite_parts,
+}composite_part_e;
+
+//one value array is shared by the header, every part and the trailer
+typedef enum
+{
+	composite_value_components = 0,
+	composite_value_count1,
+	composite_value_temperature1,
+	composite_value_humidity1,
+	composite_value_temperature2,
+	composite_value_humidity2,
+	composite_value_probe_temperature,
+	composite_value_probe_status,
+	composite_value_light,
+	composite_value_voltage,
+	composite_value_type,
+	composite_values,
+}composite_value_e;
+
+//the sample summary header and trailer share one value array
+typedef enum
+{
+	sample_summary_value_channels = 0,
+	sample_summary_value_period,
+	sample_summary_value_voltage,
+	sample_summary_value_type,
+	sample_summary_values,
+}sample_summary_value_e;
+
+//and each channel has one of its own
+typedef enum
+{
+	sample_channel_value_count = 0,
+	sample_channel_value_last,
+	sample_channel_value_mean,
+	sample_channel_value_min,
+	sample_channel_value_max,
+	sample_channel_values,
+}sample_channel_value_e;
+
+//byte for byte the single_count_data_t layout
+extern const codec_schema_t single_count_data_schema;
+//the same readings with the hourly deltas as varints, for comparison only, the
+//network side does not decode it yet
+extern const codec_schema_t single_count_compact_schema;
+//the SCL-61D5 daily summary, whole or as core and detail frames
+extern const codec_schema_t flow_summary_schema;
+extern const codec_schema_t flow_summary_core_schema;
+extern const codec_schema_t flow_summary_detail_schema;
+//the LSM6DSL vibration summary, 16 bytes
+extern const codec_schema_t vibration_summary_schema;
+//the LPS22HB barometer summary, scheduled or as an alarm, 11 bytes when steady
+extern const codec_schema_t baro_summary_schema;
+//the LSM303AGR tamper alarm and heartbeat, 4 bytes
+extern const codec_schema_t tamper_report_schema;
+//the composite frame, the header, the enabled parts in order, then the trailer
+extern const codec_schema_t composite_header_schema;
+extern const codec_schema_t composite_trailer_schema;
+extern const codec_schema_t * const composite_part_schemas[composite_parts];
+//the sampler's summary, the header, one channel part per channel, then the trailer
+extern const codec_schema_t sample_summary_header_schema;
+extern const codec_schema_t sample_summary_channel_schema;
+extern const codec_schema_t sample_summary_trailer_schema;
+
+#endif //PAYLOAD_SCHEMAS_HEADER
@@ -20,17 +20,22 @@
 #include <stdarg.h>
 #include "global.h"
 #include "packets.h"
+#include "uplink_queue.h"
  
 /********************************************************************
  *Function Prototypes                                               *
  ********************************************************************/
 uint8_t fourBit_battery_calculation(void);
+uint8_t fourBit_battery_from_mv     (uint32_t x);
 void Print_radio_information       (void);
 void radio_init                    (void);
 void sendStartupPacket             (void);
 transmit_status_e Uplink           (uint8_t payload[], uint8_t size);
+transmit_status_e Uplink_priority  (uint8_t payload[], uint8_t size, uplink_priority_e priority);
+transmit_status_e radio_transmit   (uint8_t payload[], uint8_t size);
 bool default_downlink              (uint8_t *buffer, uint8_t size);
 bool radio_joined                  (void);
+uint8_t radio_max_payload          (void);
 void save_radio_config_page        (void);
 void load_radio_config_page        (void);
 
@@ -0,0 +1,40 @@
+/*
+   _____             _____                 
+  / ____|           / ____|                
+ | (___   ___ _ __ | (___  _   _ _ __ ___  
+  \___ \ / _ \ '_ \ \___ \| | | | '_ ` _ \ 
+  ____) |  __/ | | |____) | |_| | | | | | |
+ |_____/ \___|_| |_|_____/ \__,_|_| |_| |_|
+                                           
+                                           
+	Description: Interface for the receive window calibration
+
+	Maintainer: Shea Gosnell
+
+*/
+
+#ifndef RX_TIMING_HEADER
+#define RX_TIMING_HEADER
+#include <stdint.h>
+#include "debug_uart.h"
+
+/********************************************************************
+ *Public Definitions                                                *
+ ********************************************************************/
+#ifdef DISABLE_RX_TIMING_DEBUG
+	#define dbg_rx_timing(...)
+#else
+	#define dbg_rx_timing(...) Debug_printf(__VA_ARGS__)
+#endif
+
+//number of downlink offsets kept, the worst of these sets the window
+#define RX_TIMING_SAMPLES 8
+
+/********************************************************************
+ *Function Prototypes                                               *
+ ********************************************************************/
+void rx_timing_on_downlink(int32_t offset_ms);
+void rx_timing_before_uplink( void );
+void rx_timing_print( void );
+
+#endif //RX_TIMING_HEADER
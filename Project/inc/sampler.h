@@ -0,0 +1,56 @@
+/*
+   _____             _____                 
+  / ____|           / ____|                
+ | (___   ___ _ __ | (___  _   _ _ __ ___  
+  \___ \ / _ \ '_ \ \___ \| | | | '_ ` _ \ 
+  ____) |  __/ | | |____) | |_| | | | | | |
+ |_____/ \___|_| |_|_____/ \__,_|_| |_| |_|
+                                           
+                                           
+	Description: Sampling between uplinks.
+	             A mode's channels are read every sample period, and each
+	             uplink sends the count, min, max, mean and last reading of
+	             every channel since the one before, so what happens between
+	             uplinks is seen without sending any more often.
+
+	Maintainer: Shea Gosnell
+
+*/
+
+#ifndef SAMPLER_HEADER
+#define SAMPLER_HEADER
+#include <stdint.h>
+#include <stdbool.h>
+
+/********************************************************************
+ *Public Definitions                                                *
+ ********************************************************************/
+#define SAMPLER_MAX_CHANNELS 4
+
+//reads every channel of the mode at once, a channel that could not be read is
+//left out by clearing its valid flag
+typedef void (*sampler_read_t)(int32_t values[], bool valid[]);
+
+typedef struct
+{
+	uint16_t count;
+	int32_t  min;
+	int32_t  max;
+	int32_t  last;
+	int64_t  sum;
+}sampler_channel_t;
+
+/********************************************************************
+ *Function Prototypes                                               *
+ ********************************************************************/
+void     sampler_start         (sampler_read_t read, uint8_t channels);
+void     sampler_on_each_wakeup(void);
+bool     sampler_uplink        (const int32_t values[], const bool valid[]);
+
+uint16_t sampler_period        (void);
+void     sampler_set_period    (uint16_t period_s);
+void     sampler_save_config   (uint8_t page);
+void     sampler_load_config   (uint8_t page);
+void     sampler_cli           (int argc, char *argv[]);
+
+#endif //SAMPLER_HEADER
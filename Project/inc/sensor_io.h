@@ -0,0 +1,43 @@
+/*
+   _____             _____                 
+  / ____|           / ____|                
+ | (___   ___ _ __ | (___  _   _ _ __ ___  
+  \___ \ / _ \ '_ \ \___ \| | | | '_ ` _ \ 
+  ____) |  __/ | | |____) | |_| | | | | | |
+ |_____/ \___|_| |_|_____/ \__,_|_| |_| |_|
+                                           
+                                           
+	Description: I2C glue for the ST MEMS register drivers.
+								The Drivers/BSP/Components drivers call Sensor_IO_Read and
+								Sensor_IO_Write with an opaque handle, here a sensor_io_t.
+
+	Maintainer: Shea Gosnell
+
+*/
+
+#ifndef SENSOR_IO_HEADER
+#define SENSOR_IO_HEADER
+#include <stdint.h>
+
+/********************************************************************
+ *Public Definitions                                                *
+ ********************************************************************/
+//register writes are single settings, a few bytes at most
+#define SENSOR_IO_MAX_WRITE 8
+//one I2C transaction moves at most 255 bytes
+#define SENSOR_IO_MAX_READ  255
+
+typedef struct
+{
+	uint8_t address;         //7 bit
+	uint8_t read_increment;  //OR-ed into the register of a multi byte read, 0 if the part increments by itself
+}sensor_io_t;
+
+/********************************************************************
+ *Function Prototypes                                               *
+ ********************************************************************/
+//both return 0 on success, as the ST drivers expect
+uint8_t Sensor_IO_Write(void *handle, uint8_t WriteAddr, uint8_t *pBuffer, uint16_t nBytesToWrite);
+uint8_t Sensor_IO_Read (void *handle, uint8_t ReadAddr , uint8_t *pBuffer, uint16_t nBytesToRead );
+
+#endif //SENSOR_IO_HEADER
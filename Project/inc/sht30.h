@@ -20,6 +20,7 @@
 #define SHT30HEADER
 #include <stdint.h>
 #include "lora_sensum.h"
+#include "acquire.h"
 
 /********************************************************************
  *Public Definitions                                                *
@@ -37,6 +38,8 @@ typedef struct
 sht30Reading_t sht30GetReading( void );
 void sht30_uplink( void );
 void sht30_onWakeup( void );
+void sht30_init( void );
+void sht30_onAlert( void );
 void sht30_save_config(void);
 void sht30_load_config(void);
 void sht30_cli_threshold(int argc, char *argv[]);
@@ -45,6 +48,7 @@ void sht32_onDownlink(uint8_t *buffer, uint8_t size);
  /********************************************************************
  *Global Variables                                                  *
  ********************************************************************/
+extern const acquire_driver_t sht30_acquire_driver;
 
 
 
@@ -23,6 +23,7 @@
 #define MIN_HOURS_TO_REJOIN 1
 
 #define MAX_RX_DATA 8 //maximum downlink of 8 bytes, dictated by sigfox
+#define SIGFOX_MAX_PAYLOAD 12 //maximum uplink of 12 bytes, dictated by sigfox
 
 #define PACKED __attribute__((packed, aligned(1)))
 /********************************************************************
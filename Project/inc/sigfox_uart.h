@@ -28,6 +28,7 @@
  *Function Prototypes                                               *
  ********************************************************************/
 void sigfox_usart_init      (void);
+void sigfox_clock_changed   (void);
 void disable_sigfox_usart   (void);
 void sigfox_send            (const char *format, ... );
 void sigfox_AddToWriteBuffer(char* message, int length);
@@ -0,0 +1,46 @@
+/*
+   _____             _____                 
+  / ____|           / ____|                
+ | (___   ___ _ __ | (___  _   _ _ __ ___  
+  \___ \ / _ \ '_ \ \___ \| | | | '_ ` _ \ 
+  ____) |  __/ | | |____) | |_| | | | | | |
+ |_____/ \___|_| |_|_____/ \__,_|_| |_| |_|
+                                           
+                                           
+	Description: Stack high water mark and interrupt nesting.
+								The free stack is painted at boot and measured from the bottom up,
+								so it shows the deepest the stack has ever been, interrupts included.
+
+	Maintainer: Shea Gosnell
+
+*/
+
+#ifndef STACK_MONITOR_HEADER
+#define STACK_MONITOR_HEADER
+#include <stdint.h>
+#include <stdbool.h>
+
+/********************************************************************
+ *Public Definitions                                                *
+ ********************************************************************/
+//startup packet units, 4 bits of free stack and 3 of nesting
+#define STACK_PACKET_FREE_UNIT  64
+#define STACK_PACKET_FREE_MAX   15
+#define STACK_PACKET_DEPTH_MAX  7
+
+/********************************************************************
+ *Function Prototypes                                               *
+ ********************************************************************/
+void     stack_monitor_paint          (void);
+void     stack_monitor_init           (void);
+void     stack_monitor_update         (void);
+void     stack_monitor_isr_enter      (void);
+void     stack_monitor_isr_exit       (void);
+uint16_t stack_monitor_size           (void);
+uint16_t stack_monitor_min_free       (void);
+uint8_t  stack_monitor_isr_depth_max  (void);
+void     stack_monitor_startup_fields (uint8_t *free_units, uint8_t *isr_depth);
+void     stack_monitor_print          (void);
+void     cli_stack_implementation     (int argc, char *argv[]);
+
+#endif //STACK_MONITOR_HEADER
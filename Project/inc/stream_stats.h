@@ -0,0 +1,91 @@
+/*
+   _____             _____                 
+  / ____|           / ____|                
+ | (___   ___ _ __ | (___  _   _ _ __ ___  
+  \___ \ / _ \ '_ \ \___ \| | | | '_ ` _ \ 
+  ____) |  __/ | | |____) | |_| | | | | | |
+ |_____/ \___|_| |_|_____/ \__,_|_| |_| |_|
+                                           
+                                           
+	Description: Streaming statistics over integer readings.
+								Everything is updated one sample at a time in fixed memory, so a
+								day of readings can be summarised without keeping any of them.
+
+	Maintainer: Shea Gosnell
+
+*/
+
+#ifndef STREAM_STATS_HEADER
+#define STREAM_STATS_HEADER
+#include <stdint.h>
+#include <stdbool.h>
+
+/********************************************************************
+ *Public Definitions                                                *
+ ********************************************************************/
+//fractional bits of the running mean
+#define STREAM_MEAN_SHIFT   4
+//P2 markers per quantile, and the quantiles kept
+#define STREAM_MARKERS      5
+#define STREAM_QUANTILES    3
+//the desired marker positions are kept with 16 fractional bits
+#define STREAM_POSITION_ONE 65536UL
+
+typedef enum
+{
+	stream_quantile_p10 = 0,
+	stream_quantile_p50,
+	stream_quantile_p90,
+}stream_quantile_e;
+
+//P2 estimate of one quantile (Jain & Chlamtac), the first five samples are
+//kept sorted in height[] until the markers can be placed
+typedef struct
+{
+	int32_t  height[STREAM_MARKERS];
+	uint16_t position[STREAM_MARKERS];
+	uint32_t desired[STREAM_MARKERS];   //Q16
+	uint32_t increment[STREAM_MARKERS]; //Q16
+}stream_quantile_t;
+
+typedef struct
+{
+	uint16_t count;
+	int32_t  min;
+	int32_t  max;
+	uint32_t min_time_s;
+	uint32_t max_time_s;
+
+	//Welford, the mean with STREAM_MEAN_SHIFT fractional bits and the sum of
+	//squared differences with twice that, saturating rather than wrapping
+	int64_t  mean;
+	uint64_t m2;
+
+	//trapezoidal integral of value over time, in value*seconds, doubled
+	int64_t  integral;
+
+	int32_t  last;
+	uint32_t last_time_s;
+
+	//threshold crossings, interpolated between the samples either side
+	int32_t  threshold;
+	bool     above;
+	uint16_t crossings;    //upward only
+	uint32_t first_up_s;   //UINT32_MAX if it was never above
+	uint32_t last_down_s;  //UINT32_MAX if it never came back below
+	uint32_t above_s;
+
+	stream_quantile_t quantile[STREAM_QUANTILES];
+}stream_stats_t;
+
+/********************************************************************
+ *Function Prototypes                                               *
+ ********************************************************************/
+void     stream_stats_reset    (stream_stats_t *stats, int32_t threshold);
+void     stream_stats_add      (stream_stats_t *stats, int32_t value, uint32_t time_s);
+int32_t  stream_stats_mean     (const stream_stats_t *stats);
+uint32_t stream_stats_stddev   (const stream_stats_t *stats);
+int32_t  stream_stats_quantile (const stream_stats_t *stats, stream_quantile_e quantile);
+int32_t  stream_stats_integral (const stream_stats_t *stats, uint32_t divisor);
+
+#endif //STREAM_STATS_HEADER
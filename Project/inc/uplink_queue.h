@@ -0,0 +1,59 @@
+/*
+   _____             _____                 
+  / ____|           / ____|                
+ | (___   ___ _ __ | (___  _   _ _ __ ___  
+  \___ \ / _ \ '_ \ \___ \| | | | '_ ` _ \ 
+  ____) |  __/ | | |____) | |_| | | | | | |
+ |_____/ \___|_| |_|_____/ \__,_|_| |_| |_|
+                                           
+                                           
+	Description: Application uplink queue.
+								Holds frames until the MAC's duty cycle time-off has passed,
+								highest priority first.
+
+	Maintainer: Shea Gosnell
+
+*/
+
+#ifndef UPLINK_QUEUE_HEADER
+#define UPLINK_QUEUE_HEADER
+#include <stdint.h>
+#include <stdbool.h>
+#include "debug_uart.h"
+#include "packets.h"
+
+/********************************************************************
+ *Public Definitions                                                *
+ ********************************************************************/
+#ifdef DISABLE_UPLINK_QUEUE_DEBUG
+	#define dbg_uplink_queue(...)
+#else
+	#define dbg_uplink_queue(...) Debug_printf(__VA_ARGS__)
+#endif
+
+#define UPLINK_QUEUE_ENTRIES      4
+//the interval meter fills frames up to this, larger frames bypass the queue
+#define UPLINK_QUEUE_PAYLOAD_SIZE 51
+
+typedef enum
+{
+	uplink_priority_periodic = 0,
+	uplink_priority_response,
+	uplink_priority_alarm,
+}uplink_priority_e;
+
+//called with each frame the queue has handed to the radio and the radio sent
+typedef void (*uplink_sent_t)(const uint8_t payload[], uint8_t size);
+
+/********************************************************************
+ *Function Prototypes                                               *
+ ********************************************************************/
+bool              uplink_queue_push     (const uint8_t payload[], uint8_t size, uplink_priority_e priority);
+void              uplink_queue_service  (void);
+transmit_status_e uplink_queue_send     (const uint8_t payload[], uint8_t size, uplink_priority_e priority);
+void              uplink_queue_on_wakeup(void);
+bool              uplink_queue_empty    (void);
+void              uplink_queue_print    (void);
+void              uplink_queue_on_sent  (uplink_sent_t callback);
+
+#endif //UPLINK_QUEUE_HEADER
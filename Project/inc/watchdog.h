@@ -18,7 +18,11 @@
 #include <stdint.h>
 #include <stdbool.h>
 
-#define WATCHDOG_RESET_VALUE 62 //*2 ms 63*2ms is the maximum (*2 is a rough estimate)
+//The counter ticks at PCLK1/4096/8 (WDGTB=3). clock_manager keeps PCLK1 at 2-2.1MHz
+//in every profile, so a tick is 15.6-16.4ms and the 63 ticks from the reset value
+//down to 0x3F last 984-1032ms.
+#define WATCHDOG_RESET_VALUE 62
+#define WATCHDOG_TIMEOUT_MS  984 //63 ticks at the fastest PCLK1, 2.1MHz
 #define WATCHDOG_WINDOW_VALUE (0x40|63)
 
 /********************************************************************
@@ -33,6 +37,8 @@ void reset_watchdog               ( void );
 void force_mcu_reset_via_watchdog ( void );
 int  watchdog_reset_occured       ( void );
 void clear_reset_source           ( void );
+void watchdog_refresh_in_sleep    ( bool enable );
+uint32_t watchdog_sleep_refreshes ( void );
 
 #endif //WATCHDOG_HEADER
 
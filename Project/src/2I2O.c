@@ -141,11 +141,15 @@ void set_output(char output, output_state state)
 void twoIO_uplink_state()
 {
 	lora_twoIO_t payload = {0};
+	const uint32_t channels[2] = {COUNT1_ADC_CH, STM_ADC_IN_CH};
+	uint16_t readings[2];
+	uint16_t vrefint;
 	
 	payload.members.output1_state  = output1_state;
 	payload.members.output2_state  = output2_state;
-	payload.members.input1_reading = HW_AdcReadChannel(COUNT1_ADC_CH);
-	payload.members.input2_reading = HW_AdcReadChannel(STM_ADC_IN_CH);
+	vrefint = HW_AdcReadChannels(channels, readings, 2);
+	payload.members.input1_reading = readings[0];
+	payload.members.input2_reading = readings[1];
 	
 	//print out the data to CLI
 	Debug_printf("Output 1 State  : %s\r\n", output_state_names[payload.members.output1_state]);
@@ -154,7 +158,7 @@ void twoIO_uplink_state()
 	Debug_printf("Input  2 Reading: %d\r\n", payload.members.input2_reading);
 	
 	payload.members.pkt_type    = packet_type_data;
-	payload.members.sys_voltage = fourBit_battery_calculation();
+	payload.members.sys_voltage = fourBit_battery_from_mv(HW_VrefintToBatteryLevel_mv(vrefint));
 	
 	Uplink(payload.payload, TWO_IO_SIZE);
 }
@@ -0,0 +1,153 @@
+/*
+   _____             _____                 
+  / ____|           / ____|                
+ | (___   ___ _ __ | (___  _   _ _ __ ___  
+  \___ \ / _ \ '_ \ \___ \| | | | '_ ` _ \ 
+  ____) |  __/ | | |____) | |_| | | | | | |
+ |_____/ \___|_| |_|_____/ \__,_|_| |_| |_|
+                                           
+                                           
+	Description: Sensor acquisition scheduler.
+
+	Maintainer: Shea Gosnell
+
+
+*/
+
+#include "global.h"
+#include "hw.h"
+#include "delays.h"
+#include "watchdog.h"
+#include "timeServer.h"
+#include "acquire.h"
+
+//time for the peripheral supply to come up, if it was off
+#define ACQUIRE_SUPPLY_SETTLE_MS 10
+//how often ready() is polled once a conversion is due
+#define ACQUIRE_POLL_MS          10
+
+//returns true once the job is finished with
+static bool acquire_step(acquire_job_t* job, TimerTime_t powered_at, uint32_t* next_ms)
+{
+	const acquire_driver_t* driver = job->driver;
+	uint32_t elapsed;
+	uint32_t remaining;
+
+	if(job->state == acquire_state_warmup)
+	{
+		elapsed = TimerGetElapsedTime(powered_at);
+		if(elapsed < job->warmup_ms)
+		{
+			remaining = job->warmup_ms - elapsed;
+			*next_ms  = (remaining < *next_ms) ? remaining : *next_ms;
+			return false;
+		}
+
+		job->started_at = TimerGetCurrentTime();
+		if(!driver->start(job->result))
+		{
+			//the driver records the failure in its result
+			dbg_acquire("%s start failed\r\n", driver->name);
+			job->state = acquire_state_done;
+			return true;
+		}
+		job->state = acquire_state_converting;
+		//the conversion can not be due yet, so fall through to the wait
+	}
+
+	elapsed = TimerGetElapsedTime(job->started_at);
+	if(elapsed < driver->conversion_ms)
+	{
+		remaining = driver->conversion_ms - elapsed;
+		*next_ms  = (remaining < *next_ms) ? remaining : *next_ms;
+		return false;
+	}
+
+	if(driver->ready && !driver->ready(job->result))
+	{
+		if(elapsed < (uint32_t)driver->conversion_ms + driver->timeout_ms)
+		{
+			//next_ms is already no longer than the poll period
+			return false;
+		}
+		dbg_acquire("%s timed out\r\n", driver->name);
+		driver->collect(job->result, true);
+	}
+	else
+	{
+		dbg_acquire("%s ready after %dms\r\n", driver->name, elapsed);
+		driver->collect(job->result, false);
+	}
+
+	job->state = acquire_state_done;
+	return true;
+}
+
+void acquire_run(acquire_job_t* jobs, uint8_t count)
+{
+	bool        supply_was_on;
+	TimerTime_t powered_at;
+	uint32_t    next_ms;
+	uint8_t     pending = 0;
+	int         i;
+
+	//the supply is left as it was found
+	supply_was_on = LL_GPIO_IsOutputPinSet(PER_SUPPLY_ENABLE_PORT, PER_SUPPLY_ENABLE_PIN);
+	if(!supply_was_on)
+	{
+		LL_GPIO_SetOutputPin(PER_SUPPLY_ENABLE_PORT, PER_SUPPLY_ENABLE_PIN);
+		delay_timeout_ms(ACQUIRE_SUPPLY_SETTLE_MS);
+	}
+
+	for(i=0;i<count;i++)
+	{
+		jobs[i].state     = acquire_state_warmup;
+		jobs[i].warmup_ms = 0;
+		if(jobs[i].driver->power_on)
+		{
+			jobs[i].driver->power_on(jobs[i].result);
+		}
+		//a sensor that was already powered does not need to warm up again
+		if(jobs[i].driver->power_on || !supply_was_on)
+		{
+			jobs[i].warmup_ms = jobs[i].driver->warmup_ms;
+		}
+		pending++;
+	}
+	//warm-up times all count from here, as the sensors were powered together
+	powered_at = TimerGetCurrentTime();
+
+	while(pending)
+	{
+		reset_watchdog();
+		next_ms = ACQUIRE_POLL_MS;
+
+		for(i=0;i<count;i++)
+		{
+			if(jobs[i].state != acquire_state_done && acquire_step(&jobs[i], powered_at, &next_ms))
+			{
+				pending--;
+				//collecting takes time, so re-check everything before sleeping
+				next_ms = 0;
+			}
+		}
+
+		if(pending && next_ms)
+		{
+			delay_timeout_ms(next_ms);
+		}
+	}
+
+	for(i=0;i<count;i++)
+	{
+		if(jobs[i].driver->power_off)
+		{
+			jobs[i].driver->power_off(jobs[i].result);
+		}
+	}
+
+	if(!supply_was_on)
+	{
+		LL_GPIO_ResetOutputPin(PER_SUPPLY_ENABLE_PORT, PER_SUPPLY_ENABLE_PIN);
+	}
+}
@@ -25,21 +25,30 @@
 #include "radio_common.h"
 #include "packets.h"
 #include "debug_uart.h"
+#include "fixed_point.h"
+#include "flash_map.h"
+#include "sampler.h"
+#include "adc.h"
 
 
 #define VREFINT_CAL ((uint16_t *) ((uint32_t) 0x1FF80078))
 
 uint16_t AdcReadCompensate(uint32_t Channel)
 {
-	uint16_t adc_data = 0;
-	uint16_t vrefint_data = 0;
 	uint16_t output_data = 0;
-	float processor = 0;
-	
-	adc_data = HW_AdcReadChannel(Channel);
-	
 	
+	AdcReadCompensateChannels(&Channel, &output_data, 1);
 	
+	return output_data;
+}
+
+//reads all of the channels in one ADC scan, and compensates each of them for
+//the supply voltage using the VREFINT reading from that scan.
+//returns the VREFINT reading, so the caller can work out the supply as well.
+uint16_t AdcReadCompensateChannels(const uint32_t* channels, uint16_t* results, uint8_t count)
+{
+	uint16_t vrefint_data = 0;
+	int i;
 	
 	// 30.*VREFINT_CAL*adc_data
 	//--------------------------
@@ -48,23 +57,38 @@ uint16_t AdcReadCompensate(uint32_t Channel)
 	//VREFINT_CAL = (*VREFINT_CAL)
 	//adc_data = reading
 	//FULL_SCALE = 4095
-
-
-	vrefint_data = HW_AdcReadChannel(LL_ADC_CHANNEL_VREFINT);
+	vrefint_data = HW_AdcReadChannels(channels, results, count);
 	
+	for(i=0;i<count;i++)
+	{
+		results[i] = fxp_vrefint_compensate(results[i], vrefint_data, *VREFINT_CAL);
+	}
 	
-	//processor = 3.0;
-	processor = (float)adc_data;
-	processor /= (float)vrefint_data;
-	processor *= (float)(*VREFINT_CAL);
-	//processor /= 4095.0;
-	
-	output_data = (uint16_t)processor;
-	
-	return output_data;
+	return vrefint_data;
 }
 
 
+//one ADC scan of the three inputs, returns the VREFINT reading of the scan
+static uint16_t three_adc_read(int32_t values[])
+{
+	const uint32_t channels[3] = {ADC1_CH, ADC2_CH, ADC3_CH};
+	uint16_t readings[3];
+	uint16_t vrefint;
+	uint8_t  i;
+	
+	vrefint = AdcReadCompensateChannels(channels, readings, 3);
+	for(i=0;i<3;i++)
+	{
+		values[i] = readings[i];
+	}
+	return vrefint;
+}
+
+static void three_adc_sample(int32_t values[], bool valid[])
+{
+	three_adc_read(values);
+}
+
 void init_three_adc( void )
 {
 	//configure the pin as an analog input
@@ -81,17 +105,37 @@ void init_three_adc( void )
 	HW_GPIO_Init(ADC1_PORT, ADC1_PIN, &GPIO_InitStruct);
 	HW_GPIO_Init(ADC2_PORT, ADC2_PIN, &GPIO_InitStruct);
 	HW_GPIO_Init(ADC3_PORT, ADC3_PIN, &GPIO_InitStruct);
+	
+	sampler_start(&three_adc_sample, 3);
+}
+
+void three_adc_save_config( void )
+{
+	sampler_save_config(device_specific_page_1);
+}
 
+void three_adc_load_config( void )
+{
+	sampler_load_config(device_specific_page_1);
 }
 
 void three_adc_send( void )
 {
 	lora_three_adc_payload_t packet;
+	int32_t  readings[3];
+	uint16_t vrefint;
 
+	vrefint = three_adc_read(readings);
+	
+	//with sampling on, the summary goes instead
+	if(sampler_uplink(readings, NULL))
+	{
+		return;
+	}
 	
-	packet.members.reading1 = AdcReadCompensate(ADC1_CH);
-	packet.members.reading2 = AdcReadCompensate(ADC2_CH);
-	packet.members.reading3 = AdcReadCompensate(ADC3_CH);
+	packet.members.reading1 = readings[0];
+	packet.members.reading2 = readings[1];
+	packet.members.reading3 = readings[2];
 	
 	
 	//calculate the actual voltage from this value using the following formula
@@ -111,7 +155,7 @@ void three_adc_send( void )
 
 	
 	packet.members.pkt_type    = packet_type_data;
-	packet.members.sys_voltage = fourBit_battery_calculation();
+	packet.members.sys_voltage = fourBit_battery_from_mv(HW_VrefintToBatteryLevel_mv(vrefint));
 	
 	Uplink(packet.payload, THREE_ADC_SIZE);
 }
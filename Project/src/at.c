@@ -61,6 +61,7 @@
 
 #include "global.h"
 #include "debug_uart.h"
+#include "buffer_arena.h"
 
 #ifndef DISABLE_SEND_DEBUG
 	#define dbg_send(...) Debug_printf(__VA_ARGS__); await_uart_tx()
@@ -71,11 +72,6 @@
 /* External variables --------------------------------------------------------*/
 /* Private typedef -----------------------------------------------------------*/
 /* Private define ------------------------------------------------------------*/
-/**
- * @brief Max size of the data that can be received
- */
-#define MAX_RECEIVED_DATA 255
-
 /* Private macro -------------------------------------------------------------*/
 /**
  * @brief Macro to return when an error occurs
@@ -89,31 +85,13 @@
 /*!
  * User application data buffer size
  */
-#define LORAWAN_APP_DATA_BUFF_SIZE                           64
-
-/*!
- * User application data
- */
-static uint8_t AppDataBuff[LORAWAN_APP_DATA_BUFF_SIZE];
+#define LORAWAN_APP_DATA_BUFF_SIZE                           ARENA_UPLINK_PAYLOAD_MAX
 
 /*!
- * User application data structure
- */
-static lora_AppData_t AppData={ AppDataBuff,  0 ,0 };
-/**
- * @brief Buffer that contains the last received data
- */
-static char ReceivedData[MAX_RECEIVED_DATA];
-
-/**
- * @brief Size if the buffer that contains the last received data
+ * User application data structure, the buffer is borrowed from the arena
+ * for each send, LORA_send has copied it into the MAC by the time it returns
  */
-static unsigned ReceivedDataSize = 0;
-
-/**
- * @brief Application port the last received data were on
- */
-static uint8_t ReceivedDataPort;
+static lora_AppData_t AppData={ NULL,  0 ,0 };
 
 /* Private function prototypes -----------------------------------------------*/
 /**
@@ -176,15 +154,6 @@ static void print_u(unsigned int value);
 
 /* Exported functions ------------------------------------------------------- */
 
-void set_at_receive(uint8_t AppPort, uint8_t* Buff, uint8_t BuffSize)
-{
-  if (MAX_RECEIVED_DATA <= BuffSize)
-    BuffSize = MAX_RECEIVED_DATA;
-  memcpy1((uint8_t *)ReceivedData, Buff, BuffSize);
-  ReceivedDataSize = BuffSize;
-  ReceivedDataPort = AppPort;
-}
-
 ATEerror_t at_return_ok(const char *param)
 {
   return AT_OK;
@@ -872,6 +841,7 @@ ATEerror_t at_SendBinary(const char *param)
   uint32_t appPort;
   unsigned size=0;
   char hex[3];
+  arena_mark_t mark = arena_mark();
   
     /* read and set the application port */
   if (1 != sscanf(buf, "%u:", &appPort))
@@ -899,6 +869,13 @@ ATEerror_t at_SendBinary(const char *param)
     bufSize --;
   }
 
+  AppData.Buff = arena_alloc(arena_owner_uplink_payload, (bufSize/2 < LORAWAN_APP_DATA_BUFF_SIZE) ? bufSize/2 : LORAWAN_APP_DATA_BUFF_SIZE);
+  if (AppData.Buff == NULL)
+  {
+    dbg_send("195487ABCDEF AT+SEND no buffer\r\n");
+    return AT_ERROR;
+  }
+
   hex[2] = 0;
   while ((size < LORAWAN_APP_DATA_BUFF_SIZE) && (bufSize > 1))
   {
@@ -907,6 +884,7 @@ ATEerror_t at_SendBinary(const char *param)
     if (tiny_sscanf(hex, "%hhx", &AppData.Buff[size]) != 1)
     {
 			dbg_send("195487ABCDEF AT+SEND error transferring buffer\r\n");
+      arena_release(mark);
       return AT_PARAM_ERROR;
     }
     size++;
@@ -915,6 +893,7 @@ ATEerror_t at_SendBinary(const char *param)
   if (bufSize != 0)
   {
 		dbg_send("195487ABCDEF AT+SEND tx buffer too large\r\n");
+    arena_release(mark);
     return AT_PARAM_ERROR;
   }
   
@@ -922,6 +901,7 @@ ATEerror_t at_SendBinary(const char *param)
   AppData.Port= appPort;
 
   status = LORA_send( &AppData, lora_config_reqack_get() );
+  arena_release(mark);
   
   if (status == LORA_SUCCESS)
   {
@@ -941,6 +921,7 @@ ATEerror_t at_Send(const char *param)
   const char *buf= param;
   char bufSize= strlen(param);
   uint32_t appPort;
+  arena_mark_t mark = arena_mark();
   
     /* read and set the application port */
   if (1 != sscanf(buf, "%u:", &appPort))
@@ -972,11 +953,17 @@ ATEerror_t at_Send(const char *param)
   {
     bufSize = LORAWAN_APP_DATA_BUFF_SIZE;
   }
+  AppData.Buff = arena_alloc(arena_owner_uplink_payload, bufSize);
+  if (AppData.Buff == NULL)
+  {
+    return AT_ERROR;
+  }
   memcpy1(AppData.Buff, (uint8_t *)buf, bufSize);
   AppData.BuffSize = bufSize;
   AppData.Port= appPort;
   
   status = LORA_send( &AppData, lora_config_reqack_get() );
+  arena_release(mark);
   
   if (status == LORA_SUCCESS)
   {
@@ -988,34 +975,6 @@ ATEerror_t at_Send(const char *param)
   }
 }
 
-ATEerror_t at_ReceiveBinary(const char *param)
-{
-  unsigned i;
-  
-  AT_PRINTF("%d:", ReceivedDataPort);
-  for (i = 0; i < ReceivedDataSize; i++)
-  {
-    AT_PRINTF("%02x", ReceivedData[i]);
-  }
-  AT_PRINTF("\r\n");
-  ReceivedDataSize = 0;
-
-  return AT_OK;
-}
-
-ATEerror_t at_Receive(const char *param)
-{
-  AT_PRINTF("%d:", ReceivedDataPort);
-  if (ReceivedDataSize)
-  {
-    AT_PRINTF("%s", ReceivedData);
-    ReceivedDataSize = 0;
-  }
-  AT_PRINTF("\r\n");
-
-  return AT_OK;
-}
-
 ATEerror_t at_version_get(const char *param)
 {
   AT_PRINTF(AT_VERSION_STRING"\r\n");
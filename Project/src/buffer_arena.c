@@ -0,0 +1,96 @@
+/*
+   _____             _____                 
+  / ____|           / ____|                
+ | (___   ___ _ __ | (___  _   _ _ __ ___  
+  \___ \ / _ \ '_ \ \___ \| | | | '_ ` _ \ 
+  ____) |  __/ | | |____) | |_| | | | | | |
+ |_____/ \___|_| |_|_____/ \__,_|_| |_| |_|
+                                           
+                                           
+	Description: Lifetime-scoped scratch arena.
+								A bump allocator over one static block. Only the main loop borrows
+								from it, never an interrupt, and every borrower releases its mark
+								before returning, so the block is empty between calls. The high
+								water mark shows how much of ARENA_SIZE is really needed.
+
+	Maintainer: Shea Gosnell
+
+
+*/
+
+#include <stddef.h>
+#include "global.h"
+#include "debug_uart.h"
+#include "buffer_arena.h"
+
+static uint32_t arena[ARENA_SIZE / sizeof(uint32_t)];
+static uint16_t arena_top = 0;
+static uint16_t arena_high_water = 0;
+static uint16_t arena_failures = 0;
+static uint16_t arena_owner_peak[arena_owner_count] = {0};
+
+//padded to line up with the rest of the show output
+static const char* const arena_owner_name[arena_owner_count] =
+{
+	"Arena peak uplink ascii  ",
+	"Arena peak uplink payload",
+	"Arena peak modbus rx     ",
+	"Arena peak vibration     ",
+	"Arena peak barometer     ",
+};
+
+arena_mark_t arena_mark(void)
+{
+	return arena_top;
+}
+
+//NULL if the request does not fit, the caller has to fail its operation cleanly
+void* arena_alloc(arena_owner_e owner, uint16_t size)
+{
+	uint16_t aligned = ARENA_ALIGN(size);
+	uint8_t *block;
+
+	if((owner >= arena_owner_count) || (aligned > (ARENA_SIZE - arena_top)))
+	{
+		arena_failures++;
+		return NULL;
+	}
+
+	block      = (uint8_t *)arena + arena_top;
+	arena_top += aligned;
+
+	if(arena_top > arena_high_water)
+	{
+		arena_high_water = arena_top;
+	}
+	if(size > arena_owner_peak[owner])
+	{
+		arena_owner_peak[owner] = size;
+	}
+	return block;
+}
+
+//frees everything allocated since the mark was taken
+void arena_release(arena_mark_t mark)
+{
+	if(mark < arena_top)
+	{
+		arena_top = mark;
+	}
+}
+
+void arena_print(void)
+{
+	uint8_t i;
+
+	Debug_printf("Arena size               :%u\r\n", ARENA_SIZE);
+	Debug_printf("Arena in use             :%u\r\n", arena_top);
+	Debug_printf("Arena high water         :%u\r\n", arena_high_water);
+	Debug_printf("Arena failed allocations :%u\r\n", arena_failures);
+	await_uart_tx();
+	for(i=0;i<arena_owner_count;i++)
+	{
+		Debug_printf("%s:%u\r\n", arena_owner_name[i], arena_owner_peak[i]);
+		await_uart_tx();
+	}
+}
@@ -0,0 +1,567 @@
+/*
+   _____             _____                 
+  / ____|           / ____|                
+ | (___   ___ _ __ | (___  _   _ _ __ ___  
+  \___ \ / _ \ '_ \ \___ \| | | | '_ ` _ \ 
+  ____) |  __/ | | |____) | |_| | | | | | |
+ |_____/ \___|_| |_|_____/ \__,_|_| |_| |_|
+                                           
+                                           
+	Description: System clock and core voltage manager.
+								Each user asks for a profile, the highest one asked for runs.
+								A switch raises the core voltage and flash wait states before
+								the clock goes up and lowers them after it comes down, then
+								reprograms every peripheral whose bit timing depends on the
+								clock. Time in each profile is kept, run and sleep apart, and
+								turned into charge and energy per uplink for each policy.
+
+	Maintainer: Shea Gosnell
+
+*/
+
+#include <string.h>
+#include "global.h"
+#include "hw.h"
+#include "hw_rtc.h"
+#include "hw_msp.h"
+#include "hw_spi.h"
+#include "debug_uart.h"
+#include "i2c1.h"
+#include "modbus_uart.h"
+#ifdef RADIO_SIGFOX_AT
+	#include "sigfox_uart.h"
+#endif
+#include "clock_manager.h"
+
+typedef struct
+{
+	const char *name;
+	uint32_t    hz;
+	uint32_t    voltage;   //LL_PWR_REGU_VOLTAGE_SCALEx, a larger value is a lower voltage
+	uint32_t    latency;   //flash wait states
+	uint32_t    apb1_div;  //keeps PCLK1 near 2MHz, so the WWDG timeout does not move
+	uint16_t    run_ua;
+	uint16_t    sleep_ua;
+}clock_profile_t;
+
+typedef enum
+{
+	clock_state_run = 0,
+	clock_state_sleep,
+	clock_state_stop,
+}clock_state_e;
+
+typedef struct
+{
+	uint32_t uplinks;
+	uint32_t awake_ms;
+	uint64_t charge_uams;
+	uint32_t energy_uj;
+}clock_uplink_stats_t;
+
+static const clock_profile_t profiles[clock_profiles] =
+{
+	{"low, MSI 4.2MHz range 3",  4194304,  LL_PWR_REGU_VOLTAGE_SCALE3, LL_FLASH_LATENCY_0, LL_RCC_APB1_DIV_2,  CLOCK_LOW_RUN_UA,  CLOCK_LOW_SLEEP_UA },
+	{"mid, HSI 16MHz range 2",   16000000, LL_PWR_REGU_VOLTAGE_SCALE2, LL_FLASH_LATENCY_1, LL_RCC_APB1_DIV_8,  CLOCK_MID_RUN_UA,  CLOCK_MID_SLEEP_UA },
+	{"high, PLL 32MHz range 1",  32000000, LL_PWR_REGU_VOLTAGE_SCALE1, LL_FLASH_LATENCY_1, LL_RCC_APB1_DIV_16, CLOCK_HIGH_RUN_UA, CLOCK_HIGH_SLEEP_UA},
+};
+
+static const char *policy_names[clock_policies] =
+{
+	"fixed",
+	"burst",
+	"lean",
+};
+
+static clock_policy_e  policy  = clock_policy_burst;
+//SystemClock_Config() leaves the PLL running
+static clock_profile_e active  = clock_profile_high;
+//main stays at 32MHz until clock_manager_init(), so a STOP before it restores the PLL as it used to
+static clock_profile_e demand[clock_users] = {clock_profile_high, clock_profile_low};
+static bool            running = false;
+//a radio wait has lowered the clock under the lean policy
+static bool            dropped = false;
+static uint32_t        switches = 0;
+
+//RTC ticks in each profile, and in STOP
+static clock_state_e   state = clock_state_run;
+static uint32_t        mark  = 0;
+static uint32_t        ticks[clock_profiles][2];
+static uint32_t        stop_ticks = 0;
+
+//the counters at the end of the last uplink, the next uplink is charged the difference
+static uint32_t        window_ticks[clock_profiles][2];
+static uint32_t        window_stop_ticks = 0;
+static clock_policy_e  window_policy = clock_policies;
+
+static clock_uplink_stats_t uplink_stats[clock_policies];
+static uint32_t        last_charge_uams = 0;
+static uint32_t        last_energy_uj   = 0;
+
+/********************************************************************
+ *Accounting                                                        *
+ ********************************************************************/
+
+static void clock_account(clock_state_e next)
+{
+	uint32_t now;
+
+	//the RTC is not running before clock_manager_init()
+	if(!running)
+	{
+		return;
+	}
+
+	now = HW_RTC_GetTimerValue();
+	if(state == clock_state_stop)
+	{
+		stop_ticks += now - mark;
+	}
+	else
+	{
+		ticks[active][state] += now - mark;
+	}
+	mark  = now;
+	state = next;
+}
+
+static void clock_window_restart(void)
+{
+	memcpy(window_ticks, ticks, sizeof(ticks));
+	window_stop_ticks = stop_ticks;
+	window_policy     = policy;
+}
+
+/********************************************************************
+ *Switching                                                         *
+ ********************************************************************/
+
+static void clock_set_voltage(uint32_t voltage)
+{
+	LL_PWR_SetRegulVoltageScaling(voltage);
+	while(LL_PWR_IsActiveFlag_VOSF())
+	{
+		;
+	}
+}
+
+static void clock_set_latency(uint32_t latency)
+{
+	LL_FLASH_SetLatency(latency);
+	while(LL_FLASH_GetLatency() != latency)
+	{
+		;
+	}
+}
+
+static void clock_peripherals_changed(void)
+{
+	HW_SPI_ClockChanged();
+	Debug_clock_changed();
+	i2c1_clock_changed();
+	modbus_clock_changed();
+	#ifdef RADIO_SIGFOX_AT
+	{
+		sigfox_clock_changed();
+	}
+	#endif
+}
+
+//Reads the voltage, wait states and clock source back from the registers, not
+//from the last profile, as STOP leaves the core running on MSI with the rest as it was.
+static void clock_apply(clock_profile_e target)
+{
+	const clock_profile_t *to = &profiles[target];
+	uint32_t source;
+	uint32_t status;
+
+	//a character on the wire would be cut by the BRR change
+	Debug_flush();
+	clock_account(state);
+	//after a STOP wake the core runs on MSI whatever SystemCoreClock says
+	SystemCoreClockUpdate();
+
+	//speeding up, the voltage and the wait states go first
+	if(to->voltage < LL_PWR_GetRegulVoltageScaling())
+	{
+		clock_set_voltage(to->voltage);
+	}
+	if(to->latency > LL_FLASH_GetLatency())
+	{
+		clock_set_latency(to->latency);
+	}
+
+	switch(target)
+	{
+		case clock_profile_low:
+			if(!LL_RCC_MSI_IsReady())
+			{
+				//the range can only be changed with MSI off or ready
+				LL_RCC_MSI_SetRange(LL_RCC_MSIRANGE_6);
+				LL_RCC_MSI_Enable();
+				while(!LL_RCC_MSI_IsReady())
+				{
+					;
+				}
+			}
+			source = LL_RCC_SYS_CLKSOURCE_MSI;
+			status = LL_RCC_SYS_CLKSOURCE_STATUS_MSI;
+			break;
+		case clock_profile_mid:
+			LL_RCC_HSI_Enable();
+			while(!LL_RCC_HSI_IsReady())
+			{
+				;
+			}
+			source = LL_RCC_SYS_CLKSOURCE_HSI;
+			status = LL_RCC_SYS_CLKSOURCE_STATUS_HSI;
+			break;
+		case clock_profile_high:
+		default:
+			//the PLL keeps the HSI x6 /3 set up by SystemClock_Config()
+			LL_RCC_HSI_Enable();
+			while(!LL_RCC_HSI_IsReady())
+			{
+				;
+			}
+			LL_RCC_PLL_Enable();
+			while(!LL_RCC_PLL_IsReady())
+			{
+				;
+			}
+			source = LL_RCC_SYS_CLKSOURCE_PLL;
+			status = LL_RCC_SYS_CLKSOURCE_STATUS_PLL;
+			break;
+	}
+
+	//PCLK1 must not overshoot on the way up
+	if(to->hz > SystemCoreClock)
+	{
+		LL_RCC_SetAPB1Prescaler(to->apb1_div);
+	}
+	LL_RCC_SetSysClkSource(source);
+	while(LL_RCC_GetSysClkSource() != status)
+	{
+		;
+	}
+	LL_RCC_SetAPB1Prescaler(to->apb1_div);
+
+	//stop whatever no longer clocks anything, MSI is restarted by the hardware on a STOP wake
+	if(target != clock_profile_high)
+	{
+		LL_RCC_PLL_Disable();
+	}
+	if(target == clock_profile_low)
+	{
+		LL_RCC_HSI_Disable();
+	}
+	else
+	{
+		LL_RCC_MSI_Disable();
+	}
+
+	//slowing down, the wait states and the voltage go last
+	if(to->latency < LL_FLASH_GetLatency())
+	{
+		clock_set_latency(to->latency);
+	}
+	if(to->voltage > LL_PWR_GetRegulVoltageScaling())
+	{
+		clock_set_voltage(to->voltage);
+	}
+
+	SystemCoreClockUpdate();
+	if(target != active)
+	{
+		switches++;
+	}
+	active = target;
+
+	clock_peripherals_changed();
+}
+
+static clock_profile_e clock_target(void)
+{
+	clock_profile_e target = clock_profile_low;
+	uint8_t i;
+
+	if(policy == clock_policy_fixed)
+	{
+		return clock_profile_high;
+	}
+
+	for(i=0;i<clock_users;i++)
+	{
+		if(demand[i] > target)
+		{
+			target = demand[i];
+		}
+	}
+	return target;
+}
+
+static void clock_update(void)
+{
+	clock_profile_e target = clock_target();
+
+	if(!dropped && (target != active))
+	{
+		clock_apply(target);
+	}
+}
+
+/********************************************************************
+ *Public functions                                                  *
+ ********************************************************************/
+
+void clock_manager_init()
+{
+	//STOP wakes on MSI, the faster range shortens the wake before the profile is restored
+	if(!LL_RCC_MSI_IsReady() || (LL_RCC_GetSysClkSource() != LL_RCC_SYS_CLKSOURCE_STATUS_MSI))
+	{
+		LL_RCC_MSI_Disable();
+		LL_RCC_MSI_SetRange(LL_RCC_MSIRANGE_6);
+	}
+	LL_RCC_SetClkAfterWakeFromStop(LL_RCC_STOP_WAKEUPCLOCK_MSI);
+
+	memset(ticks, 0, sizeof(ticks));
+	stop_ticks = 0;
+	mark    = HW_RTC_GetTimerValue();
+	state   = clock_state_run;
+	running = true;
+	clock_window_restart();
+	clock_update();
+}
+
+void clock_request(clock_user_e user, clock_profile_e profile)
+{
+	demand[user] = profile;
+	clock_update();
+}
+
+void clock_release(clock_user_e user)
+{
+	demand[user] = clock_profile_low;
+	clock_update();
+}
+
+clock_profile_e clock_current()
+{
+	return active;
+}
+
+void clock_set_policy(clock_policy_e policy_new)
+{
+	if(policy_new >= clock_policies)
+	{
+		return;
+	}
+	policy = policy_new;
+	clock_update();
+
+	//the uplink in progress started under the old policy, so it is not counted
+	window_policy = clock_policies;
+}
+
+clock_policy_e clock_get_policy()
+{
+	return policy;
+}
+
+//The CCIPR kernel clock selections for USART1, LPUART1 and I2C1 all use
+//1 for SYSCLK and 2 for HSI16. HSI16 is kept whenever it runs, so the bit
+//timing is exact, otherwise they follow MSI.
+uint8_t clock_kernel_select()
+{
+	return LL_RCC_HSI_IsReady() ? 2 : 1;
+}
+
+uint32_t clock_kernel_hz()
+{
+	return LL_RCC_HSI_IsReady() ? HSI_VALUE : SystemCoreClock;
+}
+
+void clock_sleep_enter()
+{
+	clock_account(clock_state_sleep);
+}
+
+void clock_sleep_exit()
+{
+	clock_account(clock_state_run);
+}
+
+void clock_stop_enter()
+{
+	clock_account(clock_state_stop);
+}
+
+//called with interrupts off, the debug UART has already been shut down for STOP
+void clock_stop_exit()
+{
+	clock_account(clock_state_run);
+	dropped = false;
+	clock_apply(clock_target());
+}
+
+//A wait for the radio, the MCU only sleeps until the next DIO or timer
+//interrupt. Under the lean policy the wait and those interrupts run on MSI.
+void clock_wait_enter()
+{
+	if((policy == clock_policy_lean) && (active != clock_profile_low))
+	{
+		clock_apply(clock_profile_low);
+		dropped = true;
+	}
+}
+
+void clock_wait_exit()
+{
+	if(dropped)
+	{
+		dropped = false;
+		clock_update();
+	}
+}
+
+//Charges the uplink just sent with everything since the one before it
+void clock_uplink_done()
+{
+	uint64_t charge = 0;
+	uint32_t awake_ms = 0;
+	uint32_t ms;
+	uint32_t energy;
+	uint8_t p;
+	uint8_t s;
+
+	clock_account(state);
+
+	if(window_policy == policy)
+	{
+		for(p=0;p<clock_profiles;p++)
+		{
+			for(s=0;s<2;s++)
+			{
+				ms = HW_RTC_Tick2ms(ticks[p][s] - window_ticks[p][s]);
+				awake_ms += ms;
+				charge   += (uint64_t)ms * ((s == clock_state_run) ? profiles[p].run_ua : profiles[p].sleep_ua);
+			}
+		}
+		charge += (uint64_t)HW_RTC_Tick2ms(stop_ticks - window_stop_ticks) * CLOCK_STOP_UA;
+
+		//uA ms times mV is pJ
+		energy = (uint32_t)((charge * HW_GetBatteryLevel_mv()) / 1000000);
+
+		uplink_stats[policy].uplinks++;
+		uplink_stats[policy].awake_ms    += awake_ms;
+		uplink_stats[policy].charge_uams += charge;
+		uplink_stats[policy].energy_uj   += energy;
+		last_charge_uams = (uint32_t)charge;
+		last_energy_uj   = energy;
+
+		dbg_clock("Clock uplink %ums awake, %uuC, %uuJ\r\n", awake_ms, (uint32_t)(charge / 1000), energy);
+	}
+
+	clock_window_restart();
+}
+
+void clock_clear_stats()
+{
+	clock_account(state);
+	memset(ticks, 0, sizeof(ticks));
+	stop_ticks = 0;
+	switches   = 0;
+	memset(uplink_stats, 0, sizeof(uplink_stats));
+	last_charge_uams = 0;
+	last_energy_uj   = 0;
+	clock_window_restart();
+	window_policy = clock_policies;
+}
+
+void clock_print()
+{
+	uint8_t i;
+
+	clock_account(state);
+
+	Debug_printf("Clock policy             :%s\r\n", policy_names[policy]);
+	Debug_printf("Clock profile            :%s\r\n", profiles[active].name);
+	await_uart_tx();
+	Debug_printf("Clock switches           :%u\r\n", switches);
+	Debug_printf("Clock run ms low/mid/high:%u/%u/%u\r\n",
+		HW_RTC_Tick2ms(ticks[clock_profile_low][clock_state_run]),
+		HW_RTC_Tick2ms(ticks[clock_profile_mid][clock_state_run]),
+		HW_RTC_Tick2ms(ticks[clock_profile_high][clock_state_run]));
+	await_uart_tx();
+	Debug_printf("Clock sleep ms           :%u/%u/%u\r\n",
+		HW_RTC_Tick2ms(ticks[clock_profile_low][clock_state_sleep]),
+		HW_RTC_Tick2ms(ticks[clock_profile_mid][clock_state_sleep]),
+		HW_RTC_Tick2ms(ticks[clock_profile_high][clock_state_sleep]));
+	Debug_printf("Clock stop s             :%u\r\n", HW_RTC_Tick2ms(stop_ticks) / 1000);
+	await_uart_tx();
+	Debug_printf("Clock last uplink        :%uuC, %uuJ\r\n", last_charge_uams / 1000, last_energy_uj);
+
+	//Debug_printf formats into 64 bytes, so the columns are terse
+	Debug_printf("Policy uplinks, per uplink: awake ms, uC, uJ\r\n");
+	await_uart_tx();
+	for(i=0;i<clock_policies;i++)
+	{
+		Debug_printf("%-6s %u, %u %u %u\r\n",
+			policy_names[i],
+			uplink_stats[i].uplinks,
+			uplink_stats[i].uplinks ? uplink_stats[i].awake_ms / uplink_stats[i].uplinks : 0,
+			uplink_stats[i].uplinks ? (uint32_t)(uplink_stats[i].charge_uams / 1000 / uplink_stats[i].uplinks) : 0,
+			uplink_stats[i].uplinks ? uplink_stats[i].energy_uj / uplink_stats[i].uplinks : 0);
+		await_uart_tx();
+	}
+}
+
+static void cli_clock_help(void)
+{
+	Debug_printf("Usage: clock show\r\n");
+	await_uart_tx();
+	Debug_printf("\tPrints the profile, time in each profile and energy per uplink\r\n");
+	await_uart_tx();
+	Debug_printf("Usage: clock [fixed|burst|lean]\r\n");
+	await_uart_tx();
+	Debug_printf("\tfixed: 32MHz throughout\r\n");
+	Debug_printf("\tburst: MSI idle, HSI16 events, 32MHz uplinks\r\n");
+	await_uart_tx();
+	Debug_printf("\tlean : as burst, radio waits on MSI\r\n");
+	await_uart_tx();
+	Debug_printf("Usage: clock clear\r\n");
+	await_uart_tx();
+	Debug_printf("\tClears the time and energy counters\r\n");
+	await_uart_tx();
+}
+
+void cli_clock_implementation(int argc, char *argv[])
+{
+	uint8_t i;
+
+	if(argc == 1)
+	{
+		if(!strcmp(argv[0], "show"))
+		{
+			clock_print();
+			return;
+		}
+		if(!strcmp(argv[0], "clear"))
+		{
+			clock_clear_stats();
+			Debug_printf("Clock counters cleared\r\n");
+			return;
+		}
+		for(i=0;i<clock_policies;i++)
+		{
+			if(!strcmp(argv[0], policy_names[i]))
+			{
+				clock_set_policy((clock_policy_e)i);
+				Debug_printf("Clock policy %s\r\n", policy_names[i]);
+				return;
+			}
+		}
+	}
+
+	cli_clock_help();
+}
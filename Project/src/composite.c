@@ -0,0 +1,435 @@
+/*
+   _____             _____                 
+  / ____|           / ____|                
+ | (___   ___ _ __ | (___  _   _ _ __ ___  
+  \___ \ / _ \ '_ \ \___ \| | | | '_ ` _ \ 
+  ____) |  __/ | | |____) | |_| | | | | | |
+ |_____/ \___|_| |_|_____/ \__,_|_| |_| |_|
+                                           
+                                           
+	Description: Composite device mode.
+								A device runs any set of the components below rather than one
+								fixed mode, so a counter with an SHT30 or a DS18B20 beside a light
+								sensor is one device and one uplink. Every enabled component with
+								a conversion joins a single acquire_run(), so their warm-up and
+								conversion times overlap, then each fills its part of a codec
+								frame. The frame starts with the components mask, so the decoder
+								knows which parts follow.
+								Adding a component is a composite_part_e entry, its part schema
+								in payload_schemas.c, and an entry in the table here.
+
+	Maintainer: Shea Gosnell
+
+
+*/
+
+#include <string.h>
+#include "composite.h"
+#include "../SHELL/app_cli.h"
+#include "hw.h"
+#include "debug_uart.h"
+#include "flash_map.h"
+#include "radio_common.h"
+#include "uplink_queue.h"
+#include "payload_schemas.h"
+#include "counter.h"
+#include "sht30.h"
+#include "ds18b20.h"
+#include "onewire.h"
+#include "i2cLightSensor.h"
+
+#ifndef DISABLE_COMPOSITE_DEBUG
+	#define composite_printf(...) Debug_printf(__VA_ARGS__)
+#else
+	#define composite_printf(...)
+#endif
+
+#define COMPOSITE_ALL_COMPONENTS     ((1 << composite_parts) - 1)
+#define COMPOSITE_DEFAULT_COMPONENTS (1 << composite_part_sht30)
+
+STATIC_ASSERT((composite_parts <= 8));
+
+static uint8_t components = COMPOSITE_DEFAULT_COMPONENTS;
+
+//filled by the shared acquisition
+static sht30Reading_t   sht30_reading;
+static ds18b20_result_t ds18b20_reading;
+static Si1133_reading_t light_reading;
+
+static void counter_part_fill(int32_t values[])
+{
+	values[composite_value_count1] = count1;
+	composite_printf("Count1      : %u\r\n", count1);
+}
+
+static void sht30_part_fill(int32_t values[])
+{
+	values[composite_value_temperature1] = sht30_reading.T1;
+	values[composite_value_humidity1]    = sht30_reading.H1;
+	values[composite_value_temperature2] = sht30_reading.T2;
+	values[composite_value_humidity2]    = sht30_reading.H2;
+	composite_printf("Temperature1: %d\r\n", sht30_reading.T1);
+	composite_printf("Humidity1   : %u\r\n", sht30_reading.H1);
+}
+
+static test_status_e sht30_part_test(void)
+{
+	return (sht30_reading.H1 == 0xFFFF) ? test_fail : test_pass;
+}
+
+//on the RS485 terminal, as the multi probe mode wires it, so COUNT1 is free
+static void ds18b20_part_init(void)
+{
+	OWP_init(MODBUS_TX_PORT, MODBUS_TX_PIN);
+}
+
+static void ds18b20_part_fill(int32_t values[])
+{
+	values[composite_value_probe_temperature] = ds18b20_reading.temperature;
+	values[composite_value_probe_status]      = ds18b20_reading.status;
+}
+
+static test_status_e ds18b20_part_test(void)
+{
+	return (ds18b20_reading.status == RESULT_OK) ? test_pass : test_fail;
+}
+
+//saturates to 16 bits in the frame, as the SHT30+Light mode does
+static void light_part_fill(int32_t values[])
+{
+	values[composite_value_light] = light_reading.visible_reading;
+}
+
+static const composite_component_t component_table[composite_parts] =
+{
+	[composite_part_counter] =
+	{
+		.name         = "counter",
+		.init         = &init_count1_only,
+		.fill         = &counter_part_fill,
+		.load_config  = &load_counter_config,
+		.save_config  = &save_counter_config,
+		.save_data    = &save_counter_data,
+		.load_data    = &load_counter_data,
+		.cli_commands = cmd_count1,
+	},
+	[composite_part_sht30] =
+	{
+		.name         = "sht30",
+		.driver       = &sht30_acquire_driver,
+		.result       = &sht30_reading,
+		.fill         = &sht30_part_fill,
+		.test         = &sht30_part_test,
+	},
+	[composite_part_ds18b20] =
+	{
+		.name         = "ds18b20",
+		.driver       = &ds18b20_acquire_driver,
+		.result       = &ds18b20_reading,
+		.init         = &ds18b20_part_init,
+		.fill         = &ds18b20_part_fill,
+		.test         = &ds18b20_part_test,
+	},
+	[composite_part_light] =
+	{
+		.name         = "light",
+		.driver       = &si1133_acquire_driver,
+		.result       = &light_reading,
+		.init         = &init_light_sensor,
+		.fill         = &light_part_fill,
+		.cli          = &light_sensor_cli_component,
+	},
+};
+
+static bool composite_enabled(uint8_t part)
+{
+	return (components >> part) & 1;
+}
+
+static void composite_update_commands(void)
+{
+	uint8_t i;
+	
+	device.cli_commands = 0;
+	for(i=0;i<composite_parts;i++)
+	{
+		if(composite_enabled(i))
+		{
+			device.cli_commands |= component_table[i].cli_commands;
+		}
+	}
+}
+
+//every enabled conversion in one acquire_run()
+static void composite_acquire(void)
+{
+	acquire_job_t jobs[composite_parts];
+	uint8_t       count = 0;
+	uint8_t       i;
+	
+	memset(jobs, 0, sizeof(jobs));
+	for(i=0;i<composite_parts;i++)
+	{
+		if(composite_enabled(i) && (component_table[i].driver != NULL))
+		{
+			jobs[count].driver = component_table[i].driver;
+			jobs[count].result = component_table[i].result;
+			count++;
+		}
+	}
+	
+	if(count != 0)
+	{
+		acquire_run(jobs, count);
+	}
+}
+
+void composite_init(void)
+{
+	uint8_t i;
+	
+	for(i=0;i<composite_parts;i++)
+	{
+		if(composite_enabled(i) && (component_table[i].init != NULL))
+		{
+			component_table[i].init();
+		}
+	}
+	composite_update_commands();
+}
+
+test_status_e composite_test(void)
+{
+	test_status_e status = test_pass;
+	uint8_t       i;
+	
+	composite_acquire();
+	for(i=0;i<composite_parts;i++)
+	{
+		if(composite_enabled(i) && (component_table[i].test != NULL) && (component_table[i].test() != test_pass))
+		{
+			Debug_printf("%s failed\r\n", component_table[i].name);
+			status = test_fail;
+		}
+	}
+	return status;
+}
+
+void composite_on_wakeup(void)
+{
+	if(wakeup_count % wakeups_per_uplink == 0)
+	{
+		Debug_printf("Regular Uplink (%d)\r\n", wakeups_per_uplink);
+		composite_uplink();
+	}
+}
+
+void composite_uplink(void)
+{
+	int32_t        values[composite_values] = {0};
+	uint8_t        payload[UPLINK_QUEUE_PAYLOAD_SIZE];
+	codec_writer_t writer;
+	uint8_t        length;
+	uint8_t        i;
+	
+	composite_acquire();
+	
+	values[composite_value_components] = components;
+	values[composite_value_voltage]    = fourBit_battery_calculation();
+	values[composite_value_type]       = packet_type_data;
+	
+	codec_writer_init(&writer, payload, sizeof(payload));
+	codec_write(&writer, &composite_header_schema, values);
+	for(i=0;i<composite_parts;i++)
+	{
+		if(composite_enabled(i))
+		{
+			if(component_table[i].fill != NULL)
+			{
+				component_table[i].fill(values);
+			}
+			codec_write(&writer, composite_part_schemas[i], values);
+		}
+	}
+	codec_write(&writer, &composite_trailer_schema, values);
+	
+	length = codec_writer_bytes(&writer);
+	if(length == 0)
+	{
+		Debug_printf("Composite frame too long\r\n");
+		return;
+	}
+	composite_printf("Composite frame %d bytes\r\n", length);
+	
+	Uplink(payload, length);
+}
+
+void composite_save_config(void)
+{
+	composite_config_page_layout_t config = {0};
+	uint8_t i;
+	
+	config.members.components   = components;
+	config.members.light_config = get_light_sensor_config_values();
+	config.members.magic        = CONFIG_MAGIC_COMPOSITE;
+	save_extra_config_page(config.raw_bytes, device_specific_page_2);
+	
+	for(i=0;i<composite_parts;i++)
+	{
+		if(composite_enabled(i) && (component_table[i].save_config != NULL))
+		{
+			component_table[i].save_config();
+		}
+	}
+}
+
+void composite_load_config(void)
+{
+	composite_config_page_layout_t config = {0};
+	uint8_t i;
+	
+	load_extra_config_page(config.raw_bytes, device_specific_page_2);
+	
+	//page 2 is shared with other modes and zeroed on a new device, so only a
+	//page this mode saved is read, and a saved none stays none
+	if(config.members.magic == CONFIG_MAGIC_COMPOSITE)
+	{
+		components = config.members.components & COMPOSITE_ALL_COMPONENTS;
+		set_light_sensor_config_values(config.members.light_config);
+	}
+	else
+	{
+		components = COMPOSITE_DEFAULT_COMPONENTS;
+	}
+	
+	for(i=0;i<composite_parts;i++)
+	{
+		if(composite_enabled(i) && (component_table[i].load_config != NULL))
+		{
+			component_table[i].load_config();
+		}
+	}
+}
+
+void composite_save_data(void)
+{
+	uint8_t i;
+	
+	for(i=0;i<composite_parts;i++)
+	{
+		if(composite_enabled(i) && (component_table[i].save_data != NULL))
+		{
+			component_table[i].save_data();
+		}
+	}
+}
+
+void composite_load_data(void)
+{
+	uint8_t i;
+	
+	for(i=0;i<composite_parts;i++)
+	{
+		if(composite_enabled(i) && (component_table[i].load_data != NULL))
+		{
+			component_table[i].load_data();
+		}
+	}
+}
+
+static void composite_cli_help(void)
+{
+	uint8_t i;
+	
+	Debug_printf("Usage: device show\r\n");
+	Debug_printf("\tShows the enabled components\r\n");
+	await_uart_tx();
+	Debug_printf("Usage: device components [name]...|none\r\n");
+	Debug_printf("\tSets the components, from:");
+	for(i=0;i<composite_parts;i++)
+	{
+		Debug_printf(" %s", component_table[i].name);
+	}
+	Debug_printf("\r\n");
+	await_uart_tx();
+	Debug_printf("Usage: device [component] ...\r\n");
+	Debug_printf("\tSettings of an enabled component, where it has any\r\n");
+	await_uart_tx();
+}
+
+//the names are matched first, so a typo leaves the components as they were
+static void composite_cli_components(int argc, char *argv[])
+{
+	uint8_t selected = 0;
+	uint8_t i;
+	int     arg;
+	
+	if((argc == 1) && !strcmp(argv[0], "none"))
+	{
+		argc = 0;
+	}
+	
+	for(arg=0;arg<argc;arg++)
+	{
+		for(i=0;i<composite_parts;i++)
+		{
+			if(!strcmp(argv[arg], component_table[i].name))
+			{
+				selected |= 1 << i;
+				break;
+			}
+		}
+		if(i == composite_parts)
+		{
+			Debug_printf("Unknown component %s\r\n", argv[arg]);
+			return;
+		}
+	}
+	
+	components = selected;
+	composite_update_commands();
+	Debug_printf("Components set, they start when the CLI closes\r\n");
+}
+
+void composite_cli(int argc, char *argv[])
+{
+	uint8_t i;
+	
+	if(argc < 1)
+	{
+		composite_cli_help();
+		return;
+	}
+	
+	if((argc == 1) && !strcmp(argv[0], "show"))
+	{
+		for(i=0;i<composite_parts;i++)
+		{
+			Debug_printf("%s: %s\r\n", component_table[i].name, composite_enabled(i) ? "ON" : "OFF");
+			await_uart_tx();
+		}
+		return;
+	}
+	
+	if(!strcmp(argv[0], "components"))
+	{
+		composite_cli_components(argc - 1, argv + 1);
+		return;
+	}
+	
+	for(i=0;i<composite_parts;i++)
+	{
+		if(!strcmp(argv[0], component_table[i].name) && (component_table[i].cli != NULL))
+		{
+			if(!composite_enabled(i))
+			{
+				Debug_printf("%s is not enabled\r\n", component_table[i].name);
+				return;
+			}
+			component_table[i].cli(argc, argv);
+			return;
+		}
+	}
+	
+	composite_cli_help();
+}
@@ -28,8 +28,12 @@
 #include "timeServer.h"
 #include "../SHELL/app_cli.h"
 #include "radio_common.h"
+#include "fixed_point.h"
+#include "payload_schemas.h"
+#include "interval_meter.h"
+#include "event_loop.h"
+#include "sampler.h"
 																	
-#define SINGLE_COUNT_DELTA_MAX 0x7FF
 
 #ifdef DISABLE_COUNT_DEBUG
 	#define dbg_print(...)
@@ -42,7 +46,6 @@
 void Count2LeakCheck(void);
 void Count1LeakCheck(void);
 
-volatile uint8_t wake_via_counters = 0;
 volatile uint8_t leak_detected_1 = 1;
 volatile uint8_t leak_detected_2 = 1;
 volatile bool burst_1_this_hour = 0;
@@ -104,7 +107,7 @@ volatile bool edge3_debounce_timedout = true;
 void Count1_debounce_timeout()
 {
 	//timeout before re-activation
-	wake_via_counters = 1;
+	event_post(event_count);
 
 	//iff count1 is high, increment the count
 	if(HW_GPIO_Read(COUNT1_PORT, COUNT1_PIN))
@@ -151,7 +154,7 @@ void Count1_debounce_timeout()
 void Count2_debounce_timeout()
 {
 	//timeout before re-activation
-	wake_via_counters = 1;
+	event_post(event_count);
 
 	//iff count2 is high, increment the count
 	if(HW_GPIO_Read(COUNT2_PORT, COUNT2_PIN))
@@ -170,7 +173,7 @@ void Count2_debounce_timeout()
 void Count3_debounce_timeout()
 {
 	//timeout before re-activation
-	wake_via_counters = 1;
+	event_post(event_count);
 
 	//iff count2 is high, increment the count
 	if(HW_GPIO_Read(COUNT3_PORT, COUNT3_PIN))
@@ -287,6 +290,7 @@ void Tamper_IRQ()
 {
 	tamper_detected = 1;
 	tamper_detected_delayed = 1;
+	event_post(event_device);
 }
 
 	
@@ -323,7 +327,7 @@ void Edge1IRQ()
 		TimerStart(&edge1_debounce_timer);
 		
 		
-		wake_via_counters = 1;
+		event_post(event_count);
 		
 		
 		
@@ -362,7 +366,7 @@ void Edge2IRQ()
 		TimerSetValue(&edge2_debounce_timer, debounce_interval);
 		TimerStart(&edge2_debounce_timer);
 		
-		wake_via_counters = 1;
+		event_post(event_count);
 
 		threeEdgeData.input_2_changed = 1;
 		threeEdgeData.input_2_state = HW_GPIO_Read(COUNT2_PORT, COUNT2_PIN);
@@ -398,7 +402,7 @@ void Edge3IRQ()
 		TimerSetValue(&edge3_debounce_timer, debounce_interval);
 		TimerStart(&edge3_debounce_timer);
 		
-		wake_via_counters = 1;
+		event_post(event_count);
 		
 		threeEdgeData.input_3_changed = 1;
 		threeEdgeData.input_3_state = HW_GPIO_Read(COUNT3_PORT, COUNT3_PIN);
@@ -570,6 +574,8 @@ void two_counter_adc_uplink()
 	static uint16_t count1History[4] = {0};
 	static uint16_t count2History[4] = {0};
 	static uint16_t adcHistory[4] = {0};
+	const uint32_t  adc_channel = ADC3_CH;
+	uint16_t        vrefint;
 	
 	//bump each history forward. [2]->[3], [1]->[2], etc
 	for(i=3; i>0; i--)
@@ -582,7 +588,9 @@ void two_counter_adc_uplink()
 	//add the current readings to the history
 	count1History[0] = count1;
 	count2History[0] = count2;
-	adcHistory[0] = read_adc();
+	//one scan gives the input and the VREFINT the battery level is worked out from
+	reset_watchdog();
+	vrefint = AdcReadCompensateChannels(&adc_channel, &adcHistory[0], 1);
 	
 	lora_two_countADC_payload_t payload = {.payload = {0}};
 	
@@ -649,7 +657,7 @@ void two_counter_adc_uplink()
 	Debug_printf("P3 ADC   :%d\r\n",payload.members.p3Adc);
 	
 	payload.members.pkt_type = packet_type_data;
-	payload.members.sys_voltage = fourBit_battery_calculation();
+	payload.members.sys_voltage = fourBit_battery_from_mv(HW_VrefintToBatteryLevel_mv(vrefint));
 	
 	Uplink(payload.payload, TWO_COUNT_ADC_SIZE);
 }
@@ -786,7 +794,7 @@ void two_counter_uplink_alarm()
 	count_payload.members.pkt_type    = packet_type_alarm;
 
 	
-	Uplink(count_payload.payload, TWO_COUNT_ALARM_SIZE);
+	Uplink_priority(count_payload.payload, TWO_COUNT_ALARM_SIZE, uplink_priority_alarm);
 }
 
 void single_counter_uplink_alarm()
@@ -813,7 +821,7 @@ void single_counter_uplink_alarm()
 	count_payload.members.pkt_type    = packet_type_alarm;
 
 	
-	Uplink(count_payload.payload, SINGLE_COUNT_ALARM_SIZE);
+	Uplink_priority(count_payload.payload, SINGLE_COUNT_ALARM_SIZE, uplink_priority_alarm);
 }
 
 void threeEdge_alarm()
@@ -1006,8 +1014,10 @@ void single_counter_uplink()
 {
 	
 	(void) single_counter_uplink;
-	single_count_data_t count_payload = {.payload={0}};
-	uint32_t x;
+	uint8_t payload[SINGLE_COUNT_DATA_SIZE];
+	int32_t values[single_count_values] = {0};
+	uint8_t size;
+	uint8_t i;
 	int offset = 0;
 	//uint8_t hour = HW_RTC_getHour();
 	#ifdef ACCELERATE_HOURS
@@ -1027,112 +1037,62 @@ void single_counter_uplink()
 	if(hour < 6)
 	{
 		offset = 18; //hour ending 19, 20 ,12, 22, 23, 24
-		count_payload.members.Count1 = hourly_count1[at_midnight]; //last complete 6-hour cycle was at midnight
-		count_payload.members.pkt_tod = count_hours18to00;
+		values[single_count_value_count1] = hourly_count1[at_midnight]; //last complete 6-hour cycle was at midnight
+		values[single_count_value_tod]    = count_hours18to00;
 	}
 	//if 6 < hour < 12
 	else if(hour < 12)
 	{
 		offset = 0;  //hour ending 1, 2, 3, 4, 5, 6
-		count_payload.members.Count1 = hourly_count1[at_6]; //last complete 6-hour cycle was at 6AM
-		count_payload.members.pkt_tod = count_hours00to06;
+		values[single_count_value_count1] = hourly_count1[at_6]; //last complete 6-hour cycle was at 6AM
+		values[single_count_value_tod]    = count_hours00to06;
 	}
 	//if 12< hour < 18
 	else if(hour < 18)
 	{
 		offset = 6;  //hour ending 7, 8, 9, 10 , 11, 12
-		count_payload.members.Count1 = hourly_count1[at_midday]; //last complete 6-hour cycle was at midday
-		count_payload.members.pkt_tod = count_hours06to12;
+		values[single_count_value_count1] = hourly_count1[at_midday]; //last complete 6-hour cycle was at midday
+		values[single_count_value_tod]    = count_hours06to12;
 	}
 	//if 18 < hour < 24
 	else //if(HW_RTC_GetHour() < 24)
 	{
 		offset = 12; //hour ending 13, 14, 15, 16, 17, 18
-		count_payload.members.Count1 = hourly_count1[at_6]; //last complete 6-hour cycle was at 6PM
-		count_payload.members.pkt_tod = count_hours12to18;
-	}
-
-	//  2, 8, 14, 20              1, 7, 13, 19
-	x = hourly_count1[(at_2+offset)%12] - hourly_count1[(at_1+offset)%12];
-
-	if(x <= SINGLE_COUNT_DELTA_MAX)
-	{
-		count_payload.members.Delta2 = x;
-	}
-	else
-	{
-		count_payload.members.Delta2 = SINGLE_COUNT_DELTA_MAX;
-	}
-	//  3, 9, 15, 21              2, 8, 14, 20
-	x = hourly_count1[(at_3+offset)%12] - hourly_count1[(at_2+offset)%12];
-
-	if(x <= SINGLE_COUNT_DELTA_MAX)
-	{
-		count_payload.members.Delta3 = x;
-	}
-	else
-	{
-		count_payload.members.Delta3 = SINGLE_COUNT_DELTA_MAX;
+		values[single_count_value_count1] = hourly_count1[at_6]; //last complete 6-hour cycle was at 6PM
+		values[single_count_value_tod]    = count_hours12to18;
 	}
-	//  4, 10, 16, 22             3, 9, 15, 21
-	x = hourly_count1[(at_4+offset)%12] - hourly_count1[(at_3+offset)%12];
 
-	if(x <= SINGLE_COUNT_DELTA_MAX)
-	{
-		count_payload.members.Delta4 = x;
-	}
-	else
-	{
-		count_payload.members.Delta4 = SINGLE_COUNT_DELTA_MAX;
-	}
-	//  5, 11, 17, 23             4, 10, 16, 22
-	x = hourly_count1[(at_5+offset)%12] - hourly_count1[(at_4+offset)%12];
-
-	if(x <= SINGLE_COUNT_DELTA_MAX)
-	{
-		count_payload.members.Delta5 = x;
-	}
-	else
-	{
-		count_payload.members.Delta5 = SINGLE_COUNT_DELTA_MAX;
-	}
-	//  6, 12, 18, 24             5, 11, 17, 23
-	x = hourly_count1[(at_6+offset)%12] - hourly_count1[(at_5+offset)%12];
-
-	if(x <= SINGLE_COUNT_DELTA_MAX)
-	{
-		count_payload.members.Delta6 = x;
-	}
-	else
+	//the schema packs the hour to hour deltas, saturated at 11 bits
+	for(i=0;i<6;i++)
 	{
-		count_payload.members.Delta6 = SINGLE_COUNT_DELTA_MAX;
+		values[single_count_value_hour1 + i] = hourly_count1[(at_1+i+offset)%12];
 	}
 	
 	Count1LeakCheck();
 	//leak detection, read the flag, to see if it was cleared in the interrupt
-	count_payload.members.leak = leak_detected_1;
+	values[single_count_value_leak] = leak_detected_1;
 	//reset the leak detected flag
 	leak_detected_1 = 1;
 	
 	//print out the payload values:
 	Debug_printf("Payload:\r\n");
 	await_uart_tx();
-	Debug_printf("\tCount :%d\r\n", count_payload.members.Count1);
+	Debug_printf("\tCount :%d\r\n", values[single_count_value_count1]);
 	await_uart_tx();
-	Debug_printf("\tDelta2:%d\r\n", count_payload.members.Delta2);
-	Debug_printf("\tDelta3:%d\r\n", count_payload.members.Delta3);
-	await_uart_tx();
-	Debug_printf("\tDelta4:%d\r\n", count_payload.members.Delta4);
-	Debug_printf("\tDelta5:%d\r\n", count_payload.members.Delta5);
-	Debug_printf("\tDelta6:%d\r\n", count_payload.members.Delta6);
+	for(i=1;i<6;i++)
+	{
+		Debug_printf("\tDelta%d:%d\r\n", i+1, values[single_count_value_hour1 + i] - values[single_count_value_hour1 + i - 1]);
+	}
 	await_uart_tx();
-	Debug_printf("\tLeak  :%d\r\n", count_payload.members.leak);
+	Debug_printf("\tLeak  :%d\r\n", values[single_count_value_leak]);
 	await_uart_tx();
 	
-	count_payload.members.sys_voltage = fourBit_battery_calculation();
-	count_payload.members.pkt_type    = packet_type_data;
+	values[single_count_value_voltage] = fourBit_battery_calculation();
+	values[single_count_value_type]    = packet_type_data;
 	
-	Uplink(count_payload.payload, SINGLE_COUNT_DATA_SIZE);
+	size = codec_encode(&single_count_data_schema, values, payload, sizeof(payload));
+	
+	Uplink(payload, size);
 }
 
 void cli_count_help()
@@ -1230,12 +1190,15 @@ void cli_count_implementation(int argc,   char *argv[])
 				
 				if(device.cli_commands & cmd_mux_adc)
 				{
-					uint16_t adc_raw = AdcReadCompensate(ADC2_CH);
-					uint16_t mA = ((adc_raw)*0.006105); //(3/4095f)*(1/120)*1000);
+					const uint32_t channels[2] = {ADC2_CH, ADC3_CH};
+					uint16_t readings[2];
+					AdcReadCompensateChannels(channels, readings, 2);
+					
+					uint16_t mA = fxp_scale(readings[0], 3000, 4095*120); //(3/4095)*(1/120)*1000
 					cli_print("4-20mA: %dmA\r\n",mA);
 					await_uart_tx();
 					
-					uint16_t volts = AdcReadCompensate(ADC3_CH)*1.4652;//(3/4095)*1000*2;
+					uint16_t volts = fxp_scale(readings[1], 3000*2, 4095);//(3/4095)*1000*2
 					cli_print("0-5V: %dmV\r\n",volts);
 					await_uart_tx();
 				}
@@ -1508,6 +1471,22 @@ void init_tamper()
 		HW_GPIO_SetIrq(TAMPER_PORT    , TAMPER_PIN    ,3,Tamper_IRQ);
 }
 
+//COUNT1 as a debounced counter with no direction or tamper input, so COUNT2
+//and COUNT3 stay free for whatever it is combined with
+void init_count1_only()
+{
+	GPIO_InitTypeDef GPIO_InitStruct;
+	
+	dir_enabled = false;
+	
+	GPIO_InitStruct.Mode  = GPIO_MODE_IT_RISING;
+	GPIO_InitStruct.Pull  = internal_pullup_enabled ? GPIO_PULLUP : GPIO_NOPULL;
+	GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_LOW;
+	
+	HW_GPIO_Init(COUNT1_PORT, COUNT1_PIN, &GPIO_InitStruct);
+	HW_GPIO_SetIrq(COUNT1_PORT, COUNT1_PIN, 3, Count1IRQ);
+}
+
 void init_single_counter()
 {
 	int i;
@@ -1709,6 +1688,7 @@ void save_counter_config()
 	config.members.count_burst_hours = consecutive_burst_hours;
 	config.members.invert_dir        = dir_inverted;
 	config.members.pullup_enabled    = internal_pullup_enabled;
+	config.members.interval_minutes  = interval_minutes;
 	
 	save_extra_config_page(config.raw_bytes, device_specific_page_1);
 }
@@ -1725,6 +1705,13 @@ void load_counter_config()
 	consecutive_burst_hours  = config.members.count_burst_hours;
 	dir_inverted             = config.members.invert_dir;
 	internal_pullup_enabled = config.members.pullup_enabled;
+	
+	//pages written before the interval meter have 0 here
+	interval_minutes = config.members.interval_minutes;
+	if(!interval_minutes_valid(interval_minutes))
+	{
+		interval_minutes = INTERVAL_MINUTES_DEFAULT;
+	}
 }
 
 void save_counter_data()
@@ -1766,11 +1753,32 @@ void three_mux_save_counter_data (void)
 void three_mux_save_config(void)
 {
 	save_counter_config();
+	sampler_save_config(device_specific_page_2);
 }
 
 void three_mux_load_config(void)
 {
 	load_counter_config();
+	sampler_load_config(device_specific_page_2);
+}
+
+//the 4-20mA and voltage inputs, then the count, returns the VREFINT reading
+static uint16_t three_mux_read(int32_t values[])
+{
+	const uint32_t channels[2] = {ADC2_CH, ADC3_CH};
+	uint16_t readings[2];
+	uint16_t vrefint;
+	
+	vrefint = AdcReadCompensateChannels(channels, readings, 2);
+	values[0] = readings[0];
+	values[1] = readings[1];
+	values[2] = count1;
+	return vrefint;
+}
+
+static void three_mux_sample(int32_t values[], bool valid[])
+{
+	three_mux_read(values);
 }
 
 void init_three_mux_inputs()
@@ -1797,13 +1805,25 @@ void init_three_mux_inputs()
 	
 	//analog input initialisation
 	init_adc();
+	
+	sampler_start(&three_mux_sample, 3);
 }
 void three_mux_uplink()
 {
 	lora_three_mux_payload_t packet = {.payload={0}};
+	int32_t  readings[3];
+	uint16_t vrefint;
 
-	packet.members.ADC_420 = AdcReadCompensate(ADC2_CH);
-	packet.members.ADC_V = AdcReadCompensate(ADC3_CH);
+	vrefint = three_mux_read(readings);
+	
+	//with sampling on, the summary goes instead
+	if(sampler_uplink(readings, NULL))
+	{
+		return;
+	}
+	
+	packet.members.ADC_420 = readings[0];
+	packet.members.ADC_V   = readings[1];
 	
 	//calculate the actual voltage from this value using the following formula
 	//     3.0*reading
@@ -1824,7 +1844,7 @@ void three_mux_uplink()
 	await_uart_tx();
 	Debug_printf("Payload:");
 	
-	packet.members.sys_voltage = fourBit_battery_calculation();
+	packet.members.sys_voltage = fourBit_battery_from_mv(HW_VrefintToBatteryLevel_mv(vrefint));
 	packet.members.pkt_type    = packet_type_data;
 	
 	Uplink(packet.payload, THREE_MUX_SIZE);
@@ -22,6 +22,8 @@
 #include "tiny_vsnprintf.h"
 #include "watchdog.h"
 #include "global.h"
+#include "clock_manager.h"
+#include "stack_monitor.h"
 
 volatile static USART_TDR_t *REG_Debug_TDR = USART1_TDR_ADDR;
 volatile static USART_RDR_t *REG_Debug_RDR = USART1_RDR_ADDR;
@@ -53,8 +55,8 @@ inline void Debug_init()
 		//set up the registers for USART
 	
 		//Enable the peripheral clock of USART1
-		//HSI16 clock
-		REG_Debug_CLKSEL->USART1_SEL = 2;
+		//HSI16 clock, or SYSCLK while the clock manager has HSI16 off
+		REG_Debug_CLKSEL->USART1_SEL = clock_kernel_select();
 	
 		//Enable the clock
 		REG_Debug_CLKEN->USART1_EN = 1;
@@ -75,7 +77,7 @@ inline void Debug_init()
 			//Leave at default for 8N1 operation
 		//Baud
 		
-		REG_Debug_BRR->BRR = 1666;
+		REG_Debug_BRR->BRR = (clock_kernel_hz() + (DEBUG_UART_BAUD/2)) / DEBUG_UART_BAUD;
 		
 		//Stop Bits
 			//Leave at default for 8N1
@@ -145,6 +147,12 @@ void Debug_printf( const char *format, ... )
 
 void Debug_AddToWriteBuffer(char* message, int length)
 {
+	//the UART is left off after waking from STOP until there is something to send
+	if(!REG_Debug_CR1->UE)
+	{
+		Debug_init();
+	}
+	
 	while(length)
 	{
 			reset_watchdog();
@@ -171,6 +179,47 @@ void await_uart_tx()
 		reset_watchdog();
 }
 
+//Waits for everything buffered to leave, including the last stop bit.
+void Debug_flush()
+{
+	if(!REG_Debug_CR1->UE)
+	{
+		return;
+	}
+	
+	await_uart_tx();
+	while(!REG_Debug_ISR->TC)
+	{
+		;
+	}
+}
+
+//Flushes anything still buffered and turns the UART off.
+void Debug_sleep()
+{
+	if(!REG_Debug_CR1->UE)
+	{
+		return;
+	}
+	
+	Debug_flush();
+	disable_Debug();
+}
+
+//The clock manager has switched the system clock, the UART has been flushed.
+void Debug_clock_changed()
+{
+	if(!REG_Debug_CR1->UE)
+	{
+		return;
+	}
+	
+	REG_Debug_CR1->UE = 0;
+	REG_Debug_CLKSEL->USART1_SEL = clock_kernel_select();
+	REG_Debug_BRR->BRR = (clock_kernel_hz() + (DEBUG_UART_BAUD/2)) / DEBUG_UART_BAUD;
+	REG_Debug_CR1->UE = 1;
+}
+
 int isCharToSend()
 {
 	return REG_Debug_CR1->TXEIE;
@@ -234,6 +283,8 @@ void Debug_disableCli(int disableRX)
 //Interrupt handler for the debug_uart
 void USART1_IRQHandler( void )
 {
+	stack_monitor_isr_enter();
+	
 	//if the TX register is empty, we can load a new character into the buffer
 	if(REG_Debug_ISR->TXE)
 	{
@@ -270,5 +321,7 @@ void USART1_IRQHandler( void )
 	{
 		REG_Debug_ICR->WUCF = 1;
 	}
+	
+	stack_monitor_isr_exit();
 }
 
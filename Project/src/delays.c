@@ -19,6 +19,14 @@
 #include "hw_rtc.h"												
 #include "debug_uart.h"		
 #include "timeServer.h"
+#include "low_power_manager.h"
+#include "hw.h"
+
+//a margin under the watchdog timeout, so SLEEP delays wake about once a second
+#define DELAY_WATCHDOG_HEARTBEAT_MS (WATCHDOG_TIMEOUT_MS - 84)
+
+//wakes while a delay was asleep, including the alarm that ends it
+static uint32_t delay_wakes = 0;
 
 void timer_dummy_event()
 {
@@ -45,22 +53,74 @@ bool timer_expired(TimerEvent_t* timer)
 	return !TimerExists(timer);
 }
 
-void delay_timeout_ms(uint32_t delay_ms)
+//One alarm for the whole delay. The watchdog is frozen in STOP, so a STOP delay
+//wakes only for the alarm or other interrupts. In SLEEP the watchdog keeps
+//counting, so a heartbeat bounds the time between refreshes, with the watchdog
+//early wakeup behind it in case the heartbeat is held off.
+static void delay_wait(uint32_t delay_ms, bool allow_stop)
 {
 	static TimerEvent_t delay_timer;
-	static TimerEvent_t sleep_timer;
+	static TimerEvent_t heartbeat_timer;
 	
 	start_timeout_timer(&delay_timer,delay_ms);
-	reset_watchdog();
-	while(!timer_expired(&delay_timer))
+	if(allow_stop)
 	{
-		start_timeout_timer(&sleep_timer, 100);
-		sleep_until_interrupt();
+		Debug_sleep();
+	}
+	watchdog_refresh_in_sleep(true);
+	
+	while(1)
+	{
+		//interrupts are held off between the check and the WFI, so the alarm can't be missed
+		DISABLE_IRQ();
+		if(timer_expired(&delay_timer))
+		{
+			ENABLE_IRQ();
+			break;
+		}
+		
+		//the RTC asks for SLEEP when its next alarm is too close for STOP to pay off
+		if(allow_stop && (LPM_GetMode() == LPM_StopMode))
+		{
+			TimerStop(&heartbeat_timer);
+			LPM_EnterStopMode();
+			LPM_ExitStopMode();
+		}
+		else
+		{
+			start_timeout_timer(&heartbeat_timer, DELAY_WATCHDOG_HEARTBEAT_MS);
+			LPM_EnterSleepMode();
+		}
+		ENABLE_IRQ();
 		reset_watchdog();
+		delay_wakes++;
 	}
-	//ensure that the timer is stopped and removed from the list before going out of scope
+	
+	watchdog_refresh_in_sleep(false);
+	reset_watchdog();
+	//ensure that the timers are stopped and removed from the list before going out of scope
+	TimerStop(&heartbeat_timer);
 	TimerStop(&delay_timer);
-	TimerStop(&sleep_timer);
+}
+
+//peripherals keep their clocks, so transfers and UART replies can complete during the delay
+void delay_timeout_ms(uint32_t delay_ms)
+{
+	delay_wait(delay_ms, false);
+}
+
+//For holds where only GPIO outputs and the RTC need to run, e.g. an LED error code
+//or the join back-off. The radio SPI and the debug UART are shut down for STOP.
+void delay_stop_ms(uint32_t delay_ms)
+{
+	delay_wait(delay_ms, true);
+}
+
+void delay_print()
+{
+	Debug_printf("Delay wakes              :%u\r\n", delay_wakes);
+	Debug_printf("Delay watchdog wakes     :%u\r\n", watchdog_sleep_refreshes());
+	await_uart_tx();
 }
 
 //void delay_timeout_ms(uint32_t delay_ms)
@@ -88,9 +148,15 @@ void delayWithFeedback(int numberOfPeriods, int feedbackPeriodMs)
 	}
 }
 
+//One pass of the loop is about 32 cycles, 1us at 32MHz. The pass count follows
+//the clock manager, so the delay holds at every system clock.
+#define DELAY_US_CYCLES_PER_PASS 32
+
 void delay_us(int duration)
 {
-	while(duration--)
+	uint32_t passes = ((uint32_t)duration * (SystemCoreClock / 1000000)) / DELAY_US_CYCLES_PER_PASS;
+	
+	while(passes--)
 	{
 		__asm("nop");
 		__asm("nop");
@@ -25,6 +25,9 @@
 #include "flash_map.h"
 #include "radio_common.h"
 #include "ds18b20.h"
+#include "fixed_point.h"
+#include "event_loop.h"
+#include "exception_report.h"
 
 #define NUM_PROBE_ADDRESS_SLOTS 6
 
@@ -33,9 +36,13 @@ static int16_t lower_temperature_threshold      = INT16_MIN;
 static bool upper_temperature_threshold_enabled = false;
 static bool lower_temperature_threshold_enabled = false;
 static uint8_t temperature_threshold_wakeups    = 1;
+static uint16_t temperature_hysteresis          = 0;
+static exception_tuning_t temperature_tuning    = {0};
 
-//latch for upper temperature threshold on the custom device for Rayza
-static bool ds18b20_latch = false;
+//in the multi probe mode the lower band is the latch for the custom device for
+//Rayza, set under the lower threshold and cleared over the upper
+static exception_channel_t  temperature_channel = {exception_band_normal};
+static exception_schedule_t uplink_schedule     = {0};
 //pin changed flag for the on each wakeup condition
 static bool pin_changed = false;
 
@@ -45,20 +52,6 @@ static bool input2_state = false;
 static bool input3_state = false;
 
 
-typedef enum
-{
-	RESULT_OK           = 0,
-	RESULT_DATA_OPEN    = 1,
-	RESULT_DATA_SHORT   = 2,
-	RESULT_CRC_ERR      = 3,
-}result_status_e;
-
-typedef struct
-{
-	int16_t temperature;
-	result_status_e status;
-}ds18b20_result_t;
-
 typedef struct
 {
        int16_t temperature[NUM_PROBE_ADDRESS_SLOTS];
@@ -100,12 +93,60 @@ uint8_t calc_crc(uint8_t *data, uint8_t size)
     return crc;
 }
 
+//Turns a scratchpad read into a temperature, crc is of all 9 bytes so 0 when
+//they are intact.
+static ds18b20_result_t ds18b20_decode(const uint8_t data[9], uint8_t crc)
+{
+	ds18b20_result_t result = {0};
+	
+	//now convert the data to a temperature
+	//The two data registers form a 16-bit sign-extended twos-compliment number.
+	//This is fixed point, with the four LSbits being 2^-1 -> 2^-4. This means 
+	//the result is 16* too large.
+	result.temperature = data[0]+(data[1]<<8);
+	//conversion for display
+	int32_t toDisplay = fxp_ds18b20_millicelsius(result.temperature);
+	char text[FXP_FORMAT_SIZE];
+	
+	Debug_printf("Temperature:%s\r\n", fxp_format_scaled(text, toDisplay, 1000));
+	await_uart_tx();
+	
+	result.status = RESULT_OK;
+	if(crc != 0x00 || data[5] != 0xFF || data[7] != 0x10)
+	{
+		result.temperature = 0;
+		Debug_printf("DATA_INVALID\r\n");
+		if(data[7] == 0xFF)
+		{
+			//open circuit
+			result.status =RESULT_DATA_OPEN;
+		}
+		else if(data[7] == 0x00)
+		{
+			//closed circuit
+			result.status =RESULT_DATA_SHORT;
+		}
+		else
+		{
+			//CRC/validation error
+			result.status =RESULT_CRC_ERR;
+		}
+	}
+	
+	return result;
+}
+
 void ds18b20_uplink()
 {
 	ds18b20_result_t result = {0};	
 	ds18b20_payload_t payload = {0};
 	
 	result = ds18b20_read();
+	if(result.status == RESULT_OK)
+	{
+		exception_reported(&temperature_channel, result.temperature);
+	}
+	exception_sent(&uplink_schedule);
 	
 	payload.members.temperature = result.temperature;
 	payload.members.status = result.status;
@@ -130,6 +171,12 @@ void ds18b20_uplink_multi()
 		temp_result = ds18b20_read_multi(probe_id[i]);
 		result.temperature[i] = temp_result.temperature;
 		
+		//the first probe is the one the thresholds watch
+		if((i == 0) && (temp_result.status == RESULT_OK))
+		{
+			exception_reported(&temperature_channel, temp_result.temperature);
+		}
+		
 		if(result.status == RESULT_OK)
 		{
 			result.status = temp_result.status;
@@ -153,7 +200,7 @@ void ds18b20_uplink_multi()
 	payload.members.input3 = input3_state;
 	
 	//get the latch state
-	payload.members.latch = ds18b20_latch;
+	payload.members.latch = (temperature_channel.band == exception_band_lower);
 	
 	//Prints
 	Debug_printf("Input 1      :%d\r\n", payload.members.input1);
@@ -163,13 +210,13 @@ void ds18b20_uplink_multi()
 	Debug_printf("Status       :%d\r\n", payload.members.owpstat);
 	
 	//now form the packet and transmit
+	exception_sent(&uplink_schedule);
 	Uplink(payload.payload, THREE_DS18B20_SIZE);
 }
 
 
 ds18b20_result_t ds18b20_read()
 {
-	ds18b20_result_t result = {0};
 	uint8_t data[9];
 	uint8_t crc = 0xFF;
 	int i;
@@ -241,45 +288,62 @@ ds18b20_result_t ds18b20_read()
 		dbg_owp("CRC:%02X\r\n", crc);
 	}
 	//if crc != 0x00, then we have invalid data.
+	return ds18b20_decode(data, crc);
+}
+
+//The same single probe read, split so the conversion can overlap other
+//sensors'. There is one attempt rather than three.
+static bool ds18b20_acquire_start(void* result)
+{
+	ds18b20_result_t* reading = (ds18b20_result_t*)result;
 	
-	//now convert the data to a temperature
-	//The two data registers form a 16-bit sign-extended twos-compliment number.
-	//This is fixed point, with the four LSbits being 2^-1 -> 2^-4. This means 
-	//the result is 16* too large.
-	result.temperature = data[0]+(data[1]<<8);
-	//conversion for display
-	float temp = (float)result.temperature;
-	temp = temp/16;
-	int32_t toDisplay = (int32_t)(temp *1000);
+	if(!OWP_reset_bus())
+	{
+		reading->temperature = 0;
+		reading->status      = RESULT_DATA_OPEN;
+		return false;
+	}
+	OWP_write_byte(0xCC);
+	OWP_write_byte(0x44);
+	return true;
+}
+
+//the probe holds the line low until the conversion is done
+static bool ds18b20_acquire_ready(void* result)
+{
+	return OWP_read_byte() != 0;
+}
+
+static void ds18b20_acquire_collect(void* result, bool timed_out)
+{
+	ds18b20_result_t* reading = (ds18b20_result_t*)result;
+	uint8_t data[9];
+	int i;
 	
-	Debug_printf("Temperature:%d.%04d\r\n", toDisplay/1000, toDisplay%1000);
-	await_uart_tx();
+	OWP_reset_bus();
+	OWP_write_byte(0xCC);
+	OWP_write_byte(0xBE);
 	
-	result.status = RESULT_OK;
-	if(crc != 0x00 || data[5] != 0xFF || data[7] != 0x10)
+	for(i=0;i<9;i++)
 	{
-		result.temperature = 0;
-		Debug_printf("DATA_INVALID\r\n");
-		if(data[7] == 0xFF)
-		{
-			//open circuit
-			result.status =RESULT_DATA_OPEN;
-		}
-		else if(data[7] == 0x00)
-		{
-			//closed circuit
-			result.status =RESULT_DATA_SHORT;
-		}
-		else
-		{
-			//CRC/validation error
-			result.status =RESULT_CRC_ERR;
-		}
+		data[i] = OWP_read_byte();
 	}
-	
-	return result;
+	*reading = ds18b20_decode(data, calc_crc(data,9));
 }
 
+const acquire_driver_t ds18b20_acquire_driver =
+{
+	.name          = "DS18B20",
+	.warmup_ms     = 1  ,
+	.conversion_ms = 94 , //the fastest resolution, 12 bit takes up to 750mS
+	.timeout_ms    = 700,
+	.power_on      = 0  ,
+	.start         = &ds18b20_acquire_start,
+	.ready         = &ds18b20_acquire_ready,
+	.collect       = &ds18b20_acquire_collect,
+	.power_off     = 0  ,
+};
+
 
 ds18b20_result_t ds18b20_read_multi(uint64_t address)
 {
@@ -383,11 +447,10 @@ ds18b20_result_t ds18b20_read_multi(uint64_t address)
 	//the result is 16* too large.
 	result.temperature = data[0]+(data[1]<<8);
 	//conversion for display
-	float temp = (float)result.temperature;
-	temp = temp/16;
-	int32_t toDisplay = (int32_t)(temp *1000);
+	int32_t toDisplay = fxp_ds18b20_millicelsius(result.temperature);
+	char text[FXP_FORMAT_SIZE];
 	
-	Debug_printf("Temperature:%d.%04d\r\n", toDisplay/1000, toDisplay%1000);
+	Debug_printf("Temperature:%s\r\n", fxp_format_scaled(text, toDisplay, 1000));
 	await_uart_tx();
 	
 	if(crc != 0x00 || data[5] != 0xFF || data[7] != 0x10)
@@ -415,34 +478,51 @@ ds18b20_result_t ds18b20_read_multi(uint64_t address)
 }
 
 
+static exception_config_t ds18b20_exception_config()
+{
+	return exception_config(upper_temperature_threshold, upper_temperature_threshold_enabled,
+	                        lower_temperature_threshold, lower_temperature_threshold_enabled,
+	                        temperature_hysteresis, &temperature_tuning);
+}
+
+//The latch is the lower band, held until the temperature is over the upper
+//threshold, which is a hysteresis of the distance between them.
+static exception_config_t multi_ds18b20_exception_config()
+{
+	int32_t hysteresis = (int32_t)upper_temperature_threshold - lower_temperature_threshold + 1;
+	
+	return exception_config(0, false, lower_temperature_threshold, true,
+	                        (hysteresis > 0) ? hysteresis : 0, &temperature_tuning);
+}
+
 void ds18b20_onWakeup()
 {
-	ds18b20_result_t result = {0};
-	if(wakeup_count % wakeups_per_uplink == 0)
+	exception_config_t config = ds18b20_exception_config();
+	exception_reason_e reason;
+	ds18b20_result_t   result;
+	
+	if(exception_heartbeat_due(&uplink_schedule))
 	{
 		Debug_printf("Regular Uplink (%d)\r\n", wakeups_per_uplink);
 		ds18b20_uplink();
 		return;
 	}
 	
-	//this is only executed if at least one of the thresholds is enabled
-	if((wakeup_count % temperature_threshold_wakeups == 0) && (upper_temperature_threshold_enabled || lower_temperature_threshold_enabled))
+	//this is only executed if something could report
+	if((wakeup_count % temperature_threshold_wakeups == 0) && exception_config_active(&config))
 	{
 		Debug_printf("Threshold Check (%d)\r\n", temperature_threshold_wakeups);
 		result = ds18b20_read();
-		
-		if((result.temperature > upper_temperature_threshold) && upper_temperature_threshold_enabled)
+		if(result.status != RESULT_OK)
 		{
-			Debug_printf("Upper Threshold exceeded\r\n");
-			ds18b20_uplink();
 			return;
 		}
 		
-		if((result.temperature < lower_temperature_threshold) && lower_temperature_threshold_enabled)
+		reason = exception_check(&temperature_channel, &config, result.temperature);
+		if(reason != exception_none)
 		{
-			Debug_printf("Lower Threshold exceeded\r\n");
+			Debug_printf("Exception Uplink: %s\r\n", exception_reason_name(reason));
 			ds18b20_uplink();
-			return;
 		}
 	}
 }
@@ -451,6 +531,9 @@ void ds18b20_mulit_on_each_wakeup()
 {
 	if(pin_changed)
 	{
+		exception_reset(&temperature_channel);
+		Debug_printf("Latch Cleared - Pin Change\r\n");
+		
 		Debug_printf("Interrupt Uplink\r\n");
 		//schedule an immediate uplink
 		ds18b20_uplink_multi();
@@ -467,74 +550,53 @@ void pin_change_irq()
 	Debug_printf("Input Changed: %d%d%d \r\n", input1_state, input2_state, input3_state);
 	
 	pin_changed = true;
-	
-	ds18b20_latch = false;
-	Debug_printf("Latch Cleared - Pin Change\r\n");
+	event_post(event_device);
 }
 
 //returns true iff this threshold triggered an uplink
 bool multi_ds18b20_check_thresholds()
 {
-	ds18b20_result_t result = {0};	
-
-	//If the temperature returns above 85 Degrees C, then we can clear the latch
-	if(ds18b20_latch)
+	exception_config_t config = multi_ds18b20_exception_config();
+	exception_reason_e reason;
+	ds18b20_result_t   result;
+	
+	//The alarm condition is the temperature falling below the lower threshold,
+	//which is only checked while D3 is low. Once the latch is set it is checked
+	//regardless, so that it can clear.
+	if(input3_state && (temperature_channel.band == exception_band_normal))
 	{
-		Debug_printf("Checking to clear latch\r\n");
-		
-		result = ds18b20_read_multi(probe_id[0]);
-		
-		//only check upper temperature if latch is clear
-		if(result.temperature > upper_temperature_threshold)
-		{
-			Debug_printf("Upper Threshold exceeded\r\n");
-			Debug_printf("Latch Cleared - Upper Threshold\r\n");
-			ds18b20_latch = false;
-		}
-		//we return here, because the alarm cannot be resent while the latch is on.
+		Debug_printf("D3 high\r\n");
 		return false;
 	}
-
-	//if the latch is not enabled, and D3 is high, then we check the
-	//temperature for the alarm condition.
-	//The alarm condition here is the temperature falling below 83 Degrees C
-	if(!input3_state)
+	
+	result = ds18b20_read_multi(probe_id[0]);
+	if(result.status != RESULT_OK)
 	{
-		Debug_printf("Checking for low temperature\r\n");
-		result = ds18b20_read_multi(probe_id[0]);
-		//If we are below the lower threshold, we have to send the alarm and turn the latch on
-		if(result.temperature < lower_temperature_threshold)
-		{
-			Debug_printf("Lower Threshold exceeded\r\n");
-			ds18b20_latch = true;
-			Debug_printf("Latch Set - Lower Threshold\r\n");
-			ds18b20_uplink_multi();
-			//return true, beacause we triggered an uplink
-			return true;
-		}
+		return false;
 	}
-	else
+	
+	reason = exception_check(&temperature_channel, &config, result.temperature);
+	if(reason == exception_none)
 	{
-		Debug_printf("D3 high\r\n");
+		return false;
 	}
-	return false;
-
-
+	
+	Debug_printf("Exception Uplink: %s\r\n", exception_reason_name(reason));
+	ds18b20_uplink_multi();
+	//return true, beacause we triggered an uplink
+	return true;
 }
 
 void multi_ds18b20_onWakeup()
 {
+	bool heartbeat = exception_heartbeat_due(&uplink_schedule);
+	
 	//if the threshold check doesn't trigger an uplink, we can check for regularly scheduled uplinks.
-	if(!multi_ds18b20_check_thresholds())
+	if(!multi_ds18b20_check_thresholds() && heartbeat)
 	{
-		if(wakeup_count % wakeups_per_uplink == 0)
-		{
-			Debug_printf("Regular Uplink (%d)\r\n", wakeups_per_uplink);
-			ds18b20_uplink_multi();
-			return;
-		}
+		Debug_printf("Regular Uplink (%d)\r\n", wakeups_per_uplink);
+		ds18b20_uplink_multi();
 	}
-
 }
 
 
@@ -582,6 +644,10 @@ void ds18b20_save_config()
 	config.members.Temperature_threshold_lower.enabled     = lower_temperature_threshold_enabled;
 	config.members.Temperature_threshold_lower.wakeups     = 0;
 	
+	config.members.temperature_hysteresis = temperature_hysteresis;
+	config.members.temperature_exception  = temperature_tuning;
+	config.members.max_silence_wakeups    = uplink_schedule.max_silence;
+	
 	save_extra_config_page(config.raw_bytes, device_specific_page_1);
 }
 
@@ -597,6 +663,14 @@ void ds18b20_load_config()
 	lower_temperature_threshold          = config.members.Temperature_threshold_lower.s_threshold;
 	lower_temperature_threshold_enabled  = config.members.Temperature_threshold_lower.enabled;
 	
+	temperature_hysteresis               = config.members.temperature_hysteresis;
+	temperature_tuning                   = config.members.temperature_exception;
+	uplink_schedule.max_silence          = config.members.max_silence_wakeups;
+	
+	//an erased page reads back as all ones
+	if(temperature_hysteresis      == 0xFFFF) temperature_hysteresis      = 0;
+	if(uplink_schedule.max_silence == 0xFFFF) uplink_schedule.max_silence = 0;
+	exception_tuning_defaults(&temperature_tuning);
 }
 
 void ds18b20_onDownlink(uint8_t *buffer, uint8_t size)
@@ -680,6 +754,13 @@ void ds18b20_cli_threshold_help()
 	Debug_printf("\tCheck threshold every [value] wakeups\r\n");
 	await_uart_tx();
 	
+	Debug_printf("Usage: threshold hysteresis [value]\r\n");
+	await_uart_tx();
+	Debug_printf("\tA threshold clears [value] back inside its limit\r\n");
+	await_uart_tx();
+	
+	exception_cli_help("");
+	
 	Debug_printf("Usage: threshold show\r\n");
 	await_uart_tx();
 	Debug_printf("\tShows the current threshold configuration\r\n");
@@ -691,7 +772,7 @@ void ds18b20_cli_threshold(int argc, char *argv[])
 	//"threshold enable t_upper"
 	//"threshold disable t_upper"
 	//"threshold set t_upper [value]"
-	float value;
+	int32_t value;
 	
 	if(argc == 1)
 	{
@@ -707,6 +788,11 @@ void ds18b20_cli_threshold(int argc, char *argv[])
 			await_uart_tx();
 			Debug_printf("Checking thresholds every %d wakeups\r\n", temperature_threshold_wakeups);
 			await_uart_tx();
+			Debug_printf("Hysteresis             :%d.%03d\r\n", temperature_hysteresis/16, ((temperature_hysteresis*1000)/16)%1000);
+			await_uart_tx();
+			exception_cli_show("Temperature", &temperature_tuning, 16);
+			Debug_printf("Max silence            :%d wakeups\r\n", uplink_schedule.max_silence);
+			await_uart_tx();
 			return;
 		}
 	}
@@ -727,6 +813,27 @@ void ds18b20_cli_threshold(int argc, char *argv[])
 			return;
 			
 		}
+		if(!strcmp(argv[0], "silence"))
+		{
+			exception_cli_silence(argv[1], &uplink_schedule);
+			return;
+		}
+		if(!strcmp(argv[0], "hysteresis"))
+		{
+			//value is parsed straight to 1/16 DegC units
+			if(!fxp_parse_scaled(argv[1], 16, &value) || value < 0 || value > UINT16_MAX)
+			{
+				Debug_printf("Invalid value\r\n");
+				return;
+			}
+			temperature_hysteresis = (uint16_t)value;
+			Debug_printf("Hysteresis set to %d.%03d\r\n", temperature_hysteresis/16, ((temperature_hysteresis*1000)/16)%1000);
+			return;
+		}
+		if(exception_cli_tuning(argv[0], argv[1], &temperature_tuning, 16))
+		{
+			return;
+		}
 		if(!strcmp(argv[0], "enable"))
 		{
 			//options here are upper or lower
@@ -767,7 +874,12 @@ void ds18b20_cli_threshold(int argc, char *argv[])
 	
 	if(argc == 3)
 	{
-		value = atof(argv[2]);
+		//value is parsed straight to 1/16 DegC units
+		if(!fxp_parse_scaled(argv[2], 16, &value))
+		{
+			Debug_printf("Invalid value\r\n");
+			return;
+		}
 		
 		if(!strcmp(argv[0], "set"))
 		{
@@ -775,14 +887,14 @@ void ds18b20_cli_threshold(int argc, char *argv[])
 			if(!strcmp(argv[1], "t_upper"))
 			{
 				//set upper
-				upper_temperature_threshold = (int)(value*16);
+				upper_temperature_threshold = (int)value;
 				Debug_printf("Upper threshold set to %d.%03d\r\n", upper_temperature_threshold/16, ((upper_temperature_threshold*1000)/16)%1000);
 				return;
 			}
 			if(!strcmp(argv[1], "t_lower"))
 			{
 				//set lower
-				lower_temperature_threshold = (int)(value*16);
+				lower_temperature_threshold = (int)value;
 				Debug_printf("Lower threshold set to %d.%03d\r\n", lower_temperature_threshold/16, ((lower_temperature_threshold*1000)/16)%1000);
 				return;
 			}
@@ -936,7 +1048,7 @@ void multi_ds18b20_init()
 	input2_state = HW_GPIO_Read(COUNT2_PORT, COUNT2_PIN);
 	input3_state = HW_GPIO_Read(COUNT3_PORT, COUNT3_PIN);
 	
-	ds18b20_latch = false;
+	exception_reset(&temperature_channel);
 	Debug_printf("Latch Cleared - Startup\r\n");
 	pin_changed = false;
 	
@@ -0,0 +1,221 @@
+/*
+   _____             _____                 
+  / ____|           / ____|                
+ | (___   ___ _ __ | (___  _   _ _ __ ___  
+  \___ \ / _ \ '_ \ \___ \| | | | '_ ` _ \ 
+  ____) |  __/ | | |____) | |_| | | | | | |
+ |_____/ \___|_| |_|_____/ \__,_|_| |_| |_|
+                                           
+                                           
+	Description: Events posted from interrupts and run from the sleep loop.
+								None of the events carry data, so each type is a posted flag
+								and a post time. Posting is one byte store and needs no lock,
+								posts of a type that is already pending merge into one run.
+								Handlers run to completion in event_type_e order, and the loop
+								goes back to STOP as soon as nothing is pending.
+
+	Maintainer: Shea Gosnell
+
+*/
+
+#include <string.h>
+#include "global.h"
+#include "hw.h"
+#include "low_power_manager.h"
+#include "timeServer.h"
+#include "debug_uart.h"
+#include "watchdog.h"
+#include "event_loop.h"
+#include "stack_monitor.h"
+
+typedef struct
+{
+	uint32_t runs;
+	uint32_t latency_total_ms;
+	uint32_t latency_max_ms;
+	uint32_t handler_max_ms;
+}event_stats_t;
+
+static const char *event_names[event_types] =
+{
+	"downlink",
+	"uplink queue",
+	"count",
+	"hourly",
+	"device",
+	"scheduled",
+};
+
+static volatile uint8_t     posted[event_types];
+static volatile TimerTime_t posted_at[event_types];
+static event_handler_t      handlers[event_types];
+static event_stats_t        stats[event_types];
+
+static TimerTime_t woke_at        = 0;
+static uint32_t    awake_total_ms = 0;
+static uint32_t    awake_max_ms   = 0;
+static uint32_t    wakes          = 0;
+//wakes where nothing was posted, i.e. timers inside the radio stack or debounce
+static uint32_t    idle_wakes     = 0;
+static bool        ran_since_wake = false;
+
+//safe from any interrupt
+void event_post(event_type_e event)
+{
+	if(!posted[event])
+	{
+		posted_at[event] = TimerGetCurrentTime();
+	}
+	posted[event] = 1;
+}
+
+void event_register(event_type_e event, event_handler_t handler)
+{
+	handlers[event] = handler;
+}
+
+static void event_record(event_type_e event)
+{
+	uint32_t latency = TimerGetElapsedTime(posted_at[event]);
+	
+	stats[event].runs++;
+	stats[event].latency_total_ms += latency;
+	if(latency > stats[event].latency_max_ms)
+	{
+		stats[event].latency_max_ms = latency;
+	}
+	ran_since_wake = true;
+}
+
+//consumes an event that has no handler, for the caller to act on
+bool event_take(event_type_e event)
+{
+	if(!posted[event])
+	{
+		return false;
+	}
+	event_record(event);
+	posted[event] = 0;
+	return true;
+}
+
+bool event_pending(event_type_e event)
+{
+	return posted[event] != 0;
+}
+
+void event_clear(event_type_e event)
+{
+	posted[event] = 0;
+}
+
+bool event_any_pending()
+{
+	uint8_t i;
+	
+	for(i=0;i<event_types;i++)
+	{
+		if(posted[i] && (handlers[i] != NULL))
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+//runs every pending handler, including ones posted by the handlers themselves.
+//A post that lands after the flag is cleared is seen by the handler already running.
+bool event_dispatch()
+{
+	bool ran = false;
+	uint8_t i = 0;
+	
+	while(i < event_types)
+	{
+		if(posted[i] && (handlers[i] != NULL))
+		{
+			TimerTime_t started;
+			uint32_t    duration;
+			
+			event_record((event_type_e)i);
+			posted[i] = 0;
+			
+			started = TimerGetCurrentTime();
+			handlers[i]();
+			duration = TimerGetElapsedTime(started);
+			if(duration > stats[i].handler_max_ms)
+			{
+				stats[i].handler_max_ms = duration;
+			}
+			
+			reset_watchdog();
+			ran = true;
+			//start again, so a higher priority event posted meanwhile goes first
+			i = 0;
+			continue;
+		}
+		i++;
+	}
+	return ran;
+}
+
+//Called with interrupts disabled and the debug UART already flushed. Returns
+//after the next wake-up, with interrupts still disabled.
+void event_loop_sleep()
+{
+	if(woke_at != 0)
+	{
+		uint32_t awake = TimerGetElapsedTime(woke_at);
+		
+		awake_total_ms += awake;
+		if(awake > awake_max_ms)
+		{
+			awake_max_ms = awake;
+		}
+		if(!ran_since_wake)
+		{
+			idle_wakes++;
+		}
+	}
+	
+	//nothing is running, so this is the stack at its most settled
+	stack_monitor_update();
+	
+	LPM_EnterStopMode();
+	LPM_ExitStopMode();
+	
+	woke_at = TimerGetCurrentTime();
+	ran_since_wake = false;
+	wakes++;
+}
+
+void event_loop_clear_stats()
+{
+	memset(stats, 0, sizeof(stats));
+	awake_total_ms = 0;
+	awake_max_ms   = 0;
+	wakes          = 0;
+	idle_wakes     = 0;
+}
+
+void event_loop_print()
+{
+	uint8_t i;
+	
+	Debug_printf("Wakes                    :%u (%u idle)\r\n", wakes, idle_wakes);
+	Debug_printf("Awake ms total/avg/max   :%u/%u/%u\r\n", awake_total_ms, wakes ? awake_total_ms / wakes : 0, awake_max_ms);
+	await_uart_tx();
+	
+	//Debug_printf formats into 64 bytes, so the columns are terse
+	Debug_printf("Event        runs latency avg/max, run max (ms)\r\n");
+	for(i=0;i<event_types;i++)
+	{
+		Debug_printf("%-12s %u %u/%u %u\r\n",
+			event_names[i],
+			stats[i].runs,
+			stats[i].runs ? stats[i].latency_total_ms / stats[i].runs : 0,
+			stats[i].latency_max_ms,
+			stats[i].handler_max_ms);
+		await_uart_tx();
+	}
+}
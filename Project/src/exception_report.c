@@ -0,0 +1,293 @@
+/*
+   _____             _____                 
+  / ____|           / ____|                
+ | (___   ___ _ __ | (___  _   _ _ __ ___  
+  \___ \ / _ \ '_ \ \___ \| | | | '_ ` _ \ 
+  ____) |  __/ | | |____) | |_| | | | | | |
+ |_____/ \___|_| |_|_____/ \__,_|_| |_| |_|
+                                           
+                                           
+	Description: Report by exception.
+								A channel is in one band at a time, inside its limits, over the
+								upper or under the lower. A new band has to be seen on dwell
+								checks in a row before it reports, and a band is only left once
+								the value is back inside its limit by the hysteresis, so a
+								reading sitting on a limit reports once rather than every check.
+								The rate and deadband triggers report a change even inside the
+								limits, and the schedule bounds the time without an uplink.
+
+	Maintainer: Shea Gosnell
+
+
+*/
+
+#include <string.h>
+#include <stdlib.h>
+#include "exception_report.h"
+#include "global.h"
+#include "debug_uart.h"
+#include "fixed_point.h"
+
+static const char* const reason_names[] =
+{
+	"none",
+	"upper limit",
+	"lower limit",
+	"cleared",
+	"rate of change",
+	"deadband",
+};
+
+static uint32_t exception_distance(int32_t a, int32_t b)
+{
+	return (a > b) ? (uint32_t)((int64_t)a - b) : (uint32_t)((int64_t)b - a);
+}
+
+static exception_band_e exception_band(const exception_channel_t* channel, const exception_config_t* config, int32_t value)
+{
+	//hold the band until the value is back past the limit by the hysteresis
+	if((channel->band == exception_band_upper) && config->upper_enabled && ((int64_t)value > (int64_t)config->upper - config->hysteresis))
+	{
+		return exception_band_upper;
+	}
+	if((channel->band == exception_band_lower) && config->lower_enabled && ((int64_t)value < (int64_t)config->lower + config->hysteresis))
+	{
+		return exception_band_lower;
+	}
+	
+	if(config->upper_enabled && (value > config->upper))
+	{
+		return exception_band_upper;
+	}
+	if(config->lower_enabled && (value < config->lower))
+	{
+		return exception_band_lower;
+	}
+	return exception_band_normal;
+}
+
+exception_config_t exception_config(int32_t upper, bool upper_enabled, int32_t lower, bool lower_enabled, uint32_t hysteresis, const exception_tuning_t* tuning)
+{
+	exception_config_t config;
+	
+	config.upper         = upper;
+	config.lower         = lower;
+	config.upper_enabled = upper_enabled;
+	config.lower_enabled = lower_enabled;
+	config.hysteresis    = hysteresis;
+	config.deadband      = tuning->deadband;
+	config.rate          = tuning->rate;
+	config.dwell         = tuning->dwell;
+	return config;
+}
+
+//false when no reading could report, so the mode can skip taking one
+bool exception_config_active(const exception_config_t* config)
+{
+	return config->upper_enabled || config->lower_enabled || (config->rate != 0) || (config->deadband != 0);
+}
+
+exception_reason_e exception_check(exception_channel_t* channel, const exception_config_t* config, int32_t value)
+{
+	exception_band_e   band   = exception_band(channel, config, value);
+	exception_reason_e reason = exception_none;
+	
+	if(band == channel->band)
+	{
+		channel->dwell_count = 0;
+	}
+	else
+	{
+		if(band != channel->pending)
+		{
+			channel->pending     = band;
+			channel->dwell_count = 0;
+		}
+		channel->dwell_count++;
+		
+		if(channel->dwell_count >= config->dwell)
+		{
+			channel->band        = band;
+			channel->dwell_count = 0;
+			
+			switch(band)
+			{
+				case exception_band_upper : reason = exception_upper; break;
+				case exception_band_lower : reason = exception_lower; break;
+				case exception_band_normal: reason = exception_clear; break;
+			}
+		}
+	}
+	
+	if(reason == exception_none)
+	{
+		if((config->rate != 0) && channel->has_previous && (exception_distance(value, channel->previous) >= config->rate))
+		{
+			reason = exception_rate;
+		}
+		else if((config->deadband != 0) && channel->has_reported && (exception_distance(value, channel->reported) >= config->deadband))
+		{
+			reason = exception_deadband;
+		}
+	}
+	
+	channel->previous     = value;
+	channel->has_previous = true;
+	return reason;
+}
+
+//the value that went out, the deadband is measured from it
+void exception_reported(exception_channel_t* channel, int32_t value)
+{
+	channel->reported     = value;
+	channel->has_reported = true;
+}
+
+void exception_reset(exception_channel_t* channel)
+{
+	memset(channel, 0, sizeof(exception_channel_t));
+}
+
+const char* exception_reason_name(exception_reason_e reason)
+{
+	if(reason >= (sizeof(reason_names) / sizeof(reason_names[0])))
+	{
+		return "unknown";
+	}
+	return reason_names[reason];
+}
+
+//called on every scheduled wakeup, true when the heartbeat uplink is due
+bool exception_heartbeat_due(exception_schedule_t* schedule)
+{
+	if(schedule->silent_wakeups < UINT16_MAX)
+	{
+		schedule->silent_wakeups++;
+	}
+	
+	if(schedule->max_silence == 0)
+	{
+		return (wakeup_count % wakeups_per_uplink) == 0;
+	}
+	return schedule->silent_wakeups >= schedule->max_silence;
+}
+
+void exception_sent(exception_schedule_t* schedule)
+{
+	schedule->silent_wakeups = 0;
+}
+
+//an erased page reads back as all ones, which turns every trigger off
+void exception_tuning_defaults(exception_tuning_t* tuning)
+{
+	if(tuning->deadband == 0xFFFF) tuning->deadband = 0;
+	if(tuning->rate     == 0xFFFF) tuning->rate     = 0;
+	if(tuning->dwell    == 0xFF  ) tuning->dwell    = 0;
+}
+
+static void exception_print_scaled(const char* label, uint32_t value, uint32_t scale)
+{
+	Debug_printf("%s%u.%03u\r\n", label, value / scale, ((value * 1000) / scale) % 1000);
+	await_uart_tx();
+}
+
+void exception_cli_help(const char* channels)
+{
+	Debug_printf("Usage: threshold deadband%s [value]\r\n", channels);
+	await_uart_tx();
+	Debug_printf("\tUplink when a reading moves [value] from the last uplink, 0 for off\r\n");
+	await_uart_tx();
+	
+	Debug_printf("Usage: threshold rate%s [value]\r\n", channels);
+	await_uart_tx();
+	Debug_printf("\tUplink when a reading moves [value] between two checks, 0 for off\r\n");
+	await_uart_tx();
+	
+	Debug_printf("Usage: threshold dwell%s [checks]\r\n", channels);
+	await_uart_tx();
+	Debug_printf("\tA limit is reported once it has held for [checks] checks\r\n");
+	await_uart_tx();
+	
+	Debug_printf("Usage: threshold silence [wakeups]\r\n");
+	await_uart_tx();
+	Debug_printf("\tUplink after [wakeups] without one, 0 for the regular uplinks\r\n");
+	await_uart_tx();
+}
+
+//false if setting is not a trigger, so the mode can go on parsing
+bool exception_cli_tuning(const char* setting, const char* value, exception_tuning_t* tuning, uint32_t scale)
+{
+	int32_t parsed;
+	
+	if(!strcmp(setting, "dwell"))
+	{
+		parsed = atoi(value);
+		if(parsed < 0 || parsed > 255)
+		{
+			Debug_printf("Value out of range\r\n");
+			return true;
+		}
+		tuning->dwell = (uint8_t)parsed;
+		Debug_printf("Dwell set to %d checks\r\n", tuning->dwell);
+		return true;
+	}
+	
+	if(strcmp(setting, "deadband") && strcmp(setting, "rate"))
+	{
+		return false;
+	}
+	
+	if(!fxp_parse_scaled(value, scale, &parsed))
+	{
+		Debug_printf("Invalid value\r\n");
+		return true;
+	}
+	if(parsed < 0 || parsed > UINT16_MAX)
+	{
+		Debug_printf("Value out of range\r\n");
+		return true;
+	}
+	
+	if(!strcmp(setting, "deadband"))
+	{
+		tuning->deadband = (uint16_t)parsed;
+		exception_print_scaled("Deadband set to ", tuning->deadband, scale);
+	}
+	else
+	{
+		tuning->rate = (uint16_t)parsed;
+		exception_print_scaled("Rate set to ", tuning->rate, scale);
+	}
+	return true;
+}
+
+bool exception_cli_silence(const char* value, exception_schedule_t* schedule)
+{
+	int32_t parsed = atoi(value);
+	
+	if(parsed < 0 || parsed > UINT16_MAX)
+	{
+		Debug_printf("Value out of range\r\n");
+		return false;
+	}
+	schedule->max_silence = (uint16_t)parsed;
+	if(schedule->max_silence == 0)
+	{
+		Debug_printf("Regular uplinks every %d wakeups\r\n", wakeups_per_uplink);
+	}
+	else
+	{
+		Debug_printf("Uplink after %d wakeups without one\r\n", schedule->max_silence);
+	}
+	return true;
+}
+
+void exception_cli_show(const char* name, const exception_tuning_t* tuning, uint32_t scale)
+{
+	Debug_printf("%s dwell : %d checks\r\n", name, tuning->dwell);
+	await_uart_tx();
+	Debug_printf("%s deadband : ", name);
+	exception_print_scaled("", tuning->deadband, scale);
+	Debug_printf("%s rate : ", name);
+	exception_print_scaled("", tuning->rate, scale);
+}
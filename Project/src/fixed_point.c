@@ -0,0 +1,252 @@
+/*
+   _____             _____                 
+  / ____|           / ____|                
+ | (___   ___ _ __ | (___  _   _ _ __ ___  
+  \___ \ / _ \ '_ \ \___ \| | | | '_ ` _ \ 
+  ____) |  __/ | | |____) | |_| | | | | | |
+ |_____/ \___|_| |_|_____/ \__,_|_| |_| |_|
+                                           
+                                           
+	Description: Integer conversion kernels for the sensor drivers.
+
+	Maintainer: Shea Gosnell
+
+
+*/
+
+#include "fixed_point.h"
+
+//ADC full scale and the analogue supply the ADC is referenced to
+#define FXP_ADC_FULL_SCALE 4095
+#define FXP_VDDA_CENTI_V   330
+
+//returns value*numerator/denominator, truncated toward zero.
+//value*numerator must fit in 32 bits, which holds for every call in this file.
+int32_t fxp_scale(int32_t value, uint32_t numerator, uint32_t denominator)
+{
+	if(value < 0)
+	{
+		return -(int32_t)(((uint32_t)(-value) * numerator) / denominator);
+	}
+	return (int32_t)(((uint32_t)value * numerator) / denominator);
+}
+
+//T = -45 + 175*raw/65535, returned in 0.01 DegC
+int16_t fxp_sht3x_temperature_centi(uint16_t raw)
+{
+	//signed numerator so the C division truncates toward zero below 0 DegC
+	int32_t numerator = ((int32_t)raw * 17500) - (4500 * 65535);
+	return (int16_t)(numerator / 65535);
+}
+
+//RH = 100*raw/65535, returned in 0.01 %RH
+uint16_t fxp_sht3x_humidity_centi(uint16_t raw)
+{
+	return (uint16_t)(((uint32_t)raw * 10000) / 65535);
+}
+
+//inverse of fxp_sht3x_temperature_centi, clamped to the sensor range
+uint16_t fxp_sht3x_temperature_raw(int32_t centi)
+{
+	if(centi < -4500) centi = -4500;
+	if(centi > 13000) centi = 13000;
+	return (uint16_t)(((uint32_t)(centi + 4500) * 65535) / 17500);
+}
+
+//inverse of fxp_sht3x_humidity_centi, clamped to the sensor range
+uint16_t fxp_sht3x_humidity_raw(int32_t centi)
+{
+	if(centi < 0) centi = 0;
+	if(centi > 10000) centi = 10000;
+	return (uint16_t)(((uint32_t)centi * 65535) / 10000);
+}
+
+//T = -46.85 + 175.72*raw/65536, returned in 0.01 DegC
+int16_t fxp_sht2x_temperature_centi(uint16_t raw)
+{
+	int32_t numerator = ((int32_t)raw * 17572) - (4685 * 65536);
+	return (int16_t)(numerator / 65536);
+}
+
+//RH = -6 + 125*raw/65536, returned in 0.1 %RH
+int16_t fxp_sht2x_humidity_deci(uint16_t raw)
+{
+	int32_t numerator = ((int32_t)raw * 1250) - (60 * 65536);
+	return (int16_t)(numerator / 65536);
+}
+
+//the DS18B20 reports in 1/16 DegC, returned in 0.001 DegC
+int32_t fxp_ds18b20_millicelsius(int16_t raw)
+{
+	//1000/16 == 125/2
+	return ((int32_t)raw * 125) / 2;
+}
+
+//scales an ADC reading to what it would have been with VDDA at the factory
+//calibration voltage (3.0V), using the internal reference reading.
+uint16_t fxp_vrefint_compensate(uint16_t adc, uint16_t vrefint, uint16_t vrefint_cal)
+{
+	if(vrefint == 0)
+	{
+		return 0;
+	}
+	return (uint16_t)(((uint32_t)adc * vrefint_cal) / vrefint);
+}
+
+//External voltage in 0.01V, through the 10:1 divider (10.9x including the
+//input impedance), on a 3.3V referenced ADC.
+uint16_t fxp_ext_voltage_centi(uint16_t adc)
+{
+	return (uint16_t)(((uint32_t)adc * FXP_VDDA_CENTI_V * 109) / (10 * FXP_ADC_FULL_SCALE));
+}
+
+//Converts the bits of an IEEE754 single to value*1000, truncated toward zero
+//and saturated at the int32 range. NaN is returned as 0.
+int32_t fxp_float32_to_milli(uint32_t bits)
+{
+	int16_t  exponent = (bits >> 23) & 0xFF;
+	uint64_t milli;
+	
+	//zero and denormals, nothing a meter reports is that small
+	if(exponent == 0)
+	{
+		return 0;
+	}
+	
+	if(exponent == 0xFF && (bits & 0x007FFFFF))
+	{
+		return 0;
+	}
+	
+	//value = 1.mantissa * 2^(exponent-127), the mantissa has 23 fractional bits
+	exponent -= 150;
+	milli = ((uint64_t)((bits & 0x007FFFFF) | 0x00800000)) * 1000;
+	
+	if(exponent >= 8)
+	{
+		//(2^24 * 1000) << 8 is past the int32 range already
+		milli = INT32_MAX;
+	}
+	else if(exponent >= 0)
+	{
+		milli <<= exponent;
+	}
+	else if(exponent > -64)
+	{
+		milli >>= -exponent;
+	}
+	else
+	{
+		milli = 0;
+	}
+	
+	if(milli > INT32_MAX)
+	{
+		milli = INT32_MAX;
+	}
+	
+	return (bits & 0x80000000) ? -(int32_t)milli : (int32_t)milli;
+}
+
+//Parses a decimal string such as "-12.375" into value*scale, truncated toward
+//zero. Up to 4 fractional digits are used, the rest are ignored. scale must be
+//at most 100000. returns false if the string is not a number or value*scale
+//is outside +-INT32_MAX.
+bool fxp_parse_scaled(const char* str, uint32_t scale, int32_t* result)
+{
+	bool     negative = false;
+	bool     digits   = false;
+	uint32_t integer  = 0;
+	uint32_t fraction = 0;
+	uint32_t divisor  = 1;
+	uint32_t magnitude;
+
+	if(*str == '-' || *str == '+')
+	{
+		negative = (*str == '-');
+		str++;
+	}
+
+	while(*str >= '0' && *str <= '9')
+	{
+		if(integer > ((uint32_t)INT32_MAX / 10))
+		{
+			return false;
+		}
+		integer = (integer * 10) + (*str - '0');
+		digits  = true;
+		str++;
+	}
+
+	if(*str == '.')
+	{
+		str++;
+		while(*str >= '0' && *str <= '9')
+		{
+			if(divisor < 10000)
+			{
+				fraction = (fraction * 10) + (*str - '0');
+				divisor *= 10;
+			}
+			digits = true;
+			str++;
+		}
+	}
+
+	if(!digits || *str != 0)
+	{
+		return false;
+	}
+
+	if(integer > ((uint32_t)INT32_MAX / scale))
+	{
+		return false;
+	}
+	magnitude = (integer * scale) + ((fraction * scale) / divisor);
+	if(magnitude > (uint32_t)INT32_MAX)
+	{
+		return false;
+	}
+
+	*result = negative ? -(int32_t)magnitude : (int32_t)magnitude;
+	return true;
+}
+
+//Writes value/scale as a decimal string such as "-0.062", with one fractional
+//digit per power of ten in scale, which must be 1, 10, 100, 1000 or 10000.
+//buffer must hold FXP_FORMAT_SIZE bytes, it is returned for use in a printf.
+char* fxp_format_scaled(char* buffer, int32_t value, uint32_t scale)
+{
+	char     digits[FXP_FORMAT_SIZE];
+	uint32_t magnitude = (value < 0) ? (0 - (uint32_t)value) : (uint32_t)value;
+	uint8_t  count = 0;
+	uint8_t  i = 0;
+	
+	//least significant first: the fraction, then the integer part, which is at
+	//least a 0
+	for(;scale>1;scale/=10)
+	{
+		digits[count++] = '0' + (magnitude % 10);
+		magnitude /= 10;
+		if(scale == 10)
+		{
+			digits[count++] = '.';
+		}
+	}
+	do
+	{
+		digits[count++] = '0' + (magnitude % 10);
+		magnitude /= 10;
+	}while(magnitude != 0);
+	
+	if(value < 0)
+	{
+		buffer[i++] = '-';
+	}
+	while(count != 0)
+	{
+		buffer[i++] = digits[--count];
+	}
+	buffer[i] = 0;
+	return buffer;
+}
@@ -67,6 +67,7 @@ Maintainer: Miguel Luis and Gregory Cristian
 #include "global.h"
 #include "lora_sensum.h"
 #include "debug_uart.h"
+#include "event_loop.h"
 
 /* Private typedef -----------------------------------------------------------*/
 
@@ -411,7 +412,44 @@ void HW_RTC_IrqHandler(void)
 
 
 
+//Alarm B interval, in minutes. Only divisors of 60 are accepted so the alarm
+//always lands back on the hour.
+static uint8_t alarm_b_interval = 60;
+static void (*alarm_b_callback)(void) = NULL;
+
+static void HW_RTC_SetAlarmB(uint8_t minute);
+
+bool HW_RTC_SetAlarmInterval(uint8_t minutes, void (*callback)(void))
+{
+	if((minutes == 0) || (minutes > 60) || (60 % minutes))
+	{
+		return false;
+	}
+	alarm_b_interval = minutes;
+	alarm_b_callback = callback;
+	
+	//re-arm so the new interval is used from the next boundary, rather than after the hour
+	if(READ_BIT(RTC->CR, RTC_CR_ALRBE))
+	{
+		HW_RTC_StartHourlyAlarm();
+	}
+	return true;
+}
+
+uint8_t HW_RTC_GetAlarmInterval(void)
+{
+	return alarm_b_interval;
+}
+
 void HW_RTC_StartHourlyAlarm()
+{
+	//the first boundary after now, which is the hour itself for a 60 minute interval
+	uint8_t minute = ((HW_RTC_GetMinute() / alarm_b_interval) + 1) * alarm_b_interval;
+	
+	HW_RTC_SetAlarmB(minute % 60);
+}
+
+static void HW_RTC_SetAlarmB(uint8_t minute)
 {
 	//enable writes to the alarm register
 	/* Set RTC_AlarmStructure with calculated values*/
@@ -428,17 +466,19 @@ void HW_RTC_StartHourlyAlarm()
   }
 	
 	//set the registers
-	//set the ss, s, m targets to 0, to ensure that we trigger on the hour each hour.
+	//set the ss, s targets to 0, and m to the next interval boundary.
+	//with the hourly interval m is 0, to ensure that we trigger on the hour each hour.
 	LL_RTC_ALMB_SetSubSecond(RTC, 0x00);
 	//disable the sub-second mask, to ensure that the alarm triggers as the seconds roll over.
   LL_RTC_ALMB_SetSubSecondMask(RTC, 0);
   LL_RTC_ALMB_ConfigTime(RTC, LL_RTC_ALMB_TIME_FORMAT_AM,
                          HW_RTC_ByteToBcd2(0),
-                         HW_RTC_ByteToBcd2(0),
+                         HW_RTC_ByteToBcd2(minute),
                          HW_RTC_ByteToBcd2(0));
   LL_RTC_ALMB_DisableWeekday(RTC);
   LL_RTC_ALMB_SetDay(RTC, 0);
-	//disable date/day of week, and hours. This ensures that we trigger every hour. 
+	//disable date/day of week, and hours. This ensures that we trigger every hour,
+	//shorter intervals move the minute target on from the interrupt.
 	#ifdef ACCELERATE_HOURS
 		#warning hourly alarm set to minutes
 		LL_RTC_ALMB_SetMask(RTC, LL_RTC_ALMB_MASK_DATEWEEKDAY | LL_RTC_ALMB_MASK_HOURS | LL_RTC_ALMB_MASK_MINUTES);
@@ -807,7 +847,6 @@ static void HW_RTC_DeactivateAlarm(void)
 
 
 volatile int wake_via_rtc_a = 0;
-volatile int wake_via_rtc_b = 0;
 static void HW_RTC_AlarmIRQHandler(void)
 {
   /* enable low power at irq*/
@@ -826,15 +865,36 @@ static void HW_RTC_AlarmIRQHandler(void)
   }
 	
 	//alarm B is for the hourly wakeup to record the reading
-	//at least for the counter
+	//at least for the counter, and for the shorter metering intervals
 	if(LL_RTC_IsActiveFlag_ALRB(RTC))
 	{
+		bool on_the_hour = true;
+		
 		LL_RTC_ClearFlag_ALRB(RTC);
 		/* Clear the EXTI's line Flag for RTC Alarm */
 		LL_EXTI_ClearFlag_0_31(HW_RTC_EXTI_LINE_ALARM_EVENT);
-		wake_via_rtc_b = 1;
-		device.on_hourly_alarm_interrupt();
-		lora_manage_rejoin();
+		
+		#ifndef ACCELERATE_HOURS
+		if(alarm_b_interval < 60)
+		{
+			uint8_t minute = HW_RTC_Bcd2ToByte(LL_RTC_ALMB_GetMinute(RTC));
+			
+			on_the_hour = (minute == 0);
+			HW_RTC_SetAlarmB((minute + alarm_b_interval) % 60);
+		}
+		#endif
+		
+		if(alarm_b_callback != NULL)
+		{
+			alarm_b_callback();
+		}
+		
+		if(on_the_hour)
+		{
+			event_post(event_hourly);
+			device.on_hourly_alarm_interrupt();
+			lora_manage_rejoin();
+		}
 	}
 }
 
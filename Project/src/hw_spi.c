@@ -61,9 +61,14 @@ Maintainer: Miguel Luis and Gregory Cristian
 /* Includes ------------------------------------------------------------------*/
 #include "hw.h"
 #include "utilities.h"
+#include "stm32l0xx_ll_dma.h"
 
 /* Private typedef -----------------------------------------------------------*/
 /* Private define ------------------------------------------------------------*/
+/* SPI1 requests are DMA1 channel 2 (RX) and channel 3 (TX), request 1 */
+#define SPI_DMA_RX_CHANNEL  LL_DMA_CHANNEL_2
+#define SPI_DMA_TX_CHANNEL  LL_DMA_CHANNEL_3
+#define SPI_DMA_REQUEST     LL_DMA_REQUEST_1
 /* Private macro -------------------------------------------------------------*/
 /* Private variables ---------------------------------------------------------*/
 /* Private function prototypes -----------------------------------------------*/
@@ -103,6 +108,21 @@ void HW_SPI_Init(void)
 
   /*##-2- Configure the SPI GPIOs */
   HW_SPI_IoInit();
+
+  /*##-3- Route the SPI1 requests, the transfers are set up per burst.
+          DMA1 is shared with the ADC and VCOM, so its clock is left on */
+  LL_AHB1_GRP1_EnableClock(LL_AHB1_GRP1_PERIPH_DMA1);
+  LL_DMA_SetPeriphRequest(DMA1, SPI_DMA_RX_CHANNEL, SPI_DMA_REQUEST);
+  LL_DMA_SetPeriphRequest(DMA1, SPI_DMA_TX_CHANNEL, SPI_DMA_REQUEST);
+}
+
+void HW_SPI_ClockChanged(void)
+{
+  /* Only called between transfers, the divisor follows the new system clock */
+  if (LL_APB2_GRP1_IsEnabledClock(LL_APB2_GRP1_PERIPH_SPI1))
+  {
+    LL_SPI_SetBaudRatePrescaler(SPI1, SpiFrequency(10000000));
+  }
 }
 
 void HW_SPI_DeInit(void)
@@ -193,6 +213,89 @@ uint16_t HW_SPI_InOut(uint16_t txData)
   return rx_data;
 }
 
+void HW_SPI_Burst(const uint8_t *txData, uint8_t *rxData, uint16_t size)
+{
+  uint8_t txDummy = 0;
+  uint8_t rxDummy;
+  uint16_t i;
+
+  /* setting up the channels costs more than a few polled bytes */
+  if (size < HW_SPI_DMA_MIN_SIZE)
+  {
+    for (i = 0; i < size; i++)
+    {
+      rxDummy = HW_SPI_InOut((txData != NULL) ? txData[i] : 0);
+      if (rxData != NULL)
+      {
+        rxData[i] = rxDummy;
+      }
+    }
+    return;
+  }
+
+  if (LL_SPI_IsEnabled(SPI1) == RESET)
+  {
+    LL_SPI_Enable(SPI1);
+  }
+
+  /* RX has the higher priority, so the data register can not overrun.
+     Without a buffer, each direction uses a fixed dummy byte */
+  LL_DMA_ConfigTransfer(DMA1, SPI_DMA_RX_CHANNEL,
+                        LL_DMA_DIRECTION_PERIPH_TO_MEMORY |
+                        LL_DMA_MODE_NORMAL                |
+                        LL_DMA_PERIPH_NOINCREMENT         |
+                        ((rxData != NULL) ? LL_DMA_MEMORY_INCREMENT : LL_DMA_MEMORY_NOINCREMENT) |
+                        LL_DMA_PDATAALIGN_BYTE            |
+                        LL_DMA_MDATAALIGN_BYTE            |
+                        LL_DMA_PRIORITY_VERYHIGH);
+  LL_DMA_ConfigAddresses(DMA1, SPI_DMA_RX_CHANNEL,
+                         LL_SPI_DMA_GetRegAddr(SPI1),
+                         (rxData != NULL) ? (uint32_t)rxData : (uint32_t)&rxDummy,
+                         LL_DMA_DIRECTION_PERIPH_TO_MEMORY);
+  LL_DMA_SetDataLength(DMA1, SPI_DMA_RX_CHANNEL, size);
+
+  LL_DMA_ConfigTransfer(DMA1, SPI_DMA_TX_CHANNEL,
+                        LL_DMA_DIRECTION_MEMORY_TO_PERIPH |
+                        LL_DMA_MODE_NORMAL                |
+                        LL_DMA_PERIPH_NOINCREMENT         |
+                        ((txData != NULL) ? LL_DMA_MEMORY_INCREMENT : LL_DMA_MEMORY_NOINCREMENT) |
+                        LL_DMA_PDATAALIGN_BYTE            |
+                        LL_DMA_MDATAALIGN_BYTE            |
+                        LL_DMA_PRIORITY_HIGH);
+  LL_DMA_ConfigAddresses(DMA1, SPI_DMA_TX_CHANNEL,
+                         (txData != NULL) ? (uint32_t)txData : (uint32_t)&txDummy,
+                         LL_SPI_DMA_GetRegAddr(SPI1),
+                         LL_DMA_DIRECTION_MEMORY_TO_PERIPH);
+  LL_DMA_SetDataLength(DMA1, SPI_DMA_TX_CHANNEL, size);
+
+  LL_DMA_ClearFlag_GI2(DMA1);
+  LL_DMA_ClearFlag_GI3(DMA1);
+
+  /* RX request first, then the channels, then TX starts the clock */
+  LL_SPI_EnableDMAReq_RX(SPI1);
+  LL_DMA_EnableChannel(DMA1, SPI_DMA_RX_CHANNEL);
+  LL_DMA_EnableChannel(DMA1, SPI_DMA_TX_CHANNEL);
+  LL_SPI_EnableDMAReq_TX(SPI1);
+
+  /* the last byte in is also the end of the last byte out */
+  while ((LL_DMA_IsActiveFlag_TC2(DMA1) == 0) && (LL_DMA_IsActiveFlag_TE2(DMA1) == 0))
+  {
+    ;
+  }
+
+  while (LL_SPI_IsActiveFlag_BSY(SPI1) != RESET)
+  {
+    ;
+  }
+
+  LL_SPI_DisableDMAReq_TX(SPI1);
+  LL_SPI_DisableDMAReq_RX(SPI1);
+  LL_DMA_DisableChannel(DMA1, SPI_DMA_TX_CHANNEL);
+  LL_DMA_DisableChannel(DMA1, SPI_DMA_RX_CHANNEL);
+  LL_DMA_ClearFlag_GI2(DMA1);
+  LL_DMA_ClearFlag_GI3(DMA1);
+}
+
 /* Private functions ---------------------------------------------------------*/
 
 static uint32_t SpiFrequency(uint32_t hz)
@@ -29,6 +29,7 @@
 
 #include "delays.h"
 #include "watchdog.h"
+#include "clock_manager.h"
 
 #ifdef DISABLE_I2C_DATA_DEBUG
 	#define DBG_DAT_printf(...)
@@ -44,6 +45,14 @@
 
 #define FLASH_I2C_ADDR	0x05
 
+//Bus timing, from table 117, page 686, section 27.4.10 of the PRM (HSI16, PRESC 3).
+//Kept in ns so the same bus timing can be rebuilt from whichever kernel clock runs.
+#define I2C_TPRESC_NS	250
+#define I2C_SCLL_NS		9750
+#define I2C_SCLH_NS		7750
+#define I2C_SDADEL_NS	2500
+#define I2C_SCLDEL_NS	2750
+
 /********************************************************************
  *Register Access                                                   *
  ********************************************************************/
@@ -201,6 +210,48 @@ bool i2c_is_dat_physical_idle()
  }
  
  
+//HSI16 gives PRESC 3, SCLL 0x26, SCLH 0x1E, SDADEL 10, SCLDEL 10, as before
+static void i2c1_set_clock(void)
+{
+	uint32_t khz = clock_kernel_hz() / 1000;
+	uint32_t presc;
+	uint32_t tpresc_ns;
+	uint32_t sdadel;
+	uint32_t scldel;
+	
+	//select HSI16 clock for I2C1 (page 162 of PM, section 7.3.20), SYSCLK while HSI16 is off
+	REG_I2CBus_CCIPR->I2C1SEL = clock_kernel_select();
+	
+	presc = ((khz * I2C_TPRESC_NS) + 500000) / 1000000;
+	presc = (presc == 0) ? 0 : ((presc > 16) ? 15 : presc - 1);
+	tpresc_ns = ((presc + 1) * 1000000) / khz;
+	
+	sdadel = (I2C_SDADEL_NS + (tpresc_ns/2)) / tpresc_ns;
+	scldel = ((I2C_SCLDEL_NS + (tpresc_ns/2)) / tpresc_ns) - 1;
+	
+	REG_I2CBus_TIMINGR->PRESC 	= presc;
+	REG_I2CBus_TIMINGR->SCLL 	= ((I2C_SCLL_NS + (tpresc_ns/2)) / tpresc_ns) - 1;
+	REG_I2CBus_TIMINGR->SCLH		= ((I2C_SCLH_NS + (tpresc_ns/2)) / tpresc_ns) - 1;
+	REG_I2CBus_TIMINGR->SDADEL	= (sdadel > 15) ? 15 : sdadel;
+	REG_I2CBus_TIMINGR->SCLDEL	= (scldel > 15) ? 15 : scldel;
+}
+
+//The clock manager has switched the system clock. Only called between transfers,
+//TIMINGR can only be written with the peripheral disabled.
+void i2c1_clock_changed()
+{
+	uint32_t enabled = REG_I2CBus_CR1->PE;
+	
+	if(!REG_I2CBus_CLKEN->I2C1EN)
+	{
+		return;
+	}
+	
+	REG_I2CBus_CR1->PE = 0;
+	i2c1_set_clock();
+	REG_I2CBus_CR1->PE = enabled;
+}
+
 bool i2c1_init()
 {
 	GPIO_InitTypeDef GPIO_InitStruct;
@@ -237,8 +288,6 @@ bool i2c1_init()
 	LL_GPIO_SetPinOutputType(I2C_DAT_PORT, I2C_DAT_PIN, LL_GPIO_OUTPUT_OPENDRAIN);
 	
 	//Now the peripheral clock
-	//select HSI16 clock for I2C1
-	REG_I2CBus_CCIPR->I2C1SEL = 2; //From page 162 of PM (section 7.3.20)
 	//Enable the peripheral clock
 	REG_I2CBus_CLKEN->I2C1EN = 1;
 	
@@ -247,15 +296,8 @@ bool i2c1_init()
 	REG_I2CBus_CR1->ANFOFF = 1;
 	REG_I2CBus_CR1->DNF=0;
 	
-	//Configure the data timing
-	//Using values from table 117, page 686, section 27.4.10 of the PRM
-	REG_I2CBus_TIMINGR->PRESC 	= 3;
-	//REG_I2CBus_TIMINGR->SCLL 	= 0x13;
-	REG_I2CBus_TIMINGR->SCLL 	= 0x26;
-	//REG_I2CBus_TIMINGR->SCLH		= 0x0F;
-	REG_I2CBus_TIMINGR->SCLH		= 0x1E;
-	REG_I2CBus_TIMINGR->SDADEL	= 10;
-	REG_I2CBus_TIMINGR->SCLDEL	= 10;
+	//Select the kernel clock and configure the data timing
+	i2c1_set_clock();
 	
 	//configure nostretch, must be kept clear in master mode
 	REG_I2CBus_CR1->NOSTRETCH = 0;
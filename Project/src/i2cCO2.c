@@ -31,6 +31,7 @@
 
 #include "watchdog.h"
 #include "radio_common.h"
+#include "acquire.h"
 
 #ifndef DISABLE_CO2_L2_DEBUG
 	#define DBG_CO2_L2_printf(...) Debug_printf(__VA_ARGS__)
@@ -548,76 +549,87 @@ void C02_init( void )
 }
  
  
-static CO2_reading_t CO2_read( void )
+//CO2_EN powers the sensor, and it needs 36mS before it will take commands
+static void co2_acquire_power_on(void* result)
 {
-	uint8_t rx_data[2] = {0};
-	CO2_reading_t return_value = {0};
-	
-	static TimerEvent_t CO2Timer;
-	static TimerEvent_t wake_timer;
+	LL_GPIO_SetOutputPin(CO2_EN_PORT,CO2_EN_PIN);
+}
+
+static void co2_acquire_power_off(void* result)
+{
+	disable();
+}
+
+static TimerTime_t co2_started_at;
+static bool        co2_nrdy_seen_high;
+
+static bool co2_acquire_start(void* result)
+{
+	CO2_reading_t* reading = (CO2_reading_t*)result;
 	
 	i2c1_init();
-
-	enable();
 	
 	//Restore REGS and START MEASUREMENT are a single command
 	if(start_measurement() == 0)
 	{
 		//restore regs/start measurement failed
 		DBG_CO2_printf("Restore Regs and Start Failed\r\n");
-		return_value.co2_error_restore_fail = 1;
-		return_value.co2_error_start_fail   = 1;
-		return return_value;
+		reading->co2_error_restore_fail = 1;
+		reading->co2_error_start_fail   = 1;
+		return false;
 	}
 	
+	co2_started_at     = TimerGetCurrentTime();
+	co2_nrdy_seen_high = false;
+	return true;
+}
+
+//nRDY rises when the measurement starts, and falls when it is complete
+static bool co2_acquire_ready(void* result)
+{
+	CO2_reading_t* reading = (CO2_reading_t*)result;
 	
+	if(HW_GPIO_Read(CO2_nRDY_PORT, CO2_nRDY_PIN))
+	{
+		co2_nrdy_seen_high = true;
+		return false;
+	}
 	
-	//wait for nRDY to rise, indicating that the measurement has started
-	start_timeout_timer(&CO2Timer, 100);
-	while(!HW_GPIO_Read(CO2_nRDY_PORT, CO2_nRDY_PIN))
+	if(co2_nrdy_seen_high)
 	{
-		reset_watchdog();
-		
-		if(timer_expired(&CO2Timer))
-		{
-			DBG_CO2_printf("Timeout Rising\r\n");
-			return_value.co2_error_timeout_rise = 1;
-			return_value.co2_error = 1;
-			break;
-		}
-		start_timeout_timer(&wake_timer, 10);
-		sleep_until_interrupt();
+		return true;
 	}
 	
-	//specified 6 second timeout from wehn the nRDY goes high.
-	start_timeout_timer(&CO2Timer, 6000);
-	stop_timeout_timer(&wake_timer);
+	//nRDY should rise within 100mS of the start, if it does not, try reading anyway
+	if(TimerGetElapsedTime(co2_started_at) > 100)
+	{
+		DBG_CO2_printf("Timeout Rising\r\n");
+		reading->co2_error_timeout_rise = 1;
+		reading->co2_error = 1;
+		return true;
+	}
+	
+	return false;
+}
+
+static void co2_acquire_collect(void* result, bool timed_out)
+{
+	CO2_reading_t* reading = (CO2_reading_t*)result;
+	uint8_t rx_data[2] = {0};
 	
-	//wait for nRDY to fall, indicating that the measurement is complete
-	while(HW_GPIO_Read(CO2_nRDY_PORT, CO2_nRDY_PIN))
+	if(timed_out)
 	{
-		reset_watchdog();
-		
-		//if the timeout has expired, then we should exit to prevent a lockup
-		if(timer_expired(&CO2Timer))
-		{
-			DBG_CO2_printf("Timeout Falling\r\n");
-			return_value.co2_error_timeout_fall = 1;
-			return_value.co2_error = 1;
-			break;
-		}
-		start_timeout_timer(&wake_timer, 10);
-		sleep_until_interrupt();
+		DBG_CO2_printf("Timeout Falling\r\n");
+		reading->co2_error_timeout_fall = 1;
+		reading->co2_error = 1;
 	}
-	stop_timeout_timer(&CO2Timer);
-	stop_timeout_timer(&wake_timer);
 	
 	//read the measured value
 	if(read_registers_secure(CO2_REGISTER_H, rx_data, 2, 0) == 0)
 	{
 		DBG_CO2_printf("Failed to read value\r\n");
-		return_value.co2_error_read_fail = 1;
-		return_value.co2_error = 1;
+		reading->co2_error_read_fail = 1;
+		reading->co2_error = 1;
 	}
 	
 	DBG_CO2_printf("Values: %02X %02X\r\n", rx_data[0], rx_data[1]);
@@ -626,14 +638,32 @@ static CO2_reading_t CO2_read( void )
 	if(backup_regs() == 0)
 	{
 		DBG_CO2_printf("Failed to backup registers\r\n");
-		return_value.co2_error_backup_fail = 1;
-		return_value.co2_error = 1;
+		reading->co2_error_backup_fail = 1;
+		reading->co2_error = 1;
 	}
 	
-	//enable low
-	disable();
+	reading->value = (rx_data[0]<<8) + rx_data[1];
+}
+
+static const acquire_driver_t co2_acquire_driver =
+{
+	.name          = "CO2",
+	.warmup_ms     = 36  ,
+	.conversion_ms = 0   , //polled on nRDY
+	.timeout_ms    = 6100, //100mS for nRDY to rise, 6 seconds for it to fall
+	.power_on      = &co2_acquire_power_on,
+	.start         = &co2_acquire_start,
+	.ready         = &co2_acquire_ready,
+	.collect       = &co2_acquire_collect,
+	.power_off     = &co2_acquire_power_off,
+};
+
+static CO2_reading_t CO2_read( void )
+{
+	CO2_reading_t return_value = {0};
+	acquire_job_t job          = {&co2_acquire_driver, &return_value};
 	
-	return_value.value = (rx_data[0]<<8) + rx_data[1];	
+	acquire_run(&job, 1);
 	
 	return return_value;
 }
@@ -644,11 +674,21 @@ void co2_uplink( void )
 	co2_payload_t payload = {0};
 	co2_error_payload_t error = {0};
 	Si1133_reading_t light_reading = {0};
-	sht30Reading_t ht_reading;
-	CO2_reading_t reading = CO2_read();
+	sht30Reading_t ht_reading = {0};
+	CO2_reading_t reading = {0};
 	
 	int i = 0;
 	
+	//all three sensors are converted at the same time, the SHT30 and light
+	//readings are done long before the CO2 measurement.
+	acquire_job_t jobs[] =
+	{
+		{&co2_acquire_driver   , &reading      },
+		{&sht30_acquire_driver , &ht_reading   },
+		{&si1133_acquire_driver, &light_reading},
+	};
+	acquire_run(jobs, sizeof(jobs)/sizeof(acquire_job_t));
+	
 	//try to read the CO2 several times, before quitting
 	while(reading.value >10000 || reading.value < 400 || reading.co2_error )
 	{
@@ -690,17 +730,11 @@ void co2_uplink( void )
 	{
 		payload.members.CO2 = reading.value;
 		
-		//now get SHT30 Temperature and Humidity
+		//SHT30 Temperature and Humidity were read alongside the CO2
 		//all CO2 devices will have a SHT30 installed.
 		
 		DBG_CO2_L2_printf("Exit CO2, value %d\r\n", reading.value);
 		await_uart_tx();
-		delay_timeout_ms(50);
-		ht_reading = sht30GetReading();
-		DBG_CO2_L2_printf("Exit SHT30\r\n");
-		await_uart_tx();
-		
-		light_reading = read_light_level();
 	
 		//post-process the light reading onto a suitable range in 8-bits.
 		light_reading.visible_reading = light_reading.visible_reading/16;
@@ -29,6 +29,7 @@
 #include "watchdog.h"
 #include "radio_common.h"
 #include "sht30.h"
+#include "acquire.h"
 
 #define SI1133_I2C_ADDR 0x55
 
@@ -124,7 +125,6 @@ typedef enum
  ********************************************************************/
 static void init_sensor_for_reading(void);
 static void write_parameter(uint8_t parameter, uint8_t value);
-static void await_reading(void);
 static void start_reading(void);
 static void reset_command_counter(void);
 static void reset_sensor(void);
@@ -229,24 +229,6 @@ static void start_reading()
 	read_response_register();
 }
 
-//this command will wait for the interrupt line to trigger, and then read the status register
-//to ensure that all channels have finished processing
-static void await_reading()
-{
-	//The COUNT2 line should Idle low while we are waiting for data to come in.
-	//lets use a ~1 second timeout to wait for the data.
-	static TimerEvent_t await_reading_timer;
-	
-	start_timeout_timer(&await_reading_timer, 1000);
-	
-	while(!timer_expired(&await_reading_timer) && HW_GPIO_Read(COUNT2_PORT, COUNT2_PIN))
-	{
-		//delaying here should put us into low power mode, which will save some power while waiting
-		delay_timeout_ms(20);
-	}
-	
-	//we should indicate that the timeout happened, instead of the falling edge?
-}
  
 Si1133_power_state_e get_sensor_power_state()
 {
@@ -368,44 +350,75 @@ static void init_sensor_for_reading()
 }
 
 
+static bool si1133_acquire_start(void* result)
+{
+	init_sensor_for_reading();
+	start_reading();
+	return true;
+}
+
+//The COUNT2 line (the sensor's INT) idles high, and is pulled low once all
+//enabled channels have finished.
+static bool si1133_acquire_ready(void* result)
+{
+	return !HW_GPIO_Read(COUNT2_PORT, COUNT2_PIN);
+}
+
 //this actually returns a 24 bit reading, but the next storage class is 32 bits.
-Si1133_reading_t read_light_level()
+static void si1133_acquire_collect(void* result, bool timed_out)
 {
-	Si1133_reading_t result;
+	Si1133_reading_t* reading = (Si1133_reading_t*)result;
 	uint8_t rx_data_buffer[6];
 	uint8_t tx_data_buffer[1];
 	
-	init_sensor_for_reading();
+	//on a timeout, whatever is in the output registers is read as before
 	
-	start_reading();
-	await_reading();
-
 	//read the data from the output buffer registers
 	tx_data_buffer[0] = HOSTOUT_START;
 	i2c1_send_feedback(SI1133_I2C_ADDR, tx_data_buffer, 1, 0);
-	i2c1_receive_feedback(SI1133_I2C_ADDR, rx_data_buffer, 9, 1);
+	i2c1_receive_feedback(SI1133_I2C_ADDR, rx_data_buffer, sizeof(rx_data_buffer), 1);
 	
 	reset_sensor();
 	
-	//The data should be in 3 sets of 24 bits (3 x (3 x uint8_t)), with one set per reading
+	//The data should be in 2 sets of 24 bits (2 x (3 x uint8_t)), with one set per reading
 	//first should be the visible light
 	//then the infra
-	//finally the ultra
-	result.visible_reading  = rx_data_buffer[0];
-	result.visible_reading  = result.visible_reading << 8;
-	result.visible_reading += rx_data_buffer[1];
-	result.visible_reading  = result.visible_reading << 8;
-	result.visible_reading += rx_data_buffer[2];
-	
-	result.infra_reading  = rx_data_buffer[3];
-	result.infra_reading  = result.infra_reading << 8;
-	result.infra_reading += rx_data_buffer[4];
-	result.infra_reading  = result.infra_reading << 8;
-	result.infra_reading += rx_data_buffer[5];
-	
-	Debug_printf("\r\nVisible:%08d\r\n", result.visible_reading);
-	Debug_printf("Infra  :%08d\r\n", result.infra_reading);
+	reading->visible_reading  = rx_data_buffer[0];
+	reading->visible_reading  = reading->visible_reading << 8;
+	reading->visible_reading += rx_data_buffer[1];
+	reading->visible_reading  = reading->visible_reading << 8;
+	reading->visible_reading += rx_data_buffer[2];
+	
+	reading->infra_reading  = rx_data_buffer[3];
+	reading->infra_reading  = reading->infra_reading << 8;
+	reading->infra_reading += rx_data_buffer[4];
+	reading->infra_reading  = reading->infra_reading << 8;
+	reading->infra_reading += rx_data_buffer[5];
+	
+	Debug_printf("\r\nVisible:%08d\r\n", reading->visible_reading);
+	Debug_printf("Infra  :%08d\r\n", reading->infra_reading);
+}
 
+const acquire_driver_t si1133_acquire_driver =
+{
+	.name          = "Si1133",
+	.warmup_ms     = 25  , //start-up time after power on
+	.conversion_ms = 0   , //depends on the gain settings, so poll the INT line
+	.timeout_ms    = 1000,
+	.power_on      = 0   ,
+	.start         = &si1133_acquire_start,
+	.ready         = &si1133_acquire_ready,
+	.collect       = &si1133_acquire_collect,
+	.power_off     = 0   ,
+};
+
+Si1133_reading_t read_light_level()
+{
+	Si1133_reading_t result = {0};
+	acquire_job_t    job    = {&si1133_acquire_driver, &result};
+	
+	acquire_run(&job, 1);
+	
 	return result;
 }
 
@@ -423,11 +436,16 @@ void light_sensor_uplink()
 {
 	LIGHT_payload_t payload = {0};
 	
-	sht30Reading_t ht_reading;
+	sht30Reading_t ht_reading = {0};
 	Si1133_reading_t light_reading = {0};
 	//we need to get the SHT30 readings, and the light sensor reading into a packet.
-	ht_reading = sht30GetReading();
-	light_reading = read_light_level();
+	//both conversions run at the same time.
+	acquire_job_t jobs[] =
+	{
+		{&sht30_acquire_driver , &ht_reading   },
+		{&si1133_acquire_driver, &light_reading},
+	};
+	acquire_run(jobs, sizeof(jobs)/sizeof(acquire_job_t));
 	
 	//truncate to uint16_t
 	if(light_reading.visible_reading > 0xFFFF)
@@ -0,0 +1,449 @@
+/*
+   _____             _____                 
+  / ____|           / ____|                
+ | (___   ___ _ __ | (___  _   _ _ __ ___  
+  \___ \ / _ \ '_ \ \___ \| | | | '_ ` _ \ 
+  ____) |  __/ | | |____) | |_| | | | | | |
+ |_____/ \___|_| |_|_____/ \__,_|_| |_| |_|
+                                           
+                                           
+	Description: Interval metering for count1.
+								The RTC alarm B interrupt records the cumulative count at each
+								interval boundary into a RAM ring, the newest part of which is
+								mirrored into the data page. Each scheduled uplink carries every
+								interval not yet delivered, numbered so a repeat is harmless:
+								
+								interval code  2 bits  0=5, 1=15, 2=30, 3=60 minutes
+								count          6 bits  deltas in this frame
+								first sequence 16 bits sequence of the first delta
+								base           32 bits cumulative count1 before the first delta
+								deltas         varint, 6 bit groups
+								sys_voltage    4 bits  byte aligned
+								pkt_type       4 bits  packet_type_interval
+								
+								Burst and leak detection are the single counter's, on the hour.
+
+	Maintainer: Shea Gosnell
+
+*/
+
+#include <string.h>
+#include <stdlib.h>
+#include "global.h"
+#include "hw.h"
+#include "counter.h"
+#include "flash_map.h"
+#include "radio_common.h"
+#include "payload_codec.h"
+#include "interval_meter.h"
+#include "uplink_queue.h"
+#include "event_loop.h"
+
+#define INTERVAL_VARINT_GROUP 6
+#define INTERVAL_HEADER_BITS  (2 + 6 + 16 + 32)
+#define INTERVAL_TRAILER_BITS 8
+#define INTERVAL_MAX_COUNT    63
+//header, one small delta and the trailer
+#define INTERVAL_MIN_FRAME    ((INTERVAL_HEADER_BITS + INTERVAL_VARINT_GROUP + 7) / 8 + 1)
+//frames per scheduled uplink, the uplink queue spaces them out for the duty cycle
+#define INTERVAL_MAX_FRAMES   3
+
+typedef struct
+{
+	uint8_t  head;
+	uint16_t head_sequence;
+	uint8_t  stored;
+}interval_snapshot_t;
+
+static const uint8_t interval_codes[] = {5, 15, 30, 60};
+
+uint8_t interval_minutes = INTERVAL_MINUTES_DEFAULT;
+
+//cumulative count1 at each boundary, ring[head] is head_sequence
+static volatile uint32_t ring[INTERVAL_RING_ENTRIES];
+static volatile uint8_t  head          = 0;
+static volatile uint16_t head_sequence = 0;
+static volatile uint8_t  stored        = 0;
+//newest interval the radio has sent, a frame the queue drops is built again from here
+static uint16_t          sent_sequence = 0;
+//newest interval in a frame, the next frame starts after it
+static uint16_t          queued_sequence = 0;
+static volatile bool     interval_recorded = false;
+
+static uint8_t interval_code(uint8_t minutes)
+{
+	uint8_t i;
+	
+	for(i=0;i<sizeof(interval_codes);i++)
+	{
+		if(interval_codes[i] == minutes)
+		{
+			return i;
+		}
+	}
+	return 0xFF;
+}
+
+bool interval_minutes_valid(uint8_t minutes)
+{
+	return interval_code(minutes) != 0xFF;
+}
+
+//this is a callback from the RTC alarmB interrupt. Don't make it too long
+static void interval_meter_record(void)
+{
+	head = (head + 1) % INTERVAL_RING_ENTRIES;
+	ring[head] = count1;
+	head_sequence++;
+	if(stored < INTERVAL_RING_ENTRIES)
+	{
+		stored++;
+	}
+	interval_recorded = true;
+	event_post(event_device);
+}
+
+static void interval_snapshot(interval_snapshot_t *snapshot)
+{
+	BACKUP_PRIMASK();
+	DISABLE_IRQ();
+	
+	snapshot->head          = head;
+	snapshot->head_sequence = head_sequence;
+	snapshot->stored        = stored;
+	
+	RESTORE_PRIMASK();
+}
+
+//the caller makes sure the sequence is still in the ring
+static uint32_t interval_count_at(const interval_snapshot_t *snapshot, uint16_t sequence)
+{
+	uint8_t back = (uint16_t)(snapshot->head_sequence - sequence);
+	
+	return ring[(snapshot->head + INTERVAL_RING_ENTRIES - back) % INTERVAL_RING_ENTRIES];
+}
+
+//intervals recorded after sequence, which is moved up if the ring no longer has it
+static uint16_t interval_after(const interval_snapshot_t *snapshot, uint16_t *sequence)
+{
+	uint16_t after = snapshot->head_sequence - *sequence;
+	
+	if(snapshot->stored == 0)
+	{
+		return 0;
+	}
+	
+	//the ring has wrapped past it, only the total is kept for those intervals
+	if(after >= snapshot->stored)
+	{
+		after = snapshot->stored - 1;
+		*sequence = snapshot->head_sequence - after;
+	}
+	return after;
+}
+
+static uint16_t interval_unsent(const interval_snapshot_t *snapshot)
+{
+	return interval_after(snapshot, &sent_sequence);
+}
+
+//start the ring again from the current count, the sequence carries on
+static void interval_restart(void)
+{
+	BACKUP_PRIMASK();
+	DISABLE_IRQ();
+	
+	head          = 0;
+	ring[0]       = count1;
+	stored        = 1;
+	sent_sequence = head_sequence;
+	queued_sequence = head_sequence;
+	
+	RESTORE_PRIMASK();
+}
+
+//The frame header says which intervals it carried. Only a frame that carries on
+//from the last one sent moves sent_sequence, so a dropped frame is not skipped.
+static void interval_meter_sent(const uint8_t payload[], uint8_t size)
+{
+	uint8_t  count;
+	uint16_t first;
+	
+	if((size < INTERVAL_MIN_FRAME) || ((payload[size-1] >> 4) != packet_type_interval))
+	{
+		return;
+	}
+	
+	count = payload[0] >> 2;
+	first = payload[1] | (payload[2] << 8);
+	if(first != (uint16_t)(sent_sequence + 1))
+	{
+		return;
+	}
+	
+	sent_sequence += count;
+	if((int16_t)(queued_sequence - sent_sequence) < 0)
+	{
+		queued_sequence = sent_sequence;
+	}
+}
+
+void init_interval_meter()
+{
+	init_single_counter();
+	uplink_queue_on_sent(&interval_meter_sent);
+	
+	if(!interval_minutes_valid(interval_minutes))
+	{
+		interval_minutes = INTERVAL_MINUTES_DEFAULT;
+	}
+	
+	//keep anything restored from flash
+	if(stored == 0)
+	{
+		interval_restart();
+	}
+	
+	HW_RTC_SetAlarmInterval(interval_minutes, interval_meter_record);
+}
+
+void interval_meter_on_wakeup()
+{
+	if(interval_recorded)
+	{
+		interval_recorded = false;
+		dbg_interval("Interval %u, count1 %u\r\n", head_sequence, count1);
+		interval_meter_save_data();
+	}
+	
+	single_counter_alarms();
+}
+
+//returns the frame length, and the number of deltas it carries in count
+static uint8_t interval_build_frame(uint8_t payload[], uint8_t size, uint8_t *count)
+{
+	interval_snapshot_t snapshot;
+	codec_writer_t      writer;
+	uint16_t            unsent;
+	uint16_t            first;
+	uint16_t            budget = (size * 8) - INTERVAL_TRAILER_BITS;
+	uint8_t             n = 0;
+	uint8_t             i;
+	
+	interval_snapshot(&snapshot);
+	unsent = interval_after(&snapshot, &queued_sequence);
+	first  = queued_sequence + 1;
+	
+	//size the frame first, the trailer is byte aligned so the padding counts too
+	codec_writer_init(&writer, NULL, 0);
+	writer.bit = INTERVAL_HEADER_BITS;
+	while((n < unsent) && (n < INTERVAL_MAX_COUNT))
+	{
+		codec_put_varint(&writer, interval_count_at(&snapshot, first + n) - interval_count_at(&snapshot, first + n - 1), INTERVAL_VARINT_GROUP);
+		if(((writer.bit + 7) & ~7) > budget)
+		{
+			break;
+		}
+		n++;
+	}
+	
+	codec_writer_init(&writer, payload, size);
+	codec_put_bits(&writer, interval_code(interval_minutes), 2);
+	codec_put_bits(&writer, n, 6);
+	codec_put_bits(&writer, first, 16);
+	codec_put_bits(&writer, interval_count_at(&snapshot, queued_sequence), 32);
+	for(i=0;i<n;i++)
+	{
+		codec_put_varint(&writer, interval_count_at(&snapshot, first + i) - interval_count_at(&snapshot, first + i - 1), INTERVAL_VARINT_GROUP);
+	}
+	codec_align(&writer);
+	codec_put_bits(&writer, fourBit_battery_calculation(), 4);
+	codec_put_bits(&writer, packet_type_interval, 4);
+	
+	*count = n;
+	return codec_writer_bytes(&writer);
+}
+
+void interval_meter_uplink()
+{
+	uint8_t payload[UPLINK_QUEUE_PAYLOAD_SIZE];
+	interval_snapshot_t snapshot;
+	uint8_t frame;
+	
+	//with nothing waiting in the queue, a frame that was not sent was dropped, so
+	//its intervals go again. A repeat is harmless, the sequence numbers them.
+	if(uplink_queue_empty())
+	{
+		queued_sequence = sent_sequence;
+	}
+	
+	for(frame=0;frame<INTERVAL_MAX_FRAMES;frame++)
+	{
+		//frames larger than the queue takes would go straight out and ignore the duty cycle
+		uint8_t size = radio_max_payload();
+		uint8_t count;
+		uint8_t length;
+		transmit_status_e result;
+		
+		if(size > UPLINK_QUEUE_PAYLOAD_SIZE)
+		{
+			size = UPLINK_QUEUE_PAYLOAD_SIZE;
+		}
+		if(size < INTERVAL_MIN_FRAME)
+		{
+			size = INTERVAL_MIN_FRAME;
+		}
+		
+		length = interval_build_frame(payload, size, &count);
+		
+		dbg_interval("Interval frame: %u deltas from %u, %u bytes\r\n", count, (uint16_t)(queued_sequence + 1), length);
+		
+		//moved on before the frame is queued, as the radio may send it, and
+		//interval_meter_sent() run, before Uplink() returns
+		queued_sequence += count;
+		result = Uplink(payload, length);
+		if(result == transmit_status_no_send)
+		{
+			queued_sequence = sent_sequence;
+			return;
+		}
+		//the frame waits in the queue for the network
+		if(result == transmit_status_no_join)
+		{
+			return;
+		}
+		
+		interval_snapshot(&snapshot);
+		if(interval_after(&snapshot, &queued_sequence) == 0)
+		{
+			break;
+		}
+	}
+}
+
+//the newest unsent intervals go into the data page, with deltas that don't fit
+//in 16 bits pinned at the maximum. The base keeps count1 itself exact.
+void interval_meter_save_data()
+{
+	interval_data_page_layout_t data = {0};
+	interval_snapshot_t snapshot;
+	uint16_t unsent;
+	uint16_t first;
+	uint8_t  i;
+	
+	interval_snapshot(&snapshot);
+	unsent = interval_unsent(&snapshot);
+	if(unsent > INTERVAL_FLASH_DELTAS)
+	{
+		unsent = INTERVAL_FLASH_DELTAS;
+	}
+	first = snapshot.head_sequence - unsent + 1;
+	
+	data.members.count1           = count1;
+	data.members.head_sequence    = snapshot.head_sequence;
+	data.members.interval_minutes = interval_minutes;
+	data.members.unsent           = unsent;
+	data.members.base             = interval_count_at(&snapshot, first - 1);
+	
+	for(i=0;i<unsent;i++)
+	{
+		uint32_t delta = interval_count_at(&snapshot, first + i) - interval_count_at(&snapshot, first + i - 1);
+		
+		data.members.deltas[i] = (delta > UINT16_MAX) ? UINT16_MAX : delta;
+	}
+	
+	save_data_page(data.raw_bytes);
+}
+
+void interval_meter_load_data()
+{
+	interval_data_page_layout_t data = {0};
+	uint32_t count;
+	uint8_t  i;
+	
+	load_data_page(data.raw_bytes);
+	
+	count1 = data.members.count1;
+	
+	//a page from another mode, or from another interval, starts the ring again
+	if((data.members.interval_minutes != interval_minutes) || (data.members.unsent > INTERVAL_FLASH_DELTAS))
+	{
+		stored = 0;
+		return;
+	}
+	
+	BACKUP_PRIMASK();
+	DISABLE_IRQ();
+	
+	count         = data.members.base;
+	head          = 0;
+	ring[0]       = count;
+	stored        = data.members.unsent + 1;
+	head_sequence = data.members.head_sequence;
+	sent_sequence = head_sequence - data.members.unsent;
+	queued_sequence = sent_sequence;
+	for(i=0;i<data.members.unsent;i++)
+	{
+		count += data.members.deltas[i];
+		head++;
+		ring[head] = count;
+	}
+	
+	RESTORE_PRIMASK();
+}
+
+static void interval_meter_print(void)
+{
+	interval_snapshot_t snapshot;
+	
+	interval_snapshot(&snapshot);
+	
+	Debug_printf("Interval      : %u minutes\r\n", interval_minutes);
+	Debug_printf("Sequence      : %u\r\n", snapshot.head_sequence);
+	Debug_printf("Unsent        : %u\r\n", interval_unsent(&snapshot));
+	Debug_printf("Stored        : %u of %u\r\n", snapshot.stored, INTERVAL_RING_ENTRIES);
+	await_uart_tx();
+}
+
+static void interval_meter_cli_help(void)
+{
+	Debug_printf("Usage: device interval show\r\n");
+	Debug_printf("\tShow the interval and the intervals not yet sent.\r\n");
+	await_uart_tx();
+	Debug_printf("Usage: device interval [minutes]\r\n");
+	Debug_printf("\tSet the metering interval, one of 5, 15, 30 or 60.\r\n");
+	Debug_printf("\tUnsent intervals are dropped, count1 itself is kept.\r\n");
+	await_uart_tx();
+}
+
+void interval_meter_cli(int argc, char *argv[])
+{
+	uint8_t minutes;
+	
+	if((argc != 2) || strcmp(argv[0], "interval"))
+	{
+		interval_meter_cli_help();
+		return;
+	}
+	
+	if(!strcmp(argv[1], "show"))
+	{
+		interval_meter_print();
+		return;
+	}
+	
+	minutes = atoi(argv[1]);
+	if(!interval_minutes_valid(minutes))
+	{
+		interval_meter_cli_help();
+		return;
+	}
+	
+	if(minutes != interval_minutes)
+	{
+		interval_minutes = minutes;
+		interval_restart();
+		HW_RTC_SetAlarmInterval(interval_minutes, interval_meter_record);
+	}
+	Debug_printf("Interval set to %u minutes\r\n", interval_minutes);
+}
@@ -0,0 +1,400 @@
+/*
+   _____             _____                 
+  / ____|           / ____|                
+ | (___   ___ _ __ | (___  _   _ _ __ ___  
+  \___ \ / _ \ '_ \ \___ \| | | | '_ ` _ \ 
+  ____) |  __/ | | |____) | |_| | | | | | |
+ |_____/ \___|_| |_|_____/ \__,_|_| |_| |_|
+                                           
+                                           
+	Description: Link quality estimator and TX power / datarate policy.
+								Keeps the link margin seen on downlinks and LinkCheckAns, and
+								while enabled takes over from ADR: the datarate is raised first,
+								since each step roughly halves the airtime, then TX power is
+								lowered. A missed ACK or LinkCheck restores power at once.
+
+	Maintainer: Shea Gosnell
+
+
+*/
+
+#include <string.h>
+#include "global.h"
+#include "hw.h"
+#include "LoRaMac.h"
+#include "region/Region.h"
+#include "lora.h"
+#include "link_policy.h"
+
+//margin kept for fading and the downlink/uplink asymmetry, the same as network ADR
+#define LINK_POLICY_INSTALL_MARGIN_DB 10
+//demodulation floor change per datarate step is 2.5dB, rounded up
+#define LINK_POLICY_DR_STEP_DB        3
+#define LINK_POLICY_POWER_STEP_DB     2
+//samples needed before the settings are changed
+#define LINK_POLICY_MIN_SAMPLES       3
+//uplinks after a fall back before the settings are optimised again
+#define LINK_POLICY_HOLDOFF           8
+//a LinkCheckReq is added to every this many uplinks, for the uplink margin
+#define LINK_POLICY_CHECK_INTERVAL    16
+
+#if defined( REGION_US915 ) || defined( REGION_US915_HYBRID )
+	//DR0-DR3 are SF10-SF7 at 125kHz, downlinks DR8-DR13 are SF12-SF7 at 500kHz
+	static const uint8_t link_policy_sf[] = { 10, 9, 8, 7, 8, 0, 0, 0, 12, 11, 10, 9, 8, 7, 0, 0 };
+	#define LINK_POLICY_MAX_DR       DR_3
+	#define LINK_POLICY_MIN_TX_POWER TX_POWER_10
+#elif defined( REGION_AU915 )
+	static const uint8_t link_policy_sf[] = { 12, 11, 10, 9, 8, 7, 8, 0, 12, 11, 10, 9, 8, 7, 0, 0 };
+	#define LINK_POLICY_MAX_DR       DR_5
+	#define LINK_POLICY_MIN_TX_POWER TX_POWER_10
+#else
+	static const uint8_t link_policy_sf[] = { 12, 11, 10, 9, 8, 7, 7, 0 };
+	#define LINK_POLICY_MAX_DR       DR_5
+	#define LINK_POLICY_MIN_TX_POWER TX_POWER_7
+#endif
+
+static int8_t   margins[LINK_POLICY_SAMPLES];
+static uint8_t  sample_count = 0;
+static uint8_t  sample_next  = 0;
+static int8_t   last_snr     = 0;
+static int16_t  last_rssi    = 0;
+static uint8_t  last_gateways = 0;
+
+static bool     policy_enabled = false;
+static bool     policy_applied = false;
+//ADR as it was before the policy took over, put back when it hands over
+static bool     saved_adr      = false;
+static int8_t   policy_datarate = DR_0;
+static int8_t   policy_tx_power = TX_POWER_0;
+static uint8_t  holdoff = 0;
+static uint8_t  uplinks_since_check = 0;
+static uint8_t  pending_size = 0;
+
+static uint32_t uplinks        = 0;
+static uint32_t missed         = 0;
+static uint32_t fall_backs     = 0;
+static uint32_t airtime_ms     = 0;
+static uint32_t bytes_delivered = 0;
+
+//SNR at which the given datarate stops demodulating, -7.5dB at SF7 to -20dB at SF12
+static int8_t link_policy_floor_db(uint8_t datarate)
+{
+	uint8_t sf = 12;
+	
+	if(datarate < sizeof(link_policy_sf) && link_policy_sf[datarate] != 0)
+	{
+		sf = link_policy_sf[datarate];
+	}
+	//the half dB is dropped, which rounds towards the stricter end
+	return -(int8_t)((15 + (5 * (sf - 7))) / 2);
+}
+
+static void link_policy_add_margin(int16_t margin_db)
+{
+	if(margin_db >  127) margin_db =  127;
+	if(margin_db < -128) margin_db = -128;
+	
+	margins[sample_next] = (int8_t)margin_db;
+	sample_next = (sample_next + 1) % LINK_POLICY_SAMPLES;
+	if(sample_count < LINK_POLICY_SAMPLES)
+	{
+		sample_count++;
+	}
+}
+
+//after a settings change the stored samples are moved by what the change costs,
+//so the history stays usable without waiting for fresh downlinks
+static void link_policy_shift_margins(int8_t delta_db)
+{
+	uint8_t i;
+	
+	for(i=0;i<sample_count;i++)
+	{
+		int16_t margin = margins[i] + delta_db;
+		margins[i] = (margin > 127) ? 127 : ((margin < -128) ? -128 : margin);
+	}
+}
+
+static void link_policy_clear_margins(void)
+{
+	sample_count = 0;
+	sample_next  = 0;
+}
+
+static int8_t link_policy_best_margin(void)
+{
+	int8_t  best = -128;
+	uint8_t i;
+	
+	for(i=0;i<sample_count;i++)
+	{
+		if(margins[i] > best)
+		{
+			best = margins[i];
+		}
+	}
+	return best;
+}
+
+void link_policy_on_downlink(int8_t snr, int16_t rssi, uint8_t rx_datarate)
+{
+	last_snr  = snr;
+	last_rssi = rssi;
+	link_policy_add_margin(snr - link_policy_floor_db(rx_datarate));
+	
+	dbg_link_policy("Link: SNR %d RSSI %d DR%d, margin %d\r\n", snr, rssi, rx_datarate, snr - link_policy_floor_db(rx_datarate));
+}
+
+static void link_policy_apply(void)
+{
+	MibRequestConfirm_t mibReq;
+	
+	lora_config_tx_datarate_set(policy_datarate);
+	
+	mibReq.Type = MIB_CHANNELS_TX_POWER;
+	mibReq.Param.ChannelsTxPower = policy_tx_power;
+	LoRaMacMibSetRequestConfirm(&mibReq);
+}
+
+//the more robust settings come back in the reverse order they were given up
+static void link_policy_fall_back(void)
+{
+	fall_backs++;
+	holdoff = LINK_POLICY_HOLDOFF;
+	
+	if(policy_tx_power != TX_POWER_0)
+	{
+		//power is recovered in full, it is the quickest way back to a working link
+		link_policy_shift_margins((policy_tx_power - TX_POWER_0) * LINK_POLICY_POWER_STEP_DB);
+		policy_tx_power = TX_POWER_0;
+	}
+	else if(policy_datarate > DR_0)
+	{
+		link_policy_shift_margins(LINK_POLICY_DR_STEP_DB);
+		policy_datarate--;
+	}
+	
+	//a missed frame says the stored margin was wrong, so ask again on the next uplink
+	uplinks_since_check = LINK_POLICY_CHECK_INTERVAL;
+	
+	dbg_link_policy("Link: fall back to DR%d power %d\r\n", policy_datarate, policy_tx_power);
+	
+	if(policy_applied)
+	{
+		link_policy_apply();
+	}
+}
+
+void link_policy_on_link_check(bool answered, uint8_t demod_margin, uint8_t gateways)
+{
+	if(!answered)
+	{
+		missed++;
+		if(policy_enabled)
+		{
+			link_policy_fall_back();
+		}
+		return;
+	}
+	
+	last_gateways = gateways;
+	link_policy_add_margin(demod_margin);
+	dbg_link_policy("Link: check margin %d, %d gateways\r\n", demod_margin, gateways);
+}
+
+void link_policy_on_confirm(bool confirmed, bool ack_received, uint8_t retries, uint32_t time_on_air_ms)
+{
+	//retries are each a full transmission
+	airtime_ms += time_on_air_ms * (retries ? retries : 1);
+	
+	if(confirmed && !ack_received)
+	{
+		missed++;
+		if(policy_enabled)
+		{
+			link_policy_fall_back();
+		}
+		return;
+	}
+	
+	bytes_delivered += pending_size;
+}
+
+//one step per uplink, towards the cheapest settings that keep the install margin
+static void link_policy_step(void)
+{
+	int8_t excess;
+	
+	if(holdoff > 0)
+	{
+		holdoff--;
+		return;
+	}
+	
+	if(sample_count < LINK_POLICY_MIN_SAMPLES)
+	{
+		return;
+	}
+	
+	excess = link_policy_best_margin() - LINK_POLICY_INSTALL_MARGIN_DB;
+	
+	if(excess >= LINK_POLICY_DR_STEP_DB && policy_datarate < LINK_POLICY_MAX_DR)
+	{
+		policy_datarate++;
+		link_policy_shift_margins(-LINK_POLICY_DR_STEP_DB);
+	}
+	else if(excess >= LINK_POLICY_POWER_STEP_DB && policy_tx_power < LINK_POLICY_MIN_TX_POWER)
+	{
+		policy_tx_power++;
+		link_policy_shift_margins(-LINK_POLICY_POWER_STEP_DB);
+	}
+	else if(excess < -LINK_POLICY_DR_STEP_DB)
+	{
+		if(policy_tx_power > TX_POWER_0)
+		{
+			policy_tx_power--;
+			link_policy_shift_margins(LINK_POLICY_POWER_STEP_DB);
+		}
+		else if(policy_datarate > DR_0)
+		{
+			policy_datarate--;
+			link_policy_shift_margins(LINK_POLICY_DR_STEP_DB);
+		}
+	}
+}
+
+void link_policy_before_uplink(uint8_t size)
+{
+	MibRequestConfirm_t mibReq;
+	
+	uplinks++;
+	pending_size = size;
+	
+	if(policy_enabled && !policy_applied)
+	{
+		//start from whatever the network last set
+		mibReq.Type = MIB_CHANNELS_DATARATE;
+		LoRaMacMibGetRequestConfirm(&mibReq);
+		policy_datarate = mibReq.Param.ChannelsDatarate;
+		
+		mibReq.Type = MIB_CHANNELS_TX_POWER;
+		LoRaMacMibGetRequestConfirm(&mibReq);
+		policy_tx_power = mibReq.Param.ChannelsTxPower;
+		
+		mibReq.Type = MIB_ADR;
+		LoRaMacMibGetRequestConfirm(&mibReq);
+		saved_adr = mibReq.Param.AdrEnable;
+		
+		mibReq.Param.AdrEnable = false;
+		LoRaMacMibSetRequestConfirm(&mibReq);
+		policy_applied = true;
+	}
+	else if(!policy_enabled && policy_applied)
+	{
+		//hand the link back, to the network only if ADR was on before
+		mibReq.Type = MIB_ADR;
+		mibReq.Param.AdrEnable = saved_adr;
+		LoRaMacMibSetRequestConfirm(&mibReq);
+		policy_applied = false;
+	}
+	
+	if(!policy_applied)
+	{
+		return;
+	}
+	
+	link_policy_step();
+	link_policy_apply();
+	
+	if(++uplinks_since_check >= LINK_POLICY_CHECK_INTERVAL)
+	{
+		MlmeReq_t mlmeReq;
+		mlmeReq.Type = MLME_LINK_CHECK;
+		LoRaMacMlmeRequest(&mlmeReq);
+		uplinks_since_check = 0;
+	}
+	
+	dbg_link_policy("Link: DR%d power %d\r\n", policy_datarate, policy_tx_power);
+}
+
+void link_policy_enable(bool enable)
+{
+	policy_enabled = enable;
+	holdoff = 0;
+}
+
+bool link_policy_enabled(void)
+{
+	return policy_enabled;
+}
+
+void link_policy_print(void)
+{
+	uint8_t i;
+	
+	Debug_printf("Link policy              :%s\r\n", policy_enabled ? "enabled" : "disabled");
+	await_uart_tx();
+	Debug_printf("Link settings            :DR%d power %d, holdoff %d\r\n", policy_datarate, policy_tx_power, holdoff);
+	await_uart_tx();
+	Debug_printf("Link last downlink       :SNR %ddB RSSI %ddBm, %d gateways\r\n", last_snr, last_rssi, last_gateways);
+	await_uart_tx();
+	Debug_printf("Link margins             :");
+	for(i=0;i<sample_count;i++)
+	{
+		Debug_printf("%d ", margins[(sample_next + LINK_POLICY_SAMPLES - sample_count + i) % LINK_POLICY_SAMPLES]);
+	}
+	Debug_printf("dB, target %ddB\r\n", LINK_POLICY_INSTALL_MARGIN_DB);
+	await_uart_tx();
+	Debug_printf("Link uplinks             :%d, %d missed, %d fall backs\r\n", uplinks, missed, fall_backs);
+	await_uart_tx();
+	Debug_printf("Link airtime per byte    :%dus\r\n", bytes_delivered ? (airtime_ms * 1000) / bytes_delivered : 0);
+	await_uart_tx();
+}
+
+static void cli_link_help(void)
+{
+	Debug_printf("Usage: link show\r\n");
+	await_uart_tx();
+	Debug_printf("\tPrints the link margin history and the policy state\r\n");
+	await_uart_tx();
+	Debug_printf("Usage: link [enable|disable]\r\n");
+	await_uart_tx();
+	Debug_printf("\tLets the device pick TX power and datarate instead of ADR\r\n");
+	await_uart_tx();
+	Debug_printf("Usage: link clear\r\n");
+	await_uart_tx();
+	Debug_printf("\tDiscards the margin history\r\n");
+	await_uart_tx();
+}
+
+void cli_link_implementation(int argc, char *argv[])
+{
+	if(argc == 1)
+	{
+		if(!strcmp(argv[0], "show"))
+		{
+			link_policy_print();
+			return;
+		}
+		if(!strcmp(argv[0], "enable"))
+		{
+			link_policy_enable(true);
+			Debug_printf("Link policy enabled from the next uplink\r\n");
+			return;
+		}
+		if(!strcmp(argv[0], "disable"))
+		{
+			link_policy_enable(false);
+			Debug_printf("Link policy disabled, ADR restored on the next uplink\r\n");
+			return;
+		}
+		if(!strcmp(argv[0], "clear"))
+		{
+			link_policy_clear_margins();
+			Debug_printf("Link margin history cleared\r\n");
+			return;
+		}
+	}
+	
+	cli_link_help();
+}
@@ -55,6 +55,9 @@
 
 #include "debug_uart.h"
 #include "global.h"
+#include "rx_timing.h"
+#include "link_policy.h"
+#include "lora_class_b.h"
 
 #ifndef DISABLE_SEND_DEBUG
 	#define dbg_send(...) Debug_printf(__VA_ARGS__); await_uart_tx()
@@ -158,6 +161,10 @@ static LoRaMainCallback_t *LoRaMainCallbacks;
  */
 static void McpsConfirm( McpsConfirm_t *mcpsConfirm )
 {
+    // Failed frames count too, a confirmed frame without an ACK is a missed frame
+    link_policy_on_confirm( mcpsConfirm->McpsRequest == MCPS_CONFIRMED, mcpsConfirm->AckReceived,
+                            mcpsConfirm->NbRetries, mcpsConfirm->TxTimeOnAir );
+
     if( mcpsConfirm->Status == LORAMAC_EVENT_INFO_STATUS_OK )
     {
         switch( mcpsConfirm->McpsRequest )
@@ -201,6 +208,14 @@ static void McpsIndication( McpsIndication_t *mcpsIndication )
         return;
     }
 
+    // Empty downlinks, such as ACKs, are still timed
+    if( mcpsIndication->RxTimingValid == true )
+    {
+        rx_timing_on_downlink( mcpsIndication->RxTimingOffset );
+    }
+
+    link_policy_on_downlink( ( int8_t )mcpsIndication->Snr, mcpsIndication->Rssi, mcpsIndication->RxDatarate );
+
     switch( mcpsIndication->McpsIndication )
     {
         case MCPS_UNCONFIRMED:
@@ -283,6 +298,8 @@ static void MlmeConfirm( MlmeConfirm_t *mlmeConfirm )
         }
         case MLME_LINK_CHECK:
         {
+            link_policy_on_link_check( mlmeConfirm->Status == LORAMAC_EVENT_INFO_STATUS_OK,
+                                       mlmeConfirm->DemodMargin, mlmeConfirm->NbGateways );
             if( mlmeConfirm->Status == LORAMAC_EVENT_INFO_STATUS_OK )
             {
                 // Check DemodMargin
@@ -363,6 +380,9 @@ void LORA_Init (LoRaMainCallback_t *callbacks, LoRaParam_t* LoRaParam )
     #error "Please define a region in the compiler options."
 #endif
   
+  /*class B reports when it actually switches, once the beacon is locked*/
+  lora_class_b_init( LoRaMainCallbacks->LORA_ConfirmClass );
+  
   mibReq.Type = MIB_ADR;
   mibReq.Param.AdrEnable = LoRaParamInit->AdrEnable;
   LoRaMacMibSetRequestConfirm( &mibReq );
@@ -484,6 +504,9 @@ LoraErrorStatus LORA_send(lora_AppData_t* AppData, LoraConfirm_t IsTxConfirmed)
       return LORA_ERROR;
     }
     
+    // Picks the datarate and TX power while the policy has taken over from ADR
+    link_policy_before_uplink( AppData->BuffSize );
+    
     if( LoRaMacQueryTxPossible( AppData->BuffSize, &txInfo ) != LORAMAC_STATUS_OK )
     {
 			dbg_send("195487ABCDEF lora.c:LORA_send LoRaMacQueryTxPossible failed\r\n");
@@ -522,6 +545,11 @@ LoraErrorStatus LORA_send(lora_AppData_t* AppData, LoraConfirm_t IsTxConfirmed)
 	}
 	#endif
 	
+    // The receive windows are computed when the frame is scheduled
+    rx_timing_before_uplink( );
+    
+    // DeviceTimeReq and PingSlotInfoReq ride on this frame while class B starts
+    lora_class_b_before_uplink( );
 	
     if( LoRaMacMcpsRequest( &mcpsReq ) == LORAMAC_STATUS_OK )
     {
@@ -542,6 +570,13 @@ LoraErrorStatus LORA_RequestClass( DeviceClass_t newClass )
   mibReq.Type = MIB_DEVICE_CLASS;
   LoRaMacMibGetRequestConfirm( &mibReq );
   
+  /*class B tracking stops with any other request, which leaves class A*/
+  if (newClass != CLASS_B)
+  {
+    lora_class_b_stop();
+    LoRaMacMibGetRequestConfirm( &mibReq );
+  }
+  
   currentClass = mibReq.Param.Class;
   /*attempt to swicth only if class update*/
   if (currentClass != newClass)
@@ -583,6 +618,16 @@ LoraErrorStatus LORA_RequestClass( DeviceClass_t newClass )
         }
         break;
       }
+      case CLASS_B:
+      {
+        /*switch is deferred until a beacon is locked and the network has the
+          ping slot periodicity, LORA_ConfirmClass is called then*/
+        if ((currentClass != CLASS_A) || (lora_class_b_start() == false))
+        {
+          Errorstatus = LORA_ERROR;
+        }
+        break;
+      }
       default:
         break;
     } 
@@ -678,6 +723,15 @@ int8_t lora_config_tx_datarate_get(void )
   return lora_config.TxDatarate;
 }
 
+uint8_t lora_max_payload(void)
+{
+  LoRaMacTxInfo_t txInfo;
+  
+  // MaxPossiblePayload is filled in even when the query itself fails
+  LoRaMacQueryTxPossible( 0, &txInfo );
+  return txInfo.MaxPossiblePayload;
+}
+
 LoraState_t lora_config_isack_get(void)
 {
   if (lora_config.McpsConfirm == NULL)
@@ -0,0 +1,861 @@
+/*
+   _____             _____                 
+  / ____|           / ____|                
+ | (___   ___ _ __ | (___  _   _ _ __ ___  
+  \___ \ / _ \ '_ \ \___ \| | | | '_ ` _ \ 
+  ____) |  __/ | | |____) | |_| | | | | | |
+ |_____/ \___|_| |_|_____/ \__,_|_| |_| |_|
+                                           
+                                           
+	Description: LoRaWAN class B (LoRaWAN 1.0.3 chapters 8-15).
+								The beacon is found from a DeviceTimeAns, or by listening for a
+								whole period where the region has a fixed beacon channel, then
+								tracked with the local clock corrected by the measured drift.
+								Ping slots are opened from the tracked beacon, so a downlink
+								waits seconds instead of the next uplink, for a fraction of the
+								current class C draws listening all the time.
+
+	Maintainer: Shea Gosnell
+
+
+*/
+
+#include <string.h>
+#include <stdlib.h>
+#include "global.h"
+#include "hw.h"
+#include "timeServer.h"
+#include "radio.h"
+#include "aes.h"
+#include "LoRaMac.h"
+#include "region/Region.h"
+#include "lora_class_b.h"
+
+//LoRaWAN 1.0.3 chapter 15
+#define CLASS_B_BEACON_PERIOD_S    128
+#define CLASS_B_BEACON_PERIOD_MS   128000
+#define CLASS_B_BEACON_RESERVED_MS 2120
+#define CLASS_B_SLOT_MS            30
+#define CLASS_B_BEACON_PREAMBLE    10
+//the spec keeps ping slots for 120 minutes without a beacon
+#define CLASS_B_MAX_MISSED         56
+//DeviceTimeAns is referenced to our TX done interrupt, trust it this far
+#define CLASS_B_TIME_ERROR_MS      100
+//beacon window either side of the prediction once locked
+#define CLASS_B_BEACON_ERROR_MS    5
+//LSE drift over a beacon period at 30ppm, the windows widen by this per miss
+#define CLASS_B_DRIFT_MS           4
+//measured drift is clamped to 100ppm over a period
+#define CLASS_B_MAX_DRIFT_US       12800
+//symbols the radio needs to find a preamble at the end of a window
+#define CLASS_B_MIN_SYMBOLS        6
+//largest LoRa symbol timeout the SX1276 takes
+#define CLASS_B_MAX_SYMBOLS        1023
+//DeviceTimeReq attempts before listening for a beacon without the time
+#define CLASS_B_TIME_ATTEMPTS      3
+//a search starts after the class A windows of the uplink that started it,
+//and listens for a little more than one period
+#define CLASS_B_SEARCH_DELAY_MS    10000
+#define CLASS_B_SEARCH_MS          (CLASS_B_BEACON_PERIOD_MS + 2000)
+//how long after the window should have ended it is given up as lost
+#define CLASS_B_WATCHDOG_MS        50
+
+//beacon and default ping slot channel per region (LoRaWAN Regional Parameters 1.0.3)
+#if defined( REGION_AS923 )
+	#define CLASS_B_REGION        LORAMAC_REGION_AS923
+	#define CLASS_B_FREQUENCY     923400000
+	#define CLASS_B_DATARATE      DR_3
+	#define CLASS_B_DWELL         1
+#elif defined( REGION_EU868 )
+	#define CLASS_B_REGION        LORAMAC_REGION_EU868
+	#define CLASS_B_FREQUENCY     869525000
+	#define CLASS_B_DATARATE      DR_3
+	#define CLASS_B_DWELL         0
+#elif defined( REGION_KR920 )
+	#define CLASS_B_REGION        LORAMAC_REGION_KR920
+	#define CLASS_B_FREQUENCY     923100000
+	#define CLASS_B_DATARATE      DR_3
+	#define CLASS_B_DWELL         0
+#elif defined( REGION_AU915 )
+	#define CLASS_B_REGION        LORAMAC_REGION_AU915
+	#define CLASS_B_HOPPING
+	#define CLASS_B_DATARATE      DR_8
+	#define CLASS_B_DWELL         0
+#elif defined( REGION_US915 )
+	#define CLASS_B_REGION        LORAMAC_REGION_US915
+	#define CLASS_B_HOPPING
+	#define CLASS_B_DATARATE      DR_8
+	#define CLASS_B_DWELL         0
+#elif defined( REGION_US915_HYBRID )
+	#define CLASS_B_REGION        LORAMAC_REGION_US915_HYBRID
+	#define CLASS_B_HOPPING
+	#define CLASS_B_DATARATE      DR_8
+	#define CLASS_B_DWELL         0
+#endif
+
+#if defined( CLASS_B_HOPPING )
+	//the beacon and ping slots hop over 8 channels, 923.3MHz upwards in 600kHz steps
+	#define CLASS_B_FREQUENCY     0
+	#define CLASS_B_HOP_BASE      923300000
+	#define CLASS_B_HOP_STEP      600000
+	#define CLASS_B_HOP_CHANNELS  8
+	//SF12 BW500, RFU 5 | Time 4 | CRC 2 | GwSpecific 7 | RFU 3 | CRC 2
+	#define CLASS_B_BEACON_SF     12
+	#define CLASS_B_BEACON_BW     2
+	#define CLASS_B_BEACON_RFU    5
+	#define CLASS_B_BEACON_SIZE   23
+#else
+	//SF9 BW125, RFU 2 | Time 4 | CRC 2 | GwSpecific 7 | CRC 2
+	#define CLASS_B_BEACON_SF     9
+	#define CLASS_B_BEACON_BW     0
+	#define CLASS_B_BEACON_RFU    2
+	#define CLASS_B_BEACON_SIZE   17
+#endif
+
+#ifndef CLASS_B_REGION
+	//no beacon plan for this build, lora_class_b_start() refuses
+	#define CLASS_B_FREQUENCY     0
+	#define CLASS_B_DATARATE      DR_3
+	#define CLASS_B_DWELL         0
+#endif
+
+static const char *state_names[] = {"off", "waiting for time", "searching", "acquiring",
+                                    "waiting for ping info", "locked", "active"};
+
+static class_b_state_e state         = class_b_off;
+static void (*class_change)(DeviceClass_t new_class) = NULL;
+static bool            timers_ready  = false;
+static TimerEvent_t    beacon_timer;
+static TimerEvent_t    ping_timer;
+static uint8_t         periodicity   = CLASS_B_DEFAULT_PERIODICITY;
+static uint8_t         time_attempts = 0;
+static bool            class_pending = false;
+static DeviceClass_t   pending_class = CLASS_A;
+
+//0 is the region default, set by BeaconFreqReq and PingSlotChannelReq
+static uint32_t        beacon_frequency = 0;
+static uint32_t        ping_frequency   = 0;
+static int8_t          ping_datarate    = CLASS_B_DATARATE;
+
+//GPS time at a local timestamp, from the last DeviceTimeAns
+static uint64_t        time_gps_ms;
+static uint32_t        time_local_ms;
+
+//the current period, from its beacon or predicted when it was missed
+static uint32_t        period_time_s;
+static uint32_t        period_local_ms;
+//the beacon the next window listens for
+static uint32_t        next_time_s;
+static uint32_t        next_local_ms;
+static bool            beacon_rx_open = false;
+static uint32_t        search_end_ms;
+
+//local ms counted over a period beyond the nominal 128000, in us
+static int32_t         drift_us     = 0;
+static int32_t         drift_rem_us = 0;
+static int32_t         last_residual_ms = 0;
+static uint8_t         missed       = 0;
+
+static RxConfigParams_t ping_rx;
+static uint16_t        ping_offset;
+static uint8_t         ping_next;
+static bool            ping_rx_open = false;
+
+static uint32_t        beacons_received = 0;
+static uint32_t        beacons_missed   = 0;
+static uint32_t        pings_opened     = 0;
+static uint32_t        pings_skipped    = 0;
+
+static void class_b_schedule_beacon(void);
+
+static uint32_t class_b_dev_addr(void)
+{
+	MibRequestConfirm_t mibReq;
+	
+	mibReq.Type = MIB_DEV_ADDR;
+	LoRaMacMibGetRequestConfirm(&mibReq);
+	return mibReq.Param.DevAddr;
+}
+
+static void class_b_set_class(DeviceClass_t new_class)
+{
+	MibRequestConfirm_t mibReq;
+	
+	mibReq.Type = MIB_DEVICE_CLASS;
+	LoRaMacMibGetRequestConfirm(&mibReq);
+	class_pending = false;
+	if(mibReq.Param.Class == new_class)
+	{
+		return;
+	}
+	
+	mibReq.Param.Class = new_class;
+	if(LoRaMacMibSetRequestConfirm(&mibReq) != LORAMAC_STATUS_OK)
+	{
+		//the MAC is mid exchange, tried again before the next uplink
+		class_pending = true;
+		pending_class = new_class;
+		return;
+	}
+	if(class_change != NULL)
+	{
+		class_change(new_class);
+	}
+}
+
+static bool class_b_arm(TimerEvent_t *timer, uint32_t at_ms)
+{
+	int32_t delay = (int32_t)(at_ms - TimerGetCurrentTime());
+	
+	if(delay <= 0)
+	{
+		return false;
+	}
+	TimerSetValue(timer, delay);
+	TimerStart(timer);
+	return true;
+}
+
+//CRC-16/CCITT as the gateway computes it over the beacon, initial value 0
+static uint16_t class_b_crc(const uint8_t *buffer, uint8_t length)
+{
+	uint16_t crc = 0;
+	uint8_t  i;
+	uint8_t  bit;
+	
+	for(i=0;i<length;i++)
+	{
+		crc ^= (uint16_t)buffer[i] << 8;
+		for(bit=0;bit<8;bit++)
+		{
+			crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : (crc << 1);
+		}
+	}
+	return crc;
+}
+
+static uint32_t class_b_beacon_frequency(uint32_t beacon_s)
+{
+	if(beacon_frequency != 0)
+	{
+		return beacon_frequency;
+	}
+#ifdef CLASS_B_HOPPING
+	return CLASS_B_HOP_BASE + ((beacon_s / CLASS_B_BEACON_PERIOD_S) % CLASS_B_HOP_CHANNELS) * CLASS_B_HOP_STEP;
+#else
+	return CLASS_B_FREQUENCY;
+#endif
+}
+
+static uint32_t class_b_ping_frequency(uint32_t beacon_s, uint32_t dev_addr)
+{
+	if(ping_frequency != 0)
+	{
+		return ping_frequency;
+	}
+#ifdef CLASS_B_HOPPING
+	return CLASS_B_HOP_BASE + ((dev_addr + (beacon_s / CLASS_B_BEACON_PERIOD_S)) % CLASS_B_HOP_CHANNELS) * CLASS_B_HOP_STEP;
+#else
+	return CLASS_B_FREQUENCY;
+#endif
+}
+
+//a cold search needs to know where to listen
+static bool class_b_can_search(void)
+{
+	return class_b_beacon_frequency(0) == class_b_beacon_frequency(CLASS_B_BEACON_PERIOD_S);
+}
+
+//the period length the local clock counts, carrying the sub-ms part forward
+static uint32_t class_b_period_ms(void)
+{
+	int32_t total = drift_us + drift_rem_us;
+	int32_t whole = total / 1000;
+	
+	drift_rem_us = total - (whole * 1000);
+	return CLASS_B_BEACON_PERIOD_MS + whole;
+}
+
+//a nominal offset into the period, in local ms
+static uint32_t class_b_correct(uint32_t offset_ms)
+{
+	return offset_ms + (int32_t)(((int64_t)drift_us * offset_ms) / ((int64_t)CLASS_B_BEACON_PERIOD_MS * 1000));
+}
+
+//pingOffset = (Rand[0] + Rand[1]*256) mod pingPeriod, where Rand is
+//AES128(key 0, beacon time | DevAddr | padding), LoRaWAN 1.0.3 chapter 13.2
+static uint16_t class_b_ping_offset(uint32_t beacon_s, uint32_t dev_addr, uint16_t ping_period)
+{
+	static aes_context aes;
+	uint8_t key[16]   = {0};
+	uint8_t block[16] = {0};
+	uint8_t rand[16];
+	
+	block[0] = beacon_s;
+	block[1] = beacon_s >> 8;
+	block[2] = beacon_s >> 16;
+	block[3] = beacon_s >> 24;
+	block[4] = dev_addr;
+	block[5] = dev_addr >> 8;
+	block[6] = dev_addr >> 16;
+	block[7] = dev_addr >> 24;
+	
+	aes_set_key(key, sizeof(key), &aes);
+	aes_encrypt(block, rand, &aes);
+	
+	return (rand[0] + ((uint16_t)rand[1] << 8)) % ping_period;
+}
+
+static void class_b_schedule_ping(void)
+{
+	uint8_t  ping_nb     = 1 << (7 - periodicity);
+	uint16_t ping_period = 1 << (5 + periodicity);
+	
+	while(ping_next < ping_nb)
+	{
+		uint32_t offset_ms = CLASS_B_BEACON_RESERVED_MS + ((ping_offset + (ping_next * ping_period)) * CLASS_B_SLOT_MS);
+		
+		ping_next++;
+		if(class_b_arm(&ping_timer, period_local_ms + class_b_correct(offset_ms) + ping_rx.WindowOffset))
+		{
+			return;
+		}
+		pings_skipped++;
+	}
+}
+
+static void class_b_start_ping_slots(void)
+{
+	uint32_t dev_addr = class_b_dev_addr();
+	
+	TimerStop(&ping_timer);
+	if(state != class_b_active)
+	{
+		return;
+	}
+	
+#ifdef CLASS_B_REGION
+	{
+		MibRequestConfirm_t mibReq;
+		uint8_t  min_rx_symbols;
+		uint32_t rx_error_ms;
+		
+		mibReq.Type = MIB_MIN_RX_SYMBOLS;
+		LoRaMacMibGetRequestConfirm(&mibReq);
+		min_rx_symbols = mibReq.Param.MinRxSymbols;
+		mibReq.Type = MIB_SYSTEM_MAX_RX_ERROR;
+		LoRaMacMibGetRequestConfirm(&mibReq);
+		rx_error_ms = mibReq.Param.SystemMaxRxError + (missed * CLASS_B_DRIFT_MS);
+		
+		RegionComputeRxWindowParameters(CLASS_B_REGION, ping_datarate, min_rx_symbols, rx_error_ms, &ping_rx);
+	}
+#endif
+	ping_rx.Channel           = 0;
+	ping_rx.DrOffset          = 0;
+	ping_rx.Frequency         = class_b_ping_frequency(period_time_s, dev_addr);
+	ping_rx.DownlinkDwellTime = CLASS_B_DWELL;
+	ping_rx.RepeaterSupport   = false;
+	ping_rx.RxContinuous      = false;
+	ping_rx.Window            = 1;
+	
+	ping_offset = class_b_ping_offset(period_time_s, dev_addr, 1 << (5 + periodicity));
+	ping_next   = 0;
+	class_b_schedule_ping();
+}
+
+static void class_b_on_ping_timer(void)
+{
+	if(state == class_b_active)
+	{
+		if(LoRaMacClassBPingSlotRx(&ping_rx))
+		{
+			ping_rx_open = true;
+			pings_opened++;
+		}
+		else
+		{
+			pings_skipped++;
+		}
+	}
+	class_b_schedule_ping();
+}
+
+//drop back to looking for the time, keeping class A until a beacon is found
+static void class_b_restart(void)
+{
+	TimerStop(&beacon_timer);
+	TimerStop(&ping_timer);
+	state         = class_b_wait_time;
+	missed        = 0;
+	drift_us      = 0;
+	drift_rem_us  = 0;
+	class_b_set_class(CLASS_A);
+}
+
+static void class_b_beacon_missed(void)
+{
+	beacons_missed++;
+	
+	if((state == class_b_searching) || (state == class_b_acquiring))
+	{
+		dbg_class_b("Class B: no beacon, asking for the time again\r\n");
+		state = class_b_wait_time;
+		return;
+	}
+	
+	missed++;
+	if(missed >= CLASS_B_MAX_MISSED)
+	{
+		dbg_class_b("Class B: beacon lost\r\n");
+		class_b_restart();
+		return;
+	}
+	
+	//the period goes on from the prediction, with wider windows
+	period_time_s   = next_time_s;
+	period_local_ms = next_local_ms;
+	next_time_s    += CLASS_B_BEACON_PERIOD_S;
+	next_local_ms  += class_b_period_ms();
+	
+	class_b_start_ping_slots();
+	class_b_schedule_beacon();
+}
+
+static void class_b_open_beacon_window(void)
+{
+	uint32_t frequency;
+	uint32_t error_ms;
+	uint32_t listen_ms;
+	uint32_t tsym_us;
+	uint32_t symbols;
+	bool     continuous = (state == class_b_searching);
+	
+	if(!LoRaMacClassBBeaconRx())
+	{
+		dbg_class_b("Class B: radio busy, beacon skipped\r\n");
+		class_b_beacon_missed();
+		return;
+	}
+	
+	if(continuous)
+	{
+		frequency = class_b_beacon_frequency(0);
+		error_ms  = 0;
+	}
+	else
+	{
+		frequency = class_b_beacon_frequency(next_time_s);
+		error_ms  = (state == class_b_acquiring) ? CLASS_B_TIME_ERROR_MS : CLASS_B_BEACON_ERROR_MS + (missed * CLASS_B_DRIFT_MS);
+	}
+	
+	//the window opens error_ms early and has to run to error_ms late
+	tsym_us = ((uint32_t)1000 << CLASS_B_BEACON_SF) / (125 << CLASS_B_BEACON_BW);
+	symbols = ((2 * error_ms * 1000) + tsym_us - 1) / tsym_us + CLASS_B_MIN_SYMBOLS;
+	if(symbols > CLASS_B_MAX_SYMBOLS)
+	{
+		symbols = CLASS_B_MAX_SYMBOLS;
+	}
+	
+	//implicit header without CRC and IQ not inverted, LoRaWAN 1.0.3 chapter 13.1
+	Radio.SetChannel(frequency);
+	Radio.SetRxConfig(MODEM_LORA, CLASS_B_BEACON_BW, CLASS_B_BEACON_SF, 1, 0, CLASS_B_BEACON_PREAMBLE,
+	                  symbols, true, CLASS_B_BEACON_SIZE, false, false, 0, false, continuous);
+	
+	if(continuous)
+	{
+		listen_ms     = CLASS_B_SEARCH_MS;
+		search_end_ms = TimerGetCurrentTime() + listen_ms;
+	}
+	else
+	{
+		listen_ms = (2 * error_ms) + Radio.GetRadioWakeUpTime() + Radio.TimeOnAir(MODEM_LORA, CLASS_B_BEACON_SIZE);
+	}
+	
+	beacon_rx_open = true;
+	Radio.Rx(listen_ms);
+	
+	//a Radio.Sleep from elsewhere ends the window without an event
+	TimerSetValue(&beacon_timer, listen_ms + CLASS_B_WATCHDOG_MS);
+	TimerStart(&beacon_timer);
+}
+
+static void class_b_on_beacon_timer(void)
+{
+	if(beacon_rx_open)
+	{
+		beacon_rx_open = false;
+		Radio.Sleep();
+		class_b_beacon_missed();
+		return;
+	}
+	if((state == class_b_off) || (state == class_b_wait_time))
+	{
+		return;
+	}
+	class_b_open_beacon_window();
+}
+
+static void class_b_schedule_beacon(void)
+{
+	uint32_t error_ms = (state == class_b_acquiring) ? CLASS_B_TIME_ERROR_MS : CLASS_B_BEACON_ERROR_MS + (missed * CLASS_B_DRIFT_MS);
+	
+	if(!class_b_arm(&beacon_timer, next_local_ms - error_ms - Radio.GetRadioWakeUpTime()))
+	{
+		class_b_beacon_missed();
+	}
+}
+
+//the next beacon from the GPS time DeviceTimeAns gave, far enough out to open a window for
+static void class_b_predict_from_time(void)
+{
+	uint32_t now    = TimerGetCurrentTime();
+	uint64_t gps_ms = time_gps_ms + (uint32_t)(now - time_local_ms);
+	uint32_t lead   = CLASS_B_TIME_ERROR_MS + Radio.GetRadioWakeUpTime() + 1;
+	
+	next_time_s   = (uint32_t)(((gps_ms / 1000) / CLASS_B_BEACON_PERIOD_S) + 1) * CLASS_B_BEACON_PERIOD_S;
+	next_local_ms = time_local_ms + (uint32_t)(((uint64_t)next_time_s * 1000) - time_gps_ms);
+	
+	if((int32_t)(next_local_ms - now) < (int32_t)lead)
+	{
+		next_time_s   += CLASS_B_BEACON_PERIOD_S;
+		next_local_ms += CLASS_B_BEACON_PERIOD_MS;
+	}
+}
+
+static void class_b_timers_init(void)
+{
+	if(!timers_ready)
+	{
+		TimerInit(&beacon_timer, class_b_on_beacon_timer);
+		TimerInit(&ping_timer, class_b_on_ping_timer);
+		timers_ready = true;
+	}
+}
+
+void lora_class_b_init(void (*on_class_change)(DeviceClass_t new_class))
+{
+	class_change = on_class_change;
+	class_b_timers_init();
+}
+
+bool lora_class_b_start(void)
+{
+#ifndef CLASS_B_REGION
+	dbg_class_b("Class B: no beacon plan for this region\r\n");
+	return false;
+#else
+	class_b_timers_init();
+	if(state == class_b_off)
+	{
+		dbg_class_b("Class B: starting\r\n");
+		time_attempts = 0;
+		class_b_restart();
+	}
+	return true;
+#endif
+}
+
+void lora_class_b_stop(void)
+{
+	if(state == class_b_off)
+	{
+		return;
+	}
+	
+	TimerStop(&beacon_timer);
+	TimerStop(&ping_timer);
+	if(beacon_rx_open || ping_rx_open)
+	{
+		Radio.Sleep();
+	}
+	beacon_rx_open = false;
+	ping_rx_open   = false;
+	state          = class_b_off;
+	class_b_set_class(CLASS_A);
+	dbg_class_b("Class B: stopped\r\n");
+}
+
+class_b_state_e lora_class_b_state(void)
+{
+	return state;
+}
+
+void lora_class_b_before_uplink(void)
+{
+	MlmeReq_t mlmeReq;
+	
+	if(class_pending)
+	{
+		class_b_set_class(pending_class);
+	}
+	
+	switch(state)
+	{
+		case class_b_wait_time:
+			if((time_attempts >= CLASS_B_TIME_ATTEMPTS) && class_b_can_search())
+			{
+				dbg_class_b("Class B: no time from the network, searching\r\n");
+				time_attempts = 0;
+				state         = class_b_searching;
+				TimerSetValue(&beacon_timer, CLASS_B_SEARCH_DELAY_MS);
+				TimerStart(&beacon_timer);
+				break;
+			}
+			time_attempts++;
+			mlmeReq.Type = MLME_DEVICE_TIME;
+			LoRaMacMlmeRequest(&mlmeReq);
+			break;
+		case class_b_wait_ping_info:
+			mlmeReq.Type = MLME_PING_SLOT_INFO;
+			mlmeReq.Req.PingSlotInfo.Periodicity = periodicity;
+			LoRaMacMlmeRequest(&mlmeReq);
+			break;
+		default:
+			break;
+	}
+}
+
+void lora_class_b_on_beacon(uint8_t *payload, uint16_t size, uint32_t rx_done_ms)
+{
+	uint32_t start_ms;
+	uint32_t beacon_s;
+	uint16_t crc;
+	
+	if(!beacon_rx_open)
+	{
+		Radio.Sleep();
+		return;
+	}
+	
+	crc = payload[CLASS_B_BEACON_RFU + 4] | ((uint16_t)payload[CLASS_B_BEACON_RFU + 5] << 8);
+	if((size != CLASS_B_BEACON_SIZE) || (class_b_crc(payload, CLASS_B_BEACON_RFU + 4) != crc))
+	{
+		//a search keeps listening through other traffic on the channel
+		if((state == class_b_searching) && ((int32_t)(search_end_ms - rx_done_ms) > 0))
+		{
+			return;
+		}
+		beacon_rx_open = false;
+		TimerStop(&beacon_timer);
+		Radio.Sleep();
+		class_b_beacon_missed();
+		return;
+	}
+	
+	beacon_rx_open = false;
+	TimerStop(&beacon_timer);
+	//the time on air uses the beacon settings, so it is taken before the radio sleeps
+	start_ms = rx_done_ms - Radio.TimeOnAir(MODEM_LORA, CLASS_B_BEACON_SIZE);
+	Radio.Sleep();
+	
+	beacon_s = payload[CLASS_B_BEACON_RFU] | ((uint32_t)payload[CLASS_B_BEACON_RFU + 1] << 8) |
+	           ((uint32_t)payload[CLASS_B_BEACON_RFU + 2] << 16) | ((uint32_t)payload[CLASS_B_BEACON_RFU + 3] << 24);
+	beacons_received++;
+	
+	if((state == class_b_searching) || (state == class_b_acquiring) || (beacon_s != next_time_s))
+	{
+		//locked, or relocked after a jump, the drift starts again
+		dbg_class_b("Class B: beacon locked, GPS time %u\r\n", beacon_s);
+		drift_us         = 0;
+		drift_rem_us     = 0;
+		last_residual_ms = 0;
+		if((state == class_b_searching) || (state == class_b_acquiring))
+		{
+			state = class_b_wait_ping_info;
+		}
+	}
+	else
+	{
+		//half of each residual goes into the drift, which is filtered and
+		//bounded so one late beacon can not pull the slots off
+		last_residual_ms = (int32_t)(start_ms - next_local_ms);
+		drift_us        += (last_residual_ms * 1000) / 2;
+		if(drift_us >  CLASS_B_MAX_DRIFT_US) drift_us =  CLASS_B_MAX_DRIFT_US;
+		if(drift_us < -CLASS_B_MAX_DRIFT_US) drift_us = -CLASS_B_MAX_DRIFT_US;
+		dbg_class_b("Class B: beacon %dms off, drift %dus/period\r\n", last_residual_ms, drift_us);
+	}
+	missed = 0;
+	
+	//the network was told the periodicity, the MAC is idle while a beacon is received
+	if(state == class_b_locked)
+	{
+		state = class_b_active;
+		class_b_set_class(CLASS_B);
+	}
+	
+	period_time_s   = beacon_s;
+	period_local_ms = start_ms;
+	next_time_s     = beacon_s + CLASS_B_BEACON_PERIOD_S;
+	next_local_ms   = start_ms + class_b_period_ms();
+	
+	class_b_start_ping_slots();
+	class_b_schedule_beacon();
+}
+
+void lora_class_b_on_rx_timeout(bool beacon)
+{
+	Radio.Sleep();
+	
+	if(!beacon)
+	{
+		ping_rx_open = false;
+		return;
+	}
+	if(beacon_rx_open)
+	{
+		beacon_rx_open = false;
+		TimerStop(&beacon_timer);
+		class_b_beacon_missed();
+	}
+}
+
+void lora_class_b_before_tx(void)
+{
+	if(ping_rx_open)
+	{
+		ping_rx_open = false;
+		if(Radio.GetStatus() == RF_RX_RUNNING)
+		{
+			Radio.Standby();
+		}
+	}
+	if(beacon_rx_open)
+	{
+		beacon_rx_open = false;
+		TimerStop(&beacon_timer);
+		Radio.Standby();
+		class_b_beacon_missed();
+	}
+}
+
+void lora_class_b_on_device_time(uint32_t gps_s, uint8_t fraction, uint32_t tx_done_ms)
+{
+	time_gps_ms   = ((uint64_t)gps_s * 1000) + (((uint32_t)fraction * 1000) / 256);
+	time_local_ms = tx_done_ms;
+	dbg_class_b("Class B: GPS time %u\r\n", gps_s);
+	
+	if(state == class_b_wait_time)
+	{
+		time_attempts = 0;
+		state         = class_b_acquiring;
+		class_b_predict_from_time();
+		class_b_schedule_beacon();
+	}
+}
+
+void lora_class_b_on_ping_slot_info_ans(void)
+{
+	if(state == class_b_wait_ping_info)
+	{
+		dbg_class_b("Class B: ping slots every %ums from the next beacon\r\n", (uint32_t)CLASS_B_SLOT_MS << (5 + periodicity));
+		state = class_b_locked;
+	}
+}
+
+//status bit 0 frequency OK, bit 1 datarate OK, only applied when both are
+uint8_t lora_class_b_ping_slot_channel_req(uint32_t frequency, int8_t datarate)
+{
+	uint8_t status = 0;
+	
+	if((frequency == 0) || Radio.CheckRfFrequency(frequency))
+	{
+		status |= 0x01;
+	}
+#ifdef CLASS_B_REGION
+	{
+		VerifyParams_t verify;
+		
+		verify.DatarateParams.Datarate          = datarate;
+		verify.DatarateParams.DownlinkDwellTime = CLASS_B_DWELL;
+		if(RegionVerify(CLASS_B_REGION, &verify, PHY_RX_DR))
+		{
+			status |= 0x02;
+		}
+	}
+#endif
+	
+	if(status == 0x03)
+	{
+		ping_frequency = frequency;
+		ping_datarate  = (frequency == 0) ? CLASS_B_DATARATE : datarate;
+	}
+	return status;
+}
+
+//status bit 0 frequency OK
+uint8_t lora_class_b_beacon_freq_req(uint32_t frequency)
+{
+	if((frequency != 0) && !Radio.CheckRfFrequency(frequency))
+	{
+		return 0;
+	}
+	beacon_frequency = frequency;
+	return 0x01;
+}
+
+bool lora_class_b_set_periodicity(uint8_t new_periodicity)
+{
+	if(new_periodicity > CLASS_B_MAX_PERIODICITY)
+	{
+		return false;
+	}
+	if(new_periodicity == periodicity)
+	{
+		return true;
+	}
+	
+	periodicity = new_periodicity;
+	//the network has to be told before the slots move, which is done in class A
+	if((state == class_b_locked) || (state == class_b_active))
+	{
+		TimerStop(&ping_timer);
+		state = class_b_wait_ping_info;
+		class_b_set_class(CLASS_A);
+	}
+	return true;
+}
+
+void lora_class_b_print(void)
+{
+	Debug_printf("Class B state            :%s\r\n", state_names[state]);
+	await_uart_tx();
+	Debug_printf("Class B beacons          :%u received, %u missed\r\n", beacons_received, beacons_missed);
+	await_uart_tx();
+	Debug_printf("Class B drift            :%dus/period, last %dms off\r\n", drift_us, last_residual_ms);
+	await_uart_tx();
+	Debug_printf("Class B ping periodicity :%u (every %ums)\r\n", periodicity, (uint32_t)CLASS_B_SLOT_MS << (5 + periodicity));
+	await_uart_tx();
+	Debug_printf("Class B ping slots       :%u opened, %u skipped\r\n", pings_opened, pings_skipped);
+	await_uart_tx();
+}
+
+static void cli_classb_help(void)
+{
+	Debug_printf("Usage: classb show\r\n");
+	await_uart_tx();
+	Debug_printf("\tPrints the beacon tracking and ping slot state\r\n");
+	await_uart_tx();
+	Debug_printf("Usage: classb periodicity <0-7>\r\n");
+	await_uart_tx();
+	Debug_printf("\tA ping slot every 0.96s * 2^periodicity\r\n");
+	await_uart_tx();
+}
+
+void cli_classb_implementation(int argc, char *argv[])
+{
+	if((argc == 1) && !strcmp(argv[0], "show"))
+	{
+		lora_class_b_print();
+		return;
+	}
+	if((argc == 2) && !strcmp(argv[0], "periodicity"))
+	{
+		if(lora_class_b_set_periodicity(atoi(argv[1])))
+		{
+			Debug_printf("Ping slot periodicity %u\r\n", periodicity);
+			return;
+		}
+	}
+	
+	cli_classb_help();
+}
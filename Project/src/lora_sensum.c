@@ -32,6 +32,10 @@
 #include "sensum_version.h"
 #include "timeServer.h"
 #include "radio_common.h"
+#include "link_policy.h"
+#include "lora_class_b.h"
+#include "event_loop.h"
+#include "buffer_arena.h"
 
 #define WATCHDOG_RESET_TIMER_PERIOD 100
 static TimerEvent_t watchdog_reset_timer;
@@ -108,6 +112,7 @@ static void LoraRxData(lora_AppData_t *AppData)
 	if(rx_data_size > 0)
 	{
 		data_received = 1;
+		event_post(event_downlink);
 	}
 	
 	reset_watchdog();
@@ -202,8 +207,10 @@ void lora_sleep()
 	stop_timeout_timer(&lora_sleep_timer);
 	//then put the radio to sleep
 	
-	//do not sleep the radio in CLASS_C
-	if(!device.lora_class_c)
+	//do not sleep the radio in CLASS_C, or while class B has beacon or ping slot
+	//windows on it. Before the device time is known nothing is scheduled yet.
+	class_b_state_e class_b = lora_class_b_state();
+	if(!device.lora_class_c && (class_b == class_b_off || class_b == class_b_wait_time))
 	{
 		Radio.Sleep( );
 	}
@@ -382,7 +389,7 @@ static bool JoinLoRaNetwork()
 		#ifndef DISABLE_LORA_DEBUG
 			Debug_printf("Delaying for %d ms\r\n", random_time);
 		#endif
-		delay_timeout_ms(random_time); 
+		delay_stop_ms(random_time); 
 	}
 	
 	//check if we are joined
@@ -693,7 +700,10 @@ transmit_status_e Lora_Uplink(uint8_t payload[], uint8_t size)
 	reset_watchdog();
 	
 	//two ascii bytes per data byte, plus "1:" and a null terminator
-	char txASCII[(size*2)+3];
+	uint16_t ascii_size = (size*2)+3;
+	arena_mark_t mark = arena_mark();
+	char *txASCII;
+	transmit_status_e status;
 	int i = 0;
 	int pos = 0;
 	
@@ -701,19 +711,29 @@ transmit_status_e Lora_Uplink(uint8_t payload[], uint8_t size)
 	
 	reset_watchdog();
 	
+	//borrowed for this uplink only, at_SendBinary takes the payload buffer above it
+	txASCII = arena_alloc(arena_owner_uplink_ascii, ascii_size);
+	if(txASCII == NULL)
+	{
+		Debug_printf("Uplink too large:%u\r\n", size);
+		return transmit_status_no_send;
+	}
+	
 	//encode as ascii for transmission
-	pos = LoRaFormatTxString(&txASCII[0], sizeof(txASCII), "1:\0");
+	pos = LoRaFormatTxString(&txASCII[0], ascii_size, "1:\0");
 	
 
 	reset_watchdog();
 	for(i=0;i< size;i++)
 	{
-		pos += LoRaFormatTxString(&txASCII[pos], sizeof(txASCII)-pos, "%02X\0", payload[(size-1)-i]);
+		pos += LoRaFormatTxString(&txASCII[pos], ascii_size-pos, "%02X\0", payload[(size-1)-i]);
 		reset_watchdog();
 	}
 	
 	reset_watchdog();
-	return sendData(txASCII);
+	status = sendData(txASCII);
+	arena_release(mark);
+	return status;
 }
 
 void save_lora_config_page(void)
@@ -723,6 +743,7 @@ void save_lora_config_page(void)
 	{
 		config_page.members.join_channel_list[i] = channel_list[i];
 	}
+	config_page.members.link_policy_enabled = link_policy_enabled();
 	
 	save_extra_config_page(config_page.raw_bytes, radio_config_page);
 }
@@ -740,6 +761,9 @@ void load_lora_config_page(void)
 		mask |= channel_list[i];
 	}
 	
+	//an erased page reads 0xFF, which leaves the policy off
+	link_policy_enable(config_page.members.link_policy_enabled == 1);
+	
 	//if we have no channels configured, we enable all channels
 	if(mask == 0)
 	{
@@ -0,0 +1,573 @@
+/*
+   _____             _____                 
+  / ____|           / ____|                
+ | (___   ___ _ __ | (___  _   _ _ __ ___  
+  \___ \ / _ \ '_ \ \___ \| | | | '_ ` _ \ 
+  ____) |  __/ | | |____) | |_| | | | | | |
+ |_____/ \___|_| |_|_____/ \__,_|_| |_| |_|
+                                           
+                                           
+	Description: Barometer mode on an LPS22HB pressure sensor.
+								The sensor runs at 1Hz in low current mode with its FIFO in stream
+								mode, and the watermark on INT_DRDY wakes the MCU for a single I2C
+								burst of the whole FIFO. Each batch mean joins a ring that a least
+								squares line is fitted over for the rate of change, in samples so
+								no clock is needed. Crossing a pressure threshold, or the rate
+								crossing its limit, sends the summary straight away as an alarm,
+								otherwise it waits for the uplink interval. INT_DRDY is wired to
+								the COUNT1 input.
+
+	Maintainer: Shea Gosnell
+
+
+*/
+
+#include <string.h>
+#include <stdlib.h>
+#include "lps22hb_barometer.h"
+#include "LPS22HB_Driver.h"
+#include "sensor_io.h"
+#include "i2c1.h"
+#include "hw.h"
+#include "debug_uart.h"
+#include "flash_map.h"
+#include "radio_common.h"
+#include "uplink_queue.h"
+#include "event_loop.h"
+#include "buffer_arena.h"
+#include "payload_schemas.h"
+#include "stream_stats.h"
+#include "fixed_point.h"
+#include "delays.h"
+
+#ifndef DISABLE_BARO_DEBUG
+	#define baro_printf(...) Debug_printf(__VA_ARGS__)
+#else
+	#define baro_printf(...)
+#endif
+
+//SA0 low, the driver's address is the 8 bit form
+#define BARO_I2C_ADDR        (LPS22HB_ADDRESS >> 1)
+
+#define BARO_INT_PORT        COUNT1_PORT
+#define BARO_INT_PIN         COUNT1_PIN
+
+#define BARO_FIFO_BYTES      (BARO_FIFO_SLOTS * BARO_SLOT_BYTES)
+
+//summary field widths
+#define BARO_PRESSURE_BITS   21 //decipascals, to 2097hPa
+#define BARO_RATE_BITS       12 //Pa/h, signed
+#define BARO_TEMP_BITS       11 //0.1 DegC, signed
+#define BARO_COUNT_BITS      8
+
+STATIC_ASSERT((BARO_FIFO_BYTES <= ARENA_BARO_FIFO_MAX));
+STATIC_ASSERT((BARO_FIFO_BYTES <= SENSOR_IO_MAX_READ));
+
+static sensor_io_t lps22hb = {BARO_I2C_ADDR, 0};
+
+//0 turns a threshold off
+static uint32_t upper_threshold_pa = 0;
+static uint32_t lower_threshold_pa = 0;
+static uint16_t rate_threshold     = BARO_DEFAULT_RATE;
+
+static bool          sensor_running = false;
+static volatile bool fifo_pending   = false;
+
+//batch means and the sample count at the middle of each batch
+static int32_t  trend_pressure[BARO_TREND_POINTS];
+static uint32_t trend_time[BARO_TREND_POINTS];
+static uint8_t  trend_head  = 0;
+static uint8_t  trend_count = 0;
+static uint32_t sample_clock = 0;
+
+static int32_t      pressure_dpa   = 0;
+static int16_t      temperature_dc = 0;
+static int32_t      rate_pa_h      = 0;
+static baro_band_e  band           = baro_band_normal;
+static baro_trend_e trend          = baro_trend_steady;
+
+//since the last scheduled uplink
+static stream_stats_t interval_stats;
+static uint16_t       interval_batches  = 0;
+static uint16_t       interval_failures = 0;
+static bool           interval_overrun  = false;
+
+static int32_t saturate_unsigned(int32_t value, uint8_t bits)
+{
+	int32_t limit = (1L << bits) - 1;
+	
+	return (value < 0) ? 0 : ((value > limit) ? limit : value);
+}
+
+static int32_t saturate_signed(int32_t value, uint8_t bits)
+{
+	int32_t limit = (1L << (bits - 1)) - 1;
+	
+	return (value < -limit) ? -limit : ((value > limit) ? limit : value);
+}
+
+static bool baro_sensor_setup(void)
+{
+	uint8_t who_am_i = 0;
+	bool    ok       = true;
+	
+	if(!i2c1_init())
+	{
+		return false;
+	}
+	if((LPS22HB_Get_DeviceID(&lps22hb, &who_am_i) != LPS22HB_OK) || (who_am_i != LPS22HB_WHO_AM_I_VAL))
+	{
+		return false;
+	}
+	
+	ok &= LPS22HB_SwReset(&lps22hb) == LPS22HB_OK;
+	delay_us(100);
+	
+	ok &= LPS22HB_Set_PowerMode              (&lps22hb, LPS22HB_LowPower        ) == LPS22HB_OK;
+	ok &= LPS22HB_Set_LowPassFilter          (&lps22hb, LPS22HB_ENABLE          ) == LPS22HB_OK;
+	ok &= LPS22HB_Set_LowPassFilterCutoff    (&lps22hb, LPS22HB_ODR_20          ) == LPS22HB_OK;
+	//stream mode keeps the newest samples, the watermark limits it to one batch
+	ok &= LPS22HB_Set_FifoModeUse            (&lps22hb, LPS22HB_ENABLE          ) == LPS22HB_OK;
+	ok &= LPS22HB_Set_FifoWatermarkLevelUse  (&lps22hb, LPS22HB_ENABLE          ) == LPS22HB_OK;
+	ok &= LPS22HB_Set_FifoWatermarkLevel     (&lps22hb, BARO_WATERMARK          ) == LPS22HB_OK;
+	ok &= LPS22HB_Set_FifoMode               (&lps22hb, LPS22HB_FIFO_STREAM_MODE) == LPS22HB_OK;
+	//INT_DRDY is push-pull active high by default
+	ok &= LPS22HB_Set_InterruptControlConfig (&lps22hb, LPS22HB_DATA            ) == LPS22HB_OK;
+	ok &= LPS22HB_Set_FIFO_FTH_Interrupt     (&lps22hb, LPS22HB_ENABLE          ) == LPS22HB_OK;
+	ok &= LPS22HB_Set_Odr                    (&lps22hb, LPS22HB_ODR_1HZ         ) == LPS22HB_OK;
+	
+	return ok;
+}
+
+//the slope of the least squares line through the ring, times and pressures
+//taken from the oldest point so the sums stay small
+static int32_t baro_trend_rate(void)
+{
+	uint8_t oldest = (trend_head + BARO_TREND_POINTS - trend_count) % BARO_TREND_POINTS;
+	int64_t n      = trend_count;
+	int64_t sum_t  = 0;
+	int64_t sum_p  = 0;
+	int64_t sum_tt = 0;
+	int64_t sum_tp = 0;
+	int64_t numerator;
+	int64_t denominator;
+	uint8_t i;
+	
+	for(i=0;i<trend_count;i++)
+	{
+		uint8_t index = (oldest + i) % BARO_TREND_POINTS;
+		int64_t t     = trend_time[index]     - trend_time[oldest];
+		int64_t p     = trend_pressure[index] - trend_pressure[oldest];
+		
+		sum_t  += t;
+		sum_p  += p;
+		sum_tt += t * t;
+		sum_tp += t * p;
+	}
+	
+	numerator   = (n * sum_tp) - (sum_t * sum_p);
+	denominator = (n * sum_tt) - (sum_t * sum_t);
+	if(denominator <= 0)
+	{
+		return 0;
+	}
+	//decipascals a sample to pascals an hour
+	return (int32_t)((numerator * 3600 * BARO_ODR_HZ) / (denominator * 10));
+}
+
+//leaving a trend takes the rate falling back to 3/4 of the limit
+static baro_trend_e baro_classify_trend(int32_t rate)
+{
+	int32_t limit   = rate_threshold;
+	int32_t release = (limit * 3) / 4;
+	
+	if((limit == 0) || (trend_count < BARO_TREND_MIN_POINTS))
+	{
+		return baro_trend_steady;
+	}
+	if((trend == baro_trend_rising ) && (rate >=  release)) return baro_trend_rising;
+	if((trend == baro_trend_falling) && (rate <= -release)) return baro_trend_falling;
+	
+	if(rate >=  limit) return baro_trend_rising;
+	if(rate <= -limit) return baro_trend_falling;
+	return baro_trend_steady;
+}
+
+static baro_band_e baro_classify_band(int32_t pa)
+{
+	int32_t upper = upper_threshold_pa;
+	int32_t lower = lower_threshold_pa;
+	
+	if((upper != 0) && ((pa >= upper) || ((band == baro_band_high) && (pa > (upper - BARO_HYSTERESIS_PA)))))
+	{
+		return baro_band_high;
+	}
+	if((lower != 0) && ((pa <= lower) || ((band == baro_band_low) && (pa < (lower + BARO_HYSTERESIS_PA)))))
+	{
+		return baro_band_low;
+	}
+	return baro_band_normal;
+}
+
+//Averages one FIFO read. Returns why it is worth an uplink now, if it is.
+static baro_reason_e baro_process(const uint8_t slots[], uint8_t count)
+{
+	int32_t       sum_p = 0;
+	int32_t       sum_t = 0;
+	baro_band_e   new_band;
+	baro_trend_e  new_trend;
+	baro_reason_e reason = baro_reason_scheduled;
+	uint8_t       i;
+	
+	for(i=0;i<count;i++)
+	{
+		const uint8_t *slot = &slots[i * BARO_SLOT_BYTES];
+		int32_t raw = (int32_t)(((uint32_t)slot[2] << 24) | ((uint32_t)slot[1] << 16) | ((uint32_t)slot[0] << 8)) >> 8;
+		
+		sum_p += raw;
+		sum_t += (int16_t)(slot[3] | (slot[4] << 8));
+	}
+	
+	//raw is 1/4096 hPa, decipascals are raw * 250/1024
+	pressure_dpa   = (int32_t)((((int64_t)sum_p * 250) + (count * 512)) / (count * 1024));
+	temperature_dc = sum_t / (count * 10);
+	
+	sample_clock += count;
+	trend_pressure[trend_head] = pressure_dpa;
+	trend_time[trend_head]     = sample_clock - (count / 2);
+	trend_head = (trend_head + 1) % BARO_TREND_POINTS;
+	if(trend_count < BARO_TREND_POINTS)
+	{
+		trend_count++;
+	}
+	
+	rate_pa_h = baro_trend_rate();
+	stream_stats_add(&interval_stats, pressure_dpa, sample_clock / BARO_ODR_HZ);
+	interval_batches++;
+	
+	new_band  = baro_classify_band(pressure_dpa / 10);
+	new_trend = baro_classify_trend(rate_pa_h);
+	if(new_band != band)
+	{
+		reason = baro_reason_threshold;
+	}
+	else if(new_trend != trend)
+	{
+		reason = baro_reason_trend;
+	}
+	band  = new_band;
+	trend = new_trend;
+	
+	baro_printf("Baro %d.%03dhPa %dPa/h (%u samples)\r\n", pressure_dpa / 1000, pressure_dpa % 1000, rate_pa_h, count);
+	return reason;
+}
+
+//one burst for everything in the FIFO, the pressure rolls back from TEMP_OUT_H
+//to PRESS_OUT_XL on its own
+static baro_reason_e baro_drain(void)
+{
+	arena_mark_t  mark   = arena_mark();
+	uint8_t      *slots  = arena_alloc(arena_owner_baro_fifo, BARO_FIFO_BYTES);
+	baro_reason_e reason = baro_reason_scheduled;
+	uint8_t       status = 0;
+	uint8_t       count;
+	
+	if((slots == NULL) || !i2c1_init() || Sensor_IO_Read(&lps22hb, LPS22HB_STATUS_FIFO_REG, &status, 1))
+	{
+		interval_failures++;
+		arena_release(mark);
+		return reason;
+	}
+	
+	count = status & LPS22HB_LEVEL_FIFO_MASK;
+	if(status & LPS22HB_OVR_FIFO_MASK)
+	{
+		interval_overrun = true;
+	}
+	if(count > BARO_FIFO_SLOTS)
+	{
+		count = BARO_FIFO_SLOTS;
+	}
+	
+	if(count != 0)
+	{
+		if(Sensor_IO_Read(&lps22hb, LPS22HB_PRESS_OUT_XL_REG, slots, count * BARO_SLOT_BYTES))
+		{
+			interval_failures++;
+		}
+		else
+		{
+			reason = baro_process(slots, count);
+		}
+	}
+	arena_release(mark);
+	return reason;
+}
+
+static void baro_reset_interval(void)
+{
+	stream_stats_reset(&interval_stats, INT32_MAX);
+	interval_batches  = 0;
+	interval_failures = 0;
+	interval_overrun  = false;
+}
+
+static void baro_send(baro_reason_e reason)
+{
+	int32_t values[baro_summary_values] = {0};
+	uint8_t payload[UPLINK_QUEUE_PAYLOAD_SIZE];
+	uint8_t length;
+	bool    have_stats = (interval_stats.count != 0);
+	
+	values[baro_summary_value_reason]      = reason;
+	values[baro_summary_value_band]        = band;
+	values[baro_summary_value_trend]       = trend;
+	values[baro_summary_value_fault]       = !sensor_running || (interval_failures != 0);
+	values[baro_summary_value_overrun]     = interval_overrun;
+	values[baro_summary_value_pressure]    = saturate_unsigned(pressure_dpa, BARO_PRESSURE_BITS);
+	values[baro_summary_value_rate]        = saturate_signed(rate_pa_h, BARO_RATE_BITS);
+	values[baro_summary_value_min]         = have_stats ? interval_stats.min : pressure_dpa;
+	values[baro_summary_value_max]         = have_stats ? interval_stats.max : pressure_dpa;
+	values[baro_summary_value_temperature] = saturate_signed(temperature_dc, BARO_TEMP_BITS);
+	values[baro_summary_value_batches]     = saturate_unsigned(interval_batches, BARO_COUNT_BITS);
+	values[baro_summary_value_voltage]     = fourBit_battery_calculation();
+	values[baro_summary_value_type]        = (reason == baro_reason_scheduled) ? packet_type_summary : packet_type_alarm;
+	
+	length = codec_encode(&baro_summary_schema, values, payload, sizeof(payload));
+	if(length == 0)
+	{
+		return;
+	}
+	
+	if(reason == baro_reason_scheduled)
+	{
+		Uplink(payload, length);
+	}
+	else
+	{
+		Uplink_priority(payload, length, uplink_priority_alarm);
+	}
+}
+
+static void baro_int_irq(void)
+{
+	if(sensor_running)
+	{
+		fifo_pending = true;
+		event_post(event_count);
+	}
+}
+
+void baro_init(void)
+{
+	GPIO_InitTypeDef GPIO_InitStruct;
+	
+	GPIO_InitStruct.Mode  = GPIO_MODE_IT_RISING;
+	GPIO_InitStruct.Pull  = GPIO_NOPULL;
+	GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_LOW;
+	
+	HW_GPIO_Init(BARO_INT_PORT, BARO_INT_PIN, &GPIO_InitStruct);
+	HW_GPIO_SetIrq(BARO_INT_PORT, BARO_INT_PIN, 3, baro_int_irq);
+	
+	trend_head     = 0;
+	trend_count    = 0;
+	sample_clock   = 0;
+	band           = baro_band_normal;
+	trend          = baro_trend_steady;
+	baro_reset_interval();
+	
+	sensor_running = baro_sensor_setup();
+	if(!sensor_running)
+	{
+		Debug_printf("LPS22HB not responding\r\n");
+		return;
+	}
+	baro_printf("Barometer running, a batch every %ds\r\n", BARO_WATERMARK / BARO_ODR_HZ);
+}
+
+test_status_e baro_test(void)
+{
+	uint8_t who_am_i = 0;
+	
+	if(!i2c1_init())
+	{
+		return test_fail;
+	}
+	if((LPS22HB_Get_DeviceID(&lps22hb, &who_am_i) != LPS22HB_OK) || (who_am_i != LPS22HB_WHO_AM_I_VAL))
+	{
+		return test_fail;
+	}
+	return test_pass;
+}
+
+void baro_on_event(void)
+{
+	baro_reason_e reason;
+	
+	if(!fifo_pending)
+	{
+		return;
+	}
+	fifo_pending = false;
+	
+	reason = baro_drain();
+	if(reason != baro_reason_scheduled)
+	{
+		Debug_printf("Barometer %s change, uplinking\r\n", (reason == baro_reason_threshold) ? "threshold" : "trend");
+		baro_send(reason);
+	}
+}
+
+void baro_on_wakeup(void)
+{
+	if(wakeup_count % wakeups_per_uplink == 0)
+	{
+		Debug_printf("Regular Uplink (%d)\r\n", wakeups_per_uplink);
+		baro_uplink();
+	}
+}
+
+//Drains the FIFO first so the summary is current, which also recovers from a
+//watermark edge that was missed. A sensor that was missing is tried again.
+void baro_uplink(void)
+{
+	if(!sensor_running)
+	{
+		sensor_running = baro_sensor_setup();
+	}
+	if(sensor_running)
+	{
+		baro_drain();
+	}
+	
+	baro_send(baro_reason_scheduled);
+	baro_reset_interval();
+}
+
+void baro_save_config(void)
+{
+	baro_config_page_layout_t config = {0};
+	
+	config.members.upper_threshold_pa = upper_threshold_pa;
+	config.members.lower_threshold_pa = lower_threshold_pa;
+	config.members.rate_threshold     = rate_threshold;
+	config.members.magic              = CONFIG_MAGIC_BARO;
+	
+	save_extra_config_page(config.raw_bytes, device_specific_page_1);
+}
+
+void baro_load_config(void)
+{
+	baro_config_page_layout_t config = {0};
+	
+	load_extra_config_page(config.raw_bytes, device_specific_page_1);
+	
+	//0 turns a threshold off, so a page this mode never saved can't be told
+	//apart by its values
+	if(config.members.magic != CONFIG_MAGIC_BARO)
+	{
+		upper_threshold_pa = 0;
+		lower_threshold_pa = 0;
+		rate_threshold     = BARO_DEFAULT_RATE;
+		return;
+	}
+	
+	upper_threshold_pa = config.members.upper_threshold_pa;
+	lower_threshold_pa = config.members.lower_threshold_pa;
+	rate_threshold     = config.members.rate_threshold;
+}
+
+static void baro_print_threshold(const char *name, uint32_t pa)
+{
+	if(pa == 0)
+	{
+		Debug_printf("%s:OFF\r\n", name);
+	}
+	else
+	{
+		Debug_printf("%s:%u.%02uhPa\r\n", name, pa / 100, pa % 100);
+	}
+	await_uart_tx();
+}
+
+static void baro_cli_help(void)
+{
+	Debug_printf("Usage: device show\r\n");
+	Debug_printf("\tShows the barometer settings and the latest batch\r\n");
+	await_uart_tx();
+	Debug_printf("Usage: device [upper|lower] [hPa|off]\r\n");
+	Debug_printf("\tPressure that sends an alarm, %d.%02dhPa hysteresis\r\n", BARO_HYSTERESIS_PA / 100, BARO_HYSTERESIS_PA % 100);
+	await_uart_tx();
+	Debug_printf("Usage: device rate [Pa/h]\r\n");
+	Debug_printf("\tRate of change that sends an alarm, 0 for none\r\n");
+	await_uart_tx();
+}
+
+void baro_cli(int argc, char *argv[])
+{
+	static const char* const band_name[]  = {"NORMAL", "HIGH", "LOW"};
+	static const char* const trend_name[] = {"STEADY", "RISING", "FALLING"};
+	int32_t value;
+	
+	if((argc == 1) && !strcmp(argv[0], "show"))
+	{
+		baro_print_threshold("Upper threshold ", upper_threshold_pa);
+		baro_print_threshold("Lower threshold ", lower_threshold_pa);
+		Debug_printf("Rate threshold  :%uPa/h\r\n", rate_threshold);
+		Debug_printf("Sensor          :%s\r\n", sensor_running ? "RUNNING" : "NOT RESPONDING");
+		await_uart_tx();
+		Debug_printf("Pressure        :%d.%03dhPa\r\n", pressure_dpa / 1000, pressure_dpa % 1000);
+		Debug_printf("Temperature     :%d.%d\r\n", temperature_dc / 10, abs(temperature_dc % 10));
+		Debug_printf("Rate            :%dPa/h over %u batches\r\n", rate_pa_h, trend_count);
+		await_uart_tx();
+		Debug_printf("Band            :%s\r\n", band_name[band]);
+		Debug_printf("Trend           :%s\r\n", trend_name[trend]);
+		Debug_printf("Batches         :%u\r\n", interval_batches);
+		await_uart_tx();
+		return;
+	}
+	
+	if(argc == 2)
+	{
+		if(!strcmp(argv[0], "rate"))
+		{
+			value = atoi(argv[1]);
+			if((value < 0) || (value >= UINT16_MAX))
+			{
+				Debug_printf("Value out of range\r\n");
+				return;
+			}
+			rate_threshold = value;
+			Debug_printf("Rate threshold set to %uPa/h\r\n", rate_threshold);
+			return;
+		}
+		
+		if(!strcmp(argv[0], "upper") || !strcmp(argv[0], "lower"))
+		{
+			//hPa to 0.01, which is Pa
+			if(!strcmp(argv[1], "off"))
+			{
+				value = 0;
+			}
+			else if(!fxp_parse_scaled(argv[1], 100, &value) || (value <= 0) || (value > 200000))
+			{
+				Debug_printf("Invalid value\r\n");
+				return;
+			}
+			
+			if(argv[0][0] == 'u')
+			{
+				upper_threshold_pa = value;
+				baro_print_threshold("Upper threshold ", upper_threshold_pa);
+			}
+			else
+			{
+				lower_threshold_pa = value;
+				baro_print_threshold("Lower threshold ", lower_threshold_pa);
+			}
+			return;
+		}
+	}
+	
+	baro_cli_help();
+}
@@ -0,0 +1,533 @@
+/*
+   _____             _____                 
+  / ____|           / ____|                
+ | (___   ___ _ __ | (___  _   _ _ __ ___  
+  \___ \ / _ \ '_ \ \___ \| | | | '_ ` _ \ 
+  ____) |  __/ | | |____) | |_| | | | | | |
+ |_____/ \___|_| |_|_____/ \__,_|_| |_| |_|
+                                           
+                                           
+	Description: Tamper mode on an LSM303AGR accelerometer.
+								The accelerometer runs at 25Hz in low power mode with both of its
+								interrupt generators in hardware. INT1 is 6D movement, it latches
+								when the face pointing up changes and has held for a while, and
+								INT2 is free-fall, all three axes low together. The MCU sleeps
+								until one of the lines rises, reads the latched source register,
+								which is also what clears it, and sends an alarm. Nothing else is
+								read from the sensor, the heartbeat reports the orientation from
+								the last interrupt. INT1 is wired to the COUNT1 input and INT2 to
+								COUNT2, the wired tamper input is not used.
+
+	Maintainer: Shea Gosnell
+
+
+*/
+
+#include <string.h>
+#include <stdlib.h>
+#include "lsm303agr_tamper.h"
+#include "LSM303AGR_ACC_driver.h"
+#include "sensor_io.h"
+#include "i2c1.h"
+#include "hw.h"
+#include "debug_uart.h"
+#include "flash_map.h"
+#include "radio_common.h"
+#include "uplink_queue.h"
+#include "event_loop.h"
+#include "payload_schemas.h"
+#include "delays.h"
+
+#ifndef DISABLE_TAMPER_DEBUG
+	#define tamper_printf(...) Debug_printf(__VA_ARGS__)
+#else
+	#define tamper_printf(...)
+#endif
+
+//the driver's address is the 8 bit form, the top bit of the register
+//address asks for auto increment
+#define TAMPER_I2C_ADDR        (LSM303AGR_ACC_I2C_ADDRESS >> 1)
+#define TAMPER_AUTO_INCREMENT  0x80
+
+#define TAMPER_INT1_PORT       COUNT1_PORT
+#define TAMPER_INT1_PIN        COUNT1_PIN
+#define TAMPER_INT2_PORT       COUNT2_PORT
+#define TAMPER_INT2_PIN        COUNT2_PIN
+
+//samples a new orientation has to hold for, so a knock is not a move
+#define TAMPER_ORIENTATION_HOLD 10
+//the threshold and duration registers are 7 bits
+#define TAMPER_REGISTER_MAX     127
+
+#define TAMPER_INT_XL          0x01
+#define TAMPER_INT_XH          0x02
+#define TAMPER_INT_YL          0x04
+#define TAMPER_INT_YH          0x08
+#define TAMPER_INT_ZL          0x10
+#define TAMPER_INT_ZH          0x20
+#define TAMPER_INT_IA          0x40
+
+//report field widths
+#define TAMPER_CHANGES_BITS    7
+#define TAMPER_FREEFALLS_BITS  8
+
+static sensor_io_t lsm303agr = {TAMPER_I2C_ADDR, TAMPER_AUTO_INCREMENT};
+
+static uint16_t orientation_threshold_mg = TAMPER_DEFAULT_ORIENTATION_MG;
+static uint16_t freefall_threshold_mg    = TAMPER_DEFAULT_FREEFALL_MG;
+static uint16_t freefall_duration_ms     = TAMPER_DEFAULT_FREEFALL_MS;
+static uint8_t  heartbeat_intervals      = TAMPER_DEFAULT_HEARTBEAT;
+
+static bool          sensor_running      = false;
+static volatile bool orientation_pending = false;
+static volatile bool freefall_pending    = false;
+
+static tamper_orientation_e orientation          = tamper_orientation_unknown;
+static tamper_orientation_e previous_orientation = tamper_orientation_unknown;
+
+//since the last heartbeat
+static uint16_t orientation_changes = 0;
+static uint16_t freefalls           = 0;
+static uint16_t read_failures       = 0;
+static uint8_t  intervals_since_heartbeat = 0;
+
+static uint8_t saturate_count(uint16_t value, uint8_t bits)
+{
+	uint16_t limit = (1U << bits) - 1;
+	
+	return (value > limit) ? limit : value;
+}
+
+static uint8_t tamper_register_value(uint16_t value, uint16_t step)
+{
+	uint16_t steps = (value + (step / 2)) / step;
+	
+	return (steps > TAMPER_REGISTER_MAX) ? TAMPER_REGISTER_MAX : steps;
+}
+
+//the axis bits latched in INT1_SOURCE by a 6D movement
+static tamper_orientation_e tamper_orientation_from_source(uint8_t source)
+{
+	if(source & TAMPER_INT_ZH) return tamper_orientation_z_up;
+	if(source & TAMPER_INT_ZL) return tamper_orientation_z_down;
+	if(source & TAMPER_INT_YH) return tamper_orientation_y_up;
+	if(source & TAMPER_INT_YL) return tamper_orientation_y_down;
+	if(source & TAMPER_INT_XH) return tamper_orientation_x_up;
+	if(source & TAMPER_INT_XL) return tamper_orientation_x_down;
+	return tamper_orientation_unknown;
+}
+
+//Only at setup, the 6D generator has nothing to compare the first position
+//with. Low power data is 8 bits, left justified.
+static tamper_orientation_e tamper_read_orientation(void)
+{
+	uint8_t raw[6];
+	int16_t mg[3];
+	uint8_t axis    = 0;
+	uint8_t largest = 0;
+	uint8_t i;
+	
+	if(Sensor_IO_Read(&lsm303agr, LSM303AGR_ACC_OUT_X_L, raw, sizeof(raw)))
+	{
+		read_failures++;
+		return tamper_orientation_unknown;
+	}
+	
+	for(i=0;i<3;i++)
+	{
+		mg[i] = (int8_t)raw[(i * 2) + 1] * TAMPER_THS_STEP_MG;
+		if(abs(mg[i]) > abs(mg[largest]))
+		{
+			largest = i;
+		}
+	}
+	if(abs(mg[largest]) < orientation_threshold_mg)
+	{
+		return tamper_orientation_unknown;
+	}
+	
+	axis = (largest == 0) ? tamper_orientation_x_up : ((largest == 1) ? tamper_orientation_y_up : tamper_orientation_z_up);
+	return (mg[largest] > 0) ? (tamper_orientation_e)axis : (tamper_orientation_e)(axis + 1);
+}
+
+static bool tamper_sensor_setup(void)
+{
+	uint8_t who_am_i = 0;
+	uint8_t source;
+	uint8_t cfg;
+	bool    ok       = true;
+	
+	if(!i2c1_init())
+	{
+		return false;
+	}
+	if(!LSM303AGR_ACC_R_WHO_AM_I(&lsm303agr, &who_am_i) || (who_am_i != LSM303AGR_ACC_WHO_AM_I))
+	{
+		return false;
+	}
+	
+	ok &= LSM303AGR_ACC_W_ODR              (&lsm303agr, LSM303AGR_ACC_ODR_DO_PWR_DOWN ) == MEMS_SUCCESS;
+	ok &= LSM303AGR_ACC_W_LOWPWR_EN        (&lsm303agr, LSM303AGR_ACC_LPEN_ENABLED    ) == MEMS_SUCCESS;
+	ok &= LSM303AGR_ACC_W_HiRes            (&lsm303agr, LSM303AGR_ACC_HR_DISABLED     ) == MEMS_SUCCESS;
+	ok &= LSM303AGR_ACC_W_FullScale        (&lsm303agr, LSM303AGR_ACC_FS_2G           ) == MEMS_SUCCESS;
+	
+	//6D movement on INT1, an OR of all six directions with the 6D bit set
+	cfg = LSM303AGR_ACC_AOI_OR | LSM303AGR_ACC_6D_ENABLED |
+	      LSM303AGR_ACC_XLIE_ENABLED | LSM303AGR_ACC_XHIE_ENABLED |
+	      LSM303AGR_ACC_YLIE_ENABLED | LSM303AGR_ACC_YHIE_ENABLED |
+	      LSM303AGR_ACC_ZLIE_ENABLED | LSM303AGR_ACC_ZHIE_ENABLED;
+	ok &= LSM303AGR_ACC_WriteReg(&lsm303agr, LSM303AGR_ACC_INT1_CFG, &cfg, 1) == MEMS_SUCCESS;
+	ok &= LSM303AGR_ACC_W_Int1_Threshold   (&lsm303agr, tamper_register_value(orientation_threshold_mg, TAMPER_THS_STEP_MG)) == MEMS_SUCCESS;
+	ok &= LSM303AGR_ACC_W_Int1_Duration    (&lsm303agr, TAMPER_ORIENTATION_HOLD        ) == MEMS_SUCCESS;
+	
+	//free-fall on INT2, an AND of the three low events
+	cfg = LSM303AGR_ACC_AOI_AND |
+	      LSM303AGR_ACC_XLIE_ENABLED | LSM303AGR_ACC_YLIE_ENABLED | LSM303AGR_ACC_ZLIE_ENABLED;
+	ok &= LSM303AGR_ACC_WriteReg(&lsm303agr, LSM303AGR_ACC_INT2_CFG, &cfg, 1) == MEMS_SUCCESS;
+	ok &= LSM303AGR_ACC_W_Int2_Threshold   (&lsm303agr, tamper_register_value(freefall_threshold_mg, TAMPER_THS_STEP_MG)) == MEMS_SUCCESS;
+	ok &= LSM303AGR_ACC_W_Int2_Duration    (&lsm303agr, tamper_register_value(freefall_duration_ms, 1000 / TAMPER_ODR_HZ)) == MEMS_SUCCESS;
+	
+	//latched, so a line stays high until the handler reads its source
+	ok &= LSM303AGR_ACC_W_LatchInterrupt_on_INT1(&lsm303agr, LSM303AGR_ACC_LIR_INT1_ENABLED) == MEMS_SUCCESS;
+	ok &= LSM303AGR_ACC_W_LatchInterrupt_on_INT2(&lsm303agr, LSM303AGR_ACC_LIR_INT2_ENABLED) == MEMS_SUCCESS;
+	ok &= LSM303AGR_ACC_W_FIFO_AOL1_on_INT1     (&lsm303agr, LSM303AGR_ACC_I1_AOI1_ENABLED ) == MEMS_SUCCESS;
+	ok &= LSM303AGR_ACC_W_I2_on_INT2            (&lsm303agr, LSM303AGR_ACC_I2_INT2_ENABLED ) == MEMS_SUCCESS;
+	
+	ok &= LSM303AGR_ACC_W_ODR              (&lsm303agr, LSM303AGR_ACC_ODR_DO_25Hz     ) == MEMS_SUCCESS;
+	if(!ok)
+	{
+		return false;
+	}
+	
+	//a couple of samples in, then clear anything latched while it started
+	delay_timeout_ms(2 * (1000 / TAMPER_ODR_HZ));
+	ok &= LSM303AGR_ACC_ReadReg(&lsm303agr, LSM303AGR_ACC_INT1_SOURCE, &source, 1) == MEMS_SUCCESS;
+	ok &= LSM303AGR_ACC_ReadReg(&lsm303agr, LSM303AGR_ACC_INT2_SOURCE, &source, 1) == MEMS_SUCCESS;
+	orientation = tamper_read_orientation();
+	
+	return ok;
+}
+
+static void tamper_reset_counts(void)
+{
+	orientation_changes       = 0;
+	freefalls                 = 0;
+	read_failures             = 0;
+	intervals_since_heartbeat = 0;
+}
+
+//any report shows the device is alive, so it restarts the heartbeat count
+static void tamper_send(tamper_reason_e reason)
+{
+	int32_t values[tamper_report_values] = {0};
+	uint8_t payload[UPLINK_QUEUE_PAYLOAD_SIZE];
+	uint8_t length;
+	
+	values[tamper_report_value_reason]      = reason;
+	values[tamper_report_value_orientation] = orientation;
+	values[tamper_report_value_previous]    = previous_orientation;
+	values[tamper_report_value_fault]       = !sensor_running || (read_failures != 0);
+	values[tamper_report_value_changes]     = saturate_count(orientation_changes, TAMPER_CHANGES_BITS);
+	values[tamper_report_value_freefalls]   = saturate_count(freefalls, TAMPER_FREEFALLS_BITS);
+	values[tamper_report_value_voltage]     = fourBit_battery_calculation();
+	values[tamper_report_value_type]        = (reason == tamper_reason_heartbeat) ? packet_type_summary : packet_type_alarm;
+	
+	length = codec_encode(&tamper_report_schema, values, payload, sizeof(payload));
+	if(length == 0)
+	{
+		return;
+	}
+	
+	if(reason == tamper_reason_heartbeat)
+	{
+		Uplink(payload, length);
+	}
+	else
+	{
+		Uplink_priority(payload, length, uplink_priority_alarm);
+	}
+	intervals_since_heartbeat = 0;
+}
+
+static void tamper_int1_irq(void)
+{
+	if(sensor_running)
+	{
+		orientation_pending = true;
+		event_post(event_count);
+	}
+}
+
+static void tamper_int2_irq(void)
+{
+	if(sensor_running)
+	{
+		freefall_pending = true;
+		event_post(event_count);
+	}
+}
+
+static void tamper_int_init(GPIO_TypeDef *port, uint16_t pin, GpioIrqHandler *irq)
+{
+	GPIO_InitTypeDef GPIO_InitStruct;
+	
+	GPIO_InitStruct.Mode  = GPIO_MODE_IT_RISING;
+	GPIO_InitStruct.Pull  = GPIO_NOPULL;
+	GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_LOW;
+	
+	HW_GPIO_Init(port, pin, &GPIO_InitStruct);
+	HW_GPIO_SetIrq(port, pin, 3, irq);
+}
+
+void accel_tamper_init(void)
+{
+	tamper_int_init(TAMPER_INT1_PORT, TAMPER_INT1_PIN, tamper_int1_irq);
+	tamper_int_init(TAMPER_INT2_PORT, TAMPER_INT2_PIN, tamper_int2_irq);
+	
+	orientation          = tamper_orientation_unknown;
+	previous_orientation = tamper_orientation_unknown;
+	tamper_reset_counts();
+	
+	sensor_running = tamper_sensor_setup();
+	if(!sensor_running)
+	{
+		Debug_printf("LSM303AGR not responding\r\n");
+		return;
+	}
+	tamper_printf("Tamper running, orientation %d\r\n", orientation);
+}
+
+test_status_e accel_tamper_test(void)
+{
+	uint8_t who_am_i = 0;
+	
+	if(!i2c1_init())
+	{
+		return test_fail;
+	}
+	if(!LSM303AGR_ACC_R_WHO_AM_I(&lsm303agr, &who_am_i) || (who_am_i != LSM303AGR_ACC_WHO_AM_I))
+	{
+		return test_fail;
+	}
+	return test_pass;
+}
+
+//Both lines are handled in one wake so a drop that lands on a new face is a
+//single alarm. Reading a source register is what releases its latch.
+void accel_tamper_on_event(void)
+{
+	tamper_reason_e reason = tamper_reason_heartbeat;
+	uint8_t         source = 0;
+	
+	if(!orientation_pending && !freefall_pending)
+	{
+		return;
+	}
+	if(!i2c1_init())
+	{
+		read_failures++;
+		return;
+	}
+	
+	if(freefall_pending)
+	{
+		freefall_pending = false;
+		if(LSM303AGR_ACC_ReadReg(&lsm303agr, LSM303AGR_ACC_INT2_SOURCE, &source, 1) != MEMS_SUCCESS)
+		{
+			read_failures++;
+		}
+		else if(source & TAMPER_INT_IA)
+		{
+			freefalls++;
+			reason = tamper_reason_freefall;
+		}
+	}
+	
+	if(orientation_pending)
+	{
+		orientation_pending = false;
+		if(LSM303AGR_ACC_ReadReg(&lsm303agr, LSM303AGR_ACC_INT1_SOURCE, &source, 1) != MEMS_SUCCESS)
+		{
+			read_failures++;
+		}
+		else if(source & TAMPER_INT_IA)
+		{
+			tamper_orientation_e now = tamper_orientation_from_source(source);
+			
+			if((now != tamper_orientation_unknown) && (now != orientation))
+			{
+				previous_orientation = orientation;
+				orientation          = now;
+				orientation_changes++;
+				if(reason == tamper_reason_heartbeat)
+				{
+					reason = tamper_reason_orientation;
+				}
+			}
+		}
+	}
+	
+	if(reason != tamper_reason_heartbeat)
+	{
+		Debug_printf("Tamper %s, uplinking\r\n", (reason == tamper_reason_freefall) ? "free-fall" : "orientation change");
+		tamper_send(reason);
+	}
+}
+
+//A line that is already high when its edge was missed would never rise again,
+//the pin level is checked here rather than anything on the sensor.
+void accel_tamper_on_wakeup(void)
+{
+	if(sensor_running)
+	{
+		if(HW_GPIO_Read(TAMPER_INT1_PORT, TAMPER_INT1_PIN)) orientation_pending = true;
+		if(HW_GPIO_Read(TAMPER_INT2_PORT, TAMPER_INT2_PIN)) freefall_pending    = true;
+		accel_tamper_on_event();
+	}
+	
+	if(wakeup_count % wakeups_per_uplink == 0)
+	{
+		intervals_since_heartbeat++;
+		if(intervals_since_heartbeat >= heartbeat_intervals)
+		{
+			Debug_printf("Heartbeat Uplink (%d intervals)\r\n", heartbeat_intervals);
+			accel_tamper_uplink();
+		}
+	}
+}
+
+//The heartbeat. A sensor that was missing is tried again.
+void accel_tamper_uplink(void)
+{
+	if(!sensor_running)
+	{
+		sensor_running = tamper_sensor_setup();
+	}
+	
+	tamper_send(tamper_reason_heartbeat);
+	tamper_reset_counts();
+}
+
+void accel_tamper_save_config(void)
+{
+	tamper_config_page_layout_t config = {0};
+	
+	config.members.orientation_threshold_mg = orientation_threshold_mg;
+	config.members.freefall_threshold_mg    = freefall_threshold_mg;
+	config.members.freefall_duration_ms     = freefall_duration_ms;
+	config.members.heartbeat_intervals      = heartbeat_intervals;
+	
+	save_extra_config_page(config.raw_bytes, device_specific_page_1);
+}
+
+void accel_tamper_load_config(void)
+{
+	tamper_config_page_layout_t config = {0};
+	
+	load_extra_config_page(config.raw_bytes, device_specific_page_1);
+	orientation_threshold_mg = config.members.orientation_threshold_mg;
+	freefall_threshold_mg    = config.members.freefall_threshold_mg;
+	freefall_duration_ms     = config.members.freefall_duration_ms;
+	heartbeat_intervals      = config.members.heartbeat_intervals;
+	
+	//a new page reads back as zeros after flash_erase_all(), an erased chip as all
+	//ones, neither is a setting the CLI allows
+	if((orientation_threshold_mg == 0xFFFF) || (orientation_threshold_mg == 0)) orientation_threshold_mg = TAMPER_DEFAULT_ORIENTATION_MG;
+	if((freefall_threshold_mg    == 0xFFFF) || (freefall_threshold_mg    == 0)) freefall_threshold_mg    = TAMPER_DEFAULT_FREEFALL_MG;
+	if((freefall_duration_ms     == 0xFFFF) || (freefall_duration_ms     == 0)) freefall_duration_ms     = TAMPER_DEFAULT_FREEFALL_MS;
+	if((heartbeat_intervals == 0xFF) || (heartbeat_intervals == 0)) heartbeat_intervals = TAMPER_DEFAULT_HEARTBEAT;
+}
+
+static void tamper_cli_help(void)
+{
+	Debug_printf("Usage: device show\r\n");
+	Debug_printf("\tShows the tamper settings and the last orientation\r\n");
+	await_uart_tx();
+	Debug_printf("Usage: device orientation [mg]\r\n");
+	Debug_printf("\tAcceleration on an axis for it to be the one facing up\r\n");
+	await_uart_tx();
+	Debug_printf("Usage: device freefall [mg] [ms]\r\n");
+	Debug_printf("\tAll axes below mg for at least ms is a free-fall\r\n");
+	await_uart_tx();
+	Debug_printf("Usage: device heartbeat [intervals]\r\n");
+	Debug_printf("\tUplink intervals between heartbeats\r\n");
+	await_uart_tx();
+}
+
+//the sensor holds the thresholds, so a change is written to it straight away
+static void tamper_apply(void)
+{
+	sensor_running = tamper_sensor_setup();
+	if(!sensor_running)
+	{
+		Debug_printf("LSM303AGR not responding\r\n");
+	}
+}
+
+void accel_tamper_cli(int argc, char *argv[])
+{
+	static const char* const orientation_name[] = {"UNKNOWN", "X UP", "X DOWN", "Y UP", "Y DOWN", "Z UP", "Z DOWN"};
+	uint16_t max_mg = TAMPER_REGISTER_MAX * TAMPER_THS_STEP_MG;
+	uint16_t max_ms = TAMPER_REGISTER_MAX * (1000 / TAMPER_ODR_HZ);
+	int32_t  value;
+	int32_t  duration;
+	
+	if((argc == 1) && !strcmp(argv[0], "show"))
+	{
+		Debug_printf("Orientation     :%umg\r\n", orientation_threshold_mg);
+		Debug_printf("Free-fall       :%umg for %ums\r\n", freefall_threshold_mg, freefall_duration_ms);
+		Debug_printf("Heartbeat       :%u intervals\r\n", heartbeat_intervals);
+		await_uart_tx();
+		Debug_printf("Sensor          :%s\r\n", sensor_running ? "RUNNING" : "NOT RESPONDING");
+		Debug_printf("Facing          :%s (was %s)\r\n", orientation_name[orientation], orientation_name[previous_orientation]);
+		Debug_printf("Changes         :%u\r\n", orientation_changes);
+		Debug_printf("Free-falls      :%u\r\n", freefalls);
+		await_uart_tx();
+		return;
+	}
+	
+	if((argc == 2) && !strcmp(argv[0], "orientation"))
+	{
+		value = atoi(argv[1]);
+		if((value < TAMPER_THS_STEP_MG) || (value > max_mg))
+		{
+			Debug_printf("Value out of range (%u-%umg)\r\n", TAMPER_THS_STEP_MG, max_mg);
+			return;
+		}
+		orientation_threshold_mg = value;
+		Debug_printf("Orientation threshold set to %umg\r\n", orientation_threshold_mg);
+		tamper_apply();
+		return;
+	}
+	
+	if((argc == 3) && !strcmp(argv[0], "freefall"))
+	{
+		value    = atoi(argv[1]);
+		duration = atoi(argv[2]);
+		if((value < TAMPER_THS_STEP_MG) || (value > max_mg) || (duration < 1) || (duration > max_ms))
+		{
+			Debug_printf("Value out of range (%u-%umg, 1-%ums)\r\n", TAMPER_THS_STEP_MG, max_mg, max_ms);
+			return;
+		}
+		freefall_threshold_mg = value;
+		freefall_duration_ms  = duration;
+		Debug_printf("Free-fall set to %umg for %ums\r\n", freefall_threshold_mg, freefall_duration_ms);
+		tamper_apply();
+		return;
+	}
+	
+	if((argc == 2) && !strcmp(argv[0], "heartbeat"))
+	{
+		value = atoi(argv[1]);
+		if((value < 1) || (value > UINT8_MAX - 1))
+		{
+			Debug_printf("Value out of range\r\n");
+			return;
+		}
+		heartbeat_intervals = value;
+		Debug_printf("Heartbeat every %u intervals\r\n", heartbeat_intervals);
+		return;
+	}
+	
+	tamper_cli_help();
+}
@@ -0,0 +1,672 @@
+/*
+   _____             _____                 
+  / ____|           / ____|                
+ | (___   ___ _ __ | (___  _   _ _ __ ___  
+  \___ \ / _ \ '_ \ \___ \| | | | '_ ` _ \ 
+  ____) |  __/ | | |____) | |_| | | | | | |
+ |_____/ \___|_| |_|_____/ \__,_|_| |_| |_|
+                                           
+                                           
+	Description: Vibration mode on an LSM6DSL accelerometer.
+								Between events the part watches for motion on its own at 26Hz in
+								low power and the MCU stays in STOP. A wake-up on INT1 switches it
+								to 416Hz with the FIFO filling to a watermark, and the watermark on
+								INT2 has the batch read in I2C bursts into the buffer arena. Each
+								batch is reduced to an RMS, peak and dominant frequency per axis,
+								and the interval keeps the strongest, sent as one summary frame.
+								INT1 and INT2 are wired to the COUNT1 and COUNT2 inputs.
+
+	Maintainer: Shea Gosnell
+
+
+*/
+
+#include <string.h>
+#include <stdlib.h>
+#include "lsm6dsl_vibration.h"
+#include "LSM6DSL_ACC_GYRO_driver.h"
+#include "sensor_io.h"
+#include "i2c1.h"
+#include "hw.h"
+#include "debug_uart.h"
+#include "flash_map.h"
+#include "radio_common.h"
+#include "uplink_queue.h"
+#include "event_loop.h"
+#include "buffer_arena.h"
+#include "payload_schemas.h"
+#include "delays.h"
+
+#ifndef DISABLE_VIBRATION_DEBUG
+	#define vib_printf(...) Debug_printf(__VA_ARGS__)
+#else
+	#define vib_printf(...)
+#endif
+
+//SA0 low, the driver's address is the 8 bit form
+#define VIBRATION_I2C_ADDR     (LSM6DSL_ACC_GYRO_I2C_ADDRESS_LOW >> 1)
+#define VIBRATION_WHO_AM_I     0x6A
+
+#define VIBRATION_INT1_PORT    COUNT1_PORT
+#define VIBRATION_INT1_PIN     COUNT1_PIN
+#define VIBRATION_INT2_PORT    COUNT2_PORT
+#define VIBRATION_INT2_PIN     COUNT2_PIN
+
+//+-4g, 0.122mg a count, and the wake-up threshold in 1/64ths of full scale
+#define VIBRATION_FULL_SCALE_MG  4000
+#define VIBRATION_UG_PER_LSB     122
+#define VIBRATION_WAKE_STEPS     64
+#define VIBRATION_WAKE_MIN_MG    (VIBRATION_FULL_SCALE_MG / VIBRATION_WAKE_STEPS)
+#define VIBRATION_WAKE_MAX_MG    (VIBRATION_FULL_SCALE_MG - VIBRATION_WAKE_MIN_MG)
+
+#define VIBRATION_BATCH_WORDS    (VIBRATION_SAMPLES * VIBRATION_AXES)
+#define VIBRATION_BURST_BYTES    (VIBRATION_BURST_SAMPLES * VIBRATION_AXES * 2)
+
+//summary field widths
+#define VIBRATION_MG_BITS        12
+#define VIBRATION_FREQ_BITS      8
+#define VIBRATION_COUNT_BITS     8
+
+STATIC_ASSERT((VIBRATION_BATCH_BYTES <= ARENA_VIBRATION_BATCH_MAX));
+STATIC_ASSERT((VIBRATION_BURST_BYTES <= SENSOR_IO_MAX_READ));
+
+typedef enum
+{
+	vibration_state_off = 0,  //no sensor
+	vibration_state_armed,    //26Hz low power, waiting for motion
+	vibration_state_capturing,//416Hz, waiting for the watermark
+	vibration_state_resting,  //powered down until the next uplink
+}vibration_state_e;
+
+//Q14 sin(2*pi*i/VIBRATION_SAMPLES)
+static const int16_t sine_q14[VIBRATION_SAMPLES] =
+{
+	     0,    804,   1606,   2404,   3196,   3981,   4756,   5520,
+	  6270,   7005,   7723,   8423,   9102,   9760,  10394,  11003,
+	 11585,  12140,  12665,  13160,  13623,  14053,  14449,  14811,
+	 15137,  15426,  15679,  15893,  16069,  16207,  16305,  16364,
+	 16384,  16364,  16305,  16207,  16069,  15893,  15679,  15426,
+	 15137,  14811,  14449,  14053,  13623,  13160,  12665,  12140,
+	 11585,  11003,  10394,   9760,   9102,   8423,   7723,   7005,
+	  6270,   5520,   4756,   3981,   3196,   2404,   1606,    804,
+	     0,   -804,  -1606,  -2404,  -3196,  -3981,  -4756,  -5520,
+	 -6270,  -7005,  -7723,  -8423,  -9102,  -9760, -10394, -11003,
+	-11585, -12140, -12665, -13160, -13623, -14053, -14449, -14811,
+	-15137, -15426, -15679, -15893, -16069, -16207, -16305, -16364,
+	-16384, -16364, -16305, -16207, -16069, -15893, -15679, -15426,
+	-15137, -14811, -14449, -14053, -13623, -13160, -12665, -12140,
+	-11585, -11003, -10394,  -9760,  -9102,  -8423,  -7723,  -7005,
+	 -6270,  -5520,  -4756,  -3981,  -3196,  -2404,  -1606,   -804,
+};
+
+static sensor_io_t lsm6dsl = {VIBRATION_I2C_ADDR, 0};
+
+static uint16_t wake_threshold_mg = VIBRATION_DEFAULT_WAKE_MG;
+static uint8_t  capture_limit     = VIBRATION_DEFAULT_LIMIT;
+
+static vibration_state_e state = vibration_state_off;
+static volatile bool motion_pending = false;
+static volatile bool batch_pending  = false;
+
+//since the last uplink
+static vibration_axis_t interval_axis[VIBRATION_AXES];
+static uint16_t interval_motions  = 0;
+static uint16_t interval_captures = 0;
+static uint16_t interval_failures = 0;
+
+static uint32_t isqrt32(uint32_t value)
+{
+	uint32_t root = 0;
+	uint32_t bit  = 1UL << 30;
+	
+	while(bit > value)
+	{
+		bit >>= 2;
+	}
+	
+	while(bit != 0)
+	{
+		if(value >= root + bit)
+		{
+			value -= root + bit;
+			root   = (root >> 1) + bit;
+		}
+		else
+		{
+			root >>= 1;
+		}
+		bit >>= 2;
+	}
+	return root;
+}
+
+static uint16_t lsb_to_mg(uint32_t lsb)
+{
+	uint32_t mg = ((lsb * VIBRATION_UG_PER_LSB) + 500) / 1000;
+	
+	return (mg < UINT16_MAX) ? mg : UINT16_MAX;
+}
+
+static int32_t saturate(uint32_t value, uint8_t bits)
+{
+	uint32_t limit = (1UL << bits) - 1;
+	
+	return (value < limit) ? value : limit;
+}
+
+static bool vibration_sensor_setup(void)
+{
+	uint8_t who_am_i = 0;
+	bool    ok       = true;
+	
+	if(!i2c1_init())
+	{
+		return false;
+	}
+	if((LSM6DSL_ACC_GYRO_R_WHO_AM_I(&lsm6dsl, &who_am_i) != MEMS_SUCCESS) || (who_am_i != VIBRATION_WHO_AM_I))
+	{
+		return false;
+	}
+	
+	ok &= LSM6DSL_ACC_GYRO_W_SW_RESET(&lsm6dsl, LSM6DSL_ACC_GYRO_SW_RESET_RESET_DEVICE) == MEMS_SUCCESS;
+	delay_us(100);
+	
+	//the gyro stays powered down from reset
+	ok &= LSM6DSL_ACC_GYRO_W_BDU         (&lsm6dsl, LSM6DSL_ACC_GYRO_BDU_BLOCK_UPDATE        ) == MEMS_SUCCESS;
+	ok &= LSM6DSL_ACC_GYRO_W_FS_XL       (&lsm6dsl, LSM6DSL_ACC_GYRO_FS_XL_4g                ) == MEMS_SUCCESS;
+	ok &= LSM6DSL_ACC_GYRO_W_DEC_FIFO_XL (&lsm6dsl, LSM6DSL_ACC_GYRO_DEC_FIFO_XL_NO_DECIMATION) == MEMS_SUCCESS;
+	ok &= LSM6DSL_ACC_GYRO_W_FIFO_Watermark(&lsm6dsl, VIBRATION_BATCH_WORDS) == MEMS_SUCCESS;
+	//the FIFO holds exactly one batch and then stops, so a late read loses nothing
+	ok &= LSM6DSL_ACC_GYRO_W_STOP_ON_FTH (&lsm6dsl, LSM6DSL_ACC_GYRO_STOP_ON_FTH_ENABLED     ) == MEMS_SUCCESS;
+	ok &= LSM6DSL_ACC_GYRO_W_ODR_FIFO    (&lsm6dsl, LSM6DSL_ACC_GYRO_ODR_FIFO_400Hz          ) == MEMS_SUCCESS;
+	ok &= LSM6DSL_ACC_GYRO_W_BASIC_INT   (&lsm6dsl, LSM6DSL_ACC_GYRO_BASIC_INT_ENABLED       ) == MEMS_SUCCESS;
+	ok &= LSM6DSL_ACC_GYRO_W_LIR         (&lsm6dsl, LSM6DSL_ACC_GYRO_LIR_DISABLED            ) == MEMS_SUCCESS;
+	ok &= LSM6DSL_ACC_GYRO_W_WAKE_DUR    (&lsm6dsl, 0) == MEMS_SUCCESS;
+	
+	return ok;
+}
+
+//26Hz low power with the wake-up on INT1, the FIFO empty and off
+static bool vibration_arm_motion(void)
+{
+	uint32_t steps = ((wake_threshold_mg * VIBRATION_WAKE_STEPS) + (VIBRATION_FULL_SCALE_MG / 2)) / VIBRATION_FULL_SCALE_MG;
+	bool     ok    = true;
+	
+	steps = (steps < 1) ? 1 : ((steps > 63) ? 63 : steps);
+	
+	if(!i2c1_init())
+	{
+		return false;
+	}
+	ok &= LSM6DSL_ACC_GYRO_W_FIFO_TSHLD_on_INT2(&lsm6dsl, LSM6DSL_ACC_GYRO_INT2_FTH_DISABLED) == MEMS_SUCCESS;
+	ok &= LSM6DSL_ACC_GYRO_W_FIFO_MODE    (&lsm6dsl, LSM6DSL_ACC_GYRO_FIFO_MODE_BYPASS) == MEMS_SUCCESS;
+	ok &= LSM6DSL_ACC_GYRO_W_LowPower_XL  (&lsm6dsl, LSM6DSL_ACC_GYRO_LP_XL_ENABLED   ) == MEMS_SUCCESS;
+	ok &= LSM6DSL_ACC_GYRO_W_ODR_XL       (&lsm6dsl, LSM6DSL_ACC_GYRO_ODR_XL_26Hz     ) == MEMS_SUCCESS;
+	ok &= LSM6DSL_ACC_GYRO_W_WK_THS       (&lsm6dsl, steps) == MEMS_SUCCESS;
+	ok &= LSM6DSL_ACC_GYRO_W_WUEvOnInt1   (&lsm6dsl, LSM6DSL_ACC_GYRO_INT1_WU_ENABLED ) == MEMS_SUCCESS;
+	
+	state = ok ? vibration_state_armed : vibration_state_off;
+	return ok;
+}
+
+//from bypass to FIFO mode starts an empty FIFO, so INT2 rises once it holds a batch
+static bool vibration_start_capture(void)
+{
+	bool ok = true;
+	
+	if(!i2c1_init())
+	{
+		return false;
+	}
+	ok &= LSM6DSL_ACC_GYRO_W_WUEvOnInt1   (&lsm6dsl, LSM6DSL_ACC_GYRO_INT1_WU_DISABLED) == MEMS_SUCCESS;
+	ok &= LSM6DSL_ACC_GYRO_W_LowPower_XL  (&lsm6dsl, LSM6DSL_ACC_GYRO_LP_XL_DISABLED  ) == MEMS_SUCCESS;
+	ok &= LSM6DSL_ACC_GYRO_W_ODR_XL       (&lsm6dsl, LSM6DSL_ACC_GYRO_ODR_XL_416Hz    ) == MEMS_SUCCESS;
+	ok &= LSM6DSL_ACC_GYRO_W_FIFO_MODE    (&lsm6dsl, LSM6DSL_ACC_GYRO_FIFO_MODE_BYPASS) == MEMS_SUCCESS;
+	ok &= LSM6DSL_ACC_GYRO_W_FIFO_TSHLD_on_INT2(&lsm6dsl, LSM6DSL_ACC_GYRO_INT2_FTH_ENABLED) == MEMS_SUCCESS;
+	ok &= LSM6DSL_ACC_GYRO_W_FIFO_MODE    (&lsm6dsl, LSM6DSL_ACC_GYRO_FIFO_MODE_FIFO  ) == MEMS_SUCCESS;
+	
+	if(ok)
+	{
+		state = vibration_state_capturing;
+	}
+	return ok;
+}
+
+//the accelerometer powered down, nothing wakes the MCU until the next uplink
+static void vibration_rest(void)
+{
+	if(i2c1_init())
+	{
+		LSM6DSL_ACC_GYRO_W_FIFO_TSHLD_on_INT2(&lsm6dsl, LSM6DSL_ACC_GYRO_INT2_FTH_DISABLED);
+		LSM6DSL_ACC_GYRO_W_WUEvOnInt1        (&lsm6dsl, LSM6DSL_ACC_GYRO_INT1_WU_DISABLED);
+		LSM6DSL_ACC_GYRO_W_FIFO_MODE         (&lsm6dsl, LSM6DSL_ACC_GYRO_FIFO_MODE_BYPASS);
+		LSM6DSL_ACC_GYRO_W_ODR_XL            (&lsm6dsl, LSM6DSL_ACC_GYRO_ODR_XL_POWER_DOWN);
+	}
+	state = vibration_state_resting;
+}
+
+//the FIFO reads back from DATA_OUT_L on its own, so each burst is one register read
+static bool vibration_read_batch(int16_t batch[])
+{
+	uint8_t *bytes   = (uint8_t*)batch;
+	uint16_t entries = 0;
+	uint16_t pattern = 0;
+	uint16_t offset;
+	
+	if(!i2c1_init())
+	{
+		return false;
+	}
+	if((LSM6DSL_ACC_GYRO_R_FIFONumOfEntries(&lsm6dsl, &entries) != MEMS_SUCCESS) || (entries < VIBRATION_BATCH_WORDS))
+	{
+		return false;
+	}
+	//the next word has to be an X for the batch to line up
+	if((LSM6DSL_ACC_GYRO_R_FIFOPattern(&lsm6dsl, &pattern) != MEMS_SUCCESS) || (pattern != 0))
+	{
+		return false;
+	}
+	
+	for(offset=0;offset<VIBRATION_BATCH_BYTES;offset+=VIBRATION_BURST_BYTES)
+	{
+		if(Sensor_IO_Read(&lsm6dsl, LSM6DSL_ACC_GYRO_FIFO_DATA_OUT_L, bytes + offset, VIBRATION_BURST_BYTES))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+//Direct DFT of the mean removed samples, the FFT's extra buffers cost more RAM
+//than the time saved over 63 bins. Products are scaled down by 2^7 so 128 of
+//them fit the accumulator.
+static uint8_t vibration_dominant_bin(const int16_t batch[], uint8_t axis)
+{
+	uint64_t best_power = 0;
+	uint8_t  best_bin   = 0;
+	uint8_t  bin;
+	uint8_t  n;
+	
+	for(bin=1;bin<(VIBRATION_SAMPLES/2);bin++)
+	{
+		int32_t  re    = 0;
+		int32_t  im    = 0;
+		uint8_t  phase = 0;
+		uint64_t power;
+		
+		for(n=0;n<VIBRATION_SAMPLES;n++)
+		{
+			int32_t d = batch[(n * VIBRATION_AXES) + axis];
+			
+			re   += (d * sine_q14[(phase + (VIBRATION_SAMPLES / 4)) & (VIBRATION_SAMPLES - 1)]) >> 7;
+			im   -= (d * sine_q14[phase]) >> 7;
+			phase = (phase + bin) & (VIBRATION_SAMPLES - 1);
+		}
+		
+		power = (uint64_t)((int64_t)re * re) + (uint64_t)((int64_t)im * im);
+		if(power > best_power)
+		{
+			best_power = power;
+			best_bin   = bin;
+		}
+	}
+	return best_bin;
+}
+
+//removes the mean from the axis in place, then measures what is left
+static void vibration_analyse_axis(int16_t batch[], uint8_t axis, vibration_axis_t *result)
+{
+	int32_t  sum        = 0;
+	uint64_t square_sum = 0;
+	uint16_t peak       = 0;
+	int32_t  mean;
+	uint8_t  n;
+	
+	memset(result, 0, sizeof(vibration_axis_t));
+	
+	for(n=0;n<VIBRATION_SAMPLES;n++)
+	{
+		int16_t x = batch[(n * VIBRATION_AXES) + axis];
+		
+		sum += x;
+		if((x == INT16_MAX) || (x == INT16_MIN))
+		{
+			result->clipped = true;
+		}
+	}
+	mean = sum / VIBRATION_SAMPLES;
+	
+	for(n=0;n<VIBRATION_SAMPLES;n++)
+	{
+		int32_t d = batch[(n * VIBRATION_AXES) + axis] - mean;
+		
+		d = (d > INT16_MAX) ? INT16_MAX : ((d < -INT16_MAX) ? -INT16_MAX : d);
+		batch[(n * VIBRATION_AXES) + axis] = d;
+		
+		square_sum += (uint32_t)(d * d);
+		if(abs(d) > peak)
+		{
+			peak = abs(d);
+		}
+	}
+	
+	result->rms_mg  = lsb_to_mg(isqrt32(square_sum / VIBRATION_SAMPLES));
+	result->peak_mg = lsb_to_mg(peak);
+	result->freq_hz = ((vibration_dominant_bin(batch, axis) * VIBRATION_ODR_HZ) + (VIBRATION_SAMPLES / 2)) / VIBRATION_SAMPLES;
+}
+
+//the interval keeps the strongest batch on each axis, with the largest peak seen
+static void vibration_merge(const vibration_axis_t *batch_axis, vibration_axis_t *interval)
+{
+	if((interval_captures == 0) || (batch_axis->rms_mg > interval->rms_mg))
+	{
+		interval->rms_mg  = batch_axis->rms_mg;
+		interval->freq_hz = batch_axis->freq_hz;
+	}
+	if(batch_axis->peak_mg > interval->peak_mg)
+	{
+		interval->peak_mg = batch_axis->peak_mg;
+	}
+	interval->clipped |= batch_axis->clipped;
+}
+
+static void vibration_capture(void)
+{
+	arena_mark_t     mark  = arena_mark();
+	int16_t         *batch = arena_alloc(arena_owner_vibration_batch, VIBRATION_BATCH_BYTES);
+	vibration_axis_t result;
+	uint8_t          axis;
+	
+	if((batch != NULL) && vibration_read_batch(batch))
+	{
+		for(axis=0;axis<VIBRATION_AXES;axis++)
+		{
+			vibration_analyse_axis(batch, axis, &result);
+			vibration_merge(&result, &interval_axis[axis]);
+			vib_printf("Axis %c rms %umg peak %umg %uHz\r\n", 'X' + axis, result.rms_mg, result.peak_mg, result.freq_hz);
+		}
+		interval_captures++;
+	}
+	else
+	{
+		vib_printf("Vibration batch read failed\r\n");
+		interval_failures++;
+	}
+	arena_release(mark);
+	
+	//a machine that keeps running would otherwise keep the MCU awake
+	if(interval_captures >= capture_limit)
+	{
+		vib_printf("Capture limit reached, resting\r\n");
+		vibration_rest();
+	}
+	else if(!vibration_arm_motion())
+	{
+		interval_failures++;
+	}
+}
+
+static void vibration_int1_irq(void)
+{
+	if(state == vibration_state_armed)
+	{
+		motion_pending = true;
+		event_post(event_count);
+	}
+}
+
+static void vibration_int2_irq(void)
+{
+	if(state == vibration_state_capturing)
+	{
+		batch_pending = true;
+		event_post(event_count);
+	}
+}
+
+void vibration_init(void)
+{
+	GPIO_InitTypeDef GPIO_InitStruct;
+	
+	//INT1 and INT2 are push-pull, active high
+	GPIO_InitStruct.Mode  = GPIO_MODE_IT_RISING;
+	GPIO_InitStruct.Pull  = GPIO_NOPULL;
+	GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_LOW;
+	
+	HW_GPIO_Init(VIBRATION_INT1_PORT, VIBRATION_INT1_PIN, &GPIO_InitStruct);
+	HW_GPIO_Init(VIBRATION_INT2_PORT, VIBRATION_INT2_PIN, &GPIO_InitStruct);
+	
+	HW_GPIO_SetIrq(VIBRATION_INT1_PORT, VIBRATION_INT1_PIN, 3, vibration_int1_irq);
+	HW_GPIO_SetIrq(VIBRATION_INT2_PORT, VIBRATION_INT2_PIN, 3, vibration_int2_irq);
+	
+	state = vibration_state_off;
+	if(!vibration_sensor_setup() || !vibration_arm_motion())
+	{
+		Debug_printf("LSM6DSL not responding\r\n");
+		return;
+	}
+	vib_printf("Vibration armed at %umg\r\n", wake_threshold_mg);
+}
+
+test_status_e vibration_test(void)
+{
+	uint8_t who_am_i = 0;
+	
+	if(!i2c1_init())
+	{
+		return test_fail;
+	}
+	if((LSM6DSL_ACC_GYRO_R_WHO_AM_I(&lsm6dsl, &who_am_i) != MEMS_SUCCESS) || (who_am_i != VIBRATION_WHO_AM_I))
+	{
+		return test_fail;
+	}
+	return test_pass;
+}
+
+void vibration_on_event(void)
+{
+	if(motion_pending)
+	{
+		motion_pending = false;
+		if(state == vibration_state_armed)
+		{
+			interval_motions++;
+			vib_printf("Motion, capturing\r\n");
+			if(!vibration_start_capture())
+			{
+				interval_failures++;
+				vibration_arm_motion();
+			}
+		}
+	}
+	
+	if(batch_pending)
+	{
+		batch_pending = false;
+		if(state == vibration_state_capturing)
+		{
+			vibration_capture();
+		}
+	}
+}
+
+void vibration_on_wakeup(void)
+{
+	if(wakeup_count % wakeups_per_uplink == 0)
+	{
+		Debug_printf("Regular Uplink (%d)\r\n", wakeups_per_uplink);
+		vibration_uplink();
+	}
+}
+
+//sends the interval so far and starts the next one listening for motion again
+void vibration_uplink(void)
+{
+	int32_t values[vibration_summary_values] = {0};
+	uint8_t payload[UPLINK_QUEUE_PAYLOAD_SIZE];
+	uint8_t length;
+	uint8_t axis;
+	
+	values[vibration_summary_value_motions]  = saturate(interval_motions , VIBRATION_COUNT_BITS);
+	values[vibration_summary_value_captures] = saturate(interval_captures, VIBRATION_COUNT_BITS);
+	for(axis=0;axis<VIBRATION_AXES;axis++)
+	{
+		values[vibration_summary_value_rms_x  + (axis * VIBRATION_SUMMARY_AXIS_VALUES)] = saturate(interval_axis[axis].rms_mg , VIBRATION_MG_BITS  );
+		values[vibration_summary_value_peak_x + (axis * VIBRATION_SUMMARY_AXIS_VALUES)] = saturate(interval_axis[axis].peak_mg, VIBRATION_MG_BITS  );
+		values[vibration_summary_value_freq_x + (axis * VIBRATION_SUMMARY_AXIS_VALUES)] = saturate(interval_axis[axis].freq_hz, VIBRATION_FREQ_BITS);
+		values[vibration_summary_value_clipped] |= interval_axis[axis].clipped;
+	}
+	values[vibration_summary_value_fault]   = (state == vibration_state_off) || (interval_failures != 0);
+	values[vibration_summary_value_voltage] = fourBit_battery_calculation();
+	values[vibration_summary_value_type]    = packet_type_summary;
+	
+	vib_printf("Vibration: %u motions, %u captures, %u failures\r\n", interval_motions, interval_captures, interval_failures);
+	
+	length = codec_encode(&vibration_summary_schema, values, payload, sizeof(payload));
+	if(length != 0)
+	{
+		Uplink(payload, length);
+	}
+	
+	memset(interval_axis, 0, sizeof(interval_axis));
+	interval_motions  = 0;
+	interval_captures = 0;
+	interval_failures = 0;
+	
+	//a capture still waiting now has most likely lost its INT2 edge, and a
+	//sensor that was missing gets another chance
+	if(state == vibration_state_off)
+	{
+		if(vibration_sensor_setup())
+		{
+			vibration_arm_motion();
+		}
+	}
+	else if(state != vibration_state_armed)
+	{
+		vibration_arm_motion();
+	}
+}
+
+//a new threshold takes effect straight away if the sensor is listening
+static void vibration_apply_config(void)
+{
+	if(state == vibration_state_armed)
+	{
+		vibration_arm_motion();
+	}
+}
+
+void vibration_save_config(void)
+{
+	vibration_config_page_layout_t config = {0};
+	
+	config.members.wake_threshold_mg = wake_threshold_mg;
+	config.members.capture_limit     = capture_limit;
+	
+	save_extra_config_page(config.raw_bytes, device_specific_page_1);
+	vibration_apply_config();
+}
+
+void vibration_load_config(void)
+{
+	vibration_config_page_layout_t config = {0};
+	
+	load_extra_config_page(config.raw_bytes, device_specific_page_1);
+	wake_threshold_mg = config.members.wake_threshold_mg;
+	capture_limit     = config.members.capture_limit;
+	
+	//a new page reads back as zeros after flash_erase_all(), an erased chip as all
+	//ones, neither is a setting the CLI allows
+	if((wake_threshold_mg == 0xFFFF) || (wake_threshold_mg == 0)) wake_threshold_mg = VIBRATION_DEFAULT_WAKE_MG;
+	if((capture_limit     == 0xFF  ) || (capture_limit     == 0)) capture_limit     = VIBRATION_DEFAULT_LIMIT;
+	
+	vibration_apply_config();
+}
+
+static void vibration_cli_help(void)
+{
+	Debug_printf("Usage: device show\r\n");
+	Debug_printf("\tShows the vibration settings and the interval so far\r\n");
+	await_uart_tx();
+	Debug_printf("Usage: device threshold [mg]\r\n");
+	Debug_printf("\tMotion that starts a capture, %d to %d\r\n", VIBRATION_WAKE_MIN_MG, VIBRATION_WAKE_MAX_MG);
+	await_uart_tx();
+	Debug_printf("Usage: device limit [value]\r\n");
+	Debug_printf("\tCaptures per uplink before resting, 1 to 254\r\n");
+	await_uart_tx();
+	Debug_printf("Usage: device capture\r\n");
+	Debug_printf("\tStarts a capture without waiting for motion\r\n");
+	await_uart_tx();
+}
+
+void vibration_cli(int argc, char *argv[])
+{
+	static const char* const state_name[] = {"NO SENSOR", "ARMED", "CAPTURING", "RESTING"};
+	int32_t value;
+	uint8_t axis;
+	
+	if(argc == 1)
+	{
+		if(!strcmp(argv[0], "show"))
+		{
+			Debug_printf("Wake threshold :%umg\r\n", wake_threshold_mg);
+			Debug_printf("Capture limit  :%u\r\n"  , capture_limit);
+			Debug_printf("State          :%s\r\n"  , state_name[state]);
+			await_uart_tx();
+			Debug_printf("Motions        :%u\r\n"  , interval_motions);
+			Debug_printf("Captures       :%u\r\n"  , interval_captures);
+			Debug_printf("Failures       :%u\r\n"  , interval_failures);
+			await_uart_tx();
+			for(axis=0;axis<VIBRATION_AXES;axis++)
+			{
+				Debug_printf("Axis %c         :rms %umg peak %umg %uHz%s\r\n", 'X' + axis,
+					interval_axis[axis].rms_mg, interval_axis[axis].peak_mg, interval_axis[axis].freq_hz,
+					interval_axis[axis].clipped ? " clipped" : "");
+				await_uart_tx();
+			}
+			return;
+		}
+		if(!strcmp(argv[0], "capture"))
+		{
+			if((state == vibration_state_off) || !vibration_start_capture())
+			{
+				Debug_printf("LSM6DSL not responding\r\n");
+				return;
+			}
+			Debug_printf("Capturing\r\n");
+			return;
+		}
+	}
+	
+	if(argc == 2)
+	{
+		value = atoi(argv[1]);
+		
+		if(!strcmp(argv[0], "threshold"))
+		{
+			if((value < VIBRATION_WAKE_MIN_MG) || (value > VIBRATION_WAKE_MAX_MG))
+			{
+				Debug_printf("Value out of range\r\n");
+				return;
+			}
+			wake_threshold_mg = value;
+			vibration_apply_config();
+			Debug_printf("Wake threshold set to %umg\r\n", wake_threshold_mg);
+			return;
+		}
+		if(!strcmp(argv[0], "limit"))
+		{
+			if((value < 1) || (value > 254))
+			{
+				Debug_printf("Value out of range\r\n");
+				return;
+			}
+			capture_limit = value;
+			Debug_printf("Capture limit set to %u\r\n", capture_limit);
+			return;
+		}
+	}
+	
+	vibration_cli_help();
+}
@@ -0,0 +1,113 @@
+/*
+   _____             _____                 
+  / ____|           / ____|                
+ | (___   ___ _ __ | (___  _   _ _ __ ___  
+  \___ \ / _ \ '_ \ \___ \| | | | '_ ` _ \ 
+  ____) |  __/ | | |____) | |_| | | | | | |
+ |_____/ \___|_| |_|_____/ \__,_|_| |_| |_|
+                                           
+                                           
+	Description: Binary LoRaMac event trace.
+								Events are recorded into a RAM ring from any context, and printed
+								as hex records by the "trace" CLI command for decoding on the host.
+
+	Maintainer: Shea Gosnell
+
+
+*/
+
+#include "global.h"
+#include "hw.h"
+#include "timeServer.h"
+#include "debug_uart.h"
+#include "mac_trace.h"
+#include <string.h>
+
+static mac_trace_entry_t mac_trace_ring[MAC_TRACE_ENTRIES];
+//total events recorded, the ring slot is the low bits
+static uint32_t mac_trace_count = 0;
+
+//The M0+ has no exclusive load/store, so claiming a slot masks interrupts for
+//the few instructions it takes to fill it in. Nothing here can block.
+void mac_trace(mac_trace_event_e event, uint8_t arg8, uint16_t arg16)
+{
+	TimerTime_t        now = TimerGetCurrentTime();
+	mac_trace_entry_t* entry;
+	
+	BACKUP_PRIMASK();
+	DISABLE_IRQ();
+	
+	entry = &mac_trace_ring[mac_trace_count & (MAC_TRACE_ENTRIES - 1)];
+	mac_trace_count++;
+	entry->timestamp = now;
+	entry->event     = event;
+	entry->arg8      = arg8;
+	entry->arg16     = arg16;
+	
+	RESTORE_PRIMASK();
+}
+
+//Prints the oldest entry first, one record per line:
+//  TR <index> <timestamp> <event> <arg8> <arg16>    (all hex)
+void mac_trace_dump( void )
+{
+	mac_trace_entry_t entry;
+	uint32_t          first;
+	uint32_t          last;
+	uint32_t          i;
+	
+	last  = mac_trace_count;
+	first = (last > MAC_TRACE_ENTRIES) ? (last - MAC_TRACE_ENTRIES) : 0;
+	
+	Debug_printf("MAC trace: %d events, showing %d\r\n", last, last - first);
+	await_uart_tx();
+	
+	for(i=first;i<last;i++)
+	{
+		//copy out under the same lock, so an IRQ cannot tear the entry
+		BACKUP_PRIMASK();
+		DISABLE_IRQ();
+		entry = mac_trace_ring[i & (MAC_TRACE_ENTRIES - 1)];
+		RESTORE_PRIMASK();
+		
+		Debug_printf("TR %08X %08X %02X %02X %04X\r\n", i, entry.timestamp, entry.event, entry.arg8, entry.arg16);
+		await_uart_tx();
+	}
+}
+
+void mac_trace_clear( void )
+{
+	BACKUP_PRIMASK();
+	DISABLE_IRQ();
+	mac_trace_count = 0;
+	memset(mac_trace_ring, 0, sizeof(mac_trace_ring));
+	RESTORE_PRIMASK();
+}
+
+static void cli_trace_help( void )
+{
+	Debug_printf("Usage: trace [dump|clear]\r\n");
+	await_uart_tx();
+	Debug_printf("\tdump the LoRaMac event trace, decode with metaScripts/mac_trace_decode.sh\r\n");
+	await_uart_tx();
+}
+
+void cli_trace_implementation(int argc, char *argv[])
+{
+	if(argc == 1)
+	{
+		if(!strcmp(argv[0], "dump"))
+		{
+			mac_trace_dump();
+			return;
+		}
+		if(!strcmp(argv[0], "clear"))
+		{
+			mac_trace_clear();
+			Debug_printf("MAC trace cleared\r\n");
+			return;
+		}
+	}
+	
+	cli_trace_help();
+}
@@ -76,10 +76,17 @@ Maintainer: Miguel Luis, Gregory Cristian and Wael Guibene
 #include "../SHELL/UsartShell.h"
 #include "../SHELL/app_cli.h"
 #include "counter.h"
+#include "interval_meter.h"
+#include "event_loop.h"
 #include "flash_map.h"
 #include "ds18b20.h"
 #include "2I2O.h"
 #include "i2cLightSensor.h"
+#include "lsm6dsl_vibration.h"
+#include "lps22hb_barometer.h"
+#include "lsm303agr_tamper.h"
+#include "composite.h"
+#include "sampler.h"
 
 #include "global.h"
 #include "sensum_version.h"
@@ -96,6 +103,8 @@ Maintainer: Miguel Luis, Gregory Cristian and Wael Guibene
 
 #include "sigfox_sensum.h"
 #include "radio_common.h"
+#include "clock_manager.h"
+#include "stack_monitor.h"
 
 
 #ifndef DISABLE_ALARM_DEBUG
@@ -155,6 +164,7 @@ sensum_device_callback_t device_modes[] =
 		.mode_name                 ="Unconfigured",
 		.legacy_counter            =legacy_counters_enabled,
 		.lora_class_c              =false,
+		.lora_class_b              =false,
 		.cli_commands              = 0,
 	},
 	
@@ -178,6 +188,7 @@ sensum_device_callback_t device_modes[] =
 		.mode_name                 ="Three Counter",
 		.legacy_counter            =legacy_counters_disabled,
 		.lora_class_c              =false,
+		.lora_class_b              =false,
 		.cli_commands              = cmd_count1 |
                                      cmd_count2 |
                                      cmd_count3,
@@ -203,6 +214,7 @@ sensum_device_callback_t device_modes[] =
 		.mode_name                 ="Generic Modbus",
 		.legacy_counter            =legacy_counters_enabled,
 		.lora_class_c              =false,
+		.lora_class_b              =false,
 		.cli_commands              = cmd_modbus,
 	},                             
 	
@@ -226,6 +238,7 @@ sensum_device_callback_t device_modes[] =
 		.mode_name                 ="Two Counter with Tamper",
 		.legacy_counter            =legacy_counters_disabled,
 		.lora_class_c              =false,
+		.lora_class_b              =false,
 		.cli_commands              = cmd_count1 |
 		                             cmd_count2 |
 		                             cmd_count_burst |
@@ -252,6 +265,7 @@ sensum_device_callback_t device_modes[] =
 		.mode_name                 ="SHT20",
 		.legacy_counter            =legacy_counters_enabled,
 		.lora_class_c              =false,
+		.lora_class_b              =false,
 		.cli_commands              = cmd_thresholds,
 	},                             
 	
@@ -275,6 +289,7 @@ sensum_device_callback_t device_modes[] =
 		.mode_name                 ="Single Counter",
 		.legacy_counter            =legacy_counters_disabled,
 		.lora_class_c              =false,
+		.lora_class_b              =false,
 		.cli_commands              = cmd_count1      |
 		                             cmd_count_burst |
 		                             cmd_count_leak,
@@ -300,6 +315,7 @@ sensum_device_callback_t device_modes[] =
 		.mode_name                 ="Three Edge Alarm",
 		.legacy_counter            =legacy_counters_disabled,
 		.lora_class_c              =false,
+		.lora_class_b              =false,
 		.cli_commands              = cmd_count1 |
 		                             cmd_count2 |
 		                             cmd_count3,
@@ -325,11 +341,12 @@ sensum_device_callback_t device_modes[] =
 		.mode_name                 ="Soil Probe",
 		.legacy_counter            =legacy_counters_enabled,
 		.lora_class_c              =false,
+		.lora_class_b              =false,
 		.cli_commands              = 0,
 	},                             
 	
 	{//8 Mux device, digital, analog and 4-20mA
-		.on_each_wakeup            =&no_action,
+		.on_each_wakeup            =&sampler_on_each_wakeup,
 		.on_scheduled_wakeup       =&three_mux_uplink,
 		.on_hourly_alarm           =&no_action,
 		.on_hourly_alarm_interrupt =&no_action,
@@ -344,21 +361,22 @@ sensum_device_callback_t device_modes[] =
 		.load_config               =&three_mux_load_config,
 		.load_data                 =&three_mux_load_counter_data,
 		.cli_set_thresholds        =&no_cli,
-		.cli_device_specific       =&no_cli,
+		.cli_device_specific       =&sampler_cli,
 		.mode_name                 ="3MUX",
 		.legacy_counter            =legacy_counters_disabled,
 		.lora_class_c              =false,
+		.lora_class_b              =false,
 		.cli_commands              = cmd_count1|cmd_mux_adc,
 	},                             
 	
 	{//9  SHT30                       
-		.on_each_wakeup            =&no_action,
+		.on_each_wakeup            =&sampler_on_each_wakeup,
 		.on_scheduled_wakeup       =&sht30_onWakeup,
 		.on_hourly_alarm           =&no_action,
 		.on_hourly_alarm_interrupt =&no_action,
-		.on_count_wakeup           =&no_action,
+		.on_count_wakeup           =&sht30_onAlert,
 		.on_alarm                  =&no_action,
-		.init                      =&no_action,//SHT20 and SHT30 have no init
+		.init                      =&sht30_init,//ALERT inputs, and alert mode if enabled
 		.test_peripheral           =&no_test,//as it is not requred
 		.send_data                 =&sht30_uplink,
 		.on_downlink               =&sht32_onDownlink,
@@ -367,10 +385,11 @@ sensum_device_callback_t device_modes[] =
 		.load_config               =&sht30_load_config,
 		.load_data                 =&no_action,
 		.cli_set_thresholds        =&sht30_cli_threshold,
-		.cli_device_specific       =&no_cli,
+		.cli_device_specific       =&sampler_cli,
 		.mode_name                 ="SHT30",
 		.legacy_counter            =legacy_counters_enabled,
 		.lora_class_c              =false,
+		.lora_class_b              =false,
 		.cli_commands              = cmd_thresholds,
 	},                             
 	
@@ -394,6 +413,7 @@ sensum_device_callback_t device_modes[] =
 		.mode_name                 ="Dual Counter with ADC",
 		.legacy_counter            =legacy_counters_disabled,
 		.lora_class_c              =false,
+		.lora_class_b              =false,
 		.cli_commands              = cmd_count1 |
 		                             cmd_count2,
 	},                             
@@ -417,7 +437,8 @@ sensum_device_callback_t device_modes[] =
 		.cli_device_specific       =&no_cli,
 		.mode_name                 ="2I2O",
 		.legacy_counter            =legacy_counters_enabled,
-		.lora_class_c              =true,
+		.lora_class_c              =false,
+		.lora_class_b              =true,
 		.cli_commands              = 0,
 	}, 	                         
 	
@@ -441,6 +462,7 @@ sensum_device_callback_t device_modes[] =
 		.mode_name                 ="CO2",
 		.legacy_counter            =legacy_counters_enabled,
 		.lora_class_c              =false,
+		.lora_class_b              =false,
 		.cli_commands              = 0,
 	},        
 
@@ -464,6 +486,7 @@ sensum_device_callback_t device_modes[] =
 		.mode_name                 ="DS18B20",
 		.legacy_counter            =legacy_counters_enabled,
 		.lora_class_c              =false,
+		.lora_class_b              =false,
 		.cli_commands              = cmd_thresholds,
 	},    
 	{//14 Single Counter                       
@@ -486,18 +509,19 @@ sensum_device_callback_t device_modes[] =
 		.mode_name                 ="Single Counter Simplified",
 		.legacy_counter            =legacy_counters_disabled,
 		.lora_class_c              =false,
+		.lora_class_b              =false,
 		.cli_commands              = cmd_count1      |
 		                             cmd_count_burst |
 		                             cmd_count_leak,
 	}, 	
 	{//15 SCL61D5 Water meter         
-		.on_each_wakeup            =&no_action,
+		.on_each_wakeup            =&scl61d5_on_each_wakeup,
 		.on_scheduled_wakeup       =&scl61d5_wakeup,
 		.on_hourly_alarm           =&no_action,
 		.on_hourly_alarm_interrupt =&no_action,
 		.on_count_wakeup           =&no_action,
 		.on_alarm                  =&no_action,
-		.init                      =&modbus_init,
+		.init                      =&scl61d5_init,
 		.test_peripheral           =&no_test,
 		.send_data                 =&scl61d5_uplink,
 		.on_downlink               =&scl61d5Downlink,
@@ -506,10 +530,11 @@ sensum_device_callback_t device_modes[] =
 		.load_config               =&scl61d5_load_config,
 		.load_data                 =&no_action,
 		.cli_set_thresholds        =&no_cli,
-		.cli_device_specific       =&no_cli,
+		.cli_device_specific       =&scl61d5_cli,
 		.mode_name                 ="SCL-61D5 Water meter",
 		.legacy_counter            =legacy_counters_enabled,
 		.lora_class_c              =false,
+		.lora_class_b              =false,
 		.cli_commands              = 0,
 	}, 
 	{//16 MultiDS18B20
@@ -532,10 +557,11 @@ sensum_device_callback_t device_modes[] =
 		.mode_name                 ="Multi DS18B20",
 		.legacy_counter            =legacy_counters_enabled,
 		.lora_class_c              =false,
+		.lora_class_b              =false,
 		.cli_commands              = cmd_thresholds,
 	},
 	{//17 Three ADC
-		.on_each_wakeup            =&no_action,
+		.on_each_wakeup            =&sampler_on_each_wakeup,
 		.on_scheduled_wakeup       =&three_adc_send,
 		.on_hourly_alarm           =&no_action,
 		.on_hourly_alarm_interrupt =&no_action,
@@ -545,15 +571,16 @@ sensum_device_callback_t device_modes[] =
 		.test_peripheral           =&no_test,
 		.send_data                 =&three_adc_send,
 		.on_downlink               =&no_downlink_action,
-		.save_config               =&no_action,
+		.save_config               =&three_adc_save_config,
 		.save_data                 =&no_action,
-		.load_config               =&no_action,
+		.load_config               =&three_adc_load_config,
 		.load_data                 =&no_action,
 		.cli_set_thresholds        =&no_cli,
-		.cli_device_specific       =&no_cli,
+		.cli_device_specific       =&sampler_cli,
 		.mode_name                 ="Three ADC",
 		.legacy_counter            =legacy_counters_enabled,
 		.lora_class_c              =false,
+		.lora_class_b              =false,
 		.cli_commands              = 0,
 	},
 	
@@ -577,6 +604,7 @@ sensum_device_callback_t device_modes[] =
 		.mode_name                 ="LEGACY CO2",
 		.legacy_counter            =legacy_counters_enabled,
 		.lora_class_c              =false,
+		.lora_class_b              =false,
 		.cli_commands              = 0,
 	},
 	
@@ -600,8 +628,131 @@ sensum_device_callback_t device_modes[] =
 		.mode_name                 ="SHT30+Light",
 		.legacy_counter            =legacy_counters_enabled,
 		.lora_class_c              =false,
+		.lora_class_b              =false,
 		.cli_commands              = 0,
 	},  
+	
+	{//20 Interval Counter
+		.on_each_wakeup            =&interval_meter_on_wakeup,
+		.on_scheduled_wakeup       =&interval_meter_uplink,
+		.on_hourly_alarm           =&single_counter_on_hour,
+		.on_hourly_alarm_interrupt =&record_hourly_count,
+		.on_count_wakeup           =&single_counter_on_count,
+		.on_alarm                  =&no_action,
+		.init                      =&init_interval_meter,
+		.test_peripheral           =&no_test,
+		.send_data                 =&interval_meter_uplink,
+		.on_downlink               =&counterDownlinks,
+		.save_config               =&save_counter_config,
+		.save_data                 =&interval_meter_save_data,
+		.load_config               =&load_counter_config,
+		.load_data                 =&interval_meter_load_data,
+		.cli_set_thresholds        =&no_cli,
+		.cli_device_specific       =&interval_meter_cli,
+		.mode_name                 ="Interval Counter",
+		.legacy_counter            =legacy_counters_disabled,
+		.lora_class_c              =false,
+		.lora_class_b              =false,
+		.cli_commands              = cmd_count1      |
+		                             cmd_count_burst |
+		                             cmd_count_leak,
+	},
+	
+	{//21 Vibration (LSM6DSL)
+		.on_each_wakeup            =&no_action,
+		.on_scheduled_wakeup       =&vibration_on_wakeup,
+		.on_hourly_alarm           =&no_action,
+		.on_hourly_alarm_interrupt =&no_action,
+		.on_count_wakeup           =&vibration_on_event,//motion on INT1, a full FIFO on INT2
+		.on_alarm                  =&no_action,
+		.init                      =&vibration_init,
+		.test_peripheral           =&vibration_test,
+		.send_data                 =&vibration_uplink,
+		.on_downlink               =&no_downlink_action,
+		.save_config               =&vibration_save_config,
+		.save_data                 =&no_action,
+		.load_config               =&vibration_load_config,
+		.load_data                 =&no_action,
+		.cli_set_thresholds        =&no_cli,
+		.cli_device_specific       =&vibration_cli,
+		.mode_name                 ="Vibration",
+		.legacy_counter            =legacy_counters_disabled,
+		.lora_class_c              =false,
+		.lora_class_b              =false,
+		.cli_commands              = 0,
+	},
+	
+	{//22 Barometer (LPS22HB)
+		.on_each_wakeup            =&no_action,
+		.on_scheduled_wakeup       =&baro_on_wakeup,
+		.on_hourly_alarm           =&no_action,
+		.on_hourly_alarm_interrupt =&no_action,
+		.on_count_wakeup           =&baro_on_event,//FIFO watermark on INT_DRDY
+		.on_alarm                  =&no_action,
+		.init                      =&baro_init,
+		.test_peripheral           =&baro_test,
+		.send_data                 =&baro_uplink,
+		.on_downlink               =&no_downlink_action,
+		.save_config               =&baro_save_config,
+		.save_data                 =&no_action,
+		.load_config               =&baro_load_config,
+		.load_data                 =&no_action,
+		.cli_set_thresholds        =&no_cli,
+		.cli_device_specific       =&baro_cli,
+		.mode_name                 ="Barometer",
+		.legacy_counter            =legacy_counters_disabled,
+		.lora_class_c              =false,
+		.lora_class_b              =false,
+		.cli_commands              = 0,
+	},
+	
+	{//23 Tamper (LSM303AGR)
+		.on_each_wakeup            =&no_action,
+		.on_scheduled_wakeup       =&accel_tamper_on_wakeup,
+		.on_hourly_alarm           =&no_action,
+		.on_hourly_alarm_interrupt =&no_action,
+		.on_count_wakeup           =&accel_tamper_on_event,//6D on INT1, free-fall on INT2
+		.on_alarm                  =&no_action,
+		.init                      =&accel_tamper_init,
+		.test_peripheral           =&accel_tamper_test,
+		.send_data                 =&accel_tamper_uplink,
+		.on_downlink               =&no_downlink_action,
+		.save_config               =&accel_tamper_save_config,
+		.save_data                 =&no_action,
+		.load_config               =&accel_tamper_load_config,
+		.load_data                 =&no_action,
+		.cli_set_thresholds        =&no_cli,
+		.cli_device_specific       =&accel_tamper_cli,
+		.mode_name                 ="Tamper",
+		.legacy_counter            =legacy_counters_disabled,
+		.lora_class_c              =false,
+		.lora_class_b              =false,
+		.cli_commands              = 0,
+	},
+	
+	{//24 Composite, the components are set with "device components"
+		.on_each_wakeup            =&no_action,
+		.on_scheduled_wakeup       =&composite_on_wakeup,
+		.on_hourly_alarm           =&no_action,
+		.on_hourly_alarm_interrupt =&no_action,
+		.on_count_wakeup           =&no_action,
+		.on_alarm                  =&no_action,
+		.init                      =&composite_init,
+		.test_peripheral           =&composite_test,
+		.send_data                 =&composite_uplink,
+		.on_downlink               =&no_downlink_action,
+		.save_config               =&composite_save_config,
+		.save_data                 =&composite_save_data,
+		.load_config               =&composite_load_config,
+		.load_data                 =&composite_load_data,
+		.cli_set_thresholds        =&no_cli,
+		.cli_device_specific       =&composite_cli,
+		.mode_name                 ="Composite",
+		.legacy_counter            =legacy_counters_disabled,
+		.lora_class_c              =false,
+		.lora_class_b              =false,
+		.cli_commands              = 0, //from the components, at init
+	},
 };
 
 sensum_device_callback_t device = {0};
@@ -677,8 +828,12 @@ void update_device_behaviour()
 	device.mode_name                 = device_modes[device_mode].mode_name;
 	device.legacy_counter            = device_modes[device_mode].legacy_counter;
 	device.lora_class_c              = device_modes[device_mode].lora_class_c;
+	device.lora_class_b              = device_modes[device_mode].lora_class_b;
 	device.cli_commands              = device_modes[device_mode].cli_commands;
 	
+	//back to the hourly alarm, a metering mode sets its own interval from init
+	HW_RTC_SetAlarmInterval(60, NULL);
+	
 	//set the uplink wakeups to a suitable value.
 	if(!(device.cli_commands & cmd_thresholds))
 	{
@@ -690,6 +845,10 @@ void update_device_behaviour()
 	{
 		LORA_RequestClass(CLASS_C);
 	}
+	else if(device.lora_class_b)
+	{
+		LORA_RequestClass(CLASS_B);
+	}
 	else
 	{
 		LORA_RequestClass(CLASS_A);
@@ -756,17 +915,66 @@ void HW_Main_Init()
 }
 
 static TimerEvent_t sleep_timer;
-uint8_t wake__flag = 0;
 void wake_flag_set()
 {
 	if(!RTC_modified)
 	{
-		wake__flag = 1;
+		event_post(event_scheduled);
 		//Reset the timer here, to prevent timing drift during operation
 		TimerStart(&sleep_timer);
 	}
 }
 
+#ifndef DISABLE_RADIO
+#ifdef RAIDO_LORA_INTERNAL
+static void on_downlink_event()
+{
+	process_lora_downlink();
+}
+#endif
+#endif
+
+static void on_count_event()
+{
+	//save the updated counts, so the count is not lost on power off
+	//the save data is here to ensure that it does not occur while the Uc is doing
+	//someting important. This is to keep in line with the principle of keeping the
+	//interrupts short.
+	device.save_data();
+	reset_watchdog();
+	
+	device.on_count_wakeup();
+	//alarms that depend on the count, e.g. bursts
+	event_post(event_device);
+}
+
+static void on_hourly_event()
+{
+	alarm_printf("wakeup hourly alarm\r\n");
+	device.on_hourly_alarm();
+	event_post(event_device);
+}
+
+static void on_device_event()
+{
+	device.on_each_wakeup();
+}
+
+//the device callbacks are called through the wrappers, so a mode change needs no re-registering
+static void register_events()
+{
+#ifndef DISABLE_RADIO
+#ifdef RAIDO_LORA_INTERNAL
+	event_register(event_downlink, on_downlink_event);
+#endif
+	//send anything held back by the duty cycle
+	event_register(event_uplink_queue, uplink_queue_on_wakeup);
+#endif
+	event_register(event_count , on_count_event);
+	event_register(event_hourly, on_hourly_event);
+	event_register(event_device, on_device_event);
+}
+
 
 //sleeps until <wakeup_time_ms> milliseconds have passed since last wakeup
 //Note that this is from last wakeup, not from now.
@@ -801,7 +1009,7 @@ static void Sleep(uint32_t wakeup_time_ms)
 		TimerSetValue(&sleep_timer, wakeup_time_ms);
 		TimerStart(&sleep_timer);
 		
-		wake__flag = 0;
+		event_clear(event_scheduled);
 		RTC_modified = false;
 	}
 	
@@ -811,7 +1019,7 @@ static void Sleep(uint32_t wakeup_time_ms)
 	//set this to 0, to ensure that we do not wake immediatly.
 
 	
-	if(wake__flag)
+	if(event_take(event_scheduled))
 	{
 		alarm_printf("Arrived at sleep after alarm triggered\r\n");
 		await_uart_tx();
@@ -819,82 +1027,47 @@ static void Sleep(uint32_t wakeup_time_ms)
 		TimerStop(&sleep_timer);
 		TimerSetValue(&sleep_timer, wakeup_time_ms);
 		TimerStart(&sleep_timer);
-		//note that firing this will not reset the wake flag.
-		//we are essentially skipping over the sleep loop.
+		//we are essentially skipping over the sleep loop, after running anything pending.
+		event_dispatch();
+		return;
 	}
 
 	
-	while(!wake__flag)
+	while(!event_take(event_scheduled))
 	{
-		//check the wake-up sources, to do data saving and the such
-	#ifndef DISABLE_RADIO
-	#ifdef RAIDO_LORA_INTERNAL
-		process_lora_downlink();
-	#endif
-	#endif
-		//counters
-		if(wake_via_counters)
-		{
-			#ifndef DISABLE_COUNT_DEBUG
-			Debug_printf("Wake via counters\r\n");
-			#endif
-			wake_via_counters = 0;
-			//save the updated counts, so the count is not lost on power off
-			//the save data is here to ensure that it does not occur while the Uc is doing
-			//someting important. This is to keep in line with the principle of keeping the
-			//interrupts short.
-			device.save_data();
-			reset_watchdog();
-			
-			device.on_count_wakeup();
-		}
-		
-		if(wake_via_rtc_b)
+		//handlers run on HSI16, range 2 is also the lowest that can write flash
+		if(event_any_pending())
 		{
-			alarm_printf("wakeup hourly alarm\r\n");
-			wake_via_rtc_b = 0;
-			
-			device.on_hourly_alarm();
+			clock_request(clock_user_main, clock_profile_mid);
 		}
-		
-		device.on_each_wakeup();
-		
+		//run everything the interrupts have posted, each to completion
+		event_dispatch();
 		reset_watchdog();
 		
-		//ensure that all characters in the TX buffer are sent.
-		await_uart_tx();
-		delay_timeout_ms(10);
+		//ensure that all characters in the TX buffer are sent, and the UART is off.
+		Debug_sleep();
 		// LL_GPIO_SetPinMode(PER_SUPPLY_ENABLE_PORT, PER_SUPPLY_ENABLE_PIN, LL_GPIO_MODE_ANALOG);
-		//we are going to disable the interrupts here, before the check for the wake flag
+		//we are going to disable the interrupts here, before the last check for events
 		//this should help prevent race conditions.
 		DISABLE_IRQ();
-		//check RTC last, if we are awoken by the RTC, then exit the sleep loop.
-		//This should be redundant, because the check_timeout should fail if the RTC alarm has gone off.
-		if(wake__flag)
+		if(event_any_pending() || event_pending(event_scheduled))
 		{
 			//ensure to re-enable the IRQ here
 			ENABLE_IRQ();
-			alarm_printf("wakeup_time_ms via Alarm\r\n");
-			break;
+			continue;
 		}
 		
-		disable_Debug();
-		
-		//sleep
-		LPM_EnterStopMode();
-
-		//wake up
-		LPM_ExitStopMode();
-		/* Enable GPIOs clock */
+		//wakes that only run an interrupt stay on MSI, the UART is already off
+		clock_release(clock_user_main);
+		//sleep until the next interrupt, the UART is turned back on by the first print
+		event_loop_sleep();
 		//also re-enable the IRQ after Interrupt wake.
 		ENABLE_IRQ();
-		delay_timeout_ms(10);
-		Debug_init();
-		alarm_printf("waking up\r\n");
 	}
+	clock_request(clock_user_main, clock_profile_mid);
 	// LL_GPIO_SetPinMode(PER_SUPPLY_ENABLE_PORT, PER_SUPPLY_ENABLE_PIN, LL_GPIO_MODE_OUTPUT);
+	alarm_printf("wakeup_time_ms via Alarm\r\n");
 	alarm_printf("Setting alarm for %d seconds\r\n", wakeup_time_ms/1000);
-	wake__flag = 0;
 	alarm_printf("Time at wake:%d\r\n", HW_RTC_GetTimerValue());
 	//now print out the RTC time to confirm
 	alarm_printf("Current Time:%u\r\n", HW_RTC_GetTimerValue());
@@ -1035,6 +1208,13 @@ static void init()
 	//Init the RTC
 	HW_RTC_Init();	
 	reset_watchdog();
+	
+	//the clock manager times each profile against the RTC
+	clock_manager_init();
+	clock_request(clock_user_main, clock_profile_mid);
+	
+	//the last run's stack record is in an RTC backup register
+	stack_monitor_init();
 
 	
 	//initialise the random seed
@@ -1213,7 +1393,7 @@ static void init()
 					Debug_printf("Device Unconfigured\r\n");
 					error = 1;
 					//display the error code for 1 minute
-					delay_timeout_ms(60000);
+					delay_stop_ms(60000);
 					continue;
 				}
 				
@@ -1230,7 +1410,7 @@ static void init()
 					//indicate that an error occured
 					error = 1;
 					//hold for 1 minute
-					delay_timeout_ms(60000);
+					delay_stop_ms(60000);
 					continue;
 				}
 	}
@@ -1253,7 +1433,7 @@ static void init()
 				Debug_printf("Failed to Join\r\n");
 				error = 1;
 				//display the error code for 1 minute
-				delay_timeout_ms(60000);
+				delay_stop_ms(60000);
 				continue;
 			}
 		#endif
@@ -1269,6 +1449,7 @@ static void init()
 	//history with our packets. To do this, we need to wake up each hour to take a reading
 	//Other devices are going to use this to establish when they should be re-enabling the 
 	//LoRa join request
+	register_events();
 	HW_RTC_StartHourlyAlarm();
 	Debug_printf("Hourly alarm enabled\r\n");
 	await_uart_tx();
@@ -1325,13 +1506,17 @@ void sleep_until_interrupt()
 {
        //sleep
        //cannot use stop mode, as this would turn off the SPI clock
+       clock_wait_enter();
        LPM_EnterSleepMode();
+       clock_wait_exit();
 }
 
 
 
 int main(void)
 {
+	//before anything else uses the stack
+	stack_monitor_paint();
 
 	if(watchdog_reset_occured())
 	{
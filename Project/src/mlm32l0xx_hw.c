@@ -64,9 +64,11 @@ Maintainer: Miguel Luis and Gregory Cristian
 #include "debug.h"
 #include "vcom.h"
 #include "global.h"
+#include "clock_manager.h"
 /* Force include of hal adc in order to inherite HAL_ADC_STATE_xxx */
 #include "stm32l0xx_hal_dma.h"
 #include "stm32l0xx_hal_adc.h"
+#include "stm32l0xx_ll_dma.h"
 
 /* Private typedef -----------------------------------------------------------*/
 /* Private define ------------------------------------------------------------*/
@@ -262,30 +264,19 @@ static ErrorStatus HW_ADC_Enable(void);
 static void HW_ADC_Start(void);
 
 /**
- * @brief  Wait for regular group conversion to be completed.
- * @note   ADC conversion flags EOS (end of sequence) and EOC (end of
- *         conversion) are cleared by this function, with an exception:
- *         if low power feature "LowPowerAutoWait" is enabled, flags are
- *         not cleared to not interfere with this feature until data register
- *         is read using function HAL_ADC_GetValue().
- * @note   This function cannot be used in a particular setup: ADC configured
- *         in DMA mode and polling for end of each conversion (ADC init
- *         parameter "EOCSelection" set to ADC_EOC_SINGLE_CONV).
- *         In this case, DMA resets the flag EOC and polling cannot be
- *         performed on each conversion. Nevertheless, polling can still
- *         be performed on the complete sequence (ADC init
- *         parameter "EOCSelection" set to ADC_EOC_SEQ_CONV).
+ * @brief  This function initializes the ADC
  * @param  none
  * @retval none
  */
-static void HW_ADC_PollForConversion(void);
+static void HW_AdcInit(void);
 
 /**
- * @brief  This function initializes the ADC
- * @param  none
- * @retval none
+ * @brief  Position of a channel in the result of a scan sequence
+ * @param  selected: all the channels of the sequence
+ * @param  channel: the channel to find
+ * @retval index of the channel's conversion in the sequence
  */
-static void HW_AdcInit(void);
+static uint8_t HW_ADC_ScanSlot(uint32_t selected, uint32_t channel);
 
 
 
@@ -396,26 +387,17 @@ void HW_GetUniqueId(uint8_t *id)
 
 uint16_t HW_GetTemperatureLevel( void ) 
 {
+  const uint32_t channel = LL_ADC_CHANNEL_TEMPSENSOR;
   uint16_t measuredLevel =0; 
   uint32_t batteryLevelmV;
   uint16_t temperatureDegreeC;
 
-  measuredLevel = HW_AdcReadChannel( LL_ADC_CHANNEL_TEMPSENSOR ); 
-
-  if (measuredLevel ==0)
-  {
-    batteryLevelmV =0;
-  }
-  else
-  {
-    batteryLevelmV= (( (uint32_t) VDDA_VREFINT_CAL * (*VREFINT_CAL ) )/ measuredLevel);
-  }
+  /* sensor and VREFINT are converted in the same scan */
+  batteryLevelmV = HW_VrefintToBatteryLevel_mv(HW_AdcReadChannels(&channel, &measuredLevel, 1));
 #if 0  
   PRINTF("VDDA= %d\n\r", batteryLevelmV);
 #endif
   
-  measuredLevel = HW_AdcReadChannel( ADC_CHANNEL_TEMPSENSOR ); 
-  
   temperatureDegreeC = COMPUTE_TEMPERATURE( measuredLevel, batteryLevelmV);
 
 #if 0 
@@ -429,25 +411,18 @@ uint16_t HW_GetTemperatureLevel( void )
   return (uint16_t) temperatureDegreeC;
 }
 
-uint32_t HW_GetBatteryLevel_mv(void)
+uint32_t HW_VrefintToBatteryLevel_mv(uint16_t vrefint)
 {
-  uint16_t measuredLevel = 0;
-  uint32_t batteryLevelmV = 0;
-
-  measuredLevel = HW_AdcReadChannel(LL_ADC_CHANNEL_VREFINT);
-	
-	//return (uint32_t)measuredLevel;
-
-  if (measuredLevel == 0)
-  {
-    batteryLevelmV = 0;
-  }
-  else
+  if (vrefint == 0)
   {
-    batteryLevelmV = (((uint32_t) VDDA_VREFINT_CAL * (*VREFINT_CAL)) / measuredLevel);
+    return 0;
   }
-	
-  return batteryLevelmV;
+  return (((uint32_t) VDDA_VREFINT_CAL * (*VREFINT_CAL)) / vrefint);
+}
+
+uint32_t HW_GetBatteryLevel_mv(void)
+{
+  return HW_VrefintToBatteryLevel_mv(HW_AdcReadChannels(0, 0, 0));
 }
 
 uint8_t HW_GetBatteryLevel(void)
@@ -456,16 +431,9 @@ uint8_t HW_GetBatteryLevel(void)
   uint16_t measuredLevel = 0;
   uint32_t batteryLevelmV;
 
-  measuredLevel = HW_AdcReadChannel(LL_ADC_CHANNEL_VREFINT);
+  measuredLevel = HW_AdcReadChannels(0, 0, 0);
+  batteryLevelmV = HW_VrefintToBatteryLevel_mv(measuredLevel);
 
-  if (measuredLevel == 0)
-  {
-    batteryLevelmV = 0;
-  }
-  else
-  {
-    batteryLevelmV = (((uint32_t) VDDA_VREFINT_CAL * (*VREFINT_CAL)) / measuredLevel);
-  }
   if (batteryLevelmV > VDD_BAT)
   {
     batteryLevel = LORAWAN_MAX_BAT;
@@ -495,6 +463,8 @@ void LPM_EnterStopMode(void)
   /*clear wake up flag*/
   LL_PWR_ClearFlag_WU();
 
+  clock_stop_enter();
+
   RESTORE_PRIMASK();
 
   /* Enter Stop Mode - is a LL implementatin of HAL_PWR_EnterSTOPMode(PWR_LOWPOWERREGULATOR_ON, PWR_STOPENTRY_WFI) */
@@ -522,36 +492,12 @@ void LPM_EnterStopMode(void)
 
 void LPM_ExitStopMode(void)
 {
-  /* Disable IRQ while the MCU is not running on HSI */
+  /* Disable IRQ until the system clock is restored */
   BACKUP_PRIMASK();
   DISABLE_IRQ();
 
-  /* After wake-up from STOP reconfigure the system clock */
-  /* Enable HSI */
-  LL_RCC_HSI_Enable();
-
-  /* Wait till HSI is ready */
-  while (LL_RCC_HSI_IsReady() == RESET)
-  {
-    ;
-  }
-
-  /* Enable PLL */
-  LL_RCC_PLL_Enable();
-  /* Wait till PLL is ready */
-  while (LL_RCC_PLL_IsReady() == RESET)
-  {
-    ;
-  }
-
-  /* Select PLL as system clock source */
-  LL_RCC_SetSysClkSource(LL_RCC_SYS_CLKSOURCE_PLL);
-
-  /* Wait till PLL is used as system clock source */
-  while (LL_RCC_GetSysClkSource() != LL_RCC_SYS_CLKSOURCE_STATUS_PLL)
-  {
-    ;
-  }
+  /* After wake-up from STOP (on MSI) restore the profile the clock manager asks for */
+  clock_stop_exit();
 
   /*initilizes the peripherals*/
   HW_IoInit();
@@ -579,8 +525,12 @@ void LPM_EnterSleepMode(void)
   /* Clear SLEEPDEEP bit of Cortex System Control Register */
   LL_LPM_EnableSleep();
 
+  clock_sleep_enter();
+
   /* Select SLEEP mode entry -------------------------------------------------*/
   __WFI();
+
+  clock_sleep_exit();
 }
 
 /* Private functions ---------------------------------------------------------*/
@@ -1079,87 +1029,16 @@ static void HW_ADC_Start()
   }
 }
 
-static void HW_ADC_PollForConversion()
+static uint8_t HW_ADC_ScanSlot(uint32_t selected, uint32_t channel)
 {
-  /* Check the parameters */
-  assert_param(IS_ADC_ALL_INSTANCE(adcinit_Instance));
-  assert_param((adcinit_EOCSelection == LL_ADC_FLAG_EOC) || (adcinit_EOCSelection == LL_ADC_FLAG_EOS));
+  uint32_t below = selected & ADC_CHANNEL_ID_BITFIELD_MASK & ((channel & ADC_CHANNEL_ID_BITFIELD_MASK) - 1);
+  uint8_t slot = 0;
 
-  /* If end of conversion selected to end of sequence */
-  if (adcinit_EOCSelection == LL_ADC_FLAG_EOS)
-  {
-    Error_Handler();  /* EOS is not implemented */
-  }
-  /* If end of conversion selected to end of each conversion */
-  else /* ADC_EOC_SINGLE_CONV */
+  for (; below; below &= below - 1)
   {
-    /* Verification that ADC configuration is compliant with polling for      */
-    /* each conversion:                                                       */
-    /* Particular case is ADC configured in DMA mode and ADC sequencer with   */
-    /* several ranks and polling for end of each conversion.                  */
-    /* For code simplicity sake, this particular case is generalized to       */
-    /* ADC configured in DMA mode and and polling for end of each conversion. */
-    if (READ_BIT(adcinit_Instance->CFGR1, ADC_CFGR1_DMAEN))
-    {
-      /* Update ADC state machine to error */
-      SET_BIT(adc_state, HAL_ADC_STATE_ERROR_CONFIG);
-      return;
-    }
-  }
-
-  /* Wait until End of Conversion flag is raised */
-  while (LL_ADC_IsActiveFlag_EOC(adcinit_Instance) == 0)
-  {
-    ;
-  }
-  while (LL_ADC_REG_IsConversionOngoing(adcinit_Instance))
-  {
-    ;
-  }
-
-  /* Update ADC state machine */
-  SET_BIT(adc_state, HAL_ADC_STATE_REG_EOC);
-
-  /* Determine whether any further conversion upcoming on group regular       */
-  /* by external trigger, continuous mode or scan sequence on going.          */
-  if (LL_ADC_REG_IsTriggerSourceSWStart(adcinit_Instance) &&
-      (adcinit_ContinuousConvMode == LL_ADC_REG_CONV_SINGLE))
-  {
-    if (LL_ADC_IsActiveFlag_EOS(adcinit_Instance))
-    {
-      /* Allowed to modify bits ADC_IT_EOC/ADC_IT_EOS only if bit             */
-      /* ADSTART==0 (no conversion on going)                                  */
-      if (!LL_ADC_REG_IsConversionOngoing(adcinit_Instance))
-      {
-        /* Disable ADC end of single conversion interrupt on group regular */
-        /* Note: Overrun interrupt was enabled with EOC interrupt in          */
-        /* HAL_Start_IT(), but is not disabled here because can be used       */
-        /* by overrun IRQ process below.                                      */
-        LL_ADC_DisableIT_EOS(adcinit_Instance);
-        LL_ADC_DisableIT_EOC(adcinit_Instance);
-
-        /* Set ADC state */
-        CLEAR_BIT(adc_state, HAL_ADC_STATE_REG_BUSY);
-        SET_BIT(adc_state, HAL_ADC_STATE_READY);
-      }
-      else
-      {
-        /* Change ADC state to error state */
-        SET_BIT(adc_state, HAL_ADC_STATE_ERROR_CONFIG);
-      }
-    }
-  }
-
-  /*
-   * Clear end of conversion flag of regular group if low power feature
-   * "LowPowerAutoWait " is disabled, to not interfere with this feature
-   * until data register is read using function HAL_ADC_GetValue().
-   */
-  if (adcinit_LowPowerAutoWait == LL_ADC_LP_MODE_NONE)
-  {
-    /* Clear regular group conversion flag */
-    LL_ADC_ClearFlag_EOC(adcinit_Instance);
+    slot++;
   }
+  return slot;
 }
 
 static void HW_AdcInit(void)
@@ -1179,59 +1058,115 @@ static void HW_AdcInit(void)
   }
 }
 
-uint16_t HW_AdcReadChannel(uint32_t Channel)
+uint16_t HW_AdcReadChannels(const uint32_t *Channels, uint16_t *Results, uint8_t Count)
 {
-  uint16_t adcData = 0;
-  if (AdcInitialized == SET)
+  uint16_t scanData[HW_ADC_MAX_CHANNELS + 1] = {0};
+  uint32_t selected = LL_ADC_CHANNEL_VREFINT;
+  uint32_t bitfield;
+  uint32_t conversions = 0;
+  uint32_t dmaWasEnabled;
+  uint8_t i;
+
+  if ((AdcInitialized == RESET) || (Count > HW_ADC_MAX_CHANNELS))
   {
-    LL_APB2_GRP1_EnableClock(LL_APB2_GRP1_PERIPH_ADC1);
-    /* wait the the Vrefint used by adc is set */
-    while (LL_PWR_IsActiveFlag_VREFINTRDY() == RESET)
-    {
-      ;
-    }
-
-    /*calibrate ADC if any calibraiton hardware*/
-    LL_ADC_StartCalibration(adcinit_Instance);
-    while (LL_ADC_IsCalibrationOnGoing(adcinit_Instance) == 0)
-    {
-      ;
-    }
+    return 0;
+  }
 
-    /* Enable the ADC, but after few cycles once the calibration is completed */
-    volatile int i = 32 * LL_ADC_DELAY_CALIB_ENABLE_ADC_CYCLES;
-    while (i)
-    {
-      i--;
-    }
-    LL_ADC_Enable(adcinit_Instance);
-    while (LL_ADC_IsActiveFlag_ADRDY(adcinit_Instance) == 0)
-    {
-      ;
-    }
+  for (i = 0; i < Count; i++)
+  {
+    selected |= Channels[i];
+  }
 
-    /* Deselects all channels*/
-    HW_ADC_DeselectChannel();
+  /* the sequencer converts the selected channels once each, in channel order */
+  for (bitfield = selected & ADC_CHANNEL_ID_BITFIELD_MASK; bitfield; bitfield &= bitfield - 1)
+  {
+    conversions++;
+  }
 
-    /* configure adc channel */
-    HW_ADC_SelectChannel(Channel);
+  LL_APB2_GRP1_EnableClock(LL_APB2_GRP1_PERIPH_ADC1);
+  /* wait the the Vrefint used by adc is set */
+  while (LL_PWR_IsActiveFlag_VREFINTRDY() == RESET)
+  {
+    ;
+  }
 
-    /* Start the conversion process */
-    HW_ADC_Start();
+  /* single calibration for the whole scan, ADC must be disabled */
+  LL_ADC_StartCalibration(adcinit_Instance);
+  while (LL_ADC_IsCalibrationOnGoing(adcinit_Instance) != 0)
+  {
+    ;
+  }
+  /* Enable the ADC, but after few cycles once the calibration is completed */
+  HW_ADC_DelayMicroSecond(1);
+
+  /* 16x hardware oversampling on each channel, shifted back to 12 bits */
+  LL_ADC_SetOverSamplingScope(adcinit_Instance, LL_ADC_OVS_GRP_REGULAR_CONTINUED);
+  LL_ADC_ConfigOverSamplingRatioShift(adcinit_Instance, LL_ADC_OVS_RATIO_16, LL_ADC_OVS_SHIFT_RIGHT_4);
+
+  /* DMA1 channel 1 is the ADC request, one shot transfer of the sequence */
+  dmaWasEnabled = LL_AHB1_GRP1_IsEnabledClock(LL_AHB1_GRP1_PERIPH_DMA1);
+  LL_AHB1_GRP1_EnableClock(LL_AHB1_GRP1_PERIPH_DMA1);
+  LL_DMA_DisableChannel(DMA1, LL_DMA_CHANNEL_1);
+  LL_DMA_SetPeriphRequest(DMA1, LL_DMA_CHANNEL_1, LL_DMA_REQUEST_0);
+  LL_DMA_ConfigTransfer(DMA1, LL_DMA_CHANNEL_1,
+                        LL_DMA_DIRECTION_PERIPH_TO_MEMORY |
+                        LL_DMA_MODE_NORMAL                |
+                        LL_DMA_PERIPH_NOINCREMENT         |
+                        LL_DMA_MEMORY_INCREMENT           |
+                        LL_DMA_PDATAALIGN_HALFWORD        |
+                        LL_DMA_MDATAALIGN_HALFWORD        |
+                        LL_DMA_PRIORITY_LOW);
+  LL_DMA_ConfigAddresses(DMA1, LL_DMA_CHANNEL_1,
+                         LL_ADC_DMA_GetRegAddr(adcinit_Instance, LL_ADC_DMA_REG_REGULAR_DATA),
+                         (uint32_t)scanData,
+                         LL_DMA_DIRECTION_PERIPH_TO_MEMORY);
+  LL_DMA_SetDataLength(DMA1, LL_DMA_CHANNEL_1, conversions);
+  LL_DMA_ClearFlag_GI1(DMA1);
+  LL_DMA_EnableChannel(DMA1, LL_DMA_CHANNEL_1);
+  LL_ADC_REG_SetDMATransfer(adcinit_Instance, LL_ADC_REG_DMA_TRANSFER_LIMITED);
+
+  HW_ADC_DeselectChannel();
+  HW_ADC_SelectChannel(selected);
+
+  /* enables the ADC, then runs the whole sequence */
+  HW_ADC_Start();
+
+  while ((LL_DMA_IsActiveFlag_TC1(DMA1) == 0) && (LL_DMA_IsActiveFlag_TE1(DMA1) == 0))
+  {
+    ;
+  }
 
-    /* Wait for the end of conversion */
-    HW_ADC_PollForConversion();
+  LL_DMA_DisableChannel(DMA1, LL_DMA_CHANNEL_1);
+  LL_DMA_ClearFlag_GI1(DMA1);
+  if (!dmaWasEnabled)
+  {
+    LL_AHB1_GRP1_DisableClock(LL_AHB1_GRP1_PERIPH_DMA1);
+  }
+  LL_ADC_REG_SetDMATransfer(adcinit_Instance, LL_ADC_REG_DMA_TRANSFER_NONE);
 
-    /* Get the converted value of regular channel */
-    adcData = LL_ADC_REG_ReadConversionData12(adcinit_Instance);
+  /* Implementation of __HAL_ADC_DISABLE(__HANDLE__) */
+  LL_ADC_Disable(adcinit_Instance);
+  LL_ADC_ClearFlag_EOSMP(adcinit_Instance);
+  LL_ADC_ClearFlag_ADRDY(adcinit_Instance);
+  LL_ADC_SetCommonPathInternalCh(ADC, LL_ADC_PATH_INTERNAL_NONE);
 
-    /* Implementation of __HAL_ADC_DISABLE(__HANDLE__) */
-    LL_ADC_Disable(adcinit_Instance);
-    LL_ADC_ClearFlag_EOSMP(adcinit_Instance);
-    LL_ADC_ClearFlag_ADRDY(adcinit_Instance);
+  LL_APB2_GRP1_DisableClock(LL_APB2_GRP1_PERIPH_ADC1);
 
-    LL_APB2_GRP1_DisableClock(LL_APB2_GRP1_PERIPH_ADC1);
+  /* the slot of a channel is the number of selected channels below it */
+  for (i = 0; i < Count; i++)
+  {
+    Results[i] = scanData[HW_ADC_ScanSlot(selected, Channels[i])];
   }
+
+  return scanData[HW_ADC_ScanSlot(selected, LL_ADC_CHANNEL_VREFINT)];
+}
+
+uint16_t HW_AdcReadChannel(uint32_t Channel)
+{
+  uint16_t adcData = 0;
+
+  HW_AdcReadChannels(&Channel, &adcData, 1);
+
   return adcData;
 }
 
@@ -62,6 +62,7 @@ Maintainer: Miguel Luis and Gregory Cristian
 #include "hw.h"
 #include "mlm32l0xx_it.h"
 #include "vcom.h"
+#include "stack_monitor.h"
 
 /* Private typedef -----------------------------------------------------------*/
 /* Private define ------------------------------------------------------------*/
@@ -72,24 +73,31 @@ Maintainer: Miguel Luis and Gregory Cristian
 
 void RTC_IRQHandler(void)
 {
+  stack_monitor_isr_enter();
   HW_RTC_IrqHandler();
+  stack_monitor_isr_exit();
 }
 
 void EXTI0_1_IRQHandler(void)
 {
+  stack_monitor_isr_enter();
   HW_GPIO_EXTI_IRQHandler(GPIO_PIN_0);
   HW_GPIO_EXTI_IRQHandler(GPIO_PIN_1);
+  stack_monitor_isr_exit();
 }
 
 void EXTI2_3_IRQHandler(void)
 {
+  stack_monitor_isr_enter();
   HW_GPIO_EXTI_IRQHandler(GPIO_PIN_2);
   HW_GPIO_EXTI_IRQHandler(GPIO_PIN_3);
+  stack_monitor_isr_exit();
 }
 
 
 void EXTI4_15_IRQHandler(void)
 {
+  stack_monitor_isr_enter();
   HW_GPIO_EXTI_IRQHandler(GPIO_PIN_4);
   HW_GPIO_EXTI_IRQHandler(GPIO_PIN_5);
   HW_GPIO_EXTI_IRQHandler(GPIO_PIN_6);
@@ -102,17 +110,21 @@ void EXTI4_15_IRQHandler(void)
   HW_GPIO_EXTI_IRQHandler(GPIO_PIN_13);
   HW_GPIO_EXTI_IRQHandler(GPIO_PIN_14);
   HW_GPIO_EXTI_IRQHandler(GPIO_PIN_15);
+  stack_monitor_isr_exit();
 }
 
 void UARTX_IRQHandler(void)
 {
+  stack_monitor_isr_enter();
   vcom_IRQHandler();
+  stack_monitor_isr_exit();
 }
 
 void DMA1_Channel4_5_6_7_IRQHandler(void)
 {
+  stack_monitor_isr_enter();
   vcom_Dma_IRQHandler();
-
+  stack_monitor_isr_exit();
 }
 
 /* Private functions ---------------------------------------------------------*/
@@ -26,6 +26,7 @@
 #include "radio_common.h"
 #include "adc.h"
 #include "flash_map.h"
+#include "fixed_point.h"
 
 
 //SD-123 Support 16 modbus slots
@@ -187,7 +188,6 @@ void genric_modbus_uplink()
 	uint8_t   sequence_number = 0;
 	uint16_t* write_head      = modbus_write_data;
 	int16_t   write_limit     = MAX_WRITE_SLOTS;
-	float     calc            = 0.0f;
 	
 	//turn on peripheral supply
 	LL_GPIO_SetOutputPin(PER_SUPPLY_ENABLE_PORT, PER_SUPPLY_ENABLE_PIN);
@@ -230,15 +230,10 @@ void genric_modbus_uplink()
 			temp[0] = modbus_read_adc();
 			Debug_printf("ADC Reading: %d\r\n", temp[0]);
 			
-			calc = (float)temp[0];
-			calc = calc * 3.3;
 			//10.9 ~= 1/(1+10) from the 10:1 resistive divider
-			calc = calc * 10.9;
-			//4095, full scale of the ADC
-			calc = calc / 4095;
-			temp[1] = (int)calc;
-			calc = calc * 100;
-			temp[2] = (int)calc - (100*temp[1]);
+			temp[2] = fxp_ext_voltage_centi(temp[0]);
+			temp[1] = temp[2] / 100;
+			temp[2] = temp[2] % 100;
 			Debug_printf("Ext Voltage %d.%02d(10:1 res div)\r\n",temp[1],temp[2]);
 			//store it in the result register, and update transaction_result
 			transaction_result.read  = 1;
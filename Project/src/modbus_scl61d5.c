@@ -8,12 +8,19 @@
                                            
                                            
                                            
-	Description: Device driver for the UMG604 Power meter.
+	Description: Device driver for the SCL-61D5 water meter.
+								Instant flow is read over Modbus and summarised on the device,
+								one summary per reads_per_uplink scheduled wakeups (a day at
+								the defaults). Readings follow the flow: while it is steady
+								they back off to every 8th wakeup, on a change they speed up
+								to 4 per wakeup, and come back down a step at a time.
 
 	Maintainer: Shea Gosnell
 
 */
 
+#include <string.h>
+#include <stdlib.h>
 #include "global.h"
 #include "modbus_uart.h"
 #include "stm32l0xx.h"                  // Device header
@@ -23,6 +30,12 @@
 #include "watchdog.h"
 #include "flash_map.h"
 #include "radio_common.h"
+#include "fixed_point.h"
+#include "timeServer.h"
+#include "event_loop.h"
+#include "stream_stats.h"
+#include "payload_schemas.h"
+#include "modbus_scl61d5.h"
 
 #ifndef DISABLE_MODBUS_DEBUG
 	#define DBG_printf(...) Debug_printf(__VA_ARGS__)
@@ -35,129 +48,305 @@
 #define  SCL61D5_READ_FUNCTION 3
 #define  SCL61D5_INSTNAT_FLOW_SIZE 2 //registers
 
-#define FLOAT_MIN -3.4e38
-#define FLOAT_MAX  3.4e38
-
-typedef union
-{
-	uint32_t uint32;
-	float flt;
-} b32_converter_t;
-
-
-float    watermark_high = FLOAT_MIN;
-uint16_t watermark_high_TOD = 0;
-
-float    watermark_low = FLOAT_MAX;
-uint16_t watermark_low_TOD = 0;
-
+//readings every 2^shift scheduled wakeups
+#define  SCL61D5_SHIFT_FAST  -2
+#define  SCL61D5_SHIFT_SLOW   3
+//a reading within 1/16th of the last, or within this many thousandths of the
+//unit for flows near zero, is steady
+#define  SCL61D5_STEADY_SHIFT 4
+#define  SCL61D5_STEADY_MILLI 50
 
+//summary times are 11 bit minutes, this one means none
+#define  SCL61D5_NO_TIME      2047
+#define  SCL61D5_MAX_FAILURES 31
+#define  SCL61D5_MAX_SAMPLES  2047
+#define  SCL61D5_MAX_CROSSING 63
 
 uint16_t reads_per_uplink = 288;
 uint8_t  device_address = 1;
+//flow threshold in thousandths of the meter unit, SCL61D5_THRESHOLD_OFF for none
+int32_t  flow_threshold = SCL61D5_THRESHOLD_OFF;
+
+static stream_stats_t flow_stats;
+static uint32_t       window_start_ms;
+static bool           window_started = false;
+static uint16_t       uplink_counter = 0;
+static uint8_t        read_failures  = 0;
+
+static int8_t         sample_shift    = 0;
+static uint8_t        ticks_to_sample = 0;
+static uint8_t        fast_remaining  = 0;
+static uint32_t       tick_at_ms;
+static TimerEvent_t   fast_timer;
+static bool           fast_timer_ready = false;
+static volatile bool  fast_due = false;
 
-float scl61d5_get_instant_flow()
+//The meter reports flow as an IEEE754 single, returned here as the raw bits.
+static bool scl61d5_get_instant_flow(uint32_t *bits)
 {
 	uint16_t temp[SCL61D5_INSTNAT_FLOW_SIZE] = {0};
 	modbus_transaction_result_t read_registers = {0};
-	
+
 	modbus_register_t reg = {0};
-	
+
 	reg.slaveID        = device_address               ;
 	reg.function_code  = SCL61D5_READ_FUNCTION        ;
 	reg.start_Register = SCL61D5_INSTANT_FLOW_REGISTER;
 	reg.register_count = SCL61D5_INSTNAT_FLOW_SIZE    ;
-	
-	
+
+
 	read_registers = modbus_transaction(reg, temp, (void*)0, SCL61D5_INSTNAT_FLOW_SIZE, 0);
-	
+
 	if(read_registers.read == 2)
 	{
-		//now convert the 2*uint16_t to float
-		b32_converter_t converter;
-		converter.uint32 = (((uint32_t)temp[0])<<16)+temp[1];
-		return converter.flt;
+		//now combine the 2*uint16_t into the raw float
+		*bits = (((uint32_t)temp[0])<<16)+temp[1];
+		return true;
 	}
-	else
+	return false;
+}
+
+static uint32_t window_seconds(void)
+{
+	return TimerGetElapsedTime(window_start_ms) / 1000;
+}
+
+static void window_restart(void)
+{
+	stream_stats_reset(&flow_stats, flow_threshold);
+	window_start_ms = TimerGetCurrentTime();
+	window_started  = true;
+	uplink_counter  = 0;
+	read_failures   = 0;
+}
+
+//this is a callback from the timer interrupt
+static void scl61d5_fast_timeout(void)
+{
+	fast_due = true;
+	event_post(event_device);
+}
+
+//Plans the readings after this one. From a shift of 0 up they fall on the
+//scheduled wakeups, below that the fast timer fills in between them.
+static void scl61d5_schedule(void)
+{
+	uint32_t period;
+	uint32_t since_tick;
+
+	TimerStop(&fast_timer);
+	fast_remaining = 0;
+
+	if(sample_shift >= 0)
+	{
+		ticks_to_sample = (1 << sample_shift) - 1;
+		return;
+	}
+
+	//the next scheduled wakeup reads anyway, so only the gaps before it are timed
+	ticks_to_sample = 0;
+	period          = transmit_interval_ms >> -sample_shift;
+	since_tick      = TimerGetElapsedTime(tick_at_ms);
+	if(since_tick < transmit_interval_ms)
 	{
-		return 0.0;
+		fast_remaining = (transmit_interval_ms - since_tick - 1) / period;
+	}
+
+	if(fast_remaining > 0)
+	{
+		TimerSetValue(&fast_timer, period);
+		TimerStart(&fast_timer);
 	}
 }
 
-//fairly certain that this will be removed soon. The whole file is likely redundant
+static void scl61d5_adapt(int32_t reading)
+{
+	int32_t band;
+
+	if(flow_stats.count == 0)
+	{
+		return;
+	}
+
+	band = abs(flow_stats.last) >> SCL61D5_STEADY_SHIFT;
+	if(band < SCL61D5_STEADY_MILLI)
+	{
+		band = SCL61D5_STEADY_MILLI;
+	}
+
+	if(abs(reading - flow_stats.last) > band)
+	{
+		sample_shift = SCL61D5_SHIFT_FAST;
+	}
+	else if(sample_shift < SCL61D5_SHIFT_SLOW)
+	{
+		sample_shift++;
+	}
+}
+
+static void scl61d5_sample(void)
+{
+	uint32_t bits;
+	int32_t  reading;
+
+	DBG_printf("Reading Flow\r\n");
+	if(!scl61d5_get_instant_flow(&bits))
+	{
+		DBG_printf("Flow read failed\r\n");
+		if(read_failures < SCL61D5_MAX_FAILURES)
+		{
+			read_failures++;
+		}
+		//try again at the next wakeup
+		ticks_to_sample = 0;
+		return;
+	}
+
+	reading = fxp_float32_to_milli(bits);
+	scl61d5_adapt(reading);
+	stream_stats_add(&flow_stats, reading, window_seconds());
+
+	DBG_printf("Flow %d.%03u, shift %d\r\n", reading/1000, abs(reading%1000), sample_shift);
+	scl61d5_schedule();
+}
+
+static int32_t minute_of_window(uint32_t time_s)
+{
+	if(time_s == UINT32_MAX)
+	{
+		return SCL61D5_NO_TIME;
+	}
+	return ((time_s / 60) < SCL61D5_NO_TIME) ? (time_s / 60) : (SCL61D5_NO_TIME - 1);
+}
+
+static void scl61d5_summary_values(int32_t values[])
+{
+	values[flow_summary_value_samples]   = (flow_stats.count < SCL61D5_MAX_SAMPLES) ? flow_stats.count : SCL61D5_MAX_SAMPLES;
+	values[flow_summary_value_failures]  = read_failures;
+	values[flow_summary_value_mean]      = stream_stats_mean(&flow_stats);
+	values[flow_summary_value_min]       = flow_stats.min;
+	values[flow_summary_value_max]       = flow_stats.max;
+	values[flow_summary_value_min_tod]   = minute_of_window(flow_stats.min_time_s);
+	values[flow_summary_value_max_tod]   = minute_of_window(flow_stats.max_time_s);
+	//thousandths of the unit per hour over hours, litres for a meter in m3/h
+	values[flow_summary_value_volume]    = stream_stats_integral(&flow_stats, 3600);
+	values[flow_summary_value_stddev]    = stream_stats_stddev(&flow_stats);
+	values[flow_summary_value_p10]       = stream_stats_quantile(&flow_stats, stream_quantile_p10);
+	values[flow_summary_value_p50]       = stream_stats_quantile(&flow_stats, stream_quantile_p50);
+	values[flow_summary_value_p90]       = stream_stats_quantile(&flow_stats, stream_quantile_p90);
+	values[flow_summary_value_crossings] = (flow_stats.crossings < SCL61D5_MAX_CROSSING) ? flow_stats.crossings : SCL61D5_MAX_CROSSING;
+	values[flow_summary_value_first_up]  = minute_of_window(flow_stats.first_up_s);
+	values[flow_summary_value_last_down] = minute_of_window(flow_stats.last_down_s);
+	values[flow_summary_value_above]     = minute_of_window(flow_stats.above_s);
+	values[flow_summary_value_voltage]   = fourBit_battery_calculation();
+	values[flow_summary_value_type]      = packet_type_summary;
+}
+
+//a frame past the data rate's limit is still sent, as the interval meter does
+static transmit_status_e scl61d5_send(const codec_schema_t *schema, int32_t values[], flow_summary_layout_e layout)
+{
+	uint8_t payload[UPLINK_QUEUE_PAYLOAD_SIZE];
+	uint8_t length;
+
+	values[flow_summary_value_layout] = layout;
+	length = codec_encode(schema, values, payload, sizeof(payload));
+	if(length == 0)
+	{
+		return transmit_status_no_send;
+	}
+	return Uplink(payload, length);
+}
+
+//sends the summary so far, whole if the data rate allows it
 void scl61d5_uplink()
 {
-	//form packet using watermark
-	scl61d5_payload_t payload;
-	
-	payload.members.watermark_high = watermark_high;
-	payload.members.watermark_low  = watermark_low;
-	payload.members.high_tod = watermark_high_TOD;
-	payload.members.low_tod = watermark_low_TOD;
-	
-	payload.members.sys_voltage = fourBit_battery_calculation();
-	payload.members.pkt_type    = packet_type_data;
+	int32_t values[flow_summary_values] = {0};
+	uint8_t size = radio_max_payload();
+
+	//frames larger than the queue takes would go straight out and ignore the duty cycle
+	if(size > UPLINK_QUEUE_PAYLOAD_SIZE)
+	{
+		size = UPLINK_QUEUE_PAYLOAD_SIZE;
+	}
+
+	scl61d5_summary_values(values);
+
+	if(codec_encoded_bits(&flow_summary_schema, values) <= (size * 8))
+	{
+		scl61d5_send(&flow_summary_schema, values, flow_summary_layout_full);
+		return;
+	}
+
+	if(scl61d5_send(&flow_summary_core_schema, values, flow_summary_layout_core) == transmit_status_no_join)
+	{
+		return;
+	}
+	scl61d5_send(&flow_summary_detail_schema, values, flow_summary_layout_detail);
+}
+
+void scl61d5_init()
+{
+	modbus_init();
 
-	//uplink data
-	Uplink(payload.payload,SCL61D5_SIZE);
+	if(!fast_timer_ready)
+	{
+		TimerInit(&fast_timer, &scl61d5_fast_timeout);
+		fast_timer_ready = true;
+	}
+
+	if(!window_started)
+	{
+		window_restart();
+		tick_at_ms = window_start_ms;
+	}
 }
 
-//needs to get the current minute of day, in order to record watermark
-//wake up 1440 times, transmit once.
+//called every transmit interval
 void scl61d5_wakeup()
 {
-	static uint16_t uplink_counter = 0;
-	//get reading
-	float reading;
-	
-	Debug_printf("Reading Flow\r\n");
-	reading = scl61d5_get_instant_flow();
-	
 	uplink_counter++;
-	
-	//compare to watermark
-		//if higher, record new watermark and time of day
-		//if lower, ignore
-	if(reading > watermark_high)
+	tick_at_ms = TimerGetCurrentTime();
+
+	if(ticks_to_sample == 0)
 	{
-		Debug_printf("New High Watermark set\r\n");
-		watermark_high = reading;
-		watermark_high_TOD = uplink_counter;
+		scl61d5_sample();
 	}
-	
-	if(reading < watermark_low)
+	else
 	{
-		Debug_printf("New Low Watermark set\r\n");
-		watermark_low = reading;
-		watermark_low_TOD = uplink_counter;
+		ticks_to_sample--;
 	}
-	
 
-	
-	//at end of day, uplink the watermark, and reset.
+	//at end of day, uplink the summary, and reset.
 	if(uplink_counter >= reads_per_uplink)
 	{
-		Debug_printf("Sending data and resetting watermarks\r\n");
-		//uplink watermark
+		DBG_printf("Sending flow summary of %u readings\r\n", flow_stats.count);
 		scl61d5_uplink();
-		//reset
-		watermark_high     = FLOAT_MIN;
-		watermark_low      = FLOAT_MAX;
-		watermark_high_TOD = 0;
-		watermark_low_TOD  = 0;
-		
-		//reset uplink counter
-		uplink_counter = 0;
+		window_restart();
+	}
+}
+
+void scl61d5_on_each_wakeup()
+{
+	if(!fast_due)
+	{
+		return;
+	}
+	fast_due = false;
+
+	if(fast_remaining > 0)
+	{
+		scl61d5_sample();
 	}
 }
 
 void scl61d5_save_config()
 {
 	scl61d5_config_page_layout_t config = {0};
-	
+
 	config.members.reads_per_uplink = reads_per_uplink;
 	config.members.device_address   = device_address  ;
-	
+	config.members.flow_threshold   = (flow_threshold == SCL61D5_THRESHOLD_OFF) ? 0 : flow_threshold;
+
 	save_extra_config_page(config.raw_bytes, device_specific_page_1);
 }
 
@@ -165,9 +354,11 @@ void scl61d5_load_config()
 {
 	scl61d5_config_page_layout_t config = {0};
 	load_extra_config_page(config.raw_bytes, device_specific_page_1);
-	
+
 	reads_per_uplink = config.members.reads_per_uplink;
 	device_address   = config.members.device_address  ;
+	//pages saved before the threshold was added read as 0
+	flow_threshold   = (config.members.flow_threshold == 0) ? SCL61D5_THRESHOLD_OFF : config.members.flow_threshold;
 }
 
 
@@ -177,20 +368,20 @@ void scl61d5Downlink(uint8_t *buffer, uint8_t size)
 {
 	scl61d5_downlink_t downlink = {0};
 	int i;
-	
+
 	Debug_printf("SCL61D5 Downlink Function\r\n");
 	Debug_printf("Received Data: ");
 	await_uart_tx();
-	
+
 	for(i=0;i<size;i++)
 	{
 		Debug_printf(" %02X", buffer[i]);
 		downlink.payload[SCL61D5_DOWNLINK_SIZE-i-1] = buffer[i];
 	}
-	
+
 	Debug_printf("\r\n");
 	await_uart_tx();
-	
+
 	if(downlink.config.downlink_type == downlink_type_scl61d5_config)
 	{
 		Debug_printf("Downlink scl61d5_config Type OK\r\n");
@@ -199,7 +390,7 @@ void scl61d5Downlink(uint8_t *buffer, uint8_t size)
 			reads_per_uplink = downlink.config.reads_per_uplink;
 			Debug_printf("New reads per uplink: %d\r\n", reads_per_uplink);
 		}
-		
+
 		if(downlink.config.device_address != 0)
 		{
 			device_address = downlink.config.device_address;
@@ -207,8 +398,110 @@ void scl61d5Downlink(uint8_t *buffer, uint8_t size)
 		}
 	}
 
-	
+
 	//because one of config or data must have changed, we should save them
 	save_config();
 }
 
+static void print_milli(const char *label, int32_t milli)
+{
+	Debug_printf("%s: %s%d.%03u\r\n", label, (milli < 0) ? "-" : "", abs(milli / 1000), abs(milli % 1000));
+	await_uart_tx();
+}
+
+static void print_minute(const char *label, uint32_t time_s)
+{
+	if(time_s == UINT32_MAX)
+	{
+		Debug_printf("%s: none\r\n", label);
+	}
+	else
+	{
+		Debug_printf("%s: minute %u\r\n", label, time_s / 60);
+	}
+	await_uart_tx();
+}
+
+static void scl61d5_print(void)
+{
+	Debug_printf("Readings      : %u, %u failed\r\n", flow_stats.count, read_failures);
+	Debug_printf("Wakeups       : %u of %u\r\n", uplink_counter, reads_per_uplink);
+	Debug_printf("Read every    : 2^%d wakeups\r\n", sample_shift);
+	await_uart_tx();
+	if(flow_threshold == SCL61D5_THRESHOLD_OFF)
+	{
+		Debug_printf("Threshold     : off\r\n");
+	}
+	else
+	{
+		print_milli("Threshold     ", flow_threshold);
+	}
+	if(flow_stats.count == 0)
+	{
+		return;
+	}
+	print_milli ("Mean          ", stream_stats_mean(&flow_stats));
+	print_milli ("Std deviation ", stream_stats_stddev(&flow_stats));
+	print_milli ("Min           ", flow_stats.min);
+	print_minute("  at          ", flow_stats.min_time_s);
+	print_milli ("Max           ", flow_stats.max);
+	print_minute("  at          ", flow_stats.max_time_s);
+	print_milli ("P10           ", stream_stats_quantile(&flow_stats, stream_quantile_p10));
+	print_milli ("P50           ", stream_stats_quantile(&flow_stats, stream_quantile_p50));
+	print_milli ("P90           ", stream_stats_quantile(&flow_stats, stream_quantile_p90));
+	print_milli ("Volume        ", stream_stats_integral(&flow_stats, 3600));
+	Debug_printf("Crossings     : %u\r\n", flow_stats.crossings);
+	await_uart_tx();
+	print_minute("First up      ", flow_stats.first_up_s);
+	print_minute("Last down     ", flow_stats.last_down_s);
+	Debug_printf("Minutes above : %u\r\n", flow_stats.above_s / 60);
+	await_uart_tx();
+}
+
+static void scl61d5_cli_help(void)
+{
+	Debug_printf("Usage: device flow show\r\n");
+	Debug_printf("\tShow the flow summary so far.\r\n");
+	await_uart_tx();
+	Debug_printf("Usage: device flow threshold [value|off]\r\n");
+	Debug_printf("\tSet the flow threshold crossings are timed against,\r\n");
+	Debug_printf("\tin the meter's unit. Applies from the next summary.\r\n");
+	await_uart_tx();
+}
+
+void scl61d5_cli(int argc, char *argv[])
+{
+	int32_t threshold;
+
+	if((argc < 2) || strcmp(argv[0], "flow"))
+	{
+		scl61d5_cli_help();
+		return;
+	}
+
+	if((argc == 2) && !strcmp(argv[1], "show"))
+	{
+		scl61d5_print();
+		return;
+	}
+
+	if((argc != 3) || strcmp(argv[1], "threshold"))
+	{
+		scl61d5_cli_help();
+		return;
+	}
+
+	if(!strcmp(argv[2], "off"))
+	{
+		threshold = SCL61D5_THRESHOLD_OFF;
+	}
+	else if(!fxp_parse_scaled(argv[2], 1000, &threshold) || (threshold == 0))
+	{
+		Debug_printf("Threshold must be a non-zero number, or off\r\n");
+		return;
+	}
+
+	flow_threshold = threshold;
+	save_config();
+	Debug_printf("Threshold set\r\n");
+}
@@ -26,6 +26,8 @@
 #include "global.h"
 #include "counter.h"
 #include "adc.h"
+#include "clock_manager.h"
+#include "buffer_arena.h"
 
 #define MODBUS_RETRY_MAX 5
 
@@ -52,6 +54,7 @@ volatile static LPUART_TDR_t *REG_Modbus_TDR = LPUART1_TDR_ADDR;
 volatile static LPUART_RDR_t *REG_Modbus_RDR = LPUART1_RDR_ADDR;
 volatile static LPUART_BRR_t *REG_Modbus_BRR = LPUART1_BRR_ADDR;
 volatile static LPUART_CR1_t *REG_Modbus_CR1 = LPUART1_CR1_ADDR;
+volatile static LPUART_CR3_t *REG_Modbus_CR3 = LPUART1_CR3_ADDR;
 volatile static LPUART_ISR_t *REG_Modbus_ISR = LPUART1_ISR_ADDR;
 
 
@@ -167,6 +170,30 @@ void modbus_disable_pins()
 	modbus_disable_rx_pin();
 }
 
+//LPUART BRR is 256 times the kernel clock over the baud rate
+static uint32_t modbus_brr(void)
+{
+	return (uint32_t)((((uint64_t)clock_kernel_hz() * 256) + (MODBUS_BAUD/2)) / MODBUS_BAUD);
+}
+
+//The clock manager has switched the system clock. The 1-Wire driver shares the
+//LPUART in half-duplex and sets its own baud for each transaction.
+void modbus_clock_changed()
+{
+	if(!REG_Modbus_CLKEN->LPUART1EN || !REG_Modbus_CR1->UE)
+	{
+		return;
+	}
+	
+	REG_Modbus_CR1->UE = 0;
+	REG_Modbus_CLKSEL->LPUSART1_SEL = clock_kernel_select();
+	if(!REG_Modbus_CR3->HDSEL)
+	{
+		REG_Modbus_BRR->BRR = modbus_brr();
+	}
+	REG_Modbus_CR1->UE = 1;
+}
+
 void modbus_init()
 {
 		//USART disable
@@ -176,8 +203,8 @@ void modbus_init()
 		//set up the registers for USART
 	
 		//Enable the peripheral clock of USART1
-		//HSI16 clock
-		REG_Modbus_CLKSEL->LPUSART1_SEL = 2;
+		//HSI16 clock, or SYSCLK while the clock manager has HSI16 off
+		REG_Modbus_CLKSEL->LPUSART1_SEL = clock_kernel_select();
 	
 		//Enable the clock
 		REG_Modbus_CLKEN->LPUART1EN = 1;
@@ -191,10 +218,12 @@ void modbus_init()
 			//Leave at default for 8N1 operation
 		//Baud
 		
-		REG_Modbus_BRR->BRR = 426667;
+		REG_Modbus_BRR->BRR = modbus_brr();
 		
 		//Stop Bits
 			//Leave at default for 8N1
+		//Full duplex, the 1-Wire driver may have left the LPUART in half-duplex
+		REG_Modbus_CR3->HDSEL = 0;
 		//Transmit Enable
 		REG_Modbus_CR1->TE = 1;
 		//Receive enable
@@ -395,12 +424,11 @@ int modbus_write_registers(modbus_register_t modbus_register, uint16_t *transmit
 	return modbus_register.register_count;
 }
 
-int modbus_read_registers(modbus_register_t modbus_register, uint16_t *receive_buffer)
+static int modbus_read_registers_into(modbus_register_t modbus_register, uint16_t *receive_buffer, uint8_t *rx_buffer)
 {
 	static TimerEvent_t read_timeout_timer;
 	uint8_t txData[8];
-	uint8_t rx_buffer[260];
-	uint16_t rx_buffer_length = 260;
+	uint16_t rx_buffer_length;
 	//to read a register, transmit a request frame, and read the response
 	//to read a holding register, use function 3
 	uint16_t crc;
@@ -520,6 +548,29 @@ int modbus_read_registers(modbus_register_t modbus_register, uint16_t *receive_b
 	return rx_buffer_length;
 }
 
+//the response frame is borrowed from the arena for the length of the read
+int modbus_read_registers(modbus_register_t modbus_register, uint16_t *receive_buffer)
+{
+	arena_mark_t mark = arena_mark();
+	uint8_t *rx_buffer;
+	int result;
+
+	if(modbus_register.register_count > ARENA_MODBUS_REGISTERS_MAX)
+	{
+		return modbus_error_count;
+	}
+
+	rx_buffer = arena_alloc(arena_owner_modbus_rx, (2*modbus_register.register_count) + 5);
+	if(rx_buffer == NULL)
+	{
+		return modbus_error_no_memory;
+	}
+
+	result = modbus_read_registers_into(modbus_register, receive_buffer, rx_buffer);
+	arena_release(mark);
+	return result;
+}
+
 //Note the void pointers for the read and write buffers, these are necessary because the coil/inputs are 8-bit orineted, while the registes are 16-bit oritented
 modbus_transaction_result_t modbus_transaction(modbus_register_t modbus_register, uint16_t *read_data, uint16_t *write_data, uint16_t read_limit, uint16_t write_limit)
 {
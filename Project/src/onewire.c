@@ -7,7 +7,20 @@
  |_____/ \___|_| |_|_____/ \__,_|_| |_| |_|
                                            
                                            
-	Description:	
+	Description:	1-Wire bus master.
+
+	The bus is driven by a UART in half-duplex mode wherever the OWP pin has a
+	UART TX mapping. Each 1-Wire slot is one UART frame, so the UART hardware
+	produces the bit timing and interrupts stay enabled for the whole transfer:
+		Reset   : 0xF0 at 9600 baud, any other echo means a slave answered
+		Write 1 : 0xFF at 115200 baud (~9uS low)
+		Write 0 : 0x00 at 115200 baud (~78uS low)
+		Read    : 0xFF at 115200 baud, echo of 0xFF is a 1, anything else is a 0
+
+	Pins without a UART mapping (COUNT1 on HW1.3) fall back to a GPIO master
+	timed by TIM22. Only the few microseconds around each sample point are run
+	with interrupts disabled, the rest of the slot can be stretched by an ISR
+	without corrupting the bus.
 
 	Maintainer: Shea Gosnell
 
@@ -18,15 +31,132 @@
 #include "i2c1.h"
 #include "sht20.h"
 #include "stm32l0xx.h"                  // Device header
+#include "stm32l0xx_ll_tim.h"
 #include "hw.h"
 #include "debug_uart.h"
 #include "lora_sensum.h"
 #include "utilities.h"
 #include "delays.h"
+#include "onewire.h"
+#include "clock_manager.h"
+
+#define OWP_RESET_BAUD 9600
+#define OWP_DATA_BAUD  115200
+
+#define OWP_RESET_FRAME 0xF0
+#define OWP_ONE_FRAME   0xFF
+#define OWP_ZERO_FRAME  0x00
+
+//GPIO fallback slot timings, all in uS from the falling edge of the slot
+#define OWP_GPIO_RESET_LOW_US      500
+#define OWP_GPIO_PRESENCE_US       70
+#define OWP_GPIO_RESET_RECOVERY_US 410
+#define OWP_GPIO_WRITE1_LOW_US     6
+#define OWP_GPIO_WRITE0_LOW_US     65
+#define OWP_GPIO_READ_LOW_US       3
+#define OWP_GPIO_READ_SAMPLE_US    12
+#define OWP_GPIO_SLOT_US           70
+
+typedef struct
+{
+	GPIO_TypeDef*  port;
+	uint16_t       pin;
+	USART_TypeDef* uart;
+	uint8_t        alternate;
+}owp_uart_map_t;
+
+//Every pin that the OWP driver is initialised on, which also has a UART TX
+//alternate function. The TX pin is the only pin used in half-duplex mode.
+static const owp_uart_map_t owp_uart_map[] =
+{
+	{GPIOA, GPIO_PIN_2, LPUART1, GPIO_AF6_LPUART1}, //MODBUS_TX
+	{GPIOA, GPIO_PIN_0, USART4 , GPIO_AF6_USART4 }, //COUNT1 on HW1.0 - HW1.2
+};
 
 uint16_t      OWP_PIN  = COUNT1_PIN ;
 GPIO_TypeDef* OWP_PORT = COUNT1_PORT;
 
+static const owp_uart_map_t* owp_uart = 0;
+
+/********************************************************************
+ *UART transport                                                    *
+ ********************************************************************/
+
+static void owp_uart_set_baud(uint32_t baud)
+{
+	LL_RCC_ClocksTypeDef clocks;
+
+	CLEAR_BIT(owp_uart->uart->CR1, USART_CR1_UE);
+
+	if(owp_uart->uart == LPUART1)
+	{
+		//LPUART1 runs from HSI16, or SYSCLK while the clock manager has HSI16 off
+		owp_uart->uart->BRR = (uint32_t)((((uint64_t)clock_kernel_hz() * 256) + (baud/2)) / baud);
+	}
+	else
+	{
+		//other USARTs run from PCLK1, read it back at the point of use, so
+		//the bit timing is correct whatever the system clock is set to.
+		LL_RCC_GetSystemClocksFreq(&clocks);
+		owp_uart->uart->BRR = (clocks.PCLK1_Frequency + (baud/2)) / baud;
+	}
+
+	SET_BIT(owp_uart->uart->CR1, USART_CR1_UE);
+}
+
+static void owp_uart_acquire(void)
+{
+	GPIO_InitTypeDef GPIO_InitStruct;
+
+	if(owp_uart->uart == LPUART1)
+	{
+		LL_RCC_SetLPUARTClockSource((clock_kernel_select() == 2) ? LL_RCC_LPUART1_CLKSOURCE_HSI : LL_RCC_LPUART1_CLKSOURCE_SYSCLK);
+		LL_APB1_GRP1_EnableClock(LL_APB1_GRP1_PERIPH_LPUART1);
+	}
+	else
+	{
+		LL_APB1_GRP1_EnableClock(LL_APB1_GRP1_PERIPH_USART4);
+	}
+
+	//The pin is shared with other functions (Modbus, pin change inputs), so
+	//the alternate function is applied at the start of every transaction.
+	GPIO_InitStruct.Mode      = GPIO_MODE_AF_PP;
+	GPIO_InitStruct.Pull      = GPIO_NOPULL;
+	GPIO_InitStruct.Speed     = GPIO_SPEED_FREQ_MEDIUM;
+	GPIO_InitStruct.Alternate = owp_uart->alternate;
+	HW_GPIO_Init(OWP_PORT, OWP_PIN, &GPIO_InitStruct);
+	//HW_GPIO_Init only does push-pull, the bus has an external pull-up
+	LL_GPIO_SetPinOutputType(OWP_PORT, OWP_PIN, LL_GPIO_OUTPUT_OPENDRAIN);
+
+	CLEAR_BIT(owp_uart->uart->CR1, USART_CR1_UE);
+	//8N1, no interrupts, single wire half-duplex on the TX pin
+	owp_uart->uart->CR1 = USART_CR1_TE | USART_CR1_RE;
+	owp_uart->uart->CR2 = 0;
+	owp_uart->uart->CR3 = USART_CR3_HDSEL;
+}
+
+//Sends one frame and returns the frame read back off the bus.
+//The UART generates the slot timing, so an interrupt here only lengthens the
+//recovery time between slots, which the 1-Wire protocol allows.
+static uint8_t owp_uart_exchange(uint8_t frame)
+{
+	//clear any errors left from a previous frame, a shorted bus will produce
+	//a framing error on every frame
+	owp_uart->uart->ICR = USART_ICR_ORECF | USART_ICR_FECF | USART_ICR_NCF;
+	(void)owp_uart->uart->RDR;
+
+	while(!(owp_uart->uart->ISR & USART_ISR_TXE));
+	owp_uart->uart->TDR = frame;
+
+	//in half-duplex mode the receiver always sees our own frame on the line
+	while(!(owp_uart->uart->ISR & USART_ISR_RXNE));
+	return (uint8_t)owp_uart->uart->RDR;
+}
+
+/********************************************************************
+ *GPIO transport (pins without a UART)                              *
+ ********************************************************************/
+
 void OWP_pin_input()
 {
 	LL_GPIO_SetPinMode(OWP_PORT, OWP_PIN, LL_GPIO_MODE_INPUT);
@@ -38,145 +168,251 @@ void OWP_pin_output()
 	LL_GPIO_ResetOutputPin(OWP_PORT, OWP_PIN);
 }
 
-void OWP_init(GPIO_TypeDef* port, uint16_t pin)
+//TIM22 is free-running at 1MHz while the GPIO transport is in use. The prescaler
+//is derived from the current bus clock, so the timing does not depend on the
+//system clock configuration.
+static void owp_timebase_start(void)
 {
-	OWP_PIN  = pin ;
-	OWP_PORT = port;
-	//set COUNT1 as an IO pin, which we can use to read/write from the device
-	//set COUNT1 as an IO pin, which we can use to read/write from the device
-	GPIO_InitTypeDef GPIO_InitStruct;
+	LL_RCC_ClocksTypeDef clocks;
+	uint32_t timer_clock;
 
-	/* LED Initialisation  */
-	GPIO_InitStruct.Mode      = GPIO_MODE_OUTPUT_PP;
-	GPIO_InitStruct.Pull      = GPIO_NOPULL;
-	GPIO_InitStruct.Speed     = GPIO_SPEED_FREQ_MEDIUM;
-	GPIO_InitStruct.Alternate = GPIO_AF6_LPUART1;
-	
-	LL_GPIO_SetPinOutputType(OWP_PORT, OWP_PIN, LL_GPIO_OUTPUT_OPENDRAIN);
+	LL_RCC_GetSystemClocksFreq(&clocks);
+	timer_clock = clocks.PCLK2_Frequency;
 
-	HW_GPIO_Init(OWP_PORT, OWP_PIN, &GPIO_InitStruct);
-	
-	OWP_pin_input();
+	//timers run at twice the APB clock when the APB is divided
+	if(LL_RCC_GetAPB2Prescaler() != LL_RCC_APB2_DIV_1)
+	{
+		timer_clock *= 2;
+	}
+
+	LL_APB2_GRP1_EnableClock(LL_APB2_GRP1_PERIPH_TIM22);
+	LL_TIM_SetPrescaler(TIM22, (timer_clock/1000000) - 1);
+	LL_TIM_SetAutoReload(TIM22, 0xFFFF);
+	LL_TIM_GenerateEvent_UPDATE(TIM22);
+	LL_TIM_EnableCounter(TIM22);
+}
+
+static void owp_timebase_stop(void)
+{
+	LL_TIM_DisableCounter(TIM22);
+	LL_APB2_GRP1_DisableClock(LL_APB2_GRP1_PERIPH_TIM22);
+}
+
+static uint16_t owp_now(void)
+{
+	return (uint16_t)LL_TIM_GetCounter(TIM22);
 }
 
-void OWP_reset_bus()
+//waits until <us> microseconds after <start>, this is tolerant of counter wrap
+static void owp_wait_until(uint16_t start, uint16_t us)
 {
-	//timing critical code, disable interrupts
-	BACKUP_PRIMASK();
-	DISABLE_IRQ( );
+	while((uint16_t)(owp_now() - start) < us);
+}
+
+static bool owp_gpio_reset(void)
+{
+	uint16_t start;
+	bool presence;
+
 	/*
 	Reset bus:
-		Pull low               | Initiates the reset
-		Wait 500uS             | Required period
+		Pull low               | Initiates the reset, 480uS minimum, longer is fine
 		Release high           | To indicate end of reset pulse
-		Wait 90uS              | To allow for slave setup
-		Read line              | To detect slave
-		Wait 1mS               | To allow reset to finish
+		Wait 70uS              | To allow for slave setup
+		Read line              | To detect slave (low = present)
+		Wait 410uS             | To allow reset to finish
 	*/
-	
-	
-	//pull low
+	owp_timebase_start();
+
+	start = owp_now();
 	OWP_pin_output();
-	//500us delay
-	delay_us(500);
-	//release line high
-	OWP_pin_input();
-	//90us delay
-	delay_us(90);
-	//here is where the read would be, we are going to ignore for now
-	//delay 1ms to clear line conditions
-	delay_us(1000);
-	//restore interrupts
-	RESTORE_PRIMASK( );
+	owp_wait_until(start, OWP_GPIO_RESET_LOW_US);
+
+	{
+		//only the release to sample window is time critical
+		BACKUP_PRIMASK();
+		DISABLE_IRQ( );
+		start = owp_now();
+		OWP_pin_input();
+		owp_wait_until(start, OWP_GPIO_PRESENCE_US);
+		presence = !LL_GPIO_IsInputPinSet(OWP_PORT, OWP_PIN);
+		RESTORE_PRIMASK( );
+	}
+
+	owp_wait_until(start, OWP_GPIO_PRESENCE_US + OWP_GPIO_RESET_RECOVERY_US);
+
+	owp_timebase_stop();
+	return presence;
 }
 
-void OWP_write_bit(bool bit)
+static void owp_gpio_write_bit(bool bit)
 {
-	//timing critical code, disable interrupts
-	BACKUP_PRIMASK();
-	DISABLE_IRQ( );
+	uint16_t start;
 	/*
 	Write 1:
 		Pull low               | Initiates Write
-		Wait 7uS               | Must be held for no more than 15uS
+		Wait 6uS               | Must be held for no more than 15uS
 		Release high           | Indicates writing 1
-		Wait 60uS              | Entire transaction is required to be >60uS
-	
+
 	Write 0:
 		Pull low               | Initiates Write
-		Wait 90uS              | Must be held low for TuS (60<T<120) 
+		Wait 65uS              | Must be held low for TuS (60<T<120)
 		Release high           | End transaction
+
+	The slot is then padded out to 70uS, with interrupts enabled.
 	*/
-	
-	if(bit)
-	{
-		OWP_pin_output();
-		delay_us(7);
-		OWP_pin_input();
-		delay_us(60);
-	}
-	else
 	{
+		BACKUP_PRIMASK();
+		DISABLE_IRQ( );
+		start = owp_now();
 		OWP_pin_output();
-		delay_us(90);
+		owp_wait_until(start, bit ? OWP_GPIO_WRITE1_LOW_US : OWP_GPIO_WRITE0_LOW_US);
 		OWP_pin_input();
-		delay_us(30);
+		RESTORE_PRIMASK( );
 	}
-	
-	RESTORE_PRIMASK( );
+
+	owp_wait_until(start, OWP_GPIO_SLOT_US);
 }
 
-bool OWP_read_bit()
+static bool owp_gpio_read_bit(void)
 {
-	//timing critical code, disable interrupts
-	BACKUP_PRIMASK();
-	DISABLE_IRQ( );
-	
+	uint16_t start;
 	bool output = 0;
 	/*
 	Read:
 		Pull low               | Initiate Read
-		Wait 5uS               | Require holdoff of > 1uS < 15uS
+		Wait 3uS               | Require holdoff of > 1uS < 15uS
 		Release high           | Allow slave to write to line
-		Wait 5uS               | All for time for slave to write
-		Read                   | Read the line state high->1, low->0.
-							|  15uS from falling edge at latest
-		Wait 60uS              | Required transaction longer than 60uS
+		Read at 12uS           | The line state high->1, low->0.
+		                       |  15uS from falling edge at latest
+		Pad slot to 70uS       | Required transaction longer than 60uS
 	*/
-	OWP_pin_output();
-	delay_us(5);
-	OWP_pin_input();
-	delay_us(5);
-	output = LL_GPIO_IsInputPinSet(OWP_PORT, OWP_PIN);
-	delay_us(60);
-	
-	//restore interrupts
-	RESTORE_PRIMASK( );
+	{
+		BACKUP_PRIMASK();
+		DISABLE_IRQ( );
+		start = owp_now();
+		OWP_pin_output();
+		owp_wait_until(start, OWP_GPIO_READ_LOW_US);
+		OWP_pin_input();
+		owp_wait_until(start, OWP_GPIO_READ_SAMPLE_US);
+		output = LL_GPIO_IsInputPinSet(OWP_PORT, OWP_PIN);
+		RESTORE_PRIMASK( );
+	}
+
+	owp_wait_until(start, OWP_GPIO_SLOT_US);
 	return output;
 }
 
+/********************************************************************
+ *Public functions                                                  *
+ ********************************************************************/
+
+void OWP_init(GPIO_TypeDef* port, uint16_t pin)
+{
+	int i;
+
+	OWP_PIN  = pin ;
+	OWP_PORT = port;
+	owp_uart = 0;
+
+	for(i=0;i<sizeof(owp_uart_map)/sizeof(owp_uart_map_t);i++)
+	{
+		if(owp_uart_map[i].port == port && owp_uart_map[i].pin == pin)
+		{
+			owp_uart = &owp_uart_map[i];
+		}
+	}
+
+	if(owp_uart)
+	{
+		dbg_owp("OWP using UART\r\n");
+		owp_uart_acquire();
+		return;
+	}
+
+	dbg_owp("OWP using GPIO\r\n");
+	//set the pin as an IO pin, which we can use to read/write from the device
+	GPIO_InitTypeDef GPIO_InitStruct;
+
+	GPIO_InitStruct.Mode      = GPIO_MODE_OUTPUT_PP;
+	GPIO_InitStruct.Pull      = GPIO_NOPULL;
+	GPIO_InitStruct.Speed     = GPIO_SPEED_FREQ_MEDIUM;
+	GPIO_InitStruct.Alternate = 0;
+
+	HW_GPIO_Init(OWP_PORT, OWP_PIN, &GPIO_InitStruct);
+	LL_GPIO_SetPinOutputType(OWP_PORT, OWP_PIN, LL_GPIO_OUTPUT_OPENDRAIN);
+
+	OWP_pin_input();
+}
+
+//returns true if at least one slave answered the reset with a presence pulse
+bool OWP_reset_bus()
+{
+	bool presence;
+
+	if(!owp_uart)
+	{
+		presence = owp_gpio_reset();
+	}
+	else
+	{
+		owp_uart_acquire();
+		owp_uart_set_baud(OWP_RESET_BAUD);
+		presence = (owp_uart_exchange(OWP_RESET_FRAME) != OWP_RESET_FRAME);
+		owp_uart_set_baud(OWP_DATA_BAUD);
+	}
+
+	dbg_owp("OWP presence:%d\r\n", presence);
+	return presence;
+}
+
 void OWP_write_byte(uint8_t byte)
 {
-	//write a byte by writing 8 bits in succession
+	//write a byte by writing 8 bits in succession, LSB first
 	int i;
-	
+
+	if(owp_uart)
+	{
+		for(i=0;i<8;i++)
+		{
+			owp_uart_exchange((byte & (1<<i)) ? OWP_ONE_FRAME : OWP_ZERO_FRAME);
+		}
+		return;
+	}
+
+	owp_timebase_start();
 	for(i=0;i<8;i++)
 	{
-		OWP_write_bit(byte & (1<<i));
+		owp_gpio_write_bit(byte & (1<<i));
 	}
+	owp_timebase_stop();
 }
 
 uint8_t OWP_read_byte()
 {
-	//read a byte by reading 8 bits in succession
+	//read a byte by reading 8 bits in succession, LSB first
 	int i;
 	uint8_t result = 0;
-	
+
+	if(owp_uart)
+	{
+		for(i=0;i<8;i++)
+		{
+			if(owp_uart_exchange(OWP_ONE_FRAME) == OWP_ONE_FRAME)
+			{
+				result |= (1<<i);
+			}
+		}
+		return result;
+	}
+
+	owp_timebase_start();
 	for(i=0; i<8;i++)
 	{
-		result |= (OWP_read_bit() << i);
+		result |= (owp_gpio_read_bit() << i);
 	}
-	
+	owp_timebase_stop();
+
 	return result;
 }
 
@@ -186,24 +422,25 @@ uint64_t OWP_getSingleID()
 {
 	uint64_t result = 0;
 	int i;
-	
+
 	//send command 33
-	OWP_reset_bus();
+	if(!OWP_reset_bus())
+	{
+		Debug_printf("OWP no presence pulse\r\n");
+	}
 	OWP_write_byte(0x33);
-	
-	
+
+
 	//we should get an immediate response, so no need for a timeout.
-	//Also because this is a timing dependant protocol, the read cannot take indefinite time.
 	for(i=0;i < sizeof(uint64_t)/sizeof(uint8_t); i++)
 	{
 		result |= ((uint64_t)OWP_read_byte()) << (8*i);
 	}
-	
+
 	//complete transaction with meaningless write
 	OWP_write_byte(0x00);
-	
+
 	Debug_printf("OWP ID: 0x%08X%08X\r\n", (uint32_t)(result>>32), (uint32_t)(result & 0xFFFFFFFF));
-	
+
 	return result;
 }
-
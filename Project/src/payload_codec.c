@@ -0,0 +1,183 @@
+/*
+   _____             _____                 
+  / ____|           / ____|                
+ | (___   ___ _ __ | (___  _   _ _ __ ___  
+  \___ \ / _ \ '_ \ \___ \| | | | '_ ` _ \ 
+  ____) |  __/ | | |____) | |_| | | | | | |
+ |_____/ \___|_| |_|_____/ \__,_|_| |_| |_|
+                                           
+                                           
+	Description: Schema driven bit packing for uplink payloads.
+								Values saturate at the field width instead of wrapping, which is
+								what the hand written packets did with their _MAX clamps. Fields
+								that stand in for an unclamped bitfield, such as a running count,
+								are flagged CODEC_WRAP and keep their low bits like it did.
+
+	Maintainer: Shea Gosnell
+
+
+*/
+
+#include <string.h>
+#include "payload_codec.h"
+
+void codec_writer_init(codec_writer_t *writer, uint8_t buffer[], uint8_t size)
+{
+	writer->buffer    = buffer;
+	writer->size_bits = size * 8;
+	writer->bit       = 0;
+	writer->overflow  = false;
+	
+	if(buffer != NULL)
+	{
+		memset(buffer, 0, size);
+	}
+}
+
+void codec_put_bits(codec_writer_t *writer, uint32_t value, uint8_t width)
+{
+	uint8_t i;
+	
+	for(i=0;i<width;i++)
+	{
+		if(writer->buffer != NULL)
+		{
+			if(writer->bit >= writer->size_bits)
+			{
+				writer->overflow = true;
+				return;
+			}
+			if((value >> i) & 1)
+			{
+				writer->buffer[writer->bit >> 3] |= 1 << (writer->bit & 7);
+			}
+		}
+		writer->bit++;
+	}
+}
+
+//groups of (width-1) data bits, the top bit of a group is set when another follows
+void codec_put_varint(codec_writer_t *writer, uint32_t value, uint8_t width)
+{
+	uint8_t data_bits = width - 1;
+	
+	while(value >> data_bits)
+	{
+		codec_put_bits(writer, (value & ((1UL << data_bits) - 1)) | (1UL << data_bits), width);
+		value >>= data_bits;
+	}
+	codec_put_bits(writer, value, width);
+}
+
+void codec_align(codec_writer_t *writer)
+{
+	writer->bit = (writer->bit + 7) & ~7;
+}
+
+//bytes used so far, or 0 if anything was dropped
+uint8_t codec_writer_bytes(const codec_writer_t *writer)
+{
+	if(writer->overflow)
+	{
+		return 0;
+	}
+	return (writer->bit + 7) / 8;
+}
+
+uint32_t codec_zigzag(int32_t value)
+{
+	return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+}
+
+static uint32_t codec_field_value(const codec_field_t *field, const int32_t values[])
+{
+	uint32_t value = (field->source == CODEC_NONE) ? 0 : (uint32_t)values[field->source];
+	
+	//done unsigned so a counter that went backwards saturates high, as the
+	//hand written deltas did
+	if(field->delta != CODEC_NONE)
+	{
+		value -= (uint32_t)values[field->delta];
+	}
+	
+	if(field->flags & CODEC_SIGNED)
+	{
+		int32_t signed_value = (int32_t)value;
+		
+		if(field->scale > 1)
+		{
+			signed_value /= field->scale;
+		}
+		
+		if(field->flags & CODEC_VARINT)
+		{
+			return codec_zigzag(signed_value);
+		}
+		
+		if((field->width < 32) && !(field->flags & CODEC_WRAP))
+		{
+			int32_t max =  (int32_t)((1UL << (field->width - 1)) - 1);
+			int32_t min = -max - 1;
+			
+			if(signed_value > max) signed_value = max;
+			if(signed_value < min) signed_value = min;
+		}
+		return (uint32_t)signed_value;
+	}
+	
+	if(field->scale > 1)
+	{
+		value /= field->scale;
+	}
+	
+	if(!(field->flags & (CODEC_VARINT | CODEC_WRAP)) && field->width < 32 && value > ((1UL << field->width) - 1))
+	{
+		value = (1UL << field->width) - 1;
+	}
+	return value;
+}
+
+//appends the fields of a schema, frames built from several schemas write each in turn
+void codec_write(codec_writer_t *writer, const codec_schema_t *schema, const int32_t values[])
+{
+	uint8_t i;
+	
+	for(i=0;i<schema->count;i++)
+	{
+		const codec_field_t *field = &schema->fields[i];
+		uint32_t value = codec_field_value(field, values);
+		
+		if(field->flags & CODEC_ALIGN)
+		{
+			codec_align(writer);
+		}
+		
+		if(field->flags & CODEC_VARINT)
+		{
+			codec_put_varint(writer, value, field->width);
+		}
+		else
+		{
+			codec_put_bits(writer, value, field->width);
+		}
+	}
+}
+
+//Returns the number of bytes used, or 0 if the payload did not fit in size bytes.
+uint8_t codec_encode(const codec_schema_t *schema, const int32_t values[], uint8_t buffer[], uint8_t size)
+{
+	codec_writer_t writer;
+	
+	codec_writer_init(&writer, buffer, size);
+	codec_write(&writer, schema, values);
+	
+	return codec_writer_bytes(&writer);
+}
+
+uint16_t codec_encoded_bits(const codec_schema_t *schema, const int32_t values[])
+{
+	codec_writer_t writer = {NULL, 0, 0, false};
+	
+	codec_write(&writer, schema, values);
+	return writer.bit;
+}
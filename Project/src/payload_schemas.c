@@ -0,0 +1,252 @@
+/*
+   _____             _____                 
+  / ____|           / ____|                
+ | (___   ___ _ __ | (___  _   _ _ __ ___  
+  \___ \ / _ \ '_ \ \___ \| | | | '_ ` _ \ 
+  ____) |  __/ | | |____) | |_| | | | | | |
+ |_____/ \___|_| |_|_____/ \__,_|_| |_| |_|
+                                           
+                                           
+	Description: Payload codec schemas.
+								Fields are listed in packing order, first field in the low bits
+								of payload[0]. The header has to end up in the last byte, which
+								is the first one sent. Decoders are generated from this file by
+								metaScripts/payload_decoder_gen.sh.
+
+	Maintainer: Shea Gosnell
+
+
+*/
+
+#include "payload_schemas.h"
+
+static const codec_field_t single_count_data_fields[] =
+{
+	CODEC_FIELD(Count1     , single_count_value_count1 , CODEC_NONE               , 27, CODEC_WRAP, 1),
+	CODEC_FIELD(leak       , single_count_value_leak   , CODEC_NONE               ,  1, 0, 1),
+	CODEC_FIELD(reserved   , CODEC_NONE                , CODEC_NONE               ,  3, 0, 1),
+	CODEC_FIELD(Delta6     , single_count_value_hour6  , single_count_value_hour5 , 11, 0, 1),
+	CODEC_FIELD(Delta5     , single_count_value_hour5  , single_count_value_hour4 , 11, 0, 1),
+	CODEC_FIELD(Delta4     , single_count_value_hour4  , single_count_value_hour3 , 11, 0, 1),
+	CODEC_FIELD(Delta3     , single_count_value_hour3  , single_count_value_hour2 , 11, 0, 1),
+	CODEC_FIELD(Delta2     , single_count_value_hour2  , single_count_value_hour1 , 11, 0, 1),
+	CODEC_FIELD(pkt_tod    , single_count_value_tod    , CODEC_NONE               ,  2, 0, 1),
+	CODEC_FIELD(sys_voltage, single_count_value_voltage, CODEC_NONE               ,  4, 0, 1),
+	CODEC_FIELD(pkt_type   , single_count_value_type   , CODEC_NONE               ,  4, 0, 1),
+};
+CODEC_SCHEMA(single_count_data_schema, single_count_data_fields);
+
+//a quiet meter sends mostly zero deltas, 5 data bits per group covers up to 31
+//counts an hour in 6 bits
+static const codec_field_t single_count_compact_fields[] =
+{
+	CODEC_FIELD(Count1     , single_count_value_count1 , CODEC_NONE               , 27, CODEC_WRAP, 1),
+	CODEC_FIELD(leak       , single_count_value_leak   , CODEC_NONE               ,  1, 0, 1),
+	CODEC_FIELD(pkt_tod    , single_count_value_tod    , CODEC_NONE               ,  2, 0, 1),
+	CODEC_FIELD(Delta2     , single_count_value_hour2  , single_count_value_hour1 ,  6, CODEC_VARINT, 1),
+	CODEC_FIELD(Delta3     , single_count_value_hour3  , single_count_value_hour2 ,  6, CODEC_VARINT, 1),
+	CODEC_FIELD(Delta4     , single_count_value_hour4  , single_count_value_hour3 ,  6, CODEC_VARINT, 1),
+	CODEC_FIELD(Delta5     , single_count_value_hour5  , single_count_value_hour4 ,  6, CODEC_VARINT, 1),
+	CODEC_FIELD(Delta6     , single_count_value_hour6  , single_count_value_hour5 ,  6, CODEC_VARINT, 1),
+	CODEC_FIELD(sys_voltage, single_count_value_voltage, CODEC_NONE               ,  4, CODEC_ALIGN, 1),
+	CODEC_FIELD(pkt_type   , single_count_value_type   , CODEC_NONE               ,  4, 0, 1),
+};
+CODEC_SCHEMA(single_count_compact_schema, single_count_compact_fields);
+
+//The daily flow summary. Flows are in thousandths of the meter unit, times in
+//minutes from the start of the day, 2047 for none. layout comes first so the
+//decoder can tell which of the three frames it has.
+static const codec_field_t flow_summary_fields[] =
+{
+	CODEC_FIELD(layout     , flow_summary_value_layout    , CODEC_NONE,  2, 0, 1),
+	CODEC_FIELD(samples    , flow_summary_value_samples   , CODEC_NONE, 11, 0, 1),
+	CODEC_FIELD(failures   , flow_summary_value_failures  , CODEC_NONE,  5, 0, 1),
+	CODEC_FIELD(mean       , flow_summary_value_mean      , CODEC_NONE,  8, CODEC_VARINT | CODEC_SIGNED, 1),
+	CODEC_FIELD(min        , flow_summary_value_min       , CODEC_NONE,  8, CODEC_VARINT | CODEC_SIGNED, 1),
+	CODEC_FIELD(max        , flow_summary_value_max       , CODEC_NONE,  8, CODEC_VARINT | CODEC_SIGNED, 1),
+	CODEC_FIELD(min_tod    , flow_summary_value_min_tod   , CODEC_NONE, 11, 0, 1),
+	CODEC_FIELD(max_tod    , flow_summary_value_max_tod   , CODEC_NONE, 11, 0, 1),
+	CODEC_FIELD(volume     , flow_summary_value_volume    , CODEC_NONE,  8, CODEC_VARINT | CODEC_SIGNED, 1),
+	CODEC_FIELD(stddev     , flow_summary_value_stddev    , CODEC_NONE,  8, CODEC_VARINT, 1),
+	CODEC_FIELD(p10        , flow_summary_value_p10       , CODEC_NONE,  8, CODEC_VARINT | CODEC_SIGNED, 1),
+	CODEC_FIELD(p50        , flow_summary_value_p50       , CODEC_NONE,  8, CODEC_VARINT | CODEC_SIGNED, 1),
+	CODEC_FIELD(p90        , flow_summary_value_p90       , CODEC_NONE,  8, CODEC_VARINT | CODEC_SIGNED, 1),
+	CODEC_FIELD(crossings  , flow_summary_value_crossings , CODEC_NONE,  6, 0, 1),
+	CODEC_FIELD(first_up   , flow_summary_value_first_up  , CODEC_NONE, 11, 0, 1),
+	CODEC_FIELD(last_down  , flow_summary_value_last_down , CODEC_NONE, 11, 0, 1),
+	CODEC_FIELD(above      , flow_summary_value_above     , CODEC_NONE, 11, 0, 1),
+	CODEC_FIELD(sys_voltage, flow_summary_value_voltage   , CODEC_NONE,  4, CODEC_ALIGN, 1),
+	CODEC_FIELD(pkt_type   , flow_summary_value_type      , CODEC_NONE,  4, 0, 1),
+};
+CODEC_SCHEMA(flow_summary_schema, flow_summary_fields);
+
+//the summary split in two, for data rates that can't carry it in one frame
+static const codec_field_t flow_summary_core_fields[] =
+{
+	CODEC_FIELD(layout     , flow_summary_value_layout    , CODEC_NONE,  2, 0, 1),
+	CODEC_FIELD(samples    , flow_summary_value_samples   , CODEC_NONE, 11, 0, 1),
+	CODEC_FIELD(failures   , flow_summary_value_failures  , CODEC_NONE,  5, 0, 1),
+	CODEC_FIELD(mean       , flow_summary_value_mean      , CODEC_NONE,  8, CODEC_VARINT | CODEC_SIGNED, 1),
+	CODEC_FIELD(min        , flow_summary_value_min       , CODEC_NONE,  8, CODEC_VARINT | CODEC_SIGNED, 1),
+	CODEC_FIELD(max        , flow_summary_value_max       , CODEC_NONE,  8, CODEC_VARINT | CODEC_SIGNED, 1),
+	CODEC_FIELD(min_tod    , flow_summary_value_min_tod   , CODEC_NONE, 11, 0, 1),
+	CODEC_FIELD(max_tod    , flow_summary_value_max_tod   , CODEC_NONE, 11, 0, 1),
+	CODEC_FIELD(volume     , flow_summary_value_volume    , CODEC_NONE,  8, CODEC_VARINT | CODEC_SIGNED, 1),
+	CODEC_FIELD(sys_voltage, flow_summary_value_voltage   , CODEC_NONE,  4, CODEC_ALIGN, 1),
+	CODEC_FIELD(pkt_type   , flow_summary_value_type      , CODEC_NONE,  4, 0, 1),
+};
+CODEC_SCHEMA(flow_summary_core_schema, flow_summary_core_fields);
+
+static const codec_field_t flow_summary_detail_fields[] =
+{
+	CODEC_FIELD(layout     , flow_summary_value_layout    , CODEC_NONE,  2, 0, 1),
+	CODEC_FIELD(stddev     , flow_summary_value_stddev    , CODEC_NONE,  8, CODEC_VARINT, 1),
+	CODEC_FIELD(p10        , flow_summary_value_p10       , CODEC_NONE,  8, CODEC_VARINT | CODEC_SIGNED, 1),
+	CODEC_FIELD(p50        , flow_summary_value_p50       , CODEC_NONE,  8, CODEC_VARINT | CODEC_SIGNED, 1),
+	CODEC_FIELD(p90        , flow_summary_value_p90       , CODEC_NONE,  8, CODEC_VARINT | CODEC_SIGNED, 1),
+	CODEC_FIELD(crossings  , flow_summary_value_crossings , CODEC_NONE,  6, 0, 1),
+	CODEC_FIELD(first_up   , flow_summary_value_first_up  , CODEC_NONE, 11, 0, 1),
+	CODEC_FIELD(last_down  , flow_summary_value_last_down , CODEC_NONE, 11, 0, 1),
+	CODEC_FIELD(above      , flow_summary_value_above     , CODEC_NONE, 11, 0, 1),
+	CODEC_FIELD(sys_voltage, flow_summary_value_voltage   , CODEC_NONE,  4, CODEC_ALIGN, 1),
+	CODEC_FIELD(pkt_type   , flow_summary_value_type      , CODEC_NONE,  4, 0, 1),
+};
+CODEC_SCHEMA(flow_summary_detail_schema, flow_summary_detail_fields);
+
+//The LSM6DSL vibration summary for one uplink interval. Levels are in mg with
+//gravity removed, frequencies in Hz, each axis from its strongest batch.
+static const codec_field_t vibration_summary_fields[] =
+{
+	CODEC_FIELD(motions    , vibration_summary_value_motions , CODEC_NONE,  8, 0, 1),
+	CODEC_FIELD(captures   , vibration_summary_value_captures, CODEC_NONE,  8, 0, 1),
+	CODEC_FIELD(rms_x      , vibration_summary_value_rms_x   , CODEC_NONE, 12, 0, 1),
+	CODEC_FIELD(peak_x     , vibration_summary_value_peak_x  , CODEC_NONE, 12, 0, 1),
+	CODEC_FIELD(freq_x     , vibration_summary_value_freq_x  , CODEC_NONE,  8, 0, 1),
+	CODEC_FIELD(rms_y      , vibration_summary_value_rms_y   , CODEC_NONE, 12, 0, 1),
+	CODEC_FIELD(peak_y     , vibration_summary_value_peak_y  , CODEC_NONE, 12, 0, 1),
+	CODEC_FIELD(freq_y     , vibration_summary_value_freq_y  , CODEC_NONE,  8, 0, 1),
+	CODEC_FIELD(rms_z      , vibration_summary_value_rms_z   , CODEC_NONE, 12, 0, 1),
+	CODEC_FIELD(peak_z     , vibration_summary_value_peak_z  , CODEC_NONE, 12, 0, 1),
+	CODEC_FIELD(freq_z     , vibration_summary_value_freq_z  , CODEC_NONE,  8, 0, 1),
+	CODEC_FIELD(clipped    , vibration_summary_value_clipped , CODEC_NONE,  1, 0, 1),
+	CODEC_FIELD(fault      , vibration_summary_value_fault   , CODEC_NONE,  1, 0, 1),
+	CODEC_FIELD(sys_voltage, vibration_summary_value_voltage , CODEC_NONE,  4, CODEC_ALIGN, 1),
+	CODEC_FIELD(pkt_type   , vibration_summary_value_type    , CODEC_NONE,  4, 0, 1),
+};
+CODEC_SCHEMA(vibration_summary_schema, vibration_summary_fields);
+
+//The LPS22HB barometer summary. Pressures are in decipascals with the interval
+//min and max relative to the latest batch, the rate in Pa/h.
+static const codec_field_t baro_summary_fields[] =
+{
+	CODEC_FIELD(reason     , baro_summary_value_reason     , CODEC_NONE                  ,  2, 0, 1),
+	CODEC_FIELD(band       , baro_summary_value_band       , CODEC_NONE                  ,  2, 0, 1),
+	CODEC_FIELD(trend      , baro_summary_value_trend      , CODEC_NONE                  ,  2, 0, 1),
+	CODEC_FIELD(fault      , baro_summary_value_fault      , CODEC_NONE                  ,  1, 0, 1),
+	CODEC_FIELD(overrun    , baro_summary_value_overrun    , CODEC_NONE                  ,  1, 0, 1),
+	CODEC_FIELD(pressure   , baro_summary_value_pressure   , CODEC_NONE                  , 21, 0, 1),
+	CODEC_FIELD(rate       , baro_summary_value_rate       , CODEC_NONE                  , 12, CODEC_SIGNED, 1),
+	CODEC_FIELD(min        , baro_summary_value_min        , baro_summary_value_pressure ,  8, CODEC_VARINT | CODEC_SIGNED, 1),
+	CODEC_FIELD(max        , baro_summary_value_max        , baro_summary_value_pressure ,  8, CODEC_VARINT | CODEC_SIGNED, 1),
+	CODEC_FIELD(temperature, baro_summary_value_temperature, CODEC_NONE                  , 11, CODEC_SIGNED, 1),
+	CODEC_FIELD(batches    , baro_summary_value_batches    , CODEC_NONE                  ,  8, 0, 1),
+	CODEC_FIELD(sys_voltage, baro_summary_value_voltage    , CODEC_NONE                  ,  4, CODEC_ALIGN, 1),
+	CODEC_FIELD(pkt_type   , baro_summary_value_type       , CODEC_NONE                  ,  4, 0, 1),
+};
+CODEC_SCHEMA(baro_summary_schema, baro_summary_fields);
+
+//The LSM303AGR tamper report, the same frame for an alarm and the heartbeat.
+//Orientations are tamper_orientation_e, the counts are since the heartbeat.
+static const codec_field_t tamper_report_fields[] =
+{
+	CODEC_FIELD(reason     , tamper_report_value_reason     , CODEC_NONE,  2, 0, 1),
+	CODEC_FIELD(orientation, tamper_report_value_orientation, CODEC_NONE,  3, 0, 1),
+	CODEC_FIELD(previous   , tamper_report_value_previous   , CODEC_NONE,  3, 0, 1),
+	CODEC_FIELD(fault      , tamper_report_value_fault      , CODEC_NONE,  1, 0, 1),
+	CODEC_FIELD(changes    , tamper_report_value_changes    , CODEC_NONE,  7, 0, 1),
+	CODEC_FIELD(freefalls  , tamper_report_value_freefalls  , CODEC_NONE,  8, 0, 1),
+	CODEC_FIELD(sys_voltage, tamper_report_value_voltage    , CODEC_NONE,  4, CODEC_ALIGN, 1),
+	CODEC_FIELD(pkt_type   , tamper_report_value_type       , CODEC_NONE,  4, 0, 1),
+};
+CODEC_SCHEMA(tamper_report_schema, tamper_report_fields);
+
+//The composite frame. Each part is the fields one sensor component adds, and
+//only the parts flagged in the header are sent.
+static const codec_field_t composite_header_fields[] =
+{
+	CODEC_FIELD(components , composite_value_components       , CODEC_NONE,  8, 0, 1),
+};
+CODEC_SCHEMA(composite_header_schema, composite_header_fields);
+
+static const codec_field_t composite_counter_fields[] =
+{
+	CODEC_FIELD(count1     , composite_value_count1           , CODEC_NONE,  8, CODEC_VARINT, 1),
+};
+CODEC_SCHEMA(composite_counter_schema, composite_counter_fields);
+
+//centi-degrees and centi-percent as the SHT30 mode sends them
+static const codec_field_t composite_sht30_fields[] =
+{
+	CODEC_FIELD(temperature1, composite_value_temperature1    , CODEC_NONE, 16, CODEC_SIGNED, 1),
+	CODEC_FIELD(humidity1   , composite_value_humidity1       , CODEC_NONE, 16, 0, 1),
+	CODEC_FIELD(temperature2, composite_value_temperature2    , CODEC_NONE, 16, CODEC_SIGNED, 1),
+	CODEC_FIELD(humidity2   , composite_value_humidity2       , CODEC_NONE, 16, 0, 1),
+};
+CODEC_SCHEMA(composite_sht30_schema, composite_sht30_fields);
+
+//1/16 DegC as the probe reports it
+static const codec_field_t composite_ds18b20_fields[] =
+{
+	CODEC_FIELD(probe_temperature, composite_value_probe_temperature, CODEC_NONE, 16, CODEC_SIGNED, 1),
+	CODEC_FIELD(probe_status     , composite_value_probe_status     , CODEC_NONE,  2, 0, 1),
+};
+CODEC_SCHEMA(composite_ds18b20_schema, composite_ds18b20_fields);
+
+static const codec_field_t composite_light_fields[] =
+{
+	CODEC_FIELD(light      , composite_value_light            , CODEC_NONE, 16, 0, 1),
+};
+CODEC_SCHEMA(composite_light_schema, composite_light_fields);
+
+static const codec_field_t composite_trailer_fields[] =
+{
+	CODEC_FIELD(sys_voltage, composite_value_voltage          , CODEC_NONE,  4, CODEC_ALIGN, 1),
+	CODEC_FIELD(pkt_type   , composite_value_type             , CODEC_NONE,  4, 0, 1),
+};
+CODEC_SCHEMA(composite_trailer_schema, composite_trailer_fields);
+
+//In composite_part_e order. The order is also read by
+//metaScripts/payload_decoder_gen.sh, keep one part per line.
+const codec_schema_t * const composite_part_schemas[composite_parts] =
+{
+	&composite_counter_schema,
+	&composite_sht30_schema,
+	&composite_ds18b20_schema,
+	&composite_light_schema,
+};
+
+//The sampler's summary of every reading since the last uplink. Readings are in
+//the mode's own units, the mean, min and max relative to the last reading.
+static const codec_field_t sample_summary_header_fields[] =
+{
+	CODEC_FIELD(channels   , sample_summary_value_channels, CODEC_NONE               ,  3, 0, 1),
+	CODEC_FIELD(period     , sample_summary_value_period  , CODEC_NONE               ,  8, CODEC_VARINT, 1),
+};
+CODEC_SCHEMA(sample_summary_header_schema, sample_summary_header_fields);
+
+static const codec_field_t sample_summary_channel_fields[] =
+{
+	CODEC_FIELD(count      , sample_channel_value_count   , CODEC_NONE               ,  8, CODEC_VARINT, 1),
+	CODEC_FIELD(last       , sample_channel_value_last    , CODEC_NONE               ,  8, CODEC_VARINT | CODEC_SIGNED, 1),
+	CODEC_FIELD(mean       , sample_channel_value_mean    , sample_channel_value_last,  8, CODEC_VARINT | CODEC_SIGNED, 1),
+	CODEC_FIELD(min        , sample_channel_value_min     , sample_channel_value_last,  8, CODEC_VARINT | CODEC_SIGNED, 1),
+	CODEC_FIELD(max        , sample_channel_value_max     , sample_channel_value_last,  8, CODEC_VARINT | CODEC_SIGNED, 1),
+};
+CODEC_SCHEMA(sample_summary_channel_schema, sample_summary_channel_fields);
+
+static const codec_field_t sample_summary_trailer_fields[] =
+{
+	CODEC_FIELD(sys_voltage, sample_summary_value_voltage , CODEC_NONE               ,  4, CODEC_ALIGN, 1),
+	CODEC_FIELD(pkt_type   , sample_summary_value_type    , CODEC_NONE               ,  4, 0, 1),
+};
+CODEC_SCHEMA(sample_summary_trailer_schema, sample_summary_trailer_fields);
@@ -33,6 +33,10 @@
 #include "sx1276.h"
 #include "sensum_version.h"
 #include "timeServer.h"
+#include "uplink_queue.h"
+#include "event_loop.h"
+#include "clock_manager.h"
+#include "stack_monitor.h"
 
 uint8_t  rx_response_buffer[MAX_RX_DATA+1] = {0xFF};
 uint8_t  rx_buffer_length;
@@ -66,11 +70,34 @@ bool radio_joined()
 	#endif
 }
 
+//largest uplink that can go out right now
+uint8_t radio_max_payload()
+{
+	uint8_t size = 0;
+	
+	#ifdef RAIDO_LORA_INTERNAL
+	{
+		size = lora_max_payload();
+	}
+	#endif
+	#ifdef RADIO_SIGFOX_AT
+	{
+		size = SIGFOX_MAX_PAYLOAD;
+	}
+	#endif
+	
+	return size;
+}
+
 uint8_t fourBit_battery_calculation()
 {
-	uint32_t x = 0;
 	//get the system voltage
-	x = HW_GetBatteryLevel_mv();
+	return fourBit_battery_from_mv(HW_GetBatteryLevel_mv());
+}
+
+//for callers that already have the supply voltage, e.g. from an ADC scan
+uint8_t fourBit_battery_from_mv(uint32_t x)
+{
 	//subtract 2 volts, as 2V is the minimum we decided
 	x = x-2000;
 	//limit to 3.6V max
@@ -161,6 +188,8 @@ void radio_init()
 void sendStartupPacket(void)
 {
 	startup_packet_t packet ={0};
+	uint8_t stack_free;
+	uint8_t isr_depth;
 	
 	packet.members.sys_voltage = fourBit_battery_calculation();
 	packet.members.pkt_type = packet_type_boot;
@@ -171,6 +200,10 @@ void sendStartupPacket(void)
 	
 	packet.members.device_mode = device_mode;
 	
+	//from this run instead if there was no run before, e.g. after power up
+	stack_monitor_startup_fields(&stack_free, &isr_depth);
+	packet.members.stack_free = stack_free;
+	packet.members.isr_depth  = isr_depth;
 	
 	populateHash(packet.members.Hash, sizeof(packet.members.Hash)/sizeof(uint8_t));
 	packet.members.HW_Major = HW_MAJOR;
@@ -191,7 +224,27 @@ void sendStartupPacket(void)
 
 transmit_status_e Uplink(uint8_t payload[], uint8_t size)
 {
-	transmit_status_e result;
+	return Uplink_priority(payload, size, uplink_priority_periodic);
+}
+
+//queues the frame and sends whatever the duty cycle allows right now, anything
+//left is sent from the sleep loop once the time-off has passed
+transmit_status_e Uplink_priority(uint8_t payload[], uint8_t size, uplink_priority_e priority)
+{
+	if(size > UPLINK_QUEUE_PAYLOAD_SIZE)
+	{
+		return radio_transmit(payload, size);
+	}
+	
+	return uplink_queue_send(payload, size, priority);
+}
+
+transmit_status_e radio_transmit(uint8_t payload[], uint8_t size)
+{
+	transmit_status_e result = transmit_status_success;
+
+	//the MAC, its crypto and the radio SPI run at 32MHz until the receive windows close
+	clock_request(clock_user_radio, clock_profile_high);
 
 	//if we are sigfox, we want sigfox uplink.
 	//if we are LoRa, we want LoRa uplink.
@@ -204,11 +257,17 @@ transmit_status_e Uplink(uint8_t payload[], uint8_t size)
 	
 	#ifdef RADIO_SIGFOX_AT
 	{
-		sf_send(payload, size);
+		if(!sf_send(payload, size))
+		{
+			result = transmit_status_no_send;
+		}
 	}
 	#endif
 	
-	while(result == transmit_status_received_downlink)
+	clock_release(clock_user_radio);
+	clock_uplink_done();
+	
+	if(result == transmit_status_received_downlink)
 	{
 		//respond to downlink
 		//populate a header with packet type and voltage
@@ -218,17 +277,8 @@ transmit_status_e Uplink(uint8_t payload[], uint8_t size)
 		Debug_printf("Header: %02X\r\n",rx_response_buffer[rx_buffer_length]);
 		Debug_printf("RX Buffer Length: %d", rx_buffer_length);
 		
-		#ifdef RAIDO_LORA_INTERNAL
-		{
-			result = Lora_Uplink(rx_response_buffer,rx_buffer_length+1);
-		}
-		#endif
-		
-		#ifdef RADIO_SIGFOX_AT
-		{
-			sf_send(payload, size);
-		}
-		#endif
+		//the response goes ahead of any periodic data still waiting
+		uplink_queue_push(rx_response_buffer, rx_buffer_length+1, uplink_priority_response);
 	}
 	
 	return result;
@@ -341,7 +391,7 @@ bool default_downlink(uint8_t *buffer, uint8_t size)
 				//we should fire the interrupt callback, and ensure that the
 				//main-program function is set to run.
 				device.on_hourly_alarm_interrupt();
-				wake_via_rtc_b = 1;
+				event_post(event_hourly);
 
 				//we are not going to call manage rejoin here, as the worst that will
 				//happen by not calling is is that the device will rejoin an hour late.
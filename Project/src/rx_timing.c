@@ -0,0 +1,199 @@
+/*
+   _____             _____                 
+  / ____|           / ____|                
+ | (___   ___ _ __ | (___  _   _ _ __ ___  
+  \___ \ / _ \ '_ \ \___ \| | | | '_ ` _ \ 
+  ____) |  __/ | | |____) | |_| | | | | | |
+ |_____/ \___|_| |_|_____/ \__,_|_| |_| |_|
+                                           
+                                           
+	Description: Receive window calibration.
+								Times class A downlinks against the nominal window start, and
+								narrows SystemMaxRxError to what this device actually needs.
+
+	Maintainer: Shea Gosnell
+
+
+*/
+
+#include "global.h"
+#include "hw.h"
+#include "LoRaMac.h"
+#include "region/Region.h"
+#include "rx_timing.h"
+
+//the LoRaMac default, used until enough downlinks have been timed
+#define RX_TIMING_DEFAULT_ERROR_MS 10
+//timer resolution plus radio wake-up jitter, never go tighter than this
+#define RX_TIMING_MIN_ERROR_MS     3
+//downlinks needed before the window is narrowed
+#define RX_TIMING_MIN_SAMPLES      4
+//an offset this large is not a timing error, so it is not recorded
+#define RX_TIMING_OUTLIER_MS       50
+//LSE initial tolerance
+#define RX_TIMING_LSE_TOLERANCE_PPM 20
+
+#if defined( REGION_AS923 )
+	#define RX_TIMING_REGION LORAMAC_REGION_AS923
+#elif defined( REGION_AU915 )
+	#define RX_TIMING_REGION LORAMAC_REGION_AU915
+#elif defined( REGION_CN470 )
+	#define RX_TIMING_REGION LORAMAC_REGION_CN470
+#elif defined( REGION_CN779 )
+	#define RX_TIMING_REGION LORAMAC_REGION_CN779
+#elif defined( REGION_EU433 )
+	#define RX_TIMING_REGION LORAMAC_REGION_EU433
+#elif defined( REGION_IN865 )
+	#define RX_TIMING_REGION LORAMAC_REGION_IN865
+#elif defined( REGION_EU868 )
+	#define RX_TIMING_REGION LORAMAC_REGION_EU868
+#elif defined( REGION_KR920 )
+	#define RX_TIMING_REGION LORAMAC_REGION_KR920
+#elif defined( REGION_US915 )
+	#define RX_TIMING_REGION LORAMAC_REGION_US915
+#elif defined( REGION_US915_HYBRID )
+	#define RX_TIMING_REGION LORAMAC_REGION_US915_HYBRID
+#endif
+
+static int8_t   offsets[RX_TIMING_SAMPLES];
+static uint8_t  sample_count    = 0;
+static uint8_t  sample_next     = 0;
+static uint32_t rx_error_ms     = RX_TIMING_DEFAULT_ERROR_MS;
+static uint32_t last_saved_ms   = 0;
+static uint32_t total_saved_ms  = 0;
+static uint32_t uplink_count    = 0;
+
+void rx_timing_on_downlink(int32_t offset_ms)
+{
+	if(offset_ms > RX_TIMING_OUTLIER_MS || offset_ms < -RX_TIMING_OUTLIER_MS)
+	{
+		dbg_rx_timing("RX timing: %dms offset ignored\r\n", offset_ms);
+		return;
+	}
+	
+	dbg_rx_timing("RX timing: %dms offset\r\n", offset_ms);
+	
+	offsets[sample_next] = (int8_t)offset_ms;
+	sample_next = (sample_next + 1) % RX_TIMING_SAMPLES;
+	if(sample_count < RX_TIMING_SAMPLES)
+	{
+		sample_count++;
+	}
+}
+
+//largest measured offset either side of the window centre
+static uint32_t rx_timing_worst_offset( void )
+{
+	uint32_t worst = 0;
+	uint8_t  i;
+	
+	for(i=0;i<sample_count;i++)
+	{
+		uint32_t magnitude = (offsets[i] < 0) ? -offsets[i] : offsets[i];
+		if(magnitude > worst)
+		{
+			worst = magnitude;
+		}
+	}
+	return worst;
+}
+
+//A 32.768kHz tuning fork slows by 0.034ppm/C^2 either side of 25C. The
+//drift is worked out for the current temperature over the longest receive
+//delay, rounded up to the next ms.
+static uint32_t rx_timing_drift_ms(uint32_t delay_ms)
+{
+	//HW_GetTemperatureLevel returns DegC in 8.8 fixed point
+	int32_t  temperature = ((int16_t)HW_GetTemperatureLevel()) >> 8;
+	int32_t  delta       = temperature - 25;
+	uint32_t ppm         = RX_TIMING_LSE_TOLERANCE_PPM + ((delta * delta * 34) + 999) / 1000;
+	
+	return ((delay_ms * ppm) + 999999) / 1000000;
+}
+
+#ifdef RX_TIMING_REGION
+//the radio is left in RX for the whole window when nothing arrives, the window
+//timeout is (timeout symbols * Tsym), and the offset is 4*Tsym - timeout/2, so
+//the difference in window length is twice the difference in offset.
+static uint32_t rx_timing_window_saving(int8_t datarate, uint8_t min_rx_symbols)
+{
+	RxConfigParams_t calibrated;
+	RxConfigParams_t reference;
+	
+	RegionComputeRxWindowParameters(RX_TIMING_REGION, datarate, min_rx_symbols, rx_error_ms               , &calibrated);
+	RegionComputeRxWindowParameters(RX_TIMING_REGION, datarate, min_rx_symbols, RX_TIMING_DEFAULT_ERROR_MS, &reference );
+	
+	return 2 * (calibrated.WindowOffset - reference.WindowOffset);
+}
+#endif
+
+void rx_timing_before_uplink( void )
+{
+	MibRequestConfirm_t mibReq;
+	uint32_t delay_ms;
+	
+	mibReq.Type = MIB_RECEIVE_DELAY_2;
+	LoRaMacMibGetRequestConfirm(&mibReq);
+	delay_ms = mibReq.Param.ReceiveDelay2;
+	
+	rx_error_ms = RX_TIMING_DEFAULT_ERROR_MS;
+	if(sample_count >= RX_TIMING_MIN_SAMPLES)
+	{
+		//one extra ms covers the resolution of the timestamps
+		rx_error_ms = rx_timing_worst_offset() + rx_timing_drift_ms(delay_ms) + 1;
+		
+		if(rx_error_ms < RX_TIMING_MIN_ERROR_MS)
+		{
+			rx_error_ms = RX_TIMING_MIN_ERROR_MS;
+		}
+		if(rx_error_ms > RX_TIMING_DEFAULT_ERROR_MS)
+		{
+			rx_error_ms = RX_TIMING_DEFAULT_ERROR_MS;
+		}
+	}
+	
+	mibReq.Type = MIB_SYSTEM_MAX_RX_ERROR;
+	mibReq.Param.SystemMaxRxError = rx_error_ms;
+	LoRaMacMibSetRequestConfirm(&mibReq);
+	
+	last_saved_ms = 0;
+#ifdef RX_TIMING_REGION
+	{
+		int8_t  datarate;
+		uint8_t min_rx_symbols;
+		
+		mibReq.Type = MIB_MIN_RX_SYMBOLS;
+		LoRaMacMibGetRequestConfirm(&mibReq);
+		min_rx_symbols = mibReq.Param.MinRxSymbols;
+		
+		//RX1 follows the uplink datarate, the DR offset is assumed to be 0
+		mibReq.Type = MIB_CHANNELS_DATARATE;
+		LoRaMacMibGetRequestConfirm(&mibReq);
+		datarate = RegionApplyDrOffset(RX_TIMING_REGION, 0, mibReq.Param.ChannelsDatarate, 0);
+		last_saved_ms += rx_timing_window_saving(datarate, min_rx_symbols);
+		
+		mibReq.Type = MIB_RX2_CHANNEL;
+		LoRaMacMibGetRequestConfirm(&mibReq);
+		last_saved_ms += rx_timing_window_saving(mibReq.Param.Rx2Channel.Datarate, min_rx_symbols);
+	}
+#endif
+	
+	total_saved_ms += last_saved_ms;
+	uplink_count++;
+	
+	dbg_rx_timing("RX timing: max error %dms, %dms RX saved\r\n", rx_error_ms, last_saved_ms);
+}
+
+void rx_timing_print( void )
+{
+	Debug_printf("RX timing samples        :%d\r\n", sample_count);
+	await_uart_tx();
+	Debug_printf("RX timing worst offset   :%dms\r\n", rx_timing_worst_offset());
+	await_uart_tx();
+	Debug_printf("RX max error             :%dms\r\n", rx_error_ms);
+	await_uart_tx();
+	Debug_printf("RX time saved last uplink:%dms\r\n", last_saved_ms);
+	await_uart_tx();
+	Debug_printf("RX time saved total      :%dms over %d uplinks\r\n", total_saved_ms, uplink_count);
+	await_uart_tx();
+}
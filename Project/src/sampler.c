@@ -0,0 +1,319 @@
+/*
+   _____             _____                 
+  / ____|           / ____|                
+ | (___   ___ _ __ | (___  _   _ _ __ ___  
+  \___ \ / _ \ '_ \ \___ \| | | | '_ ` _ \ 
+  ____) |  __/ | | |____) | |_| | | | | | |
+ |_____/ \___|_| |_|_____/ \__,_|_| |_| |_|
+                                           
+                                           
+	Description: Sampling between uplinks.
+								The sample timer runs from the mode's init, and its samples are
+								taken from the event loop, like the SCL-61D5 fast readings. Only
+								the count, min, max, sum and last reading of each channel are
+								kept, so the memory used does not depend on how many samples an
+								uplink covers. The reading a mode takes at uplink time is its
+								last sample, then the summary goes out in place of the mode's
+								own frame and the next window starts.
+
+	Maintainer: Shea Gosnell
+
+
+*/
+
+#include <string.h>
+#include <stdlib.h>
+#include "sampler.h"
+#include "global.h"
+#include "debug_uart.h"
+#include "flash_map.h"
+#include "radio_common.h"
+#include "uplink_queue.h"
+#include "payload_schemas.h"
+#include "timeServer.h"
+#include "event_loop.h"
+
+#ifndef DISABLE_SAMPLER_DEBUG
+	#define sampler_printf(...) Debug_printf(__VA_ARGS__)
+#else
+	#define sampler_printf(...)
+#endif
+
+static sampler_read_t    sample_read   = NULL;
+static uint8_t           channel_count = 0;
+static sampler_channel_t channels[SAMPLER_MAX_CHANNELS];
+static uint16_t          period_s      = 0;
+static TimerEvent_t      sample_timer;
+static bool              timer_ready   = false;
+static volatile bool     sample_due    = false;
+
+//this is a callback from the timer interrupt
+static void sampler_timeout(void)
+{
+	sample_due = true;
+	event_post(event_device);
+}
+
+static bool sampler_running(void)
+{
+	return (sample_read != NULL) && (period_s != 0);
+}
+
+static void sampler_schedule(void)
+{
+	//the period can be loaded before any mode has started the sampler
+	if(!timer_ready)
+	{
+		return;
+	}
+	TimerStop(&sample_timer);
+	sample_due = false;
+	
+	if(sampler_running())
+	{
+		TimerSetValue(&sample_timer, (uint32_t)period_s * 1000);
+		TimerStart(&sample_timer);
+	}
+}
+
+static void sampler_reset(void)
+{
+	memset(channels, 0, sizeof(channels));
+}
+
+//the count saturates, samples past that are ignored
+static void sampler_add(const int32_t values[], const bool valid[])
+{
+	sampler_channel_t *channel;
+	uint8_t            i;
+	
+	for(i=0;i<channel_count;i++)
+	{
+		channel = &channels[i];
+		if(((valid != NULL) && !valid[i]) || (channel->count == UINT16_MAX))
+		{
+			continue;
+		}
+		
+		if((channel->count == 0) || (values[i] < channel->min))
+		{
+			channel->min = values[i];
+		}
+		if((channel->count == 0) || (values[i] > channel->max))
+		{
+			channel->max = values[i];
+		}
+		channel->count++;
+		channel->sum  += values[i];
+		channel->last  = values[i];
+	}
+}
+
+static void sampler_sample(void)
+{
+	int32_t values[SAMPLER_MAX_CHANNELS] = {0};
+	bool    valid[SAMPLER_MAX_CHANNELS];
+	
+	memset(valid, true, sizeof(valid));
+	sample_read(values, valid);
+	sampler_add(values, valid);
+	
+	sampler_printf("Sample %u\r\n", channels[0].count);
+}
+
+//rounded to nearest, halves away from zero
+static int32_t sampler_mean(const sampler_channel_t *channel)
+{
+	int64_t half = channel->count / 2;
+	
+	if(channel->sum < 0)
+	{
+		return (int32_t)((channel->sum - half) / channel->count);
+	}
+	return (int32_t)((channel->sum + half) / channel->count);
+}
+
+//from the mode's init, read is called for every sample after this
+void sampler_start(sampler_read_t read, uint8_t count)
+{
+	if(!timer_ready)
+	{
+		TimerInit(&sample_timer, &sampler_timeout);
+		timer_ready = true;
+	}
+	
+	sample_read   = read;
+	channel_count = (count < SAMPLER_MAX_CHANNELS) ? count : SAMPLER_MAX_CHANNELS;
+	sampler_reset();
+	sampler_schedule();
+}
+
+void sampler_on_each_wakeup(void)
+{
+	if(!sample_due)
+	{
+		return;
+	}
+	sample_due = false;
+	
+	if(sampler_running())
+	{
+		sampler_sample();
+		sampler_schedule();
+	}
+}
+
+//Adds the reading the mode took for its uplink and sends the summary. false
+//while sampling is off, and the mode sends its own frame instead.
+bool sampler_uplink(const int32_t values[], const bool valid[])
+{
+	int32_t        header[sample_summary_values] = {0};
+	int32_t        part[sample_channel_values];
+	uint8_t        payload[UPLINK_QUEUE_PAYLOAD_SIZE];
+	codec_writer_t writer;
+	uint8_t        length;
+	uint8_t        i;
+	
+	if(!sampler_running())
+	{
+		return false;
+	}
+	
+	sampler_add(values, valid);
+	
+	header[sample_summary_value_channels] = channel_count;
+	header[sample_summary_value_period]   = period_s;
+	header[sample_summary_value_voltage]  = fourBit_battery_calculation();
+	header[sample_summary_value_type]     = packet_type_summary;
+	
+	codec_writer_init(&writer, payload, sizeof(payload));
+	codec_write(&writer, &sample_summary_header_schema, header);
+	for(i=0;i<channel_count;i++)
+	{
+		memset(part, 0, sizeof(part));
+		part[sample_channel_value_count] = channels[i].count;
+		if(channels[i].count != 0)
+		{
+			part[sample_channel_value_last] = channels[i].last;
+			part[sample_channel_value_mean] = sampler_mean(&channels[i]);
+			part[sample_channel_value_min]  = channels[i].min;
+			part[sample_channel_value_max]  = channels[i].max;
+		}
+		codec_write(&writer, &sample_summary_channel_schema, part);
+		
+		sampler_printf("Channel %d: %u samples, last %d mean %d min %d max %d\r\n", i, channels[i].count,
+		               part[sample_channel_value_last], part[sample_channel_value_mean],
+		               part[sample_channel_value_min] , part[sample_channel_value_max]);
+	}
+	codec_write(&writer, &sample_summary_trailer_schema, header);
+	
+	sampler_reset();
+	
+	length = codec_writer_bytes(&writer);
+	if(length == 0)
+	{
+		Debug_printf("Sample summary too long\r\n");
+		return true;
+	}
+	
+	Uplink(payload, length);
+	return true;
+}
+
+uint16_t sampler_period(void)
+{
+	return period_s;
+}
+
+void sampler_set_period(uint16_t period)
+{
+	if(period == period_s)
+	{
+		return;
+	}
+	period_s = period;
+	sampler_schedule();
+}
+
+void sampler_save_config(uint8_t page)
+{
+	sample_config_page_layout_t config = {0};
+	
+	config.members.sample_period_s = period_s;
+	save_extra_config_page(config.raw_bytes, page);
+}
+
+void sampler_load_config(uint8_t page)
+{
+	sample_config_page_layout_t config = {0};
+	
+	load_extra_config_page(config.raw_bytes, page);
+	
+	//an erased page reads back as all ones
+	if(config.members.sample_period_s == 0xFFFF)
+	{
+		config.members.sample_period_s = 0;
+	}
+	sampler_set_period(config.members.sample_period_s);
+}
+
+static void sampler_cli_help(void)
+{
+	Debug_printf("Usage: device show\r\n");
+	Debug_printf("\tShows the sample period and the samples so far\r\n");
+	await_uart_tx();
+	Debug_printf("Usage: device sample [seconds]\r\n");
+	Debug_printf("\tRead every [seconds] and send a summary each uplink, 0 for off\r\n");
+	await_uart_tx();
+}
+
+void sampler_cli(int argc, char *argv[])
+{
+	int32_t value;
+	uint8_t i;
+	
+	if((argc == 1) && !strcmp(argv[0], "show"))
+	{
+		if(period_s == 0)
+		{
+			Debug_printf("Sampling     : OFF, one reading per uplink\r\n");
+			await_uart_tx();
+			return;
+		}
+		Debug_printf("Sample period: %u s\r\n", period_s);
+		await_uart_tx();
+		for(i=0;i<channel_count;i++)
+		{
+			Debug_printf("Channel %d    : %u samples\r\n", i, channels[i].count);
+			await_uart_tx();
+		}
+		return;
+	}
+	
+	if((argc == 2) && !strcmp(argv[0], "sample"))
+	{
+		value = atoi(argv[1]);
+		if(value < 0 || value > UINT16_MAX)
+		{
+			Debug_printf("Value out of range\r\n");
+			return;
+		}
+		sampler_set_period((uint16_t)value);
+		
+		if(period_s == 0)
+		{
+			Debug_printf("Sampling OFF\r\n");
+		}
+		else
+		{
+			Debug_printf("Sampling every %u s\r\n", period_s);
+		}
+		if((period_s != 0) && (((uint32_t)period_s * 1000) >= transmit_interval_ms))
+		{
+			Debug_printf("The period is not shorter than the uplink interval\r\n");
+		}
+		return;
+	}
+	
+	sampler_cli_help();
+}
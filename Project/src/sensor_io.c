@@ -0,0 +1,60 @@
+/*
+   _____             _____                 
+  / ____|           / ____|                
+ | (___   ___ _ __ | (___  _   _ _ __ ___  
+  \___ \ / _ \ '_ \ \___ \| | | | '_ ` _ \ 
+  ____) |  __/ | | |____) | |_| | | | | | |
+ |_____/ \___|_| |_|_____/ \__,_|_| |_| |_|
+                                           
+                                           
+	Description: I2C glue for the ST MEMS register drivers.
+								The caller brings the bus up with i2c1_init() first, a burst of
+								register accesses then costs no more than the transfers.
+
+	Maintainer: Shea Gosnell
+
+
+*/
+
+#include <string.h>
+#include "sensor_io.h"
+#include "i2c1.h"
+
+uint8_t Sensor_IO_Write(void *handle, uint8_t WriteAddr, uint8_t *pBuffer, uint16_t nBytesToWrite)
+{
+	sensor_io_t *io = (sensor_io_t*)handle;
+	uint8_t data_to_send[SENSOR_IO_MAX_WRITE + 1];
+	
+	if(nBytesToWrite > SENSOR_IO_MAX_WRITE)
+	{
+		return 1;
+	}
+	
+	//register then data in the one transaction
+	data_to_send[0] = WriteAddr;
+	memcpy(&data_to_send[1], pBuffer, nBytesToWrite);
+	
+	return i2c1_send_feedback(io->address, data_to_send, nBytesToWrite + 1, 1) ? 0 : 1;
+}
+
+uint8_t Sensor_IO_Read(void *handle, uint8_t ReadAddr, uint8_t *pBuffer, uint16_t nBytesToRead)
+{
+	sensor_io_t *io = (sensor_io_t*)handle;
+	
+	if((nBytesToRead == 0) || (nBytesToRead > SENSOR_IO_MAX_READ))
+	{
+		return 1;
+	}
+	
+	if(nBytesToRead > 1)
+	{
+		ReadAddr |= io->read_increment;
+	}
+	
+	//register pointer without a stop, then a repeated start to read
+	if(!i2c1_send_feedback(io->address, &ReadAddr, 1, 0))
+	{
+		return 1;
+	}
+	return i2c1_receive_feedback(io->address, pBuffer, nBytesToRead, 1) ? 0 : 1;
+}
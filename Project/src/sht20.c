@@ -27,6 +27,7 @@
 
 #include "lora_sensum.h"
 #include "radio_common.h"
+#include "fixed_point.h"
 
 
 #define SHT20_ADDR 0x40
@@ -67,8 +68,7 @@ int16_t sht20GetTemperature()
 	uint8_t data_send_length = 1;
 	uint8_t data_to_read[3] = {0};
 	uint8_t data_read_length = 3;
-	int16_t temp;
-	float  temperature;
+	uint16_t temp;
 	
 	//request temperature data from the SHT20
 	//set the i2c peripheral to the default state
@@ -92,11 +92,8 @@ int16_t sht20GetTemperature()
 	temp = data_to_read[0];
 	temp = temp<<8;
 	temp = temp + data_to_read[1];
-	temperature = ((float)temp)*0.2681274414 - 4685;
-	
-	temp = temperature;
 	
-	return temp;
+	return fxp_sht2x_temperature_centi(temp);
 	
 }
 
@@ -108,7 +105,6 @@ uint16_t sht20GetHumidity()
 	uint8_t data_to_read[3] = {0};
 	uint8_t data_read_length = 3;
 	uint16_t temp;
-	float  humidity;
 	
 	//request temperature data from the SHT20
 	//set the i2c peripheral to the default state
@@ -132,19 +128,9 @@ uint16_t sht20GetHumidity()
 	temp = data_to_read[0];
 	temp = temp<<8;
 	temp = temp + data_to_read[1];
-	humidity = (float)temp;
-	
-	//conversion factor from datasheet
-	humidity = humidity * 0.001907348633;
-	humidity = humidity - 6;
-	
-	//multiply by 10 to catch the decimal palce
-	humidity = humidity * 10;
-	
-	//convert back to int
-	temp = humidity;
 	
-	return temp;
+	//conversion factor from datasheet, to 0.1 %RH
+	return (uint16_t)fxp_sht2x_humidity_deci(temp);
 	
 }
 
@@ -28,11 +28,42 @@
 #include "lora_sensum.h"
 #include "global.h"
 #include "radio_common.h"
+#include "fixed_point.h"
+#include "acquire.h"
+#include "counter.h"
+#include "delays.h"
+#include "event_loop.h"
+#include "exception_report.h"
+#include "sampler.h"
+#include <string.h>
 
 #define SHT30_ADDR_1 0x44
 #define SHT30_ADDR_2 0x45
 #define CRC_POLYNOMIAL 0x131 //P(x)=x^8+x^5+x^4+1 = 100110001
 
+#define SHT30_CMD_SINGLE_SHOT      0x2400 //high repeatability, no clock stretching
+#define SHT30_CMD_PERIODIC_LOW     0x202F //0.5 measurements per second, low repeatability
+#define SHT30_CMD_FETCH_DATA       0xE000
+#define SHT30_CMD_BREAK            0x3093
+#define SHT30_CMD_ALERT_HIGH_SET   0x611D
+#define SHT30_CMD_ALERT_HIGH_CLEAR 0x6116
+#define SHT30_CMD_ALERT_LOW_CLEAR  0x610B
+#define SHT30_CMD_ALERT_LOW_SET    0x6100
+
+//the ALERT output of each sensor is wired to a counter input
+#define SHT30_ALERT1_PORT COUNT1_PORT
+#define SHT30_ALERT1_PIN  COUNT1_PIN
+#define SHT30_ALERT2_PORT COUNT2_PORT
+#define SHT30_ALERT2_PIN  COUNT2_PIN
+
+//on these boards the COUNT lines share their EXTI lines with the radio, see
+//update_device_behaviour(), so alert mode can't have them
+#if (defined(HW_1_0) + defined(HW_1_1) + defined(HW_1_2)) && defined(RAIDO_LORA_INTERNAL)
+	#define SHT30_ALERT_PINS_SHARED
+#endif
+
+#define SHT30_DEFAULT_HYSTERESIS 50 //0.5 DegC and 0.5 %RH
+
 static int16_t upper_temperature_threshold         = INT16_MAX;
 static int16_t lower_temperature_threshold         = INT16_MIN;
 static bool    upper_temperature_threshold_enabled = false;
@@ -42,10 +73,24 @@ static int16_t lower_humidity_threshold            = INT16_MIN;
 static bool    upper_humidity_threshold_enabled    = false;
 static bool    lower_humidity_threshold_enabled    = false;
 static uint8_t threshold_wakeups                   = 1;
+static bool    alert_mode_enabled                  = false;
+static uint16_t temperature_hysteresis             = SHT30_DEFAULT_HYSTERESIS;
+static uint16_t humidity_hysteresis                = SHT30_DEFAULT_HYSTERESIS;
+static exception_tuning_t temperature_tuning       = {0};
+static exception_tuning_t humidity_tuning          = {0};
+
+//one channel per reading, the two sensors share their limits
+static exception_channel_t  temperature_channel[2] = {{exception_band_normal}};
+static exception_channel_t  humidity_channel[2]    = {{exception_band_normal}};
+static exception_schedule_t uplink_schedule        = {0};
+
+//set while both sensors are measuring periodically with the alert limits loaded
+static bool          alert_mode_running = false;
+static volatile bool alert_pending      = false;
 
 
 //calculates 8-Bit checksum with given polynomial
-static uint8_t validCRC(uint8_t *data, uint8_t data_length, uint8_t checksum)
+static uint8_t calcCRC(uint8_t *data, uint8_t data_length)
 {
 	uint8_t crc = 0xFF;
 	uint8_t byte_counter;
@@ -67,165 +112,214 @@ static uint8_t validCRC(uint8_t *data, uint8_t data_length, uint8_t checksum)
 			}
 		}
 	}
-	if (crc != checksum) return 0;
-	else return 1;
+	return crc;
 }
 
-//This function will get the temperature from the sht30, using the hold-master method
-sht30Reading_t sht30GetReading()
+static uint8_t validCRC(uint8_t *data, uint8_t data_length, uint8_t checksum)
 {
-	sht30Reading_t results = {0};
-	uint8_t data_to_send[] = {0x2C, 0x06};
-	uint8_t data_send_length = 2;
-	uint8_t data_to_read[6] = {0};
-	uint8_t data_read_length = 6;
-	int16_t temp;
-	float  tempf;
+	return calcCRC(data, data_length) == checksum;
+}
+
+//sends the same 16 bit command to both sensors
+static void sht30_send_command(uint16_t command)
+{
+	uint8_t data_to_send[] = {command >> 8, command & 0xFF};
+	
+	i2c1_send(SHT30_ADDR_1, data_to_send, sizeof(data_to_send), 1);
+	i2c1_send(SHT30_ADDR_2, data_to_send, sizeof(data_to_send), 1);
+}
+
+//converts one sensor's 6 byte response, invalid data is marked with the min/max value
+static void sht30_convert(uint8_t *data_to_read, int16_t *temperature, uint16_t *humidity)
+{
+	uint16_t raw;
 	
-	//request temperature data from the sht30
-	//set the i2c peripheral to the default state
-	if(!i2c1_init())
-	{
-		//if we could not initialise the I2C, then we cannot read the sensors.
-		for(temp = 0; temp < data_read_length; temp++)
-		{
-			data_to_read[temp] = 0;
-		}
-	}
-	else
-	{
-		i2c1_send(SHT30_ADDR_1, data_to_send, data_send_length, 1);
-		i2c1_receive(SHT30_ADDR_1, data_to_read, data_read_length,1);
-	}
 	//check the data validity using CRC, temperature
 	if(validCRC(data_to_read, 2, *(data_to_read+2)))
 	{
-		Debug_printf("T1 OK\r\n");
 		//CRC OK
-		//at this point we know we have valid data, time to convert T1
-		temp = data_to_read[0];
-		temp = temp<<8;
-		temp = temp + data_to_read[1];
-		
-		//conversion from raw to Deg C
-		tempf = (float)temp;
-		tempf = tempf*0.002670328832;
-		tempf = tempf - 45;
+		//at this point we know we have valid data, time to convert T
+		raw = data_to_read[0];
+		raw = raw<<8;
+		raw = raw + data_to_read[1];
 		
-		//scale up for 2dp precision
-		tempf = tempf * 100;
-		
-		results.T1 = (int16_t)tempf;
+		//conversion from raw to Deg C, 2dp precision
+		*temperature = fxp_sht3x_temperature_centi(raw);
 	}
 	else
 	{
 		//CRC ERROR, return minimum value
-		results.T1 = 0x8000;
+		*temperature = 0x8000;
 	}
 	
-		//check the data validity using CRC, humidity
+	//check the data validity using CRC, humidity
 	if(validCRC(data_to_read+3, 2, *(data_to_read+5)))
 	{
-		Debug_printf("H1 OK\r\n");
 		//CRC OK
-		//at this point we know we have valid data, time to convert H1
-		temp = data_to_read[3];
-		temp = temp<<8;
-		temp = temp + data_to_read[4];
-		
-		//conversion from raw to %RH
-		tempf = (float)((uint16_t)temp);
-		tempf = tempf*0.00152590219;
+		//at this point we know we have valid data, time to convert H
+		raw = data_to_read[3];
+		raw = raw<<8;
+		raw = raw + data_to_read[4];
 		
-		//scale up for 2dp precision
-		tempf = tempf * 100;
-		
-		results.H1 = (int16_t)tempf;
+		//conversion from raw to %RH, 2dp precision
+		*humidity = fxp_sht3x_humidity_centi(raw);
 	}
 	else
 	{
 		//CRC ERROR, return maximum value to signify
-		results.H1 = 0xFFFF;
+		*humidity = 0xFFFF;
 	}
+}
+
+//Single shot, high repeatability, no clock stretching. The sensor NACKs reads
+//until the measurement is done, so the bus is free for other sensors meanwhile.
+//In alert mode the sensors are already measuring, so the latest periodic result
+//is fetched instead. Stopping them would re-trigger the ALERT output.
+static bool sht30_acquire_start(void* result)
+{
+	sht30Reading_t* reading = (sht30Reading_t*)result;
 	
-	//request temperature data from the sht30
 	//set the i2c peripheral to the default state
 	if(!i2c1_init())
 	{
 		//if we could not initialise the I2C, then we cannot read the sensors.
-		for(temp = 0; temp < data_read_length; temp++)
-		{
-			data_to_read[temp] = 0;
-		}
-	}
-	else
-	{
-		i2c1_send(SHT30_ADDR_2, data_to_send, data_send_length, 1);
-		i2c1_receive(SHT30_ADDR_2, data_to_read, data_read_length,1);
+		reading->T1 = 0x8000;
+		reading->T2 = 0x8000;
+		reading->H1 = 0xFFFF;
+		reading->H2 = 0xFFFF;
+		return false;
 	}
+	
+	sht30_send_command(alert_mode_running ? SHT30_CMD_FETCH_DATA : SHT30_CMD_SINGLE_SHOT);
+	return true;
+}
 
-	//check the data validity using CRC, temperature
-	if(validCRC(data_to_read, 2, *(data_to_read+2)))
+static void sht30_acquire_collect(void* result, bool timed_out)
+{
+	uint8_t data_to_read[6] = {0};
+	sht30Reading_t* reading = (sht30Reading_t*)result;
+	
+	//a NACK leaves the buffer zeroed, which fails the CRC check
+	if(!i2c1_receive_feedback(SHT30_ADDR_1, data_to_read, sizeof(data_to_read), 1))
 	{
-		Debug_printf("T2 OK\r\n");
-		//CRC OK
-		//at this point we know we have valid data, time to convert T1
-		temp = data_to_read[0];
-		temp = temp<<8;
-		temp = temp + data_to_read[1];
-		
-		//conversion from raw to Deg C
-		tempf = (float)temp;
-		tempf = tempf*0.002670328832;
-		tempf = tempf - 45;
-		
-		//scale up for 2dp precision
-		tempf = tempf * 100;
-		
-		results.T2 = (int16_t)tempf;
+		memset(data_to_read, 0, sizeof(data_to_read));
 	}
-	else
+	sht30_convert(data_to_read, &reading->T1, &reading->H1);
+	
+	if(!i2c1_receive_feedback(SHT30_ADDR_2, data_to_read, sizeof(data_to_read), 1))
 	{
-		//CRC ERROR, return minimum value
-		results.T2 = 0x8000;
+		memset(data_to_read, 0, sizeof(data_to_read));
 	}
+	sht30_convert(data_to_read, &reading->T2, &reading->H2);
+}
+
+const acquire_driver_t sht30_acquire_driver =
+{
+	.name          = "SHT30",
+	.warmup_ms     = 1 , //power-up time
+	.conversion_ms = 16, //high repeatability, 15mS max
+	.timeout_ms    = 0 ,
+	.power_on      = 0 ,
+	.start         = &sht30_acquire_start,
+	.ready         = 0 ,
+	.collect       = &sht30_acquire_collect,
+	.power_off     = 0 ,
+};
+
+//This function will get the temperature and humidity from both sht30s
+sht30Reading_t sht30GetReading()
+{
+	sht30Reading_t results = {0};
+	acquire_job_t  job     = {&sht30_acquire_driver, &results};
 	
-		//check the data validity using CRC, humidity
-	if(validCRC(data_to_read+3, 2, *(data_to_read+5)))
+	acquire_run(&job, 1);
+	
+	return results;
+}
+
+//a failed read is marked with the min/max values, which must not move a channel
+static bool sht30_valid(int16_t temperature, uint16_t humidity)
+{
+	return (temperature != (int16_t)0x8000) && (humidity != 0xFFFF);
+}
+
+static void sht30_exception_reported(uint8_t sensor, int16_t temperature, uint16_t humidity)
+{
+	if(sht30_valid(temperature, humidity))
 	{
-		Debug_printf("H2 OK\r\n");
-		//CRC OK
-		//at this point we know we have valid data, time to convert H1
-		temp = data_to_read[3];
-		temp = temp<<8;
-		temp = temp + data_to_read[4];
-		
-		//conversion from raw to %RH
-		tempf = (float)((uint16_t)temp);
-		tempf = tempf*0.00152590219;
-		
-		//scale up for 2dp precision
-		tempf = tempf * 100;
-		
-		results.H2 = (int16_t)tempf;
+		exception_reported(&temperature_channel[sensor], temperature);
+		exception_reported(&humidity_channel[sensor]   , humidity   );
 	}
-	else
+}
+
+//checks every channel, so each keeps its band and dwell, and returns the first reason
+static exception_reason_e sht30_exception_check(const sht30Reading_t* reading, const exception_config_t* temperature, const exception_config_t* humidity)
+{
+	const int16_t      t[2] = {reading->T1, reading->T2};
+	const uint16_t     h[2] = {reading->H1, reading->H2};
+	exception_reason_e found = exception_none;
+	exception_reason_e reason;
+	uint8_t            i;
+	
+	for(i=0;i<2;i++)
 	{
-		//CRC ERROR, return maximum value to signify
-		results.H2 = 0xFFFF;
+		if(!sht30_valid(t[i], h[i]))
+		{
+			continue;
+		}
+		
+		reason = exception_check(&temperature_channel[i], temperature, t[i]);
+		if(found == exception_none)
+		{
+			found = reason;
+		}
+		reason = exception_check(&humidity_channel[i], humidity, h[i]);
+		if(found == exception_none)
+		{
+			found = reason;
+		}
 	}
+	return found;
+}
+
+//the sampler's channels are T1, H1, T2 then H2, a failed sensor is left out
+static void sht30_sample_values(const sht30Reading_t* reading, int32_t values[], bool valid[])
+{
+	values[0] = reading->T1;
+	values[1] = reading->H1;
+	values[2] = reading->T2;
+	values[3] = reading->H2;
+	valid[0]  = valid[1] = sht30_valid(reading->T1, reading->H1);
+	valid[2]  = valid[3] = sht30_valid(reading->T2, reading->H2);
+}
+
+static void sht30_sample(int32_t values[], bool valid[])
+{
+	sht30Reading_t reading = sht30GetReading();
 	
-	return results;
-	
+	sht30_sample_values(&reading, values, valid);
 }
 
 void sht30_uplink( void )
 {
 	sht30_payload_t payload = {0};
 	sht30Reading_t data = {0};
+	int32_t values[4];
+	bool    valid[4];
 	
 	data = sht30GetReading();
 	
+	sht30_exception_reported(0, data.T1, data.H1);
+	sht30_exception_reported(1, data.T2, data.H2);
+	exception_sent(&uplink_schedule);
+	
+	//with sampling on, the summary goes instead
+	sht30_sample_values(&data, values, valid);
+	if(sampler_uplink(values, valid))
+	{
+		return;
+	}
+	
 	payload.members.Temperature1 = data.T1;
 	payload.members.Temperature2 = data.T2;
 	payload.members.Humidity1 = data.H1;
@@ -242,43 +336,180 @@ void sht30_uplink( void )
 	Uplink(payload.payload, SHT30_SIZE);
 }
 
+//packs a limit pair into the alert format, the 7 MSBs of the raw humidity
+//followed by the 9 MSBs of the raw temperature
+static uint16_t sht30_alert_limit(int32_t temperature, int32_t humidity)
+{
+	return (fxp_sht3x_humidity_raw(humidity) & 0xFE00) | (fxp_sht3x_temperature_raw(temperature) >> 7);
+}
+
+static void sht30_write_alert_limit(uint16_t command, uint16_t limit)
+{
+	uint8_t data_to_send[] = {command >> 8, command & 0xFF, limit >> 8, limit & 0xFF, 0};
+	
+	data_to_send[4] = calcCRC(&data_to_send[2], 2);
+	i2c1_send(SHT30_ADDR_1, data_to_send, sizeof(data_to_send), 1);
+	i2c1_send(SHT30_ADDR_2, data_to_send, sizeof(data_to_send), 1);
+}
+
+//ALERT rises when either sensor crosses a set limit. The reading and uplink are
+//left to the main loop, through the count event.
+static void sht30_alert_irq( void )
+{
+	if(alert_mode_running)
+	{
+		alert_pending = true;
+		event_post(event_count);
+	}
+}
+
+//The ALERT inputs are only taken while alert mode runs, so the COUNT inputs are
+//left alone otherwise
+static void sht30_alert_pins(bool claim)
+{
+	GPIO_InitTypeDef GPIO_InitStruct;
+	
+	if(!claim)
+	{
+		HW_GPIO_SetIrq(SHT30_ALERT1_PORT, SHT30_ALERT1_PIN, 3, NULL);
+		HW_GPIO_SetIrq(SHT30_ALERT2_PORT, SHT30_ALERT2_PIN, 3, NULL);
+		HW_GPIO_DeInit(SHT30_ALERT1_PORT, SHT30_ALERT1_PIN);
+		HW_GPIO_DeInit(SHT30_ALERT2_PORT, SHT30_ALERT2_PIN);
+		return;
+	}
+	
+	//the ALERT outputs are push-pull, active high
+	GPIO_InitStruct.Mode      = GPIO_MODE_IT_RISING;
+	GPIO_InitStruct.Pull      = GPIO_NOPULL;
+	GPIO_InitStruct.Speed     = GPIO_SPEED_FREQ_LOW;
+	
+	HW_GPIO_Init(SHT30_ALERT1_PORT, SHT30_ALERT1_PIN, &GPIO_InitStruct);
+	HW_GPIO_Init(SHT30_ALERT2_PORT, SHT30_ALERT2_PIN, &GPIO_InitStruct);
+	
+	HW_GPIO_SetIrq(SHT30_ALERT1_PORT, SHT30_ALERT1_PIN, 3, sht30_alert_irq);
+	HW_GPIO_SetIrq(SHT30_ALERT2_PORT, SHT30_ALERT2_PIN, 3, sht30_alert_irq);
+}
+
+//Loads the thresholds into the alert limit registers and leaves both sensors
+//measuring periodically, so the ALERT outputs track the thresholds without the
+//MCU waking. Disabled thresholds are pushed to the end of the sensor range.
+static void sht30_alert_arm( void )
+{
+	int32_t t_upper = upper_temperature_threshold_enabled ? upper_temperature_threshold : 13000;
+	int32_t t_lower = lower_temperature_threshold_enabled ? lower_temperature_threshold : -4500;
+	int32_t h_upper = upper_humidity_threshold_enabled    ? upper_humidity_threshold    : 10000;
+	int32_t h_lower = lower_humidity_threshold_enabled    ? lower_humidity_threshold    : 0;
+	
+	if(!i2c1_init())
+	{
+		Debug_printf("SHT30 alert: I2C init failed\r\n");
+		alert_mode_running = false;
+		return;
+	}
+	
+	//the sensors must be idle for the limits to be written
+	sht30_send_command(SHT30_CMD_BREAK);
+	delay_us(1000);
+	
+	sht30_write_alert_limit(SHT30_CMD_ALERT_HIGH_SET  , sht30_alert_limit(t_upper                         , h_upper                      ));
+	sht30_write_alert_limit(SHT30_CMD_ALERT_HIGH_CLEAR, sht30_alert_limit(t_upper - temperature_hysteresis, h_upper - humidity_hysteresis));
+	sht30_write_alert_limit(SHT30_CMD_ALERT_LOW_CLEAR , sht30_alert_limit(t_lower + temperature_hysteresis, h_lower + humidity_hysteresis));
+	sht30_write_alert_limit(SHT30_CMD_ALERT_LOW_SET   , sht30_alert_limit(t_lower                         , h_lower                      ));
+	
+	sht30_alert_pins(true);
+	sht30_send_command(SHT30_CMD_PERIODIC_LOW);
+	alert_mode_running = true;
+	
+	Debug_printf("SHT30 alert mode armed\r\n");
+}
+
+static void sht30_alert_disarm( void )
+{
+	alert_mode_running = false;
+	sht30_alert_pins(false);
+	
+	if(i2c1_init())
+	{
+		sht30_send_command(SHT30_CMD_BREAK);
+	}
+	
+	Debug_printf("SHT30 alert mode stopped\r\n");
+}
+
+//re-applies the alert configuration, after a config load or change
+static void sht30_alert_update( void )
+{
+#ifdef SHT30_ALERT_PINS_SHARED
+	alert_mode_enabled = false;
+#endif
+	if(alert_mode_enabled)
+	{
+		sht30_alert_arm();
+	}
+	else if(alert_mode_running)
+	{
+		sht30_alert_disarm();
+	}
+}
+
+void sht30_init( void )
+{
+	sht30_alert_update();
+	
+	sampler_start(&sht30_sample, 4);
+}
+
+void sht30_onAlert( void )
+{
+	if(!alert_pending)
+	{
+		return;
+	}
+	alert_pending = false;
+	
+	Debug_printf("Threshold Alert\r\n");
+	sht30_uplink();
+}
+
 void sht30_onWakeup( void )
 {
-	if(wakeup_count % wakeups_per_uplink == 0)
+	exception_config_t temperature = exception_config(upper_temperature_threshold, upper_temperature_threshold_enabled,
+	                                                  lower_temperature_threshold, lower_temperature_threshold_enabled,
+	                                                  temperature_hysteresis, &temperature_tuning);
+	exception_config_t humidity    = exception_config(upper_humidity_threshold, upper_humidity_threshold_enabled,
+	                                                  lower_humidity_threshold, lower_humidity_threshold_enabled,
+	                                                  humidity_hysteresis, &humidity_tuning);
+	exception_reason_e reason;
+	
+	if(exception_heartbeat_due(&uplink_schedule))
 	{
 		Debug_printf("Regular Uplink (%d)\r\n", wakeups_per_uplink);
 		sht30_uplink();
 		return;
 	}
 	
-	//this is only executed if at least one of the thresholds is enabled
+	//in alert mode the sensors check the thresholds themselves
+	if(alert_mode_running)
+	{
+		return;
+	}
+	
+	//this is only executed if something could report
 	if((wakeup_count % threshold_wakeups == 0) && 
-		(upper_temperature_threshold_enabled ||
-		 lower_temperature_threshold_enabled ||
-		 upper_humidity_threshold_enabled    ||
-		 lower_humidity_threshold_enabled))
+		(exception_config_active(&temperature) || exception_config_active(&humidity)))
 	{
 		Debug_printf("Threshold Check (%d)\r\n", threshold_wakeups);
 		sht30Reading_t result = sht30GetReading();
 		
-		if((result.T1 > upper_temperature_threshold || result.T2 > upper_temperature_threshold) && upper_temperature_threshold_enabled)
+		reason = sht30_exception_check(&result, &temperature, &humidity);
+		if(reason != exception_none)
 		{
-			Debug_printf("Upper Threshold exceeded\r\n");
+			Debug_printf("Exception Uplink: %s\r\n", exception_reason_name(reason));
 			sht30_uplink();
-			return;
-		}
-		
-		if((result.H1 > upper_humidity_threshold || result.H2 > upper_humidity_threshold) && lower_humidity_threshold_enabled)
-		{
-			Debug_printf("Lower Threshold exceeded\r\n");
-			sht30_uplink();
-			return;
 		}
 	}
 }
 
-              
-
 void sht30_save_config()
 {
 	sht30_config_page_layout_t config = {0};
@@ -292,8 +523,18 @@ void sht30_save_config()
 	config.members.temperature_upper_enabled   = upper_temperature_threshold_enabled;
 	config.members.temperature_lower_enabled   = lower_temperature_threshold_enabled;
 	config.members.threshold_wakeups           = threshold_wakeups                  ;
+	config.members.alert_mode_enabled          = alert_mode_enabled                 ;
+	config.members.temperature_hysteresis      = temperature_hysteresis             ;
+	config.members.humidity_hysteresis         = humidity_hysteresis                ;
+	config.members.temperature_exception       = temperature_tuning                 ;
+	config.members.humidity_exception          = humidity_tuning                    ;
+	config.members.max_silence_wakeups         = uplink_schedule.max_silence        ;
 	
 	save_extra_config_page(config.raw_bytes, device_specific_page_1);
+	sampler_save_config(device_specific_page_2);
+	
+	//thresholds may have changed, so the sensors need the new limits
+	sht30_alert_update();
 }
 
 void sht30_load_config()
@@ -311,6 +552,25 @@ void sht30_load_config()
 	upper_temperature_threshold_enabled = config.members.temperature_upper_enabled  ;
 	lower_temperature_threshold_enabled = config.members.temperature_lower_enabled  ;
 	threshold_wakeups                   = config.members.threshold_wakeups          ;                
+	alert_mode_enabled                  = config.members.alert_mode_enabled         ;
+	temperature_hysteresis              = config.members.temperature_hysteresis     ;
+	humidity_hysteresis                 = config.members.humidity_hysteresis        ;
+	temperature_tuning                  = config.members.temperature_exception      ;
+	humidity_tuning                     = config.members.humidity_exception         ;
+	uplink_schedule.max_silence         = config.members.max_silence_wakeups        ;
+	
+	//pages saved before the hysteresis existed, and new pages, read back as
+	//zeros, an erased chip as all ones. A clear limit on the set limit chatters,
+	//so 0 is not a setting the CLI allows.
+	if((temperature_hysteresis == 0xFFFF) || (temperature_hysteresis == 0)) temperature_hysteresis = SHT30_DEFAULT_HYSTERESIS;
+	if((humidity_hysteresis    == 0xFFFF) || (humidity_hysteresis    == 0)) humidity_hysteresis    = SHT30_DEFAULT_HYSTERESIS;
+	//an erased page reads back as all ones
+	if(uplink_schedule.max_silence == 0xFFFF) uplink_schedule.max_silence = 0;
+	exception_tuning_defaults(&temperature_tuning);
+	exception_tuning_defaults(&humidity_tuning);
+	
+	sampler_load_config(device_specific_page_2);
+	sht30_alert_update();
 
 }
 
@@ -431,18 +691,30 @@ void sht30_cli_threshold_help()
 	Debug_printf("\tCheck threshold every [value] wakeups\r\n");
 	await_uart_tx();
 	
+	Debug_printf("Usage: threshold alert [enable|disable]\r\n");
+	await_uart_tx();
+	Debug_printf("\tLet the sensors check the thresholds, waking only on ALERT\r\n");
+	await_uart_tx();
+	
+	Debug_printf("Usage: threshold hysteresis [t|h] [value]\r\n");
+	await_uart_tx();
+	Debug_printf("\tset the alert clear hysteresis for temperature or humidity\r\n");
+	await_uart_tx();
+	
+	exception_cli_help(" [t|h]");
+	
 	Debug_printf("Usage: threshold show\r\n");
 	await_uart_tx();
 	Debug_printf("\tShows the current threshold configuration\r\n");
 	await_uart_tx();
 }
 
-void sht30_cli_threshold(int argc, char *argv[])
+static void sht30_cli_threshold_parse(int argc, char *argv[])
 {
 	//"threshold enable t_upper"
 	//"threshold disable t_upper"
 	//"threshold set t_upper [value]"
-	float value;
+	int32_t value;
 	
 	if(argc == 1)
 	{
@@ -466,6 +738,16 @@ void sht30_cli_threshold(int argc, char *argv[])
 			await_uart_tx();
 			Debug_printf("Checking thresholds every %d wakeups\r\n", threshold_wakeups);
 			await_uart_tx();
+			Debug_printf("Alert mode               :%s\r\n"        , alert_mode_enabled?(alert_mode_running?"RUNNING":"ENABLED"):"NO");
+			await_uart_tx();
+			Debug_printf("Temperature hysteresis   :%d.%02d\r\n"   , temperature_hysteresis/100, temperature_hysteresis%100);
+			await_uart_tx();
+			Debug_printf("Humidity hysteresis      :%d.%02d\r\n"   , humidity_hysteresis/100, humidity_hysteresis%100);
+			await_uart_tx();
+			exception_cli_show("Temperature", &temperature_tuning, 100);
+			exception_cli_show("Humidity"   , &humidity_tuning   , 100);
+			Debug_printf("Max silence              :%d wakeups\r\n", uplink_schedule.max_silence);
+			await_uart_tx();
 			return;
 		}
 	}
@@ -486,6 +768,30 @@ void sht30_cli_threshold(int argc, char *argv[])
 			return;
 			
 		}
+		if(!strcmp(argv[0], "silence"))
+		{
+			exception_cli_silence(argv[1], &uplink_schedule);
+			return;
+		}
+		if(!strcmp(argv[0], "alert"))
+		{
+			if(!strcmp(argv[1], "enable"))
+			{
+#ifdef SHT30_ALERT_PINS_SHARED
+				Debug_printf("Alert mode needs the COUNT inputs, which the radio uses on this board\r\n");
+#else
+				alert_mode_enabled = true;
+				Debug_printf("Alert mode Enabled\r\n");
+#endif
+				return;
+			}
+			if(!strcmp(argv[1], "disable"))
+			{
+				alert_mode_enabled = false;
+				Debug_printf("Alert mode Disabled\r\n");
+				return;
+			}
+		}
 		if(!strcmp(argv[0], "enable"))
 		{
 			//options here are upper or lower
@@ -541,7 +847,42 @@ void sht30_cli_threshold(int argc, char *argv[])
 	
 	if(argc == 3)
 	{
-		value = atof(argv[2]);
+		if(!strcmp(argv[1], "t") && exception_cli_tuning(argv[0], argv[2], &temperature_tuning, 100))
+		{
+			return;
+		}
+		if(!strcmp(argv[1], "h") && exception_cli_tuning(argv[0], argv[2], &humidity_tuning, 100))
+		{
+			return;
+		}
+		
+		//value is parsed straight to 0.01 units
+		if(!fxp_parse_scaled(argv[2], 100, &value))
+		{
+			Debug_printf("Invalid value\r\n");
+			return;
+		}
+		
+		if(!strcmp(argv[0], "hysteresis"))
+		{
+			if(value < 1 || value > 2000)
+			{
+				Debug_printf("Value out of range\r\n");
+				return;
+			}
+			if(!strcmp(argv[1], "t"))
+			{
+				temperature_hysteresis = (uint16_t)value;
+				Debug_printf("Temperature hysteresis set to %d.%02d\r\n", temperature_hysteresis/100, temperature_hysteresis%100);
+				return;
+			}
+			if(!strcmp(argv[1], "h"))
+			{
+				humidity_hysteresis = (uint16_t)value;
+				Debug_printf("Humidity hysteresis set to %d.%02d\r\n", humidity_hysteresis/100, humidity_hysteresis%100);
+				return;
+			}
+		}
 		
 		if(!strcmp(argv[0], "set"))
 		{
@@ -549,14 +890,14 @@ void sht30_cli_threshold(int argc, char *argv[])
 			if(!strcmp(argv[1], "t_upper"))
 			{
 				//set upper
-				upper_temperature_threshold = (int16_t)(value*100);
+				upper_temperature_threshold = (int16_t)value;
 				Debug_printf("Upper threshold set to %d.%02d\r\n", upper_temperature_threshold/100, upper_temperature_threshold%100);
 				return;
 			}
 			if(!strcmp(argv[1], "t_lower"))
 			{
 				//set lower
-				lower_temperature_threshold = (int16_t)(value*100);
+				lower_temperature_threshold = (int16_t)value;
 				Debug_printf("Upper threshold set to %d.%02d\r\n", lower_temperature_threshold/100, lower_temperature_threshold%100);
 				return;
 			}
@@ -564,14 +905,14 @@ void sht30_cli_threshold(int argc, char *argv[])
 			if(!strcmp(argv[1], "h_upper"))
 			{
 				//set upper
-				upper_humidity_threshold = (uint16_t)(value*100);
+				upper_humidity_threshold = (uint16_t)value;
 				Debug_printf("Upper threshold set to %d.%02d\r\n", upper_humidity_threshold/100, upper_humidity_threshold%100);
 				return;
 			}
 			if(!strcmp(argv[1], "h_lower"))
 			{
 				//set lower
-				lower_humidity_threshold = (uint16_t)(value*100);
+				lower_humidity_threshold = (uint16_t)value;
 				Debug_printf("Upper threshold set to %d.%02d\r\n", lower_humidity_threshold/100, lower_humidity_threshold%100);
 				return;
 			}
@@ -582,4 +923,16 @@ void sht30_cli_threshold(int argc, char *argv[])
 }
 
 
+void sht30_cli_threshold(int argc, char *argv[])
+{
+	sht30_cli_threshold_parse(argc, argv);
+	
+	//pick up any change to the limits straight away, "show" changes nothing
+	if(argc > 1 && (alert_mode_enabled || alert_mode_running))
+	{
+		sht30_alert_update();
+	}
+}
+
+
 
@@ -161,7 +161,7 @@ static int SigfoxFormatTxString(char* output, int output_length,const char *form
 
 bool sf_send(uint8_t* data, int length)
 {
-	if(length > 12)
+	if(length > SIGFOX_MAX_PAYLOAD)
 	{
 		return false;
 	}
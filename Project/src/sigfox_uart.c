@@ -25,6 +25,7 @@
 #include "global.h"
 #include "timeServer.h"
 #include "delays.h"
+#include "stack_monitor.h"
 
 volatile static USART_TDR_t *REG_Sigfox_TDR = USART5_TDR_ADDR;
 volatile static USART_RDR_t *REG_Sigfox_RDR = USART5_RDR_ADDR;
@@ -46,6 +47,31 @@ volatile static char tx_buffer[TX_BUFFER_LENGTH];
 volatile static int  tx_buffer_read_pos=0;
 volatile static int  tx_buffer_write_pos=0;
 
+//USART5 runs from PCLK1 with OVER8 set, BRR[2:0] holds USARTDIV[3:0] shifted right by one
+static uint32_t sigfox_brr(void)
+{
+	LL_RCC_ClocksTypeDef clocks;
+	uint32_t usartdiv;
+	
+	LL_RCC_GetSystemClocksFreq(&clocks);
+	usartdiv = ((2 * clocks.PCLK1_Frequency) + (SIGFOX_BAUD/2)) / SIGFOX_BAUD;
+	
+	return (usartdiv & 0xFFF0) | ((usartdiv & 0x000F) >> 1);
+}
+
+//The clock manager has switched the system clock, and with it PCLK1
+void sigfox_clock_changed()
+{
+	if(!REG_Sigfox_CLKEN->USART5_EN || !REG_Sigfox_CR1->UE)
+	{
+		return;
+	}
+	
+	REG_Sigfox_CR1->UE = 0;
+	REG_Sigfox_BRR->BRR = sigfox_brr();
+	REG_Sigfox_CR1->UE = 1;
+}
+
 void sigfox_usart_init()
 {
 	//USART disable
@@ -77,7 +103,7 @@ void sigfox_usart_init()
 		//Baud
 		//enable over8 (instead of over16)
 		REG_Sigfox_CR1->OVER8 = 1;
-		REG_Sigfox_BRR->BRR   = 0x1A0;
+		REG_Sigfox_BRR->BRR   = sigfox_brr();
 		
 		//Stop Bits
 			//Leave at default for 8N1
@@ -257,6 +283,8 @@ int sigfox_readLine(char* input, int max_length, int timeout_ms)
 //Interrupt handler for the Sigfox_uart
 void USART4_5_IRQHandler( void )
 {
+	stack_monitor_isr_enter();
+	
 	//if the TX register is empty, we can load a new character into the buffer
 	if(REG_Sigfox_ISR->TXE)
 	{
@@ -291,5 +319,7 @@ void USART4_5_IRQHandler( void )
 	{
 		REG_Sigfox_ICR->WUCF = 1;
 	}
+	
+	stack_monitor_isr_exit();
 }
 
@@ -0,0 +1,211 @@
+/*
+   _____             _____                 
+  / ____|           / ____|                
+ | (___   ___ _ __ | (___  _   _ _ __ ___  
+  \___ \ / _ \ '_ \ \___ \| | | | '_ ` _ \ 
+  ____) |  __/ | | |____) | |_| | | | | | |
+ |_____/ \___|_| |_|_____/ \__,_|_| |_| |_|
+                                           
+                                           
+	Description: Stack high water mark and interrupt nesting.
+								Everything under the stack pointer is filled with a pattern before
+								init() runs, and the free stack is the run of pattern left at the
+								bottom. Interrupt handlers count themselves in and out, so the
+								deepest nesting is known too. Both are kept in an RTC backup
+								register, which survives a watchdog reset, so the startup packet
+								can report the run that ended as well as this one.
+
+	Maintainer: Shea Gosnell
+
+
+*/
+
+#include <string.h>
+#include "hw.h"
+#include "debug_uart.h"
+#include "stack_monitor.h"
+
+//from startup_stm32l072xx.s, the stack runs from __initial_sp down to Stack_Mem
+extern uint32_t Stack_Mem[];
+extern uint32_t __initial_sp[];
+
+#define STACK_PAINT            0xC5C5C5C5UL
+//words left unpainted under the stack pointer, for the frame that is painting
+#define STACK_PAINT_GUARD      8
+#define STACK_BACKUP_REGISTER  LL_RTC_BKP_DR0
+//top byte marks the register as ours, then the nesting, then the free bytes
+#define STACK_BACKUP_MAGIC     0xA5000000UL
+#define STACK_BACKUP_MAGIC_MSK 0xFF000000UL
+
+static uint16_t min_free = 0;
+static volatile uint8_t isr_depth = 0;
+static volatile uint8_t isr_depth_max = 0;
+
+static bool     started = false;
+static uint32_t saved = 0;
+static bool     previous_valid = false;
+static uint16_t previous_min_free = 0;
+static uint8_t  previous_isr_depth_max = 0;
+
+static uint16_t stack_free_bytes(void)
+{
+	uint32_t *word = Stack_Mem;
+
+	while((word < __initial_sp) && (*word == STACK_PAINT))
+	{
+		word++;
+	}
+	return (uint16_t)((word - Stack_Mem) * sizeof(uint32_t));
+}
+
+static void stack_monitor_save(void)
+{
+	uint32_t record = STACK_BACKUP_MAGIC | ((uint32_t)isr_depth_max << 16) | min_free;
+
+	if(record == saved)
+	{
+		return;
+	}
+	LL_PWR_EnableBkUpAccess();
+	LL_RTC_BAK_SetRegister(RTC, STACK_BACKUP_REGISTER, record);
+	saved = record;
+}
+
+//first thing in main(), nothing below the stack pointer is live yet
+void stack_monitor_paint(void)
+{
+	uint32_t *word = Stack_Mem;
+	uint32_t *end  = (uint32_t *)__get_MSP() - STACK_PAINT_GUARD;
+
+	while(word < end)
+	{
+		*word++ = STACK_PAINT;
+	}
+	min_free = stack_free_bytes();
+}
+
+//after init(), the RTC is running so the last run's record can be read
+void stack_monitor_init(void)
+{
+	uint32_t record = LL_RTC_BAK_GetRegister(RTC, STACK_BACKUP_REGISTER);
+
+	if((record & STACK_BACKUP_MAGIC_MSK) == STACK_BACKUP_MAGIC)
+	{
+		previous_valid         = true;
+		previous_isr_depth_max = (uint8_t)(record >> 16);
+		previous_min_free      = (uint16_t)record;
+	}
+	started = true;
+	stack_monitor_update();
+}
+
+//from the main loop, ideally with interrupts disabled just before sleeping
+void stack_monitor_update(void)
+{
+	uint16_t free_now = stack_free_bytes();
+
+	if(free_now < min_free)
+	{
+		min_free = free_now;
+	}
+	if(started)
+	{
+		stack_monitor_save();
+	}
+}
+
+//first and last thing in each interrupt handler. A handler that preempts the
+//increment puts the count back before it returns, so no locking is needed.
+void stack_monitor_isr_enter(void)
+{
+	isr_depth++;
+	if(isr_depth > isr_depth_max)
+	{
+		isr_depth_max = isr_depth;
+	}
+}
+
+void stack_monitor_isr_exit(void)
+{
+	isr_depth--;
+}
+
+uint16_t stack_monitor_size(void)
+{
+	return (uint16_t)((__initial_sp - Stack_Mem) * sizeof(uint32_t));
+}
+
+uint16_t stack_monitor_min_free(void)
+{
+	return min_free;
+}
+
+uint8_t stack_monitor_isr_depth_max(void)
+{
+	return isr_depth_max;
+}
+
+//the run before this reset if there was one, this run so far otherwise
+void stack_monitor_startup_fields(uint8_t *free_units, uint8_t *isr_depth_out)
+{
+	uint16_t free_bytes;
+	uint8_t  depth;
+
+	stack_monitor_update();
+	free_bytes = min_free;
+	depth      = isr_depth_max;
+	if(previous_valid)
+	{
+		free_bytes = previous_min_free;
+		depth      = previous_isr_depth_max;
+	}
+
+	free_bytes /= STACK_PACKET_FREE_UNIT;
+	*free_units    = (free_bytes > STACK_PACKET_FREE_MAX) ? STACK_PACKET_FREE_MAX : free_bytes;
+	*isr_depth_out = (depth > STACK_PACKET_DEPTH_MAX) ? STACK_PACKET_DEPTH_MAX : depth;
+}
+
+void stack_monitor_print(void)
+{
+	stack_monitor_update();
+
+	Debug_printf("Stack size               :%u\r\n", stack_monitor_size());
+	Debug_printf("Stack min free           :%u\r\n", min_free);
+	await_uart_tx();
+	Debug_printf("ISR max nesting          :%u\r\n", isr_depth_max);
+	await_uart_tx();
+	if(previous_valid)
+	{
+		Debug_printf("Last run stack min free  :%u\r\n", previous_min_free);
+		Debug_printf("Last run ISR max nesting :%u\r\n", previous_isr_depth_max);
+		await_uart_tx();
+	}
+}
+
+static void cli_stack_help(void)
+{
+	Debug_printf("Usage: stack [repaint]\r\n");
+	await_uart_tx();
+	Debug_printf("\trepaint the free stack and clear the maxima, to measure one operation\r\n");
+	await_uart_tx();
+}
+
+void cli_stack_implementation(int argc, char *argv[])
+{
+	if(argc == 0)
+	{
+		stack_monitor_print();
+		return;
+	}
+	if((argc == 1) && !strcmp(argv[0], "repaint"))
+	{
+		//the CLI is deeper than an idle main loop, that part of the stack is not
+		//repainted and is only counted again once something goes deeper
+		stack_monitor_paint();
+		isr_depth_max = 0;
+		stack_monitor_save();
+		Debug_printf("Stack repainted, %u free\r\n", min_free);
+		return;
+	}
+	cli_stack_help();
+}
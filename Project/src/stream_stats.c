@@ -0,0 +1,345 @@
+/*
+   _____             _____                 
+  / ____|           / ____|                
+ | (___   ___ _ __ | (___  _   _ _ __ ___  
+  \___ \ / _ \ '_ \ \___ \| | | | '_ ` _ \ 
+  ____) |  __/ | | |____) | |_| | | | | | |
+ |_____/ \___|_| |_|_____/ \__,_|_| |_| |_|
+                                           
+                                           
+	Description: Streaming statistics over integer readings.
+								Mean and variance are Welford's, the integral is trapezoidal and
+								the quantiles are P2 estimates, all in integer arithmetic. The
+								sample count saturates at 65535, samples past that are ignored.
+
+	Maintainer: Shea Gosnell
+
+
+*/
+
+#include <string.h>
+#include "stream_stats.h"
+
+//p in Q16 for each stream_quantile_e
+static const uint32_t quantile_p[STREAM_QUANTILES] = {6554, 32768, 58982};
+
+static int64_t clamp_to_int32(int64_t value)
+{
+	if(value > INT32_MAX) return INT32_MAX;
+	if(value < INT32_MIN) return INT32_MIN;
+	return value;
+}
+
+static uint64_t isqrt64(uint64_t value)
+{
+	uint64_t root = 0;
+	uint64_t bit  = 1ULL << 62;
+
+	while(bit > value)
+	{
+		bit >>= 2;
+	}
+
+	while(bit != 0)
+	{
+		if(value >= root + bit)
+		{
+			value -= root + bit;
+			root   = (root >> 1) + bit;
+		}
+		else
+		{
+			root >>= 1;
+		}
+		bit >>= 2;
+	}
+	return root;
+}
+
+//while there are no more than STREAM_MARKERS samples they are kept sorted
+static void quantile_insert(stream_quantile_t *q, uint8_t used, int32_t value)
+{
+	uint8_t i = used;
+
+	while((i > 0) && (q->height[i-1] > value))
+	{
+		q->height[i] = q->height[i-1];
+		i--;
+	}
+	q->height[i] = value;
+}
+
+static void quantile_place_markers(stream_quantile_t *q, uint32_t p)
+{
+	uint8_t i;
+
+	for(i=0;i<STREAM_MARKERS;i++)
+	{
+		q->position[i] = i + 1;
+	}
+
+	q->desired[0] = STREAM_POSITION_ONE;
+	q->desired[1] = STREAM_POSITION_ONE + (2 * p);
+	q->desired[2] = STREAM_POSITION_ONE + (4 * p);
+	q->desired[3] = (3 * STREAM_POSITION_ONE) + (2 * p);
+	q->desired[4] = 5 * STREAM_POSITION_ONE;
+
+	q->increment[0] = 0;
+	q->increment[1] = p / 2;
+	q->increment[2] = p;
+	q->increment[3] = (STREAM_POSITION_ONE + p) / 2;
+	q->increment[4] = STREAM_POSITION_ONE;
+}
+
+//piecewise parabolic prediction of marker i moved by step (+-1)
+static int32_t quantile_parabolic(const stream_quantile_t *q, uint8_t i, int8_t step)
+{
+	int64_t below = q->position[i]   - q->position[i-1];
+	int64_t above = q->position[i+1] - q->position[i];
+	int64_t rise  = ((below + step) * (q->height[i+1] - q->height[i])) / above;
+	int64_t fall  = ((above - step) * (q->height[i] - q->height[i-1])) / below;
+
+	return q->height[i] + (int32_t)((step * (rise + fall)) / (below + above));
+}
+
+static int32_t quantile_linear(const stream_quantile_t *q, uint8_t i, int8_t step)
+{
+	int64_t span = (int64_t)q->height[i+step] - q->height[i];
+
+	return q->height[i] + (int32_t)((step * span) / (q->position[i+step] - q->position[i]));
+}
+
+static void quantile_update(stream_quantile_t *q, int32_t value)
+{
+	uint8_t k;
+	uint8_t i;
+
+	//find the cell the sample falls in, stretching the ends if it is outside
+	if(value < q->height[0])
+	{
+		q->height[0] = value;
+		k = 0;
+	}
+	else if(value >= q->height[STREAM_MARKERS-1])
+	{
+		q->height[STREAM_MARKERS-1] = value;
+		k = STREAM_MARKERS - 2;
+	}
+	else
+	{
+		for(k=0;value >= q->height[k+1];k++);
+	}
+
+	for(i=k+1;i<STREAM_MARKERS;i++)
+	{
+		q->position[i]++;
+	}
+	for(i=0;i<STREAM_MARKERS;i++)
+	{
+		q->desired[i] += q->increment[i];
+	}
+
+	//move the middle markers a step at a time toward where they should be
+	for(i=1;i<STREAM_MARKERS-1;i++)
+	{
+		int64_t offset = (int64_t)q->desired[i] - ((int64_t)q->position[i] * STREAM_POSITION_ONE);
+		int8_t  step;
+		int32_t height;
+
+		if((offset >= (int64_t)STREAM_POSITION_ONE) && ((q->position[i+1] - q->position[i]) > 1))
+		{
+			step = 1;
+		}
+		else if((offset <= -(int64_t)STREAM_POSITION_ONE) && ((q->position[i] - q->position[i-1]) > 1))
+		{
+			step = -1;
+		}
+		else
+		{
+			continue;
+		}
+
+		height = quantile_parabolic(q, i, step);
+		if((height <= q->height[i-1]) || (height >= q->height[i+1]))
+		{
+			height = quantile_linear(q, i, step);
+		}
+		q->height[i]    = height;
+		q->position[i] += step;
+	}
+}
+
+static void stream_welford(stream_stats_t *stats, int32_t value)
+{
+	int64_t  x = (int64_t)value << STREAM_MEAN_SHIFT;
+	int64_t  delta;
+	int64_t  delta_after;
+	uint64_t square;
+
+	delta        = x - stats->mean;
+	stats->mean += delta / stats->count;
+	delta_after  = x - stats->mean;
+
+	//both differences have the same sign, clamped so the product fits
+	delta       = clamp_to_int32(delta);
+	delta_after = clamp_to_int32(delta_after);
+	if((delta < 0) != (delta_after < 0))
+	{
+		return;
+	}
+	square = (uint64_t)(delta * delta_after);
+
+	stats->m2 = (stats->m2 > UINT64_MAX - square) ? UINT64_MAX : stats->m2 + square;
+}
+
+//the time the straight line between the last sample and this one crosses the threshold
+static uint32_t stream_crossing_time(const stream_stats_t *stats, int32_t value, uint32_t time_s)
+{
+	int64_t span = (int64_t)value - stats->last;
+
+	return stats->last_time_s + (uint32_t)((((int64_t)stats->threshold - stats->last) * (time_s - stats->last_time_s)) / span);
+}
+
+static void stream_threshold(stream_stats_t *stats, int32_t value, uint32_t time_s)
+{
+	bool     above = (value >= stats->threshold);
+	uint32_t crossed_at;
+
+	if(above == stats->above)
+	{
+		if(above)
+		{
+			stats->above_s += time_s - stats->last_time_s;
+		}
+		return;
+	}
+
+	crossed_at   = stream_crossing_time(stats, value, time_s);
+	stats->above = above;
+
+	if(above)
+	{
+		stats->crossings++;
+		if(stats->first_up_s == UINT32_MAX)
+		{
+			stats->first_up_s = crossed_at;
+		}
+		stats->above_s += time_s - crossed_at;
+	}
+	else
+	{
+		stats->last_down_s = crossed_at;
+		stats->above_s    += crossed_at - stats->last_time_s;
+	}
+}
+
+void stream_stats_reset(stream_stats_t *stats, int32_t threshold)
+{
+	memset(stats, 0, sizeof(stream_stats_t));
+
+	stats->threshold   = threshold;
+	stats->first_up_s  = UINT32_MAX;
+	stats->last_down_s = UINT32_MAX;
+}
+
+//time_s is from any fixed start, it must not go backwards
+void stream_stats_add(stream_stats_t *stats, int32_t value, uint32_t time_s)
+{
+	uint8_t i;
+
+	if(stats->count == UINT16_MAX)
+	{
+		return;
+	}
+	stats->count++;
+
+	if(stats->count == 1)
+	{
+		stats->min        = value;
+		stats->max        = value;
+		stats->min_time_s = time_s;
+		stats->max_time_s = time_s;
+		stats->above      = (value >= stats->threshold);
+		if(stats->above)
+		{
+			stats->first_up_s = time_s;
+		}
+	}
+	else
+	{
+		if(value < stats->min)
+		{
+			stats->min        = value;
+			stats->min_time_s = time_s;
+		}
+		if(value > stats->max)
+		{
+			stats->max        = value;
+			stats->max_time_s = time_s;
+		}
+
+		stats->integral += ((int64_t)stats->last + value) * (time_s - stats->last_time_s);
+		stream_threshold(stats, value, time_s);
+	}
+
+	stream_welford(stats, value);
+
+	for(i=0;i<STREAM_QUANTILES;i++)
+	{
+		if(stats->count <= STREAM_MARKERS)
+		{
+			quantile_insert(&stats->quantile[i], stats->count - 1, value);
+			if(stats->count == STREAM_MARKERS)
+			{
+				quantile_place_markers(&stats->quantile[i], quantile_p[i]);
+			}
+		}
+		else
+		{
+			quantile_update(&stats->quantile[i], value);
+		}
+	}
+
+	stats->last        = value;
+	stats->last_time_s = time_s;
+}
+
+int32_t stream_stats_mean(const stream_stats_t *stats)
+{
+	//round to nearest rather than toward minus infinity
+	return (int32_t)((stats->mean + (1 << (STREAM_MEAN_SHIFT - 1))) >> STREAM_MEAN_SHIFT);
+}
+
+//sample standard deviation, 0 until there are two samples
+uint32_t stream_stats_stddev(const stream_stats_t *stats)
+{
+	if(stats->count < 2)
+	{
+		return 0;
+	}
+	return (uint32_t)(isqrt64(stats->m2 / (stats->count - 1)) >> STREAM_MEAN_SHIFT);
+}
+
+int32_t stream_stats_quantile(const stream_stats_t *stats, stream_quantile_e quantile)
+{
+	const stream_quantile_t *q = &stats->quantile[quantile];
+
+	if(stats->count == 0)
+	{
+		return 0;
+	}
+
+	//nearest rank of the sorted samples until the markers are placed
+	if(stats->count < STREAM_MARKERS)
+	{
+		return q->height[((stats->count - 1) * quantile_p[quantile] + (STREAM_POSITION_ONE / 2)) / STREAM_POSITION_ONE];
+	}
+	return q->height[2];
+}
+
+//the integral in value*seconds/divisor, 3600 gives value*hours
+int32_t stream_stats_integral(const stream_stats_t *stats, uint32_t divisor)
+{
+	//the trapezoids are summed doubled, so the halving is only rounded once
+	return (int32_t)clamp_to_int32(stats->integral / (2 * (int64_t)divisor));
+}
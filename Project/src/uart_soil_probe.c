@@ -101,15 +101,13 @@ void probe_power_off()
 int8_t probe_temperature_process(uint8_t MSB, uint8_t LSB)
 {
 	int16_t temp;
-	float flt;
 	
 	temp = MSB;
 	temp = temp << 8;
 	temp += LSB;
 	//divide by 256 to get the temperature.
-	//note that this is a float conversion, and not equivilant to a >>8.
-	flt = ((float)temp)/256.0;
-	return (int8_t)flt; 
+	//note that this truncates toward zero, and is not equivilant to a >>8.
+	return (int8_t)(temp/256);
 }
 
 uint8_t probe_humidity_process(uint8_t MSB, uint8_t LSB)
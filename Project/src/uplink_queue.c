@@ -0,0 +1,372 @@
+/*
+   _____             _____                 
+  / ____|           / ____|                
+ | (___   ___ _ __ | (___  _   _ _ __ ___  
+  \___ \ / _ \ '_ \ \___ \| | | | '_ ` _ \ 
+  ____) |  __/ | | |____) | |_| | | | | | |
+ |_____/ \___|_| |_|_____/ \__,_|_| |_| |_|
+                                           
+                                           
+	Description: Application uplink queue.
+								Frames are sent highest priority first, oldest first within a
+								priority. When the MAC reports a duty cycle time-off the queue
+								arms a timer for it and returns to the main loop, rather than
+								letting ScheduleTx hold the frame while sendData spins.
+
+	Maintainer: Shea Gosnell
+
+
+*/
+
+#include <string.h>
+#include "global.h"
+#include "timeServer.h"
+#include "watchdog.h"
+#include "radio_common.h"
+#include "uplink_queue.h"
+#include "event_loop.h"
+#ifdef RAIDO_LORA_INTERNAL
+	#include "LoRaMac.h"
+#endif
+
+//a time-off shorter than this is left to the MAC, sleeping for it is not worth the wake-up
+#define UPLINK_QUEUE_MIN_DEFER_MS  1000
+//retry period when the MAC is still busy with a previous frame
+#define UPLINK_QUEUE_BUSY_RETRY_MS 1000
+
+typedef struct
+{
+	uint8_t  payload[UPLINK_QUEUE_PAYLOAD_SIZE];
+	uint8_t  size; //0 marks a free entry
+	uint8_t  priority;
+	uint16_t sequence;
+}uplink_queue_entry_t;
+
+static uplink_queue_entry_t queue[UPLINK_QUEUE_ENTRIES];
+static uint16_t next_sequence = 0;
+
+static TimerEvent_t  backoff_timer;
+static bool          backoff_timer_initialised = false;
+static volatile bool backoff_expired = false;
+static bool          backoff_armed = false;
+
+static uplink_sent_t sent_callback = NULL;
+
+//the frame uplink_queue_send() queued, and what became of it
+static bool              watching = false;
+static uint16_t          watch_sequence;
+static transmit_status_e watch_result;
+
+static uint32_t frames_sent     = 0;
+static uint32_t frames_failed   = 0;
+static uint32_t frames_merged   = 0;
+static uint32_t frames_dropped  = 0;
+static uint32_t frames_deferred = 0;
+static uint32_t deferred_ms     = 0;
+
+//the header byte is sent first, so it is the last byte of the payload
+static uint8_t uplink_queue_packet_type(const uint8_t payload[], uint8_t size)
+{
+	return payload[size-1] >> 4;
+}
+
+//true if a should be sent before b
+static bool uplink_queue_before(const uplink_queue_entry_t *a, const uplink_queue_entry_t *b)
+{
+	if(a->priority != b->priority)
+	{
+		return a->priority > b->priority;
+	}
+	return (int16_t)(a->sequence - b->sequence) < 0;
+}
+
+static int8_t uplink_queue_next(void)
+{
+	int8_t next = -1;
+	int8_t i;
+	
+	for(i=0;i<UPLINK_QUEUE_ENTRIES;i++)
+	{
+		if(queue[i].size != 0 && (next < 0 || uplink_queue_before(&queue[i], &queue[next])))
+		{
+			next = i;
+		}
+	}
+	return next;
+}
+
+//the entry that would be sent last, which is the one given up when the queue is full
+static int8_t uplink_queue_last(void)
+{
+	int8_t last = -1;
+	int8_t i;
+	
+	for(i=0;i<UPLINK_QUEUE_ENTRIES;i++)
+	{
+		if(queue[i].size != 0 && (last < 0 || uplink_queue_before(&queue[last], &queue[i])))
+		{
+			last = i;
+		}
+	}
+	return last;
+}
+
+static int8_t uplink_queue_free(void)
+{
+	int8_t i;
+	
+	for(i=0;i<UPLINK_QUEUE_ENTRIES;i++)
+	{
+		if(queue[i].size == 0)
+		{
+			return i;
+		}
+	}
+	return -1;
+}
+
+static bool uplink_queue_insert(const uint8_t payload[], uint8_t size, uplink_priority_e priority, uint16_t *sequence)
+{
+	int8_t  slot = -1;
+	int8_t  i;
+	uint8_t packet_type;
+	
+	if(size == 0 || size > UPLINK_QUEUE_PAYLOAD_SIZE)
+	{
+		return false;
+	}
+	
+	packet_type = uplink_queue_packet_type(payload, size);
+	
+	//an alarm carries the current state of its flags, so a newer alarm of the
+	//same type replaces one still waiting and keeps its place in the queue
+	if(priority == uplink_priority_alarm)
+	{
+		for(i=0;i<UPLINK_QUEUE_ENTRIES;i++)
+		{
+			if(queue[i].size     == size                  &&
+			   queue[i].priority == uplink_priority_alarm &&
+			   uplink_queue_packet_type(queue[i].payload, size) == packet_type)
+			{
+				memcpy(queue[i].payload, payload, size);
+				*sequence = queue[i].sequence;
+				frames_merged++;
+				dbg_uplink_queue("Uplink queue: alarm type %d merged\r\n", packet_type);
+				return true;
+			}
+		}
+	}
+	
+	slot = uplink_queue_free();
+	if(slot < 0)
+	{
+		//full, give up the frame that would go last, if it is no more important than this one
+		slot = uplink_queue_last();
+		if(queue[slot].priority > priority)
+		{
+			frames_dropped++;
+			dbg_uplink_queue("Uplink queue: full, type %d dropped\r\n", packet_type);
+			return false;
+		}
+		frames_dropped++;
+		dbg_uplink_queue("Uplink queue: full, type %d replaced\r\n", uplink_queue_packet_type(queue[slot].payload, queue[slot].size));
+	}
+	
+	memcpy(queue[slot].payload, payload, size);
+	queue[slot].size     = size;
+	queue[slot].priority = priority;
+	queue[slot].sequence = next_sequence++;
+	*sequence = queue[slot].sequence;
+	
+	dbg_uplink_queue("Uplink queue: type %d queued, priority %d\r\n", packet_type, priority);
+	return true;
+}
+
+bool uplink_queue_push(const uint8_t payload[], uint8_t size, uplink_priority_e priority)
+{
+	uint16_t sequence;
+	
+	return uplink_queue_insert(payload, size, priority, &sequence);
+}
+
+static void uplink_queue_backoff_expired(void)
+{
+	backoff_expired = true;
+	event_post(event_uplink_queue);
+}
+
+static void uplink_queue_defer(uint32_t time_ms)
+{
+	if(!backoff_timer_initialised)
+	{
+		TimerInit(&backoff_timer, &uplink_queue_backoff_expired);
+		backoff_timer_initialised = true;
+	}
+	
+	TimerStop(&backoff_timer);
+	backoff_expired = false;
+	TimerSetValue(&backoff_timer, time_ms);
+	TimerStart(&backoff_timer);
+	backoff_armed = true;
+	
+	frames_deferred++;
+	deferred_ms += time_ms;
+	dbg_uplink_queue("Uplink queue: deferred %dms\r\n", time_ms);
+}
+
+//time until the next frame can go on air without the MAC holding it
+static uint32_t uplink_queue_time_off(void)
+{
+#ifdef RAIDO_LORA_INTERNAL
+	if(isLoRaMacTxBusy() == LORAMAC_STATUS_BUSY)
+	{
+		return UPLINK_QUEUE_BUSY_RETRY_MS;
+	}
+	
+	//join requests are paced by JoinLoRaNetwork
+	if(!radio_joined())
+	{
+		return 0;
+	}
+	
+	return LoRaMacQueryTxTimeOff();
+#else
+	return 0;
+#endif
+}
+
+void uplink_queue_service(void)
+{
+	transmit_status_e    result;
+	uplink_queue_entry_t entry;
+	uint32_t             time_off;
+	int8_t               next;
+	
+	if(backoff_armed && !backoff_expired)
+	{
+		return;
+	}
+	backoff_armed   = false;
+	backoff_expired = false;
+	
+	while((next = uplink_queue_next()) >= 0)
+	{
+		time_off = uplink_queue_time_off();
+		if(time_off >= UPLINK_QUEUE_MIN_DEFER_MS)
+		{
+			uplink_queue_defer(time_off);
+			return;
+		}
+		
+		//copied out, as the radio can push a response frame while this one is sent
+		entry = queue[next];
+		result = radio_transmit(entry.payload, entry.size);
+		reset_watchdog();
+		
+		if(watching && (entry.sequence == watch_sequence))
+		{
+			watch_result = result;
+		}
+		
+		//without a network the frame stays where it is, and it and the rest go
+		//out with the next uplink
+		if(result == transmit_status_no_join)
+		{
+			frames_failed++;
+			break;
+		}
+		
+		//a frame the radio refused would only be refused again. A response pushed
+		//into a full queue meanwhile may have taken the entry over already.
+		if(queue[next].sequence == entry.sequence)
+		{
+			queue[next].size = 0;
+		}
+		if(result == transmit_status_no_send)
+		{
+			frames_failed++;
+			continue;
+		}
+		
+		frames_sent++;
+		if(sent_callback != NULL)
+		{
+			sent_callback(entry.payload, entry.size);
+		}
+	}
+}
+
+//Queues the frame and sends what the duty cycle allows. Returns what happened to
+//this frame: queued if it is still waiting, no_send if the queue had no room for it.
+transmit_status_e uplink_queue_send(const uint8_t payload[], uint8_t size, uplink_priority_e priority)
+{
+	bool              was_watching = watching;
+	uint16_t          was_sequence = watch_sequence;
+	transmit_status_e was_result   = watch_result;
+	transmit_status_e result;
+	uint16_t          sequence;
+	
+	if(!uplink_queue_insert(payload, size, priority, &sequence))
+	{
+		return transmit_status_no_send;
+	}
+	
+	watching       = true;
+	watch_sequence = sequence;
+	watch_result   = transmit_status_queued;
+	uplink_queue_service();
+	result = watch_result;
+	
+	//a downlink handler can send while an outer send is still waiting on its frame
+	watching       = was_watching;
+	watch_sequence = was_sequence;
+	watch_result   = was_result;
+	return result;
+}
+
+void uplink_queue_on_wakeup(void)
+{
+	if(backoff_expired)
+	{
+		uplink_queue_service();
+	}
+}
+
+//a frame can still be dropped after Uplink() has queued it, so a mode that has
+//to know its data went out waits for this
+void uplink_queue_on_sent(uplink_sent_t callback)
+{
+	sent_callback = callback;
+}
+
+bool uplink_queue_empty(void)
+{
+	return uplink_queue_next() < 0;
+}
+
+void uplink_queue_print(void)
+{
+	uint8_t pending = 0;
+	int8_t  i;
+	
+	for(i=0;i<UPLINK_QUEUE_ENTRIES;i++)
+	{
+		if(queue[i].size != 0)
+		{
+			pending++;
+		}
+	}
+	
+	Debug_printf("Uplink queue pending     :%d\r\n", pending);
+	await_uart_tx();
+	Debug_printf("Uplink queue sent        :%d\r\n", frames_sent);
+	await_uart_tx();
+	Debug_printf("Uplink queue failed      :%d\r\n", frames_failed);
+	await_uart_tx();
+	Debug_printf("Uplink queue merged      :%d\r\n", frames_merged);
+	await_uart_tx();
+	Debug_printf("Uplink queue dropped     :%d\r\n", frames_dropped);
+	await_uart_tx();
+	Debug_printf("Uplink queue deferred    :%d, %dms total\r\n", frames_deferred, deferred_ms);
+	await_uart_tx();
+}
@@ -27,17 +27,22 @@
 
 volatile static WWDG_CR_t     *REG_Watchdog_CR    = WWDG_CR_ADDR;
 volatile static WWDG_CFR_t    *REG_Watchdog_CFR   = WWDG_CFR_ADDR;
-//volatile static WWDG_SR_t     *REG_Watchdog_SR    = WWDG_SR_ADDR;
+volatile static WWDG_SR_t     *REG_Watchdog_SR    = WWDG_SR_ADDR;
 volatile static RCC_APB1ENR_t *REG_Watchdog_CLKEN = WWDG_CLK_EN_ADDR;
 volatile static RCC_CSR_t     *REG_Watchdog_reset = WWDG_RESET_ADDR;
 
+static volatile uint32_t sleep_refreshes = 0;
+
 void init_watchdog        ( void )
 {
+	//start the clock first, writes to an unclocked WWDG are lost
+	REG_Watchdog_CLKEN->WWDG = 1;
 	
 	REG_Watchdog_CR->T = 0x40 | WATCHDOG_RESET_VALUE;
 	
-	//We don't want to fire the interrupt
-	REG_Watchdog_CFR->EWI = 0;
+	//The early wakeup interrupt can't be turned off again once set. It stays
+	//masked in the NVIC except while a delay is asleep, see watchdog_refresh_in_sleep
+	REG_Watchdog_CFR->EWI = 1;
 	
 	
 	//divide clock by 8, for slowest reset clock
@@ -46,9 +51,6 @@ void init_watchdog        ( void )
 	//disable the window
 	REG_Watchdog_CFR->W = WATCHDOG_WINDOW_VALUE;
 	
-	//start the clock
-	REG_Watchdog_CLKEN->WWDG = 1;
-	
 	//finally, set the WDGA bit to enable the watchdog
 	REG_Watchdog_CR->WDGA = 1;
 }
@@ -81,11 +83,35 @@ void reset_watchdog       ( void )
 }
 
 
-//This IRQ will fire about 1ms before the watchdog expires.
+//The watchdog keeps counting in SLEEP. While enabled, the early wakeup interrupt
+//refreshes it, so a sleeping delay is only woken when the watchdog needs it.
+//Outside of a delay the interrupt stays masked, so a hang still resets the device.
+void watchdog_refresh_in_sleep(bool enable)
+{
+	if(enable)
+	{
+		reset_watchdog();
+		REG_Watchdog_SR->EWF = 0;
+		NVIC_ClearPendingIRQ(WWDG_IRQn);
+		NVIC_EnableIRQ(WWDG_IRQn);
+	}
+	else
+	{
+		NVIC_DisableIRQ(WWDG_IRQn);
+	}
+}
+
+uint32_t watchdog_sleep_refreshes(void)
+{
+	return sleep_refreshes;
+}
+
+//This IRQ fires one tick, about 16ms, before the watchdog expires.
 void WWDG_IRQHandler( void )
 {
-	//this is here in case we decide to use the interrupt at some
-	//point in the future
+	reset_watchdog();
+	REG_Watchdog_SR->EWF = 0;
+	sleep_refreshes++;
 }
 
 
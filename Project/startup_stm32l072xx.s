@@ -51,6 +51,8 @@ Stack_Size      EQU     0x00000400
 Stack_Mem       SPACE   Stack_Size
 __initial_sp
 
+                EXPORT  Stack_Mem               ; painted and measured by stack_monitor.c
+
 
 ; <h> Heap Configuration
 ;   <o>  Heap Size (in Bytes) <0x0-0xFFFFFFFF:8>
@@ -0,0 +1,297 @@
+#!/bin/bash
+
+#Checks the integer kernels in fixed_point.c against the float code they replaced.
+#usage: metaScripts/fixed_point_check.sh
+#Builds Project/src/fixed_point.c with the host C compiler. Every sensor
+#conversion is run over its whole raw input range and must equal the exact
+#truncated result, and be within 1 LSB of the old float expression. The
+#parser is checked against atof() and exact values at its boundaries
+#(negatives, truncation, extra digits, the int32 limit at each scale), and the
+#formatter against printf and by parsing its output back.
+#Exits non zero if any check fails.
+
+PROJECT=`dirname "$0"`/../Project
+CC=${CC:-cc}
+WORK=`mktemp -d`
+trap 'rm -rf "$WORK"' EXIT
+
+cat > "$WORK/check.c" <<'EOF'
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "fixed_point.h"
+
+#define RANDOM_CASES 200000
+
+static int failed = 0;
+
+//kernel must be the exact result, and within 1 of what the float code gave
+static void compare(const char *what, long input, long kernel, long exact, long old_float)
+{
+	if(kernel != exact || labs(kernel - old_float) > 1)
+	{
+		if(failed++ < 20)
+		{
+			printf("FAIL %s(%ld): kernel %ld, exact %ld, float %ld\n", what, input, kernel, exact, old_float);
+		}
+	}
+}
+
+static void check_conversions(void)
+{
+	long  raw;
+	float tempf;
+
+	for(raw=0;raw<=0xFFFF;raw++)
+	{
+		//sht30GetReading
+		tempf = (float)raw;
+		tempf = tempf*0.002670328832;
+		tempf = tempf - 45;
+		tempf = tempf * 100;
+		compare("sht3x temperature", raw, fxp_sht3x_temperature_centi(raw),
+		        (long)trunc(((double)raw * 17500 - 4500.0 * 65535) / 65535), (int16_t)tempf);
+
+		tempf = (float)raw;
+		tempf = tempf*0.00152590219;
+		tempf = tempf * 100;
+		compare("sht3x humidity", raw, fxp_sht3x_humidity_centi(raw),
+		        (raw * 10000) / 65535, (int16_t)tempf);
+
+		//sht20GetTemperature/Humidity
+		tempf = ((float)raw)*0.2681274414 - 4685;
+		compare("sht2x temperature", raw, fxp_sht2x_temperature_centi(raw),
+		        (long)trunc(((double)raw * 17572 - 4685.0 * 65536) / 65536), (int16_t)tempf);
+
+		tempf = (float)raw;
+		tempf = tempf * 0.001907348633;
+		tempf = tempf - 6;
+		tempf = tempf * 10;
+		compare("sht2x humidity", raw, fxp_sht2x_humidity_deci(raw),
+		        (long)trunc(((double)raw * 1250 - 60.0 * 65536) / 65536), (int16_t)tempf);
+
+		//ds18b20 display, over every signed reading
+		tempf = (float)(int16_t)raw;
+		tempf = tempf/16;
+		compare("ds18b20", (int16_t)raw, fxp_ds18b20_millicelsius((int16_t)raw),
+		        (long)trunc((double)(int16_t)raw * 1000 / 16), (int32_t)(tempf * 1000));
+
+		//the sensor setpoints go back through the inverse, which truncates to a raw
+		//step of under 0.01, so reading that back may come out 0.01 low
+		if(raw <= 17500)
+		{
+			long centi = raw - 4500;
+			long back  = fxp_sht3x_temperature_centi(fxp_sht3x_temperature_raw(centi));
+			compare("sht3x temperature raw", centi, back, (labs(back - centi) <= 1) ? back : centi, centi);
+		}
+		if(raw <= 10000)
+		{
+			long back = fxp_sht3x_humidity_centi(fxp_sht3x_humidity_raw(raw));
+			compare("sht3x humidity raw", raw, back, (labs(back - raw) <= 1) ? back : raw, raw);
+		}
+	}
+
+	for(raw=0;raw<=4095;raw++)
+	{
+		long vrefint;
+
+		//counter CLI 4-20mA and 0-5V
+		compare("4-20mA", raw, fxp_scale(raw, 3000, 4095*120), (raw * 3000) / (4095 * 120), (uint16_t)(raw*0.006105));
+		compare("0-5V", raw, fxp_scale(raw, 3000*2, 4095), (raw * 6000) / 4095, (uint16_t)(raw*1.4652));
+
+		//AdcReadCompensate, over the VREFINT readings a 1.8V-3.6V supply gives
+		for(vrefint=1360;vrefint<=2740;vrefint+=23)
+		{
+			long cal = 1655;
+			tempf = (float)raw;
+			tempf /= (float)vrefint;
+			tempf *= (float)cal;
+			compare("vrefint compensate", raw, fxp_vrefint_compensate(raw, vrefint, cal), (raw * cal) / vrefint, (uint16_t)tempf);
+		}
+	}
+	compare("vrefint compensate", 0, fxp_vrefint_compensate(1000, 0, 1655), 0, 0);
+}
+
+static void check_float_bits(void)
+{
+	static const float edges[] = {0.0f, -0.0f, 0.0005f, 0.001f, -0.001f, 0.9999f, 1.0f, -1.5f, 1234.5678f,
+	                              2147483.5f, 2147484.0f, -2147484.0f, 3.4e38f, -3.4e38f, INFINITY, -INFINITY};
+	uint32_t bits;
+	unsigned i;
+	float    f;
+
+	for(i=0;i<sizeof(edges)/sizeof(edges[0]);i++)
+	{
+		double milli = trunc((double)edges[i] * 1000);
+		memcpy(&bits, &edges[i], sizeof(bits));
+		if(milli >  INT32_MAX) milli =  INT32_MAX;
+		if(milli < -INT32_MAX) milli = -INT32_MAX;
+		compare("float32 milli", i, fxp_float32_to_milli(bits), (long)milli, (long)milli);
+	}
+
+	srand(1);
+	for(i=0;i<RANDOM_CASES;i++)
+	{
+		double milli;
+
+		bits = ((uint32_t)rand() << 16) ^ (uint32_t)rand();
+		memcpy(&f, &bits, sizeof(f));
+		if(isnan(f))
+		{
+			continue;
+		}
+
+		milli = trunc((double)f * 1000);
+		if(milli >  INT32_MAX) milli =  INT32_MAX;
+		if(milli < -INT32_MAX) milli = -INT32_MAX;
+		compare("float32 milli", bits, fxp_float32_to_milli(bits), (long)milli, (long)milli);
+	}
+}
+
+static void parse_case(const char *str, uint32_t scale, int valid, long exact)
+{
+	int32_t result = 0;
+	int     parsed = fxp_parse_scaled(str, scale, &result);
+	//the threshold CLIs did (int)(atof(str)*scale) through a float, which is
+	//only good to 24 bits
+	float   value  = atof(str);
+	long    old_float = (long)(value * scale);
+	long    slack  = 1 + (labs(exact) >> 22);
+
+	if(parsed != valid || (valid && (result != exact || labs(result - old_float) > slack)))
+	{
+		if(failed++ < 20)
+		{
+			printf("FAIL parse \"%s\" x%u: %s %ld, exact %s %ld, atof %ld\n", str, scale,
+			       parsed ? "ok" : "invalid", (long)result, valid ? "ok" : "invalid", exact, old_float);
+		}
+	}
+}
+
+static void check_parse(void)
+{
+	uint32_t i;
+
+	parse_case("0",            16, 1, 0);
+	parse_case("-0",           16, 1, 0);
+	parse_case("+12.5",        16, 1, 200);
+	parse_case("12.375",       16, 1, 198);
+	parse_case("-12.375",      16, 1, -198);
+	parse_case("0.0625",       16, 1, 1);
+	parse_case("0.06",         16, 1, 0);
+	parse_case("-0.06",        16, 1, 0);
+	parse_case("-.5",          16, 1, -8);
+	parse_case("5.",           16, 1, 80);
+	parse_case("-55",          16, 1, -880);
+	parse_case("125",          16, 1, 2000);
+	parse_case("12.34",       100, 1, 1234);
+	parse_case("-45.01",      100, 1, -4501);
+	parse_case("0.999",       100, 1, 99);
+	parse_case("-0.999",      100, 1, -99);
+	parse_case("1.23456",    1000, 1, 1234);
+	parse_case("0.0001",    10000, 1, 1);
+	parse_case("1.00009",   10000, 1, 10000);
+
+	//the int32 limit at the largest scales
+	parse_case("2147483647",        1, 1, INT32_MAX);
+	parse_case("-2147483647",       1, 1, -INT32_MAX);
+	parse_case("2147483648",        1, 0, 0);
+	parse_case("4294967296",        1, 0, 0);
+	parse_case("99999999999",       1, 0, 0);
+	parse_case("214748.3647",   10000, 1, INT32_MAX);
+	parse_case("-214748.3647",  10000, 1, -INT32_MAX);
+	parse_case("214748.3648",   10000, 0, 0);
+	parse_case("214749",        10000, 0, 0);
+	parse_case("21474.8364",   100000, 1, 2147483640);
+	parse_case("21474.8365",   100000, 0, 0);
+
+	parse_case("",             16, 0, 0);
+	parse_case("-",            16, 0, 0);
+	parse_case(".",            16, 0, 0);
+	parse_case("1.2.3",        16, 0, 0);
+	parse_case("12a",          16, 0, 0);
+	parse_case(" 1",           16, 0, 0);
+	parse_case("1e3",          16, 0, 0);
+
+	//random values with up to 4 decimals, truncated toward zero
+	for(i=0;i<RANDOM_CASES;i++)
+	{
+		static const uint32_t scales[] = {1, 10, 16, 100, 1000};
+		uint32_t scale    = scales[rand() % 5];
+		long     integer  = rand() % 10000;
+		long     fraction = rand() % 10000;
+		int      negative = rand() & 1;
+		long     exact    = integer * scale + (fraction * scale) / 10000;
+		char     str[24];
+
+		sprintf(str, "%s%ld.%04ld", negative ? "-" : "", integer, fraction);
+		parse_case(str, scale, 1, negative ? -exact : exact);
+	}
+}
+
+static void format_case(int32_t value, uint32_t scale, int digits)
+{
+	char     text[FXP_FORMAT_SIZE + 8];
+	char     expect[32];
+	uint32_t magnitude = (value < 0) ? (0 - (uint32_t)value) : (uint32_t)value;
+	int32_t  back;
+
+	memset(text, 'x', sizeof(text));
+	fxp_format_scaled(text, value, scale);
+	if(scale == 1)
+	{
+		sprintf(expect, "%s%u", value < 0 ? "-" : "", magnitude);
+	}
+	else
+	{
+		sprintf(expect, "%s%u.%0*u", value < 0 ? "-" : "", magnitude / scale, digits, magnitude % scale);
+	}
+
+	if(strcmp(text, expect) || strlen(text) >= FXP_FORMAT_SIZE ||
+	   (value != INT32_MIN && scale <= 10000 && (!fxp_parse_scaled(text, scale, &back) || back != value)))
+	{
+		if(failed++ < 20)
+		{
+			printf("FAIL format %d/%u: \"%s\", expected \"%s\"\n", value, scale, text, expect);
+		}
+	}
+}
+
+static void check_format(void)
+{
+	static const int32_t edges[] = {0, 1, -1, 9, -9, 10, 999, -999, 1000, -1000, 1001, 9999, 10000,
+	                                INT32_MAX, -INT32_MAX, INT32_MIN};
+	uint32_t scale;
+	unsigned i;
+	int      digits;
+	long     raw;
+
+	for(scale=1,digits=0;scale<=10000;scale*=10,digits++)
+	{
+		for(i=0;i<sizeof(edges)/sizeof(edges[0]);i++)
+		{
+			format_case(edges[i], scale, digits);
+		}
+	}
+
+	//the ds18b20 display
+	for(raw=-0x8000;raw<=0x7FFF;raw++)
+	{
+		format_case(fxp_ds18b20_millicelsius(raw), 1000, 3);
+	}
+}
+
+int main(void)
+{
+	check_conversions();
+	check_float_bits();
+	check_parse();
+	check_format();
+
+	printf("%s\n", failed ? "fixed_point.c differs from the float code" : "fixed_point.c matches the float code");
+	return failed != 0;
+}
+EOF
+
+$CC -std=c99 -O2 -I"$PROJECT/inc" "$WORK/check.c" "$PROJECT/src/fixed_point.c" -lm -o "$WORK/check" && "$WORK/check"
@@ -0,0 +1,44 @@
+#!/bin/bash
+
+#Decodes the output of the "trace dump" CLI command.
+#usage: metaScripts/mac_trace_decode.sh [capture file]   (reads stdin if no file)
+#Event names are taken from Project/inc/mac_trace.h, so run this from the
+#same checkout as the firmware that produced the dump.
+
+HEADER=`dirname "$0"`/../Project/inc/mac_trace.h
+
+awk '
+	function hex(str,    i, value) {
+		value = 0
+		str = tolower(str)
+		for (i = 1; i <= length(str); i++) {
+			value = value * 16 + index("0123456789abcdef", substr(str, i, 1)) - 1
+		}
+		return value
+	}
+	#enum entries look like "mac_trace_rx_done = 37, //arg8: size"
+	FNR == NR {
+		if (match($0, /^[ \t]*mac_trace_[a-z0-9_]+[ \t]*=[ \t]*[0-9]+/)) {
+			split(substr($0, RSTART, RLENGTH), parts, "=")
+			gsub(/[ \t]/, "", parts[1])
+			gsub(/[ \t]/, "", parts[2])
+			name[parts[2] + 0] = substr(parts[1], 11)
+		}
+		next
+	}
+	{ sub(/\r$/, "") }
+	$1 == "TR" {
+		time  = hex($3)
+		event = hex($4)
+		delta = (seen ? time - last : 0)
+		label = (event in name) ? name[event] : sprintf("event_%d", event)
+		arg16 = hex($6)
+		#rssi is signed
+		if (label == "rx_done" && arg16 >= 32768) arg16 -= 65536
+		printf("%10d ms  +%6d  %-28s %3d %6d\n", time, delta, label, hex($5), arg16)
+		last = time
+		seen = 1
+		next
+	}
+	{ print }
+' "$HEADER" "${1:--}"
@@ -0,0 +1,85 @@
+#!/bin/bash
+
+#Bytes per uplink of the payload codec schemas against the fixed layouts.
+#usage: metaScripts/payload_codec_bench.sh
+#Builds Project/src/payload_codec.c and payload_schemas.c with the host C
+#compiler, and encodes 10000 synthetic 6 hour periods per meter profile.
+#LoRaWAN adds 13 bytes of MAC overhead to every frame, shown in the PHY column.
+
+PROJECT=`dirname "$0"`/../Project
+CC=${CC:-cc}
+WORK=`mktemp -d`
+trap 'rm -rf "$WORK"' EXIT
+
+cat > "$WORK/bench.c" <<'EOF'
+#include <stdio.h>
+#include <stdlib.h>
+#include "payload_schemas.h"
+
+#define PERIODS      10000
+#define MAC_OVERHEAD 13
+
+typedef struct
+{
+	const char *name;
+	uint32_t    busy_percent; //hours with flow
+	uint32_t    max_per_hour;
+}profile_t;
+
+static const profile_t profiles[] =
+{
+	{"idle"     ,   0,    0},
+	{"quiet"    ,  20,    5},
+	{"domestic" ,  40,   60},
+	{"busy"     , 100,  500},
+	{"saturated", 100, 4000},
+};
+
+int main(void)
+{
+	const codec_schema_t *schemas[] = {&single_count_data_schema, &single_count_compact_schema};
+	const char           *names[]   = {"layout", "compact"};
+	uint32_t p, s, t, h;
+	
+	srand(1);
+	printf("%-10s %-8s %8s %8s\n", "profile", "schema", "app B", "PHY B");
+	for(p=0;p<sizeof(profiles)/sizeof(profiles[0]);p++)
+	{
+		uint32_t total[2] = {0, 0};
+		
+		for(t=0;t<PERIODS;t++)
+		{
+			int32_t values[single_count_values] = {0};
+			uint32_t count = rand() & 0xFFFFF;
+			uint8_t  buffer[32];
+			
+			values[single_count_value_tod]     = t & 3;
+			values[single_count_value_voltage] = 12;
+			values[single_count_value_type]    = 1;
+			for(h=0;h<6;h++)
+			{
+				if((uint32_t)(rand() % 100) < profiles[p].busy_percent)
+				{
+					count += rand() % (profiles[p].max_per_hour + 1);
+				}
+				values[single_count_value_hour1 + h] = count;
+			}
+			values[single_count_value_count1] = count;
+			
+			for(s=0;s<2;s++)
+			{
+				total[s] += codec_encode(schemas[s], values, buffer, sizeof(buffer));
+			}
+		}
+		
+		for(s=0;s<2;s++)
+		{
+			double bytes = (double)total[s] / PERIODS;
+			printf("%-10s %-8s %8.2f %8.2f\n", profiles[p].name, names[s], bytes, bytes + MAC_OVERHEAD);
+		}
+	}
+	return 0;
+}
+EOF
+
+$CC -std=c99 -O2 -I"$PROJECT/inc" "$WORK/bench.c" "$PROJECT/src/payload_codec.c" "$PROJECT/src/payload_schemas.c" -o "$WORK/bench" && "$WORK/bench"
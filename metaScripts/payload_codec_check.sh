@@ -0,0 +1,130 @@
+#!/bin/bash
+
+#Checks the payload codec against the bitfield layout it stands in for.
+#usage: metaScripts/payload_codec_check.sh
+#Builds Project/src/payload_codec.c and payload_schemas.c with the host C
+#compiler, and encodes single_count_data_schema next to the hand written
+#single_count_data_t packing it replaced, for the counter boundaries and
+#100000 random periods. Exits non zero on the first frame that differs.
+
+PROJECT=`dirname "$0"`/../Project
+CC=${CC:-cc}
+WORK=`mktemp -d`
+trap 'rm -rf "$WORK"' EXIT
+
+cat > "$WORK/check.c" <<'EOF'
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "payload_schemas.h"
+
+#define PERIODS   100000
+#define DELTA_MAX 0x7FF
+
+//single_count_data_t from packets.h, which needs the device headers
+typedef union
+{
+	uint8_t payload[12];
+	struct
+	{
+		uint64_t
+			Count1      :27,
+			leak        :1,
+			reserved    :3,
+			Delta6      :11,
+			Delta5      :11,
+			Delta4      :11;
+		uint32_t
+			Delta3      :11,
+			Delta2      :11,
+			pkt_tod     :2,
+			sys_voltage :4,
+			pkt_type    :4;
+	}__attribute__((packed)) members;
+}legacy_t;
+
+//the clamps single_counter_uplink had before the codec
+static uint32_t legacy_delta(uint32_t to, uint32_t from)
+{
+	uint32_t x = to - from;
+	return (x <= DELTA_MAX) ? x : DELTA_MAX;
+}
+
+static int check(const int32_t values[], const char *what)
+{
+	legacy_t legacy;
+	uint8_t  buffer[sizeof(legacy.payload)];
+	int      i;
+
+	memset(&legacy, 0, sizeof(legacy));
+	legacy.members.Count1      = (uint32_t)values[single_count_value_count1];
+	legacy.members.leak        = values[single_count_value_leak];
+	legacy.members.Delta2      = legacy_delta(values[single_count_value_hour2], values[single_count_value_hour1]);
+	legacy.members.Delta3      = legacy_delta(values[single_count_value_hour3], values[single_count_value_hour2]);
+	legacy.members.Delta4      = legacy_delta(values[single_count_value_hour4], values[single_count_value_hour3]);
+	legacy.members.Delta5      = legacy_delta(values[single_count_value_hour5], values[single_count_value_hour4]);
+	legacy.members.Delta6      = legacy_delta(values[single_count_value_hour6], values[single_count_value_hour5]);
+	legacy.members.pkt_tod     = values[single_count_value_tod];
+	legacy.members.sys_voltage = values[single_count_value_voltage];
+	legacy.members.pkt_type    = values[single_count_value_type];
+
+	if(codec_encode(&single_count_data_schema, values, buffer, sizeof(buffer)) != sizeof(buffer) ||
+	   memcmp(buffer, legacy.payload, sizeof(buffer)))
+	{
+		printf("FAIL %s, count1 0x%08X\n  codec :", what, (uint32_t)values[single_count_value_count1]);
+		for(i=0;i<(int)sizeof(buffer);i++) printf(" %02X", buffer[i]);
+		printf("\n  layout:");
+		for(i=0;i<(int)sizeof(buffer);i++) printf(" %02X", legacy.payload[i]);
+		printf("\n");
+		return 1;
+	}
+	return 0;
+}
+
+static void fill(int32_t values[], uint32_t count, uint32_t step)
+{
+	int h;
+
+	memset(values, 0, single_count_values * sizeof(int32_t));
+	for(h=0;h<6;h++)
+	{
+		values[single_count_value_hour1 + h] = (int32_t)(count + h * step);
+	}
+	values[single_count_value_count1]  = (int32_t)count;
+	values[single_count_value_leak]    = count & 1;
+	values[single_count_value_tod]     = count & 3;
+	values[single_count_value_voltage] = 12;
+	values[single_count_value_type]    = 1;
+}
+
+int main(void)
+{
+	//either side of the 27 bit count, and where a uint32_t count rolls over
+	static const uint32_t counts[] = {0, 0x07FFFFFE, 0x07FFFFFF, 0x08000000, 0x08000005, 0x0FFFFFFF, 0x7FFFFFFF, 0x80000000, 0xFFFFFFFF};
+	int32_t  values[single_count_values];
+	uint32_t i;
+	int      failed = 0;
+
+	for(i=0;i<sizeof(counts)/sizeof(counts[0]);i++)
+	{
+		fill(values, counts[i], 1);
+		failed |= check(values, "count boundary");
+		fill(values, counts[i], DELTA_MAX + 1);
+		failed |= check(values, "saturated deltas");
+		fill(values, counts[i], (uint32_t)-1);
+		failed |= check(values, "count went backwards");
+	}
+
+	srand(1);
+	for(i=0;i<PERIODS && !failed;i++)
+	{
+		fill(values, ((uint32_t)rand() << 16) ^ (uint32_t)rand(), rand() % (2 * DELTA_MAX));
+		failed |= check(values, "random period");
+	}
+
+	printf("%s\n", failed ? "single_count_data_schema differs from single_count_data_t" : "single_count_data_schema matches single_count_data_t");
+	return failed;
+}
+EOF
+
+$CC -std=c99 -O2 -I"$PROJECT/inc" "$WORK/check.c" "$PROJECT/src/payload_codec.c" "$PROJECT/src/payload_schemas.c" -o "$WORK/check" && "$WORK/check"
@@ -0,0 +1,146 @@
+#!/bin/bash
+
+#Generates JavaScript decoders for the payload codec schemas.
+#usage: metaScripts/payload_decoder_gen.sh > payload_decoders.js
+#One decode_<schema>(bytes) function is written per CODEC_SCHEMA in
+#Project/src/payload_schemas.c. bytes are in the order they were received.
+#A field with a delta has the field it was taken from added back.
+#A table of part schemas, <frame>_part_schemas[], also gets a decode_<frame>
+#that reads <frame>_header_schema, every part whose bit is set in the header's
+#components field, then <frame>_trailer_schema. A <frame>_channel_schema gets a
+#decode_<frame> that reads the header, the channel schema once for each of the
+#header's channels into out.channel[], then the trailer.
+
+SCHEMAS=`dirname "$0"`/../Project/src/payload_schemas.c
+
+awk '
+	BEGIN {
+		print "// Generated by metaScripts/payload_decoder_gen.sh from Project/src/payload_schemas.c"
+		print ""
+		print "// the device sends the payload last byte first, fields are packed LSB first from that last byte"
+		print "function codec_reader(bytes) { return { data: bytes.slice().reverse(), bit: 0 }; }"
+		print "function codec_bits(r, width) {"
+		print "  var value = 0;"
+		print "  for (var i = 0; i < width; i++, r.bit++) {"
+		print "    if ((r.data[r.bit >> 3] >> (r.bit & 7)) & 1) value += Math.pow(2, i);"
+		print "  }"
+		print "  return value;"
+		print "}"
+		print "function codec_varint(r, width) {"
+		print "  var more = Math.pow(2, width - 1), value = 0, shift = 1, group;"
+		print "  do {"
+		print "    group = codec_bits(r, width);"
+		print "    value += (group % more) * shift;"
+		print "    shift *= more;"
+		print "  } while (group >= more);"
+		print "  return value;"
+		print "}"
+		print "function codec_signed(value, width) { return value >= Math.pow(2, width - 1) ? value - Math.pow(2, width) : value; }"
+		print "function codec_unzigzag(value) { return (value % 2) ? -(value + 1) / 2 : value / 2; }"
+		print "function codec_align(r) { r.bit = (r.bit + 7) & ~7; }"
+	}
+	{ sub(/\r$/, "") }
+	#static const codec_field_t single_count_data_fields[] =
+	/codec_field_t[ \t]+[A-Za-z0-9_]+\[\]/ {
+		match($0, /[A-Za-z0-9_]+\[\]/)
+		table = substr($0, RSTART, RLENGTH - 2)
+		count[table] = 0
+		next
+	}
+	#CODEC_FIELD(name, source, delta, width, flags, scale),
+	/^[ \t]*CODEC_FIELD\(/ {
+		line = $0
+		sub(/^[ \t]*CODEC_FIELD\(/, "", line)
+		sub(/\)[ \t]*,?[ \t]*$/, "", line)
+		n = split(line, part, ",")
+		for (i = 1; i <= n; i++) gsub(/^[ \t]+|[ \t]+$/, "", part[i])
+		c = count[table]++
+		name[table, c]   = part[1]
+		source[table, c] = part[2]
+		delta[table, c]  = part[3]
+		width[table, c]  = part[4]
+		flags[table, c]  = part[5]
+		scale[table, c]  = part[6]
+		next
+	}
+	#CODEC_SCHEMA(single_count_data_schema, single_count_data_fields);
+	/^[ \t]*CODEC_SCHEMA\(/ {
+		line = $0
+		sub(/^[ \t]*CODEC_SCHEMA\(/, "", line)
+		sub(/\).*$/, "", line)
+		split(line, part, ",")
+		gsub(/[ \t]/, "", part[1])
+		gsub(/[ \t]/, "", part[2])
+		t = part[2]
+		print ""
+		printf("function read_%s(r, out) {\n", part[1])
+		for (i = 0; i < count[t]; i++) {
+			f = flags[t, i]
+			if (index(f, "CODEC_ALIGN")) print "  codec_align(r);"
+			if (index(f, "CODEC_VARINT")) {
+				read = sprintf("codec_varint(r, %d)", width[t, i])
+				if (index(f, "CODEC_SIGNED")) read = "codec_unzigzag(" read ")"
+			} else {
+				read = sprintf("codec_bits(r, %d)", width[t, i])
+				if (index(f, "CODEC_SIGNED")) read = sprintf("codec_signed(%s, %d)", read, width[t, i])
+			}
+			if (source[t, i] == "CODEC_NONE") {
+				printf("  %s;\n", read)
+				continue
+			}
+			if (scale[t, i] + 0 > 1) read = sprintf("%s * %d", read, scale[t, i])
+			for (j = 0; j < i && delta[t, i] != "CODEC_NONE"; j++) {
+				if (source[t, j] == delta[t, i]) {
+					read = sprintf("%s + out.%s", read, name[t, j])
+					break
+				}
+			}
+			printf("  out.%s = %s;\n", name[t, i], read)
+		}
+		print "  return out;"
+		print "}"
+		printf("function decode_%s(bytes) { return read_%s(codec_reader(bytes), {}); }\n", part[1], part[1])
+		if (part[1] ~ /_channel_schema$/) {
+			channel_frame[channel_frames++] = substr(part[1], 1, length(part[1]) - length("_channel_schema"))
+		}
+		next
+	}
+	#const codec_schema_t * const composite_part_schemas[composite_parts] =
+	/codec_schema_t[ \t]*\*[ \t]*const[ \t]+[A-Za-z0-9_]+_part_schemas\[/ {
+		match($0, /[A-Za-z0-9_]+_part_schemas\[/)
+		frame = substr($0, RSTART, RLENGTH - length("_part_schemas["))
+		parts = 0
+		next
+	}
+	#	&composite_counter_schema,
+	frame != "" && /^[ \t]*&[A-Za-z0-9_]+[ \t]*,?[ \t]*$/ {
+		line = $0
+		gsub(/[ \t&,]/, "", line)
+		part_name[parts++] = line
+		next
+	}
+	frame != "" && /^[ \t]*};/ {
+		print ""
+		printf("function decode_%s(bytes) {\n", frame)
+		printf("  var r = codec_reader(bytes), out = read_%s_header_schema(r, {});\n", frame)
+		for (i = 0; i < parts; i++) {
+			printf("  if ((out.components >> %d) & 1) read_%s(r, out);\n", i, part_name[i])
+		}
+		printf("  return read_%s_trailer_schema(r, out);\n", frame)
+		print "}"
+		frame = ""
+		next
+	}
+	END {
+		for (i = 0; i < channel_frames; i++) {
+			f = channel_frame[i]
+			print ""
+			printf("function decode_%s(bytes) {\n", f)
+			printf("  var r = codec_reader(bytes), out = read_%s_header_schema(r, {});\n", f)
+			print "  out.channel = [];"
+			printf("  for (var i = 0; i < out.channels; i++) out.channel.push(read_%s_channel_schema(r, {}));\n", f)
+			printf("  return read_%s_trailer_schema(r, out);\n", f)
+			print "}"
+		}
+	}
+' "$SCHEMAS"
@@ -0,0 +1,58 @@
+#!/bin/bash
+
+#Summarises RAM use from the linker map of a Keil build.
+#usage: metaScripts/ram_map.sh [map file] [symbol count]
+#With no map file the newest Lora.map under Project/build is used. Lists the
+#largest RAM symbols, the RAM taken by each object, and the stack and heap
+#reserved by the startup file, so growth shows up before it reaches the stack.
+
+MAP=$1
+COUNT=${2:-20}
+#STM32L072 SRAM
+RAM_SIZE=20480
+
+if [ -z "$MAP" ]; then
+	MAP=`find "$(dirname "$0")/../Project/build" -name Lora.map -printf '%T@ %p\n' 2>/dev/null | sort -nr | head -1 | cut -d' ' -f2-`
+fi
+if [ ! -f "$MAP" ]; then
+	echo "no map file, build the target first or pass the .map path" >&2
+	exit 1
+fi
+echo "Map: $MAP"
+
+SYMBOLS=`mktemp`
+trap 'rm -f "$SYMBOLS"' EXIT
+
+#symbol table lines look like "arena    0x20000a10   Data   260  buffer_arena.o(.bss)",
+#with the Ov column sometimes present, so the fields are taken from the end
+awk '
+	{ sub(/\r$/, "") }
+	/Image Symbol Table/ { in_table = 1; next }
+	in_table && $2 ~ /^0x2000[0-9a-fA-F]+$/ && $(NF-2) == "Data" && $(NF-1) > 0 {
+		object = $NF
+		sub(/\(.*$/, "", object)
+		print $(NF-1), $1, object
+	}
+' "$MAP" | sort -nr > "$SYMBOLS"
+
+echo
+echo "Largest RAM symbols:"
+head -n "$COUNT" "$SYMBOLS" | awk '{ printf("%8d  %-36s %s\n", $1, $2, $3) }'
+
+echo
+echo "RAM by object:"
+awk '{ total[$3] += $1 } END { for (o in total) printf("%8d  %s\n", total[o], o) }' "$SYMBOLS" | sort -nr
+
+echo
+awk -v ram="$RAM_SIZE" '
+	{ sub(/\r$/, "") }
+	$1 == "Stack_Mem" { stack = $(NF-1) }
+	$1 == "Heap_Mem"  { heap  = $(NF-1) }
+	/Total RW  Size/  { rw = $(NF-2) + 0 }
+	END {
+		printf("Stack reserved           :%d\n", stack)
+		printf("Heap reserved            :%d\n", heap)
+		printf("RW+ZI total              :%d\n", rw)
+		printf("RAM unallocated          :%d of %d\n", ram - rw, ram)
+	}
+' "$MAP"
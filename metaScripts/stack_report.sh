@@ -0,0 +1,78 @@
+#!/bin/bash
+
+#Worst case stack per entry point, from the armlink call graph (Lora.htm).
+#usage: metaScripts/stack_report.sh [Lora.htm ...]
+#With no files every Lora.htm under Project/build is reported, one per Keil
+#target. The worst case is main plus the deepest handler at each of the four
+#Cortex-M0+ priority levels, each with its 32 byte exception frame. Calls
+#through function pointers (timer callbacks, the LoRaMac callbacks) are not in
+#the call graph, so any figure marked unknown is a lower bound; check it
+#against "stack" on a device that has been running for a while.
+
+ROOT=`dirname "$0"`/..
+NVIC_LEVELS=4
+FRAME=32
+RESERVED=$((`awk '$1 == "Stack_Size" { print $3 }' "$ROOT/Project/startup_stm32l072xx.s" | tr -d '\r'`))
+
+if [ $# -eq 0 ]; then
+	set -- `find "$ROOT/Project/build" -name Lora.htm 2>/dev/null | sort`
+fi
+if [ $# -eq 0 ]; then
+	echo "no call graph, build with --callgraph (set in Lora.uvprojx) or pass the .htm path" >&2
+	exit 1
+fi
+
+for HTM in "$@"; do
+	echo "$HTM"
+	#functions look like "<STRONG><a name="[5a]"></a>main</STRONG> (Thumb, 96 bytes, Stack size 8 bytes, ..."
+	#followed, if they call anything, by "<LI>Max Depth = 568 + Unknown Stack Size"
+	awk -v levels="$NVIC_LEVELS" -v frame="$FRAME" -v reserved="$RESERVED" '
+		function finish() {
+			if (name != "") {
+				depth[name]   = (max != "") ? max : own
+				unknown[name] = unk
+			}
+			name = ""; max = ""; own = 0; unk = 0
+		}
+		{ sub(/\r$/, "") }
+		/<STRONG><a name=/ {
+			finish()
+			line = $0
+			sub(/^.*<\/a>/, "", line)
+			name = line
+			sub(/<\/STRONG>.*$/, "", name)
+			if (match(line, /Stack size [0-9]+ bytes/)) {
+				own = substr(line, RSTART + 11, RLENGTH - 17) + 0
+			}
+			next
+		}
+		name != "" && /Max Depth = / {
+			line = $0
+			sub(/^.*Max Depth = /, "", line)
+			max = line + 0
+			if (line ~ /Unknown/) unk = 1
+		}
+		END {
+			finish()
+			if (!("main" in depth)) { print "  no main in the call graph"; exit }
+			printf("  %-32s %6d%s\n", "main", depth["main"], unknown["main"] ? "  +unknown" : "")
+			count = 0
+			for (f in depth) {
+				if (f ~ /_IRQHandler$/) handler[++count] = f
+			}
+			#deepest first
+			for (i = 1; i <= count; i++) {
+				for (j = i + 1; j <= count; j++) {
+					if (depth[handler[j]] > depth[handler[i]]) { t = handler[i]; handler[i] = handler[j]; handler[j] = t }
+				}
+			}
+			worst = depth["main"]
+			for (i = 1; i <= count; i++) {
+				printf("  %-32s %6d%s\n", handler[i], depth[handler[i]], unknown[handler[i]] ? "  +unknown" : "")
+				if (i <= levels) worst += depth[handler[i]] + frame
+			}
+			printf("  %-32s %6d of %d reserved, %d spare\n", "worst case", worst, reserved, reserved - worst)
+		}
+	' "$HTM"
+	echo
+done